@@ -45,9 +45,11 @@
 #define FISH_MV_FILE            "mv"
 #define FISH_HARDLINK_FILE      "hardlink"
 #define FISH_GET_FILE           "get"
+#define FISH_READ_FILE          "read"
 #define FISH_SEND_FILE          "send"
 #define FISH_APPEND_FILE        "append"
 #define FISH_INFO_FILE          "info"
+#define FISH_LSTREE_FILE        "lstree"
 
 #define MC_EXTFS_DIR            "extfs.d"
 
@@ -62,6 +64,7 @@
 #define MC_PANELS_FILE          "panels.ini"
 #define MC_FHL_INI_FILE         "filehighlight.ini"
 #define MC_SKINS_SUBDIR         "skins"
+#define MC_VFS_INDEX_DIR        "vfs-index"
 
 /* editor home directory */
 #define EDIT_DIR                "mcedit"
@@ -112,6 +112,7 @@ mc_global_t mc_global = {
     {
         .cd_symlinks = TRUE,
         .preallocate_space = FALSE,
+        .archive_index = FALSE,
     }
 
 };
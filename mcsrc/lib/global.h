@@ -312,6 +312,9 @@ typedef struct
         /* Preallocate space before file copying */
         gboolean preallocate_space;
 
+        /* Keep persistent listing index of scanned archives */
+        gboolean archive_index;
+
     } vfs;
 } mc_global_t;
 
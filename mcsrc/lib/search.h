@@ -55,6 +55,9 @@ typedef enum
 typedef mc_search_cbret_t (*mc_search_fn) (const void *user_data, gsize char_offset,
                                            int *current_char);
 typedef mc_search_cbret_t (*mc_update_fn) (const void *user_data, gsize char_offset);
+/* Get data starting at offset: point *block to it and set *len to the length of it */
+typedef mc_search_cbret_t (*mc_search_block_fn) (const void *user_data, gsize offset,
+                                                 const char **block, gsize * len);
 
 
 /*** structures declarations (and typedefs of structures)*****************************************/
@@ -83,6 +86,9 @@ typedef struct mc_search_struct
     /* function, used for getting data. NULL if not used */
     mc_search_fn search_fn;
 
+    /* function, used for getting data by blocks instead of search_fn. NULL if not used */
+    mc_search_block_fn search_block_fn;
+
     /* function, used for updatin current search status. NULL if not used */
     mc_update_fn update_fn;
 
@@ -30,6 +30,9 @@ typedef struct mc_search_cond_struct
     GString *lower;
     mc_search_regex_t *regex_handle;
     gchar *charset;
+    /* string which can be found in data as is, without regex; NULL if there is none */
+    GString *plain;
+    gboolean plain_caseless;    /* ASCII letters of plain are matched in either case */
 } mc_search_cond_t;
 
 /*** global variables defined in .c file *********************************************************/
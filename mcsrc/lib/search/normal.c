@@ -26,6 +26,8 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include "lib/global.h"
 #include "lib/strutil.h"
 #include "lib/search.h"
@@ -87,6 +89,20 @@ mc_search__cond_struct_new_init_normal (const char *charset, mc_search_t * lc_mc
                                         mc_search_cond_t * mc_search_cond)
 {
     GString *tmp;
+    gboolean is_ascii = TRUE;
+    gsize loop;
+
+    for (loop = 0; loop < mc_search_cond->str->len && is_ascii; loop++)
+        is_ascii = (unsigned char) mc_search_cond->str->str[loop] < 0x80;
+
+    /* text without line breaks can be found in data blocks without regex */
+    if (!lc_mc_search->whole_words && (lc_mc_search->is_case_sensitive || is_ascii)
+        && memchr (mc_search_cond->str->str, '\n', mc_search_cond->str->len) == NULL)
+    {
+        mc_search_cond->plain = g_string_new_len (mc_search_cond->str->str,
+                                                  mc_search_cond->str->len);
+        mc_search_cond->plain_caseless = !lc_mc_search->is_case_sensitive;
+    }
 
     tmp = mc_search__normal_translate_to_regex (mc_search_cond->str);
     g_string_free (mc_search_cond->str, TRUE);
@@ -29,6 +29,7 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "lib/global.h"
 #include "lib/strutil.h"
@@ -46,6 +47,9 @@
 #define REPLACE_PREPARE_T_REPLACE_FLAG    -2
 #define REPLACE_PREPARE_T_ESCAPE_SEQ      -3
 
+/* largest part of data searched between calls of update_fn */
+#define SEARCH_BLOCK_MAX (256 * 1024)
+
 /*** file scope type declarations ****************************************************************/
 
 typedef enum
@@ -320,13 +324,13 @@ mc_search__g_regex_match_full_safe (const GRegex * regex,
 
 static mc_search__found_cond_t
 mc_search__regex_found_cond_one (mc_search_t * lc_mc_search, mc_search_regex_t * regex,
-                                 GString * search_str)
+                                 const char *search_str, gsize search_len)
 {
 #ifdef SEARCH_TYPE_GLIB
     GError *mcerror = NULL;
 
     if (!mc_search__g_regex_match_full_safe
-        (regex, search_str->str, search_str->len, 0, G_REGEX_MATCH_NEWLINE_ANY,
+        (regex, search_str, search_len, 0, G_REGEX_MATCH_NEWLINE_ANY,
          &lc_mc_search->regex_match_info, &mcerror))
     {
         g_match_info_free (lc_mc_search->regex_match_info);
@@ -345,7 +349,7 @@ mc_search__regex_found_cond_one (mc_search_t * lc_mc_search, mc_search_regex_t *
     lc_mc_search->num_results = g_match_info_get_match_count (lc_mc_search->regex_match_info);
 #else /* SEARCH_TYPE_GLIB */
     lc_mc_search->num_results = pcre_exec (regex, lc_mc_search->regex_match_info,
-                                           search_str->str, search_str->len, 0, 0,
+                                           search_str, search_len, 0, 0,
                                            lc_mc_search->iovector, MC_SEARCH__NUM_REPLACE_ARGS);
     if (lc_mc_search->num_results < 0)
     {
@@ -359,7 +363,7 @@ mc_search__regex_found_cond_one (mc_search_t * lc_mc_search, mc_search_regex_t *
 /* --------------------------------------------------------------------------------------------- */
 
 static mc_search__found_cond_t
-mc_search__regex_found_cond (mc_search_t * lc_mc_search, GString * search_str)
+mc_search__regex_found_cond (mc_search_t * lc_mc_search, const char *search_str, gsize search_len)
 {
     gsize loop1;
 
@@ -375,13 +379,312 @@ mc_search__regex_found_cond (mc_search_t * lc_mc_search, GString * search_str)
 
         ret =
             mc_search__regex_found_cond_one (lc_mc_search, mc_search_cond->regex_handle,
-                                             search_str);
+                                             search_str, search_len);
         if (ret != COND__NOT_FOUND)
             return ret;
     }
     return COND__NOT_ALL_FOUND;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/* Match conditions against a line of data starting at offset */
+
+static mc_search__found_cond_t
+mc_search__regex_found_line (mc_search_t * lc_mc_search, const char *line, gsize len,
+                             gsize offset, gsize * found_len)
+{
+    mc_search__found_cond_t ret;
+    gint start_pos;
+    gint end_pos;
+
+    lc_mc_search->start_buffer = offset;
+
+    ret = mc_search__regex_found_cond (lc_mc_search, line, len);
+    if (ret == COND__FOUND_OK)
+    {
+#ifdef SEARCH_TYPE_GLIB
+        g_match_info_fetch_pos (lc_mc_search->regex_match_info, 0, &start_pos, &end_pos);
+#else /* SEARCH_TYPE_GLIB */
+        start_pos = lc_mc_search->iovector[0];
+        end_pos = lc_mc_search->iovector[1];
+#endif /* SEARCH_TYPE_GLIB */
+        if (found_len != NULL)
+            *found_len = end_pos - start_pos;
+        lc_mc_search->normal_offset = offset + start_pos;
+    }
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/* Search lines of a block of data. The part of last line which continues in the next block
+   is kept in regex_buffer */
+
+static mc_search__found_cond_t
+mc_search__regex_found_block (mc_search_t * lc_mc_search, const char *block, gsize len,
+                              gsize offset, gsize * found_len)
+{
+    GString *carry = lc_mc_search->regex_buffer;
+    const char *p = block;
+    const char *end = block + len;
+
+    while (p < end)
+    {
+        const char *eol;
+        mc_search__found_cond_t ret;
+
+        eol = memchr (p, '\n', end - p);
+        if (eol == NULL)
+        {
+            if (carry->len == 0)
+                lc_mc_search->start_buffer = offset + (p - block);
+            g_string_append_len (carry, p, end - p);
+            break;
+        }
+
+        eol++;
+
+        if (carry->len == 0)
+            ret = mc_search__regex_found_line (lc_mc_search, p, eol - p, offset + (p - block),
+                                               found_len);
+        else
+        {
+            g_string_append_len (carry, p, eol - p);
+            ret = mc_search__regex_found_line (lc_mc_search, carry->str, carry->len,
+                                               lc_mc_search->start_buffer, found_len);
+            g_string_set_size (carry, 0);
+        }
+
+        if (ret != COND__NOT_ALL_FOUND)
+            return ret;
+
+        p = eol;
+    }
+
+    return COND__NOT_ALL_FOUND;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static const char *
+mc_search__plain_find (const mc_search_cond_t * mc_search_cond, const char *data, gsize len)
+{
+    const char *str = mc_search_cond->plain->str;
+    gsize str_len = mc_search_cond->plain->len;
+    const char *p, *last;
+
+    if (len < str_len)
+        return NULL;
+
+#ifdef HAVE_MEMMEM
+    if (!mc_search_cond->plain_caseless)
+        return (const char *) memmem (data, len, str, str_len);
+#endif
+
+    last = data + len - str_len;
+
+    if (!mc_search_cond->plain_caseless)
+    {
+        for (p = data; p <= last; p++)
+        {
+            p = (const char *) memchr (p, str[0], last - p + 1);
+            if (p == NULL)
+                break;
+            if (memcmp (p, str, str_len) == 0)
+                return p;
+        }
+
+        return NULL;
+    }
+
+    for (p = data; p <= last; p++)
+        if (g_ascii_tolower (*p) == g_ascii_tolower (str[0])
+            && g_ascii_strncasecmp (p, str, str_len) == 0)
+            return p;
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/* Find the first of plain strings of conditions in data */
+
+static gboolean
+mc_search__plain_find_first (mc_search_t * lc_mc_search, const char *data, gsize len,
+                             gsize * pos, gsize * found_len)
+{
+    const char *found = NULL;
+    gsize loop1;
+
+    for (loop1 = 0; loop1 < lc_mc_search->conditions->len; loop1++)
+    {
+        mc_search_cond_t *mc_search_cond;
+        const char *p;
+
+        mc_search_cond = (mc_search_cond_t *) g_ptr_array_index (lc_mc_search->conditions, loop1);
+
+        p = mc_search__plain_find (mc_search_cond, data, len);
+        if (p != NULL && (found == NULL || p < found))
+        {
+            found = p;
+            *found_len = mc_search_cond->plain->len;
+        }
+    }
+
+    if (found == NULL)
+        return FALSE;
+
+    *pos = found - data;
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/* Search plain strings in a block of data. Last max_len - 1 bytes before the block
+   are kept in regex_buffer to find strings crossing the boundary of blocks */
+
+static mc_search__found_cond_t
+mc_search__plain_found_block (mc_search_t * lc_mc_search, const char *block, gsize len,
+                              gsize offset, gsize max_len, gsize * found_len)
+{
+    GString *carry = lc_mc_search->regex_buffer;
+    gsize pos, flen, keep;
+
+    if (carry->len != 0)
+    {
+        gsize carried = carry->len;
+
+        g_string_append_len (carry, block, MIN (len, max_len - 1));
+        if (mc_search__plain_find_first (lc_mc_search, carry->str, carry->len, &pos, &flen)
+            && pos < carried)
+        {
+            offset -= carried;
+            goto found;
+        }
+        g_string_set_size (carry, carried);
+    }
+
+    if (mc_search__plain_find_first (lc_mc_search, block, len, &pos, &flen))
+        goto found;
+
+    keep = MIN (max_len - 1, carry->len + len);
+    if (len >= keep)
+    {
+        g_string_set_size (carry, 0);
+        g_string_append_len (carry, block + len - keep, keep);
+    }
+    else
+    {
+        g_string_erase (carry, 0, carry->len + len - keep);
+        g_string_append_len (carry, block, len);
+    }
+
+    return COND__NOT_ALL_FOUND;
+
+  found:
+    lc_mc_search->start_buffer = offset;
+    lc_mc_search->normal_offset = offset + pos;
+    if (found_len != NULL)
+        *found_len = flen;
+    return COND__FOUND_OK;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/* Length of the longest plain string of conditions, 0 if some of them needs regex */
+
+static gsize
+mc_search__plain_max_len (const mc_search_t * lc_mc_search)
+{
+    gsize max_len = 0;
+    gsize loop1;
+
+    for (loop1 = 0; loop1 < lc_mc_search->conditions->len; loop1++)
+    {
+        const mc_search_cond_t *mc_search_cond;
+
+        mc_search_cond = (const mc_search_cond_t *) g_ptr_array_index (lc_mc_search->conditions,
+                                                                        loop1);
+        if (mc_search_cond->plain == NULL)
+            return 0;
+
+        max_len = MAX (max_len, mc_search_cond->plain->len);
+    }
+
+    return max_len;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Search data got by search_block_fn. Lines are matched right in the blocks, only a line crossing
+ * the boundary of blocks is copied. Strings of normal search are found without regex.
+ */
+
+static gboolean
+mc_search__run_regex_blocks (mc_search_t * lc_mc_search, const void *user_data,
+                             gsize start_search, gsize end_search, gsize * found_len)
+{
+    mc_search_cbret_t ret = MC_SEARCH_CB_NOTFOUND;
+    mc_search__found_cond_t cond = COND__NOT_ALL_FOUND;
+    gsize plain_len, pos, len;
+
+    plain_len = mc_search__plain_max_len (lc_mc_search);
+
+    /* end_search is the last byte to search, like with search_fn */
+    for (pos = start_search; pos <= end_search; pos += len)
+    {
+        const char *block = NULL;
+
+        len = 0;
+        ret = lc_mc_search->search_block_fn (user_data, pos, &block, &len);
+        if (ret != MC_SEARCH_CB_OK)
+            break;
+        if (len == 0)
+        {
+            ret = MC_SEARCH_CB_NOTFOUND;
+            break;
+        }
+
+        len = MIN (len, end_search - pos + 1);
+        len = MIN (len, SEARCH_BLOCK_MAX);
+
+        if (plain_len != 0)
+            cond = mc_search__plain_found_block (lc_mc_search, block, len, pos, plain_len,
+                                                 found_len);
+        else
+            cond = mc_search__regex_found_block (lc_mc_search, block, len, pos, found_len);
+
+        if (cond != COND__NOT_ALL_FOUND)
+            break;
+
+        if (lc_mc_search->update_fn != NULL
+            && lc_mc_search->update_fn (user_data, pos + len) == MC_SEARCH_CB_ABORT)
+        {
+            ret = MC_SEARCH_CB_ABORT;
+            break;
+        }
+    }
+
+    /* last line without line break */
+    if (cond == COND__NOT_ALL_FOUND && ret != MC_SEARCH_CB_ABORT && plain_len == 0
+        && lc_mc_search->regex_buffer->len != 0)
+        cond = mc_search__regex_found_line (lc_mc_search, lc_mc_search->regex_buffer->str,
+                                            lc_mc_search->regex_buffer->len,
+                                            lc_mc_search->start_buffer, found_len);
+
+    if (cond == COND__FOUND_OK)
+        return TRUE;
+
+    g_string_free (lc_mc_search->regex_buffer, TRUE);
+    lc_mc_search->regex_buffer = NULL;
+
+    if (cond == COND__NOT_ALL_FOUND)
+    {
+        MC_PTR_FREE (lc_mc_search->error_str);
+        lc_mc_search->error =
+            ret == MC_SEARCH_CB_ABORT ? MC_SEARCH_E_ABORT : MC_SEARCH_E_NOTFOUND;
+    }
+
+    return FALSE;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static int
@@ -886,14 +1189,16 @@ mc_search__run_regex (mc_search_t * lc_mc_search, const void *user_data,
 {
     mc_search_cbret_t ret = MC_SEARCH_CB_NOTFOUND;
     gsize current_pos, virtual_pos;
-    gint start_pos;
-    gint end_pos;
 
     if (lc_mc_search->regex_buffer != NULL)
         g_string_set_size (lc_mc_search->regex_buffer, 0);
     else
         lc_mc_search->regex_buffer = g_string_sized_new (64);
 
+    if (lc_mc_search->search_block_fn != NULL)
+        return mc_search__run_regex_blocks (lc_mc_search, user_data, start_search, end_search,
+                                            found_len);
+
     virtual_pos = current_pos = start_search;
     while (virtual_pos <= end_search)
     {
@@ -952,18 +1257,11 @@ mc_search__run_regex (mc_search_t * lc_mc_search, const void *user_data,
             virtual_pos = current_pos;
         }
 
-        switch (mc_search__regex_found_cond (lc_mc_search, lc_mc_search->regex_buffer))
+        switch (mc_search__regex_found_line (lc_mc_search, lc_mc_search->regex_buffer->str,
+                                             lc_mc_search->regex_buffer->len,
+                                             lc_mc_search->start_buffer, found_len))
         {
         case COND__FOUND_OK:
-#ifdef SEARCH_TYPE_GLIB
-            g_match_info_fetch_pos (lc_mc_search->regex_match_info, 0, &start_pos, &end_pos);
-#else /* SEARCH_TYPE_GLIB */
-            start_pos = lc_mc_search->iovector[0];
-            end_pos = lc_mc_search->iovector[1];
-#endif /* SEARCH_TYPE_GLIB */
-            if (found_len != NULL)
-                *found_len = end_pos - start_pos;
-            lc_mc_search->normal_offset = lc_mc_search->start_buffer + start_pos;
             return TRUE;
         case COND__NOT_ALL_FOUND:
             break;
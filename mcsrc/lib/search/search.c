@@ -100,6 +100,9 @@ mc_search__cond_struct_free (mc_search_cond_t * mc_search_cond)
     if (mc_search_cond->lower)
         g_string_free (mc_search_cond->lower, TRUE);
 
+    if (mc_search_cond->plain != NULL)
+        g_string_free (mc_search_cond->plain, TRUE);
+
     g_string_free (mc_search_cond->str, TRUE);
     g_free (mc_search_cond->charset);
 
@@ -0,0 +1,478 @@
+/*
+   Virtual File System: persistent listing index of archives
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * \brief Source: Virtual File System: persistent listing index of archives
+ *
+ * Scanning a big archive (tar, cpio, extfs "list" helpers) may take seconds or minutes.
+ * After the first successful scan the vfs_s_inode tree is serialized into the user cache
+ * directory. The index file is keyed by the class (and extfs helper) that scanned the archive,
+ * because data offsets mean different things to each of them, and by archive name, size,
+ * mtime, device and inode number. It is rejected as soon as any of them changes.
+ * Re-entering an unchanged archive becomes a single mmap of the index file.
+ *
+ * Index file layout (native byte order, the file is never shared between hosts):
+ *
+ *   vfs_index_header_t
+ *   archive name (header.name_len bytes)
+ *   owner: class name and helper name (header.owner_len bytes)
+ *   header.entries times:
+ *       vfs_index_record_t
+ *       entry name (record.name_len bytes)
+ *       link name (record.link_len bytes)
+ *
+ * Inodes are numbered in order of appearance, the root inode has number 0. An entry
+ * whose inode number is less than the number of inodes seen so far is a hard link
+ * to that inode and carries no inode data. Like extfs, the inode keeps its first entry.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "lib/global.h"
+#include "lib/fileloc.h"
+#include "lib/util.h"           /* mc_build_filename() */
+
+#include "vfs.h"
+#include "utilvfs.h"
+#include "xdirentry.h"
+#include "arcindex.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define VFS_INDEX_MAGIC "MCVFSIX"
+#define VFS_INDEX_VERSION 2
+
+/* don't bother with tiny archives: rescanning them is cheaper than the index I/O */
+#define VFS_INDEX_MIN_ENTRIES 64
+
+/*** file scope type declarations ****************************************************************/
+
+typedef struct
+{
+    char magic[8];
+    guint32 version;
+    guint32 name_len;
+    guint32 owner_len;
+    guint32 reserved;
+    guint64 size;
+    gint64 mtime;
+    guint64 dev;
+    guint64 ino;
+    guint32 inodes;
+    guint32 entries;
+} vfs_index_header_t;
+
+typedef struct
+{
+    guint32 parent;             /* inode number of directory */
+    guint32 inode;              /* inode number of entry */
+    guint32 name_len;
+    guint32 link_len;
+    guint32 mode;
+    guint32 uid;
+    guint32 gid;
+    guint32 reserved;
+    guint64 size;
+    guint64 rdev;
+    gint64 mtime;
+    gint64 atime;
+    gint64 ctime;
+    gint64 data_offset;
+} vfs_index_record_t;
+
+/*** file scope variables ************************************************************************/
+
+/* --------------------------------------------------------------------------------------------- */
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Get name of tree builder: class name and name of extfs helper if any.
+ */
+
+static char *
+vfs_s_index_get_owner (const struct vfs_s_super *super, const char *helper)
+{
+    return g_strconcat (super->me->name, ":", helper != NULL ? helper : "", (char *) NULL);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char *
+vfs_s_index_get_filename (const char *archive_name, const char *owner)
+{
+    char *key, *checksum, *fname, *ret;
+
+    key = g_strconcat (owner, PATH_SEP_STR, archive_name, (char *) NULL);
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, key, -1);
+    g_free (key);
+    fname = g_strconcat (checksum, ".idx", (char *) NULL);
+    ret = mc_build_filename (mc_config_get_cache_path (), MC_VFS_INDEX_DIR, fname, (char *) NULL);
+    g_free (fname);
+    g_free (checksum);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+vfs_s_index_enabled (const struct vfs_s_super *super, const struct stat *archive_stat)
+{
+    return (mc_global.vfs.archive_index && super->name != NULL && super->root != NULL
+            && archive_stat != NULL && S_ISREG (archive_stat->st_mode));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+vfs_s_index_fill_header (vfs_index_header_t * header, const char *archive_name,
+                         const char *owner, const struct stat *archive_stat)
+{
+    memset (header, 0, sizeof (*header));
+    memcpy (header->magic, VFS_INDEX_MAGIC, sizeof (header->magic));
+    header->version = VFS_INDEX_VERSION;
+    header->name_len = (guint32) strlen (archive_name);
+    header->owner_len = (guint32) strlen (owner);
+    header->size = (guint64) archive_stat->st_size;
+    header->mtime = (gint64) archive_stat->st_mtime;
+    header->dev = (guint64) archive_stat->st_dev;
+    header->ino = (guint64) archive_stat->st_ino;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+vfs_s_index_put_record (GString * data, guint32 parent, guint32 inode_num,
+                        const struct vfs_s_entry *entry, gboolean new_inode)
+{
+    vfs_index_record_t rec;
+    const struct vfs_s_inode *ino = entry->ino;
+
+    memset (&rec, 0, sizeof (rec));
+    rec.parent = parent;
+    rec.inode = inode_num;
+    rec.name_len = (guint32) strlen (entry->name);
+
+    if (new_inode)
+    {
+        rec.link_len = ino->linkname == NULL ? 0 : (guint32) strlen (ino->linkname);
+        rec.mode = (guint32) ino->st.st_mode;
+        rec.uid = (guint32) ino->st.st_uid;
+        rec.gid = (guint32) ino->st.st_gid;
+        rec.size = (guint64) ino->st.st_size;
+#ifdef HAVE_STRUCT_STAT_ST_RDEV
+        rec.rdev = (guint64) ino->st.st_rdev;
+#endif
+        rec.mtime = (gint64) ino->st.st_mtime;
+        rec.atime = (gint64) ino->st.st_atime;
+        rec.ctime = (gint64) ino->st.st_ctime;
+        rec.data_offset = (gint64) ino->data_offset;
+    }
+
+    g_string_append_len (data, (const char *) &rec, sizeof (rec));
+    g_string_append_len (data, entry->name, rec.name_len);
+    if (rec.link_len != 0)
+        g_string_append_len (data, ino->linkname, rec.link_len);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+vfs_s_index_fill_stat (struct stat *st, const vfs_index_record_t * rec)
+{
+    memset (st, 0, sizeof (*st));
+    st->st_mode = (mode_t) rec->mode;
+    st->st_uid = (uid_t) rec->uid;
+    st->st_gid = (gid_t) rec->gid;
+    st->st_size = (off_t) rec->size;
+#ifdef HAVE_STRUCT_STAT_ST_RDEV
+    st->st_rdev = (dev_t) rec->rdev;
+#endif
+    st->st_mtime = (time_t) rec->mtime;
+    st->st_atime = (time_t) rec->atime;
+    st->st_ctime = (time_t) rec->ctime;
+    vfs_adjust_stat (st);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+vfs_s_index_clear_root (struct vfs_class *me, struct vfs_s_inode *root)
+{
+    while (g_queue_get_length (root->subdir) != 0)
+        vfs_s_free_entry (me, VFS_ENTRY (g_queue_peek_head (root->subdir)));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+vfs_s_index_parse (struct vfs_s_super *super, const char *data, gsize len,
+                   const vfs_index_header_t * header)
+{
+    struct vfs_class *me = super->me;
+    GPtrArray *inodes;
+    GString *name;
+    gsize pos;
+    guint32 i;
+    gboolean ok = TRUE;
+
+    pos = sizeof (*header) + header->name_len + header->owner_len;
+
+    inodes = g_ptr_array_sized_new (header->inodes);
+    g_ptr_array_add (inodes, super->root);
+    name = g_string_sized_new (MC_MAXFILENAMELEN);
+
+    for (i = 0; ok && i < header->entries; i++)
+    {
+        vfs_index_record_t rec;
+        struct vfs_s_inode *parent, *inode;
+        struct vfs_s_entry *entry, *first;
+
+        if (len - pos < sizeof (rec))
+        {
+            ok = FALSE;
+            break;
+        }
+        memcpy (&rec, data + pos, sizeof (rec));
+        pos += sizeof (rec);
+
+        if (rec.name_len == 0 || len - pos < (gsize) rec.name_len + rec.link_len
+            || rec.parent >= inodes->len || rec.inode > inodes->len)
+        {
+            ok = FALSE;
+            break;
+        }
+
+        parent = VFS_INODE (g_ptr_array_index (inodes, rec.parent));
+        if (!S_ISDIR (parent->st.st_mode))
+        {
+            ok = FALSE;
+            break;
+        }
+
+        g_string_truncate (name, 0);
+        g_string_append_len (name, data + pos, rec.name_len);
+        pos += rec.name_len;
+
+        first = NULL;
+
+        if (rec.inode < inodes->len)
+        {
+            inode = VFS_INODE (g_ptr_array_index (inodes, rec.inode));
+            first = inode->ent;
+        }
+        else
+        {
+            struct stat st;
+
+            vfs_s_index_fill_stat (&st, &rec);
+            inode = vfs_s_new_inode (me, super, &st);
+            if (inode == NULL)
+            {
+                ok = FALSE;
+                break;
+            }
+            inode->data_offset = (off_t) rec.data_offset;
+            if (rec.link_len != 0)
+                vfs_s_set_linkname (inode, data + pos, rec.link_len);
+            g_ptr_array_add (inodes, inode);
+        }
+        pos += rec.link_len;
+
+        entry = vfs_s_new_entry (me, name->str, inode);
+        vfs_s_insert_entry (me, parent, entry);
+
+        /* hard link: keep the first entry of inode */
+        if (first != NULL)
+            inode->ent = first;
+    }
+
+    g_string_free (name, TRUE);
+    g_ptr_array_free (inodes, TRUE);
+
+    if (!ok)
+        vfs_s_index_clear_root (me, super->root);
+
+    return ok;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Fill the directory tree of archive from the persistent index.
+ *
+ * @param super superblock with the root inode already created
+ * @param helper name of extfs helper that lists the archive, NULL for other classes
+ * @param archive_stat stat of the archive file
+ *
+ * @return TRUE if tree was loaded from index, FALSE if archive should be scanned
+ */
+
+gboolean
+vfs_s_index_load (struct vfs_s_super *super, const char *helper, const struct stat *archive_stat)
+{
+    char *owner, *fname;
+    GMappedFile *mfile;
+    const char *data;
+    gsize len;
+    vfs_index_header_t header, etalon;
+    gboolean ret = FALSE;
+
+    if (!vfs_s_index_enabled (super, archive_stat))
+        return FALSE;
+
+    owner = vfs_s_index_get_owner (super, helper);
+    fname = vfs_s_index_get_filename (super->name, owner);
+    mfile = g_mapped_file_new (fname, FALSE, NULL);
+    g_free (fname);
+    if (mfile == NULL)
+    {
+        g_free (owner);
+        return FALSE;
+    }
+
+    data = g_mapped_file_get_contents (mfile);
+    len = g_mapped_file_get_length (mfile);
+
+    if (data != NULL && len >= sizeof (header))
+    {
+        memcpy (&header, data, sizeof (header));
+        vfs_s_index_fill_header (&etalon, super->name, owner, archive_stat);
+
+        if (memcmp (header.magic, etalon.magic, sizeof (header.magic)) == 0
+            && header.version == etalon.version && header.name_len == etalon.name_len
+            && header.owner_len == etalon.owner_len
+            && header.size == etalon.size && header.mtime == etalon.mtime
+            && header.dev == etalon.dev && header.ino == etalon.ino
+            && len - sizeof (header) >= (gsize) header.name_len + header.owner_len
+            && memcmp (data + sizeof (header), super->name, header.name_len) == 0
+            && memcmp (data + sizeof (header) + header.name_len, owner, header.owner_len) == 0)
+            ret = vfs_s_index_parse (super, data, len, &header);
+    }
+
+    g_mapped_file_unref (mfile);
+    g_free (owner);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Store the directory tree of freshly scanned archive into the persistent index.
+ * Errors are silently ignored: the index is a cache only.
+ *
+ * @param super superblock of scanned archive
+ * @param helper name of extfs helper that listed the archive, NULL for other classes
+ * @param archive_stat stat of the archive file taken before scanning
+ */
+
+void
+vfs_s_index_save (struct vfs_s_super *super, const char *helper, const struct stat *archive_stat)
+{
+    GHashTable *numbers;
+    GQueue dirs = G_QUEUE_INIT;
+    GString *data;
+    vfs_index_header_t header;
+    struct vfs_s_inode *dir;
+    guint32 inodes = 1;
+    guint32 entries = 0;
+    char *owner, *fname, *dname;
+
+    if (!vfs_s_index_enabled (super, archive_stat))
+        return;
+
+    owner = vfs_s_index_get_owner (super, helper);
+    vfs_s_index_fill_header (&header, super->name, owner, archive_stat);
+
+    data = g_string_sized_new (BUF_10K);
+    g_string_append_len (data, (const char *) &header, sizeof (header));
+    g_string_append_len (data, super->name, header.name_len);
+    g_string_append_len (data, owner, header.owner_len);
+
+    /* inode -> number + 1 */
+    numbers = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_hash_table_insert (numbers, super->root, GUINT_TO_POINTER (1));
+
+    /* breadth-first walk: parents are always stored before their children */
+    g_queue_push_tail (&dirs, super->root);
+
+    while ((dir = VFS_INODE (g_queue_pop_head (&dirs))) != NULL)
+    {
+        guint32 parent;
+        GList *iter;
+
+        parent = GPOINTER_TO_UINT (g_hash_table_lookup (numbers, dir)) - 1;
+
+        for (iter = g_queue_peek_head_link (dir->subdir); iter != NULL; iter = g_list_next (iter))
+        {
+            const struct vfs_s_entry *entry = VFS_ENTRY (iter->data);
+            guint32 number;
+
+            number = GPOINTER_TO_UINT (g_hash_table_lookup (numbers, entry->ino));
+            if (number != 0)
+                vfs_s_index_put_record (data, parent, number - 1, entry, FALSE);
+            else
+            {
+                number = inodes++;
+                g_hash_table_insert (numbers, entry->ino, GUINT_TO_POINTER (number + 1));
+                vfs_s_index_put_record (data, parent, number, entry, TRUE);
+
+                if (S_ISDIR (entry->ino->st.st_mode))
+                    g_queue_push_tail (&dirs, entry->ino);
+            }
+
+            entries++;
+        }
+    }
+
+    g_hash_table_destroy (numbers);
+
+    if (entries >= VFS_INDEX_MIN_ENTRIES)
+    {
+        header.inodes = inodes;
+        header.entries = entries;
+        memcpy (data->str, &header, sizeof (header));
+
+        dname = mc_build_filename (mc_config_get_cache_path (), MC_VFS_INDEX_DIR, (char *) NULL);
+        fname = vfs_s_index_get_filename (super->name, owner);
+
+        /* g_file_set_contents() writes into temporary file and renames it */
+        if (g_mkdir_with_parents (dname, 0700) == 0)
+            (void) g_file_set_contents (fname, data->str, (gssize) data->len, NULL);
+
+        g_free (fname);
+        g_free (dname);
+    }
+
+    g_string_free (data, TRUE);
+    g_free (owner);
+}
+
+/* --------------------------------------------------------------------------------------------- */
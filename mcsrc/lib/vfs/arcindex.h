@@ -0,0 +1,28 @@
+/**
+ * \file
+ * \brief Header: Virtual File System: persistent listing index of archives
+ */
+
+#ifndef MC__VFS_ARCINDEX_H
+#define MC__VFS_ARCINDEX_H
+
+#include "xdirentry.h"
+
+/*** typedefs(not structures) and defined constants **********************************************/
+
+/*** enums ***************************************************************************************/
+
+/*** structures declarations (and typedefs of structures)*****************************************/
+
+/*** global variables defined in .c file *********************************************************/
+
+/*** declarations of public functions ************************************************************/
+
+gboolean vfs_s_index_load (struct vfs_s_super *super, const char *helper,
+                           const struct stat *archive_stat);
+void vfs_s_index_save (struct vfs_s_super *super, const char *helper,
+                       const struct stat *archive_stat);
+
+/*** inline functions ****************************************************************************/
+
+#endif /* MC__VFS_ARCINDEX_H */
@@ -0,0 +1,224 @@
+/*
+   Virtual File System: buffered sequential reader of archives
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * \brief Source: Virtual File System: buffered sequential reader of archives
+ *
+ * tar and cpio archives are scanned by reading a small header, skipping the member data
+ * and reading the next header. Done with mc_read() and mc_lseek() directly, this costs
+ * two or three system calls (or network round trips, if the archive itself is on
+ * a remote filesystem) per member.
+ *
+ * This reader keeps a large block of the archive in memory. Reads and seeks that land
+ * inside the block don't touch the file at all; a seek outside of it drops the block
+ * and seeks the file. The block size starts at ARCREAD_MIN_BLOCK after each long seek
+ * and is doubled on every refill up to ARCREAD_MAX_BLOCK, so archives of many
+ * small members are read in big chunks while for archives of few big members little is
+ * read beyond the headers.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+
+#include "lib/global.h"
+
+#include "vfs.h"
+#include "arcread.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define ARCREAD_MIN_BLOCK (64 * 1024)
+#define ARCREAD_MAX_BLOCK (1024 * 1024)
+
+/*** file scope type declarations ****************************************************************/
+
+struct vfs_arcread_t
+{
+    int fd;                     /* archive file */
+    vfs_zstream_t *zs;          /* decompressor, if archive is compressed */
+
+    char *buf;
+    off_t offset;               /* offset of buf[0] in archive */
+    size_t pos;
+    size_t len;
+    size_t block;               /* size of next refill */
+};
+
+/*** file scope variables ************************************************************************/
+
+/* --------------------------------------------------------------------------------------------- */
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+arcread_fill (vfs_arcread_t * ar)
+{
+    ssize_t n;
+
+    ar->offset += (off_t) ar->len;
+    ar->pos = 0;
+    ar->len = 0;
+
+    n = (ar->zs != NULL) ? vfs_zstream_read (ar->zs, ar->buf, ar->block)
+        : mc_read (ar->fd, ar->buf, ar->block);
+
+    if (n > 0)
+    {
+        ar->len = (size_t) n;
+        ar->block = MIN (ar->block * 2, ARCREAD_MAX_BLOCK);
+    }
+
+    return n;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Create reader of archive @fd (or of decompressed data of @zs, if it isn't NULL).
+ * The file must be positioned at the beginning of archive.
+ */
+
+vfs_arcread_t *
+vfs_arcread_open (int fd, vfs_zstream_t * zs)
+{
+    vfs_arcread_t *ar;
+
+    ar = g_new0 (vfs_arcread_t, 1);
+    ar->fd = fd;
+    ar->zs = zs;
+    ar->buf = g_malloc (ARCREAD_MAX_BLOCK);
+    ar->block = ARCREAD_MIN_BLOCK;
+
+    return ar;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Free reader. The file position of archive is undefined afterwards.
+ */
+
+void
+vfs_arcread_close (vfs_arcread_t * ar)
+{
+    if (ar != NULL)
+    {
+        g_free (ar->buf);
+        g_free (ar);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+ssize_t
+vfs_arcread_read (vfs_arcread_t * ar, char *buffer, size_t count)
+{
+    size_t done = 0;
+
+    while (done < count)
+    {
+        size_t n;
+
+        if (ar->pos == ar->len)
+        {
+            ssize_t res;
+
+            /* don't copy big reads through the buffer */
+            if (count - done >= ar->block)
+            {
+                res = (ar->zs != NULL) ? vfs_zstream_read (ar->zs, buffer + done, count - done)
+                    : mc_read (ar->fd, buffer + done, count - done);
+                if (res > 0)
+                {
+                    ar->offset += (off_t) (ar->len + (size_t) res);
+                    ar->pos = ar->len = 0;
+                    done += (size_t) res;
+                    continue;
+                }
+            }
+            else
+                res = arcread_fill (ar);
+
+            if (res == -1)
+                return done != 0 ? (ssize_t) done : -1;
+            if (res == 0)
+                break;
+        }
+
+        n = MIN (count - done, ar->len - ar->pos);
+        memcpy (buffer + done, ar->buf + ar->pos, n);
+        ar->pos += n;
+        done += n;
+    }
+
+    return (ssize_t) done;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Set position in archive. Seeks inside of the buffered block are free.
+ *
+ * @return new position, -1 on error
+ */
+
+off_t
+vfs_arcread_seek (vfs_arcread_t * ar, off_t offset)
+{
+    off_t res;
+
+    if (offset < 0)
+        return -1;
+
+    if (offset >= ar->offset && offset <= ar->offset + (off_t) ar->len)
+    {
+        ar->pos = (size_t) (offset - ar->offset);
+        return offset;
+    }
+
+    res = (ar->zs != NULL) ? vfs_zstream_seek (ar->zs, offset)
+        : mc_lseek (ar->fd, offset, SEEK_SET);
+    if (res == -1)
+        return -1;
+
+    /* a short skip past the block doesn't break sequential scan */
+    if (offset < ar->offset || offset - (ar->offset + (off_t) ar->len) >= (off_t) ar->block)
+        ar->block = ARCREAD_MIN_BLOCK;
+
+    ar->offset = res;
+    ar->pos = ar->len = 0;
+
+    return res;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+off_t
+vfs_arcread_tell (const vfs_arcread_t * ar)
+{
+    return ar->offset + (off_t) ar->pos;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,32 @@
+/**
+ * \file
+ * \brief Header: Virtual File System: buffered sequential reader of archives
+ */
+
+#ifndef MC__VFS_ARCREAD_H
+#define MC__VFS_ARCREAD_H
+
+#include "zstream.h"
+
+/*** typedefs(not structures) and defined constants **********************************************/
+
+/*** enums ***************************************************************************************/
+
+/*** structures declarations (and typedefs of structures)*****************************************/
+
+typedef struct vfs_arcread_t vfs_arcread_t;
+
+/*** global variables defined in .c file *********************************************************/
+
+/*** declarations of public functions ************************************************************/
+
+vfs_arcread_t *vfs_arcread_open (int fd, vfs_zstream_t * zs);
+void vfs_arcread_close (vfs_arcread_t * ar);
+
+ssize_t vfs_arcread_read (vfs_arcread_t * ar, char *buffer, size_t count);
+off_t vfs_arcread_seek (vfs_arcread_t * ar, off_t offset);
+off_t vfs_arcread_tell (const vfs_arcread_t * ar);
+
+/*** inline functions ****************************************************************************/
+
+#endif /* MC__VFS_ARCREAD_H */
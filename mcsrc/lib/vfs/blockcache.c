@@ -0,0 +1,248 @@
+/*
+   Virtual File System: block cache of remote files
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * \brief Source: Virtual File System: block cache of remote files
+ *
+ * Without random access, a remote file opened for reading has to be downloaded as a whole
+ * to a temporary file, even if only its tail is looked at in the viewer.
+ *
+ * The cache keeps parts of the file in blocks of VFS_BLOCKCACHE_BLOCK bytes and gets
+ * missing ones with the fetch callback, which reads a range of the file (REST for ftp,
+ * a dd based script for fish). One fetch is a full round trip, so if a miss follows
+ * the range fetched last time, the read is taken as sequential and the range is doubled
+ * up to BLOCKCACHE_MAX_AHEAD blocks. A random miss fetches a single block.
+ *
+ * At most BLOCKCACHE_MAX_BLOCKS blocks are held; the least recently used are dropped.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <string.h>
+
+#include "lib/global.h"
+
+#include "blockcache.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define BLOCKCACHE_MAX_BLOCKS 256
+#define BLOCKCACHE_MAX_AHEAD 32
+
+/*** file scope type declarations ****************************************************************/
+
+typedef struct
+{
+    gint64 index;               /* number of block in file, hash key */
+    GList link;                 /* in LRU queue */
+    size_t len;                 /* less than VFS_BLOCKCACHE_BLOCK at end of file */
+    char data[];
+} blockcache_block_t;
+
+struct vfs_blockcache_t
+{
+    off_t size;
+    vfs_blockcache_fetch_fn fetch;
+    void *data;
+
+    GHashTable *blocks;
+    GQueue lru;                 /* most recently used first */
+    gint64 next;                /* block after the range fetched last time */
+    gint64 ahead;               /* size of next sequential fetch, in blocks */
+};
+
+/*** file scope variables ************************************************************************/
+
+/* --------------------------------------------------------------------------------------------- */
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+blockcache_add (vfs_blockcache_t * bc, gint64 index, const char *data, size_t len)
+{
+    blockcache_block_t *blk;
+
+    blk = g_malloc (sizeof (*blk) + len);
+    blk->index = index;
+    blk->len = len;
+    memcpy (blk->data, data, len);
+    blk->link.data = blk;
+    blk->link.prev = blk->link.next = NULL;
+
+    g_hash_table_insert (bc->blocks, &blk->index, blk);
+    g_queue_push_head_link (&bc->lru, &blk->link);
+
+    while (bc->lru.length > BLOCKCACHE_MAX_BLOCKS)
+    {
+        blk = (blockcache_block_t *) g_queue_peek_tail (&bc->lru);
+        g_queue_unlink (&bc->lru, &blk->link);
+        g_hash_table_remove (bc->blocks, &blk->index);
+        g_free (blk);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static blockcache_block_t *
+blockcache_fetch (vfs_blockcache_t * bc, gint64 index)
+{
+    gint64 last_block, count, i;
+    off_t offset;
+    size_t len;
+    ssize_t n;
+    char *buf;
+
+    if (index == bc->next)
+        bc->ahead = MIN (bc->ahead * 2, BLOCKCACHE_MAX_AHEAD);
+    else
+        bc->ahead = 1;
+
+    /* fetch up to the next cached block or end of file */
+    last_block = (bc->size - 1) / VFS_BLOCKCACHE_BLOCK;
+    for (count = 1; count < bc->ahead && index + count <= last_block; count++)
+    {
+        gint64 key = index + count;
+
+        if (g_hash_table_lookup (bc->blocks, &key) != NULL)
+            break;
+    }
+
+    offset = (off_t) index * VFS_BLOCKCACHE_BLOCK;
+    len = (size_t) MIN ((off_t) count * VFS_BLOCKCACHE_BLOCK, bc->size - offset);
+
+    buf = g_malloc (len);
+    n = bc->fetch (bc->data, offset, buf, len);
+    if (n < 0)
+    {
+        g_free (buf);
+        bc->next = -1;
+        return NULL;
+    }
+
+    /* add read-ahead blocks first to keep requested one the most recently used */
+    for (i = count - 1; i >= 0; i--)
+    {
+        size_t pos;
+
+        pos = MIN ((size_t) i * VFS_BLOCKCACHE_BLOCK, (size_t) n);
+        /* requested block is added even if empty to mark end of file */
+        if (i == 0 || pos < (size_t) n)
+            blockcache_add (bc, index + i, buf + pos, MIN ((size_t) n - pos, VFS_BLOCKCACHE_BLOCK));
+    }
+
+    g_free (buf);
+    bc->next = index + count;
+
+    return (blockcache_block_t *) g_queue_peek_head (&bc->lru);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+vfs_blockcache_t *
+vfs_blockcache_new (off_t size, vfs_blockcache_fetch_fn fetch, void *data)
+{
+    vfs_blockcache_t *bc;
+
+    bc = g_new0 (vfs_blockcache_t, 1);
+    bc->size = size;
+    bc->fetch = fetch;
+    bc->data = data;
+    bc->blocks = g_hash_table_new (g_int64_hash, g_int64_equal);
+    g_queue_init (&bc->lru);
+    bc->next = -1;
+    bc->ahead = 1;
+
+    return bc;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+void
+vfs_blockcache_free (vfs_blockcache_t * bc)
+{
+    GList *link;
+
+    if (bc == NULL)
+        return;
+
+    while ((link = g_queue_pop_head_link (&bc->lru)) != NULL)
+        g_free (link->data);
+    g_hash_table_destroy (bc->blocks);
+    g_free (bc);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read from the file.
+ *
+ * @return number of bytes read, 0 at end of file, -1 if nothing could be fetched
+ */
+
+ssize_t
+vfs_blockcache_read (vfs_blockcache_t * bc, off_t offset, char *buffer, size_t count)
+{
+    size_t total = 0;
+
+    while (count != 0 && offset < bc->size)
+    {
+        gint64 index = offset / VFS_BLOCKCACHE_BLOCK;
+        blockcache_block_t *blk;
+        size_t start, n;
+
+        blk = (blockcache_block_t *) g_hash_table_lookup (bc->blocks, &index);
+        if (blk == NULL)
+        {
+            blk = blockcache_fetch (bc, index);
+            if (blk == NULL)
+                return total != 0 ? (ssize_t) total : -1;
+        }
+        else if (bc->lru.head != &blk->link)
+        {
+            g_queue_unlink (&bc->lru, &blk->link);
+            g_queue_push_head_link (&bc->lru, &blk->link);
+        }
+
+        start = (size_t) (offset - (off_t) index * VFS_BLOCKCACHE_BLOCK);
+        if (start >= blk->len)
+            break;
+
+        n = MIN (count, blk->len - start);
+        memcpy (buffer + total, blk->data + start, n);
+        total += n;
+        offset += n;
+        count -= n;
+
+        /* file is shorter than expected */
+        if (blk->len < VFS_BLOCKCACHE_BLOCK)
+            break;
+    }
+
+    return (ssize_t) total;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,34 @@
+/**
+ * \file
+ * \brief Header: Virtual File System: block cache of remote files
+ */
+
+#ifndef MC__VFS_BLOCKCACHE_H
+#define MC__VFS_BLOCKCACHE_H
+
+/*** typedefs(not structures) and defined constants **********************************************/
+
+#define VFS_BLOCKCACHE_BLOCK (64 * 1024)
+
+/* Read len bytes of file starting at offset into buf. Should return less than len
+   only at end of file; -1 on error */
+typedef ssize_t (*vfs_blockcache_fetch_fn) (void *data, off_t offset, char *buf, size_t len);
+
+/*** enums ***************************************************************************************/
+
+/*** structures declarations (and typedefs of structures)*****************************************/
+
+typedef struct vfs_blockcache_t vfs_blockcache_t;
+
+/*** global variables defined in .c file *********************************************************/
+
+/*** declarations of public functions ************************************************************/
+
+vfs_blockcache_t *vfs_blockcache_new (off_t size, vfs_blockcache_fetch_fn fetch, void *data);
+void vfs_blockcache_free (vfs_blockcache_t * bc);
+
+ssize_t vfs_blockcache_read (vfs_blockcache_t * bc, off_t offset, char *buffer, size_t count);
+
+/*** inline functions ****************************************************************************/
+
+#endif /* MC__VFS_BLOCKCACHE_H */
@@ -50,6 +50,13 @@
  *  completely fake, it contains entries such as 'usr', 'usr/src', ...,
  *  and we'll try to use custom find_entry function.
  *
+ *  Trees of read-only archives are built once and dropped as a whole
+ *  when the archive is released. Their entries, inodes and directory
+ *  list links are allocated from an arena of the superblock, names are
+ *  interned. This saves the malloc overhead of millions of small
+ *  objects of big archives, and freeing the archive costs a few free()
+ *  calls instead of a walk over the whole tree.
+ *
  *  \author Pavel Machek <pavel@ucw.cz>
  *  \date 1998
  *
@@ -88,8 +95,18 @@
         if (VFS_SUBCLASS (me)->x != NULL) \
             VFS_SUBCLASS (me)->x
 
+#define VFS_S_ARENA_BLOCK (64 * 1024)
+
 /*** file scope type declarations ****************************************************************/
 
+struct vfs_s_arena
+{
+    GSList *blocks;             /* allocated blocks, the current one is first */
+    char *ptr;                  /* free space of the current block */
+    size_t left;
+    GStringChunk *strings;      /* names and symlink contents */
+};
+
 struct dirhandle
 {
     GList *cur;
@@ -100,6 +117,80 @@ struct dirhandle
 
 /* --------------------------------------------------------------------------------------------- */
 /*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Nodes of read-only archives are freed one by one only in rare cases (e.g. if archive index
+ * was found broken), so they can be taken from arena.
+ */
+
+static gboolean
+vfs_s_use_arena (struct vfs_class *me)
+{
+    return ((me->flags & (VFSF_READONLY | VFSF_USETMP)) == VFSF_READONLY
+            && VFS_SUBCLASS (me)->free_inode == NULL);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_arena *
+vfs_s_arena_new (void)
+{
+    struct vfs_s_arena *arena;
+
+    arena = g_new0 (struct vfs_s_arena, 1);
+    arena->strings = g_string_chunk_new (VFS_S_ARENA_BLOCK);
+
+    return arena;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+vfs_s_arena_free (struct vfs_s_arena *arena)
+{
+    g_slist_free_full (arena->blocks, g_free);
+    g_string_chunk_free (arena->strings);
+    g_free (arena);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Allocate zero-filled memory. It is freed only with the whole arena.
+ */
+
+static void *
+vfs_s_arena_alloc0 (struct vfs_s_arena *arena, size_t size)
+{
+    void *ret;
+
+    size = (size + G_MEM_ALIGN - 1) & ~((size_t) G_MEM_ALIGN - 1);
+
+    if (size > arena->left)
+    {
+        arena->ptr = g_malloc (VFS_S_ARENA_BLOCK);
+        arena->left = VFS_S_ARENA_BLOCK;
+        arena->blocks = g_slist_prepend (arena->blocks, arena->ptr);
+    }
+
+    ret = arena->ptr;
+    arena->ptr += size;
+    arena->left -= size;
+
+    return memset (ret, 0, size);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_arena *
+vfs_s_entry_arena (const struct vfs_s_entry *ent)
+{
+    const struct vfs_s_inode *ino;
+
+    ino = ent->ino != NULL ? ent->ino : ent->dir;
+
+    return ino != NULL ? ino->super->arena : NULL;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 /* We were asked to create entries automagically */
@@ -334,7 +425,8 @@ vfs_s_insert_super (struct vfs_class *me, struct vfs_s_super *super)
 static void
 vfs_s_free_super (struct vfs_class *me, struct vfs_s_super *super)
 {
-    if (super->root != NULL)
+    /* with arena, the tree is dropped at once below */
+    if (super->root != NULL && super->arena == NULL)
     {
         vfs_s_free_inode (me, super->root);
         super->root = NULL;
@@ -353,6 +445,13 @@ vfs_s_free_super (struct vfs_class *me, struct vfs_s_super *super)
     VFS_SUBCLASS (me)->supers = g_list_remove (VFS_SUBCLASS (me)->supers, super);
 
     CALL (free_archive) (me, super);
+
+    if (super->arena != NULL)
+    {
+        vfs_s_arena_free (super->arena);
+        super->arena = NULL;
+        super->root = NULL;
+    }
 #ifdef ENABLE_VFS_NET
     vfs_path_element_free (super->path_element);
 #endif
@@ -381,9 +480,21 @@ vfs_s_free_fh (struct vfs_s_subclass *s, vfs_file_handler_t * fh)
     if (s->fh_free != NULL)
         s->fh_free (fh);
 
+    vfs_blockcache_free (fh->cache);
     g_free (fh);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+vfs_s_read_block (void *data, off_t offset, char *buf, size_t len)
+{
+    vfs_file_handler_t *fh = VFS_FILE_HANDLER (data);
+    struct vfs_class *me = VFS_FILE_HANDLER_SUPER (fh)->me;
+
+    return VFS_SUBCLASS (me)->read_range (me, fh, offset, buf, len);
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /* Support of archives */
 /* ------------------------ readdir & friends ----------------------------- */
@@ -571,6 +682,16 @@ vfs_s_read (void *fh, char *buffer, size_t count)
     if (file->linear == LS_LINEAR_OPEN)
         return VFS_SUBCLASS (me)->linear_read (me, file, buffer, count);
 
+    if (file->cache != NULL)
+    {
+        ssize_t n;
+
+        n = vfs_blockcache_read (file->cache, file->pos, buffer, count);
+        if (n > 0)
+            file->pos += n;
+        return n;
+    }
+
     if (file->handle != -1)
     {
         ssize_t n;
@@ -605,6 +726,8 @@ vfs_s_write (void *fh, const char *buffer, size_t count)
             me->verrno = errno;
         return n;
     }
+    if (VFS_SUBCLASS (me)->fh_write != NULL)
+        return VFS_SUBCLASS (me)->fh_write (me, file, buffer, count);
     vfs_die ("vfs_s_write: This should not happen\n");
     return 0;
 }
@@ -761,11 +884,17 @@ vfs_s_getlocalcopy (const vfs_path_t * vpath)
 
     if (fh != NULL)
     {
-        const struct vfs_class *me;
+        struct vfs_class *me;
 
         me = vfs_path_get_by_index (vpath, -1)->class;
         if ((me->flags & VFSF_USETMP) != 0 && fh->ino != NULL)
-            local = vfs_path_from_str_flags (fh->ino->localname, VPF_NO_CANON);
+        {
+            /* file opened for reading by ranges has not been downloaded */
+            if (fh->ino->localname == NULL)
+                vfs_s_retrieve_file (me, fh->ino);
+            if (fh->ino->localname != NULL)
+                local = vfs_path_from_str_flags (fh->ino->localname, VPF_NO_CANON);
+        }
 
         vfs_s_close (fh);
     }
@@ -789,6 +918,92 @@ vfs_s_ungetlocalcopy (const vfs_path_t * vpath, const vfs_path_t * local, gboole
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Put directory loaded by dir_load_tree() into directory cache of remote filesystem,
+ * replacing the cached one if any.
+ */
+
+static void
+vfs_s_add_tree_dir (struct vfs_class *me, struct vfs_s_super *super, const char *path,
+                    struct vfs_s_inode *ino)
+{
+    GList *iter;
+
+    iter = g_queue_find_custom (super->root->subdir, path, (GCompareFunc) vfs_s_entry_compare);
+    if (iter != NULL)
+        vfs_s_free_entry (me, VFS_ENTRY (iter->data));
+
+    vfs_s_insert_entry (me, super->root, vfs_s_new_entry (me, path, ino));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+vfs_s_load_tree (const vfs_path_t * vpath)
+{
+    struct vfs_class *me;
+    struct vfs_s_super *super;
+    const char *q;
+    char *path;
+    GList *iter;
+    int result;
+
+    me = vfs_path_get_by_index (vpath, -1)->class;
+    if (VFS_SUBCLASS (me)->dir_load_tree == NULL)
+        return 0;
+
+    q = vfs_s_get_path (vpath, &super, 0);
+    if (q == NULL)
+        return 0;
+
+    /* canonicalize the way vfs_s_find_entry_linear() does */
+    path = g_strdup (q);
+    custom_canonicalize_pathname (path, CANON_PATH_ALL & (~CANON_PATH_REMDOUBLEDOTS));
+
+    /* don't load the tree again while walking it */
+    iter = g_queue_find_custom (super->root->subdir, path, (GCompareFunc) vfs_s_entry_compare);
+    if (iter != NULL && VFS_ENTRY (iter->data)->ino->tree
+        && VFS_SUBCLASS (me)->dir_uptodate (me, VFS_ENTRY (iter->data)->ino))
+        result = 1;
+    else
+        result = VFS_SUBCLASS (me)->dir_load_tree (me, super, path) == 0 ? 1 : 0;
+
+    g_free (path);
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+vfs_s_prefetch_dir (const vfs_path_t * vpath)
+{
+    struct vfs_class *me;
+    struct vfs_s_super *super;
+    const char *q;
+    char *path;
+    GList *iter;
+    int result = 0;
+
+    me = vfs_path_get_by_index (vpath, -1)->class;
+    /* pending flush is for the next directory user reads */
+    if ((me->flags & VFSF_REMOTE) == 0 || VFS_SUBCLASS (me)->find_entry != vfs_s_find_entry_linear
+        || me->flush)
+        return 0;
+
+    q = vfs_s_get_path (vpath, &super, FL_NO_OPEN);
+    if (q == NULL)
+        return 0;
+
+    path = g_strdup (q);
+    custom_canonicalize_pathname (path, CANON_PATH_ALL & (~CANON_PATH_REMDOUBLEDOTS));
+
+    iter = g_queue_find_custom (super->root->subdir, path, (GCompareFunc) vfs_s_entry_compare);
+    if (iter == NULL || !VFS_SUBCLASS (me)->dir_uptodate (me, VFS_ENTRY (iter->data)->ino))
+        result = vfs_s_find_inode (me, super, path, LINK_FOLLOW, FL_DIR) != NULL ? 1 : 0;
+
+    g_free (path);
+    return result;
+}
 
 static int
 vfs_s_setctl (const vfs_path_t * vpath, int ctlop, void *arg)
@@ -821,6 +1036,10 @@ vfs_s_setctl (const vfs_path_t * vpath, int ctlop, void *arg)
     case VFS_SETCTL_FLUSH:
         path_element->class->flush = TRUE;
         return 1;
+    case VFS_SETCTL_LOAD_TREE:
+        return vfs_s_load_tree (vpath);
+    case VFS_SETCTL_PREFETCH_DIR:
+        return vfs_s_prefetch_dir (vpath);
     default:
         return 0;
     }
@@ -876,6 +1095,35 @@ vfs_s_dir_uptodate (struct vfs_class *me, struct vfs_s_inode *ino)
     return (tim.tv_sec < ino->timestamp.tv_sec ? 1 : 0);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+
+static off_t
+vfs_s_data_offset (const struct vfs_s_inode *ino)
+{
+    off_t offset = -1;
+
+    if (S_ISREG (ino->st.st_mode))
+    {
+        if (ino->st.st_size > 0)
+            offset = ino->data_offset;
+    }
+    else if (S_ISDIR (ino->st.st_mode))
+    {
+        GList *iter;
+
+        for (iter = g_queue_peek_head_link (ino->subdir); iter != NULL; iter = g_list_next (iter))
+        {
+            off_t o;
+
+            o = vfs_s_data_offset (VFS_ENTRY (iter->data)->ino);
+            if (o >= 0 && (offset < 0 || o < offset))
+                offset = o;
+        }
+    }
+
+    return offset;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /*** public functions ****************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -885,14 +1133,23 @@ vfs_s_new_inode (struct vfs_class *me, struct vfs_s_super *super, struct stat *i
 {
     struct vfs_s_inode *ino;
 
-    ino = g_try_new0 (struct vfs_s_inode, 1);
-    if (ino == NULL)
-        return NULL;
+    if (super->arena != NULL)
+    {
+        ino = vfs_s_arena_alloc0 (super->arena, sizeof (struct vfs_s_inode));
+        ino->subdir = vfs_s_arena_alloc0 (super->arena, sizeof (GQueue));
+    }
+    else
+    {
+        ino = g_try_new0 (struct vfs_s_inode, 1);
+        if (ino == NULL)
+            return NULL;
+
+        ino->subdir = g_queue_new ();
+    }
 
     if (initstat != NULL)
         ino->st = *initstat;
     ino->super = super;
-    ino->subdir = g_queue_new ();
     ino->st.st_nlink = 0;
     ino->st.st_ino = VFS_SUBCLASS (me)->inode_counter++;
     ino->st.st_dev = VFS_SUBCLASS (me)->rdev;
@@ -927,6 +1184,15 @@ vfs_s_free_inode (struct vfs_class *me, struct vfs_s_inode *ino)
         vfs_s_free_entry (me, entry);
     }
 
+    ino->super->ino_usage--;
+
+    /* memory of arena is released with superblock */
+    if (ino->super->arena != NULL)
+    {
+        ino->subdir = NULL;
+        return;
+    }
+
     g_queue_free (ino->subdir);
     ino->subdir = NULL;
 
@@ -937,7 +1203,6 @@ vfs_s_free_inode (struct vfs_class *me, struct vfs_s_inode *ino)
         unlink (ino->localname);
         g_free (ino->localname);
     }
-    ino->super->ino_usage--;
     g_free (ino);
 }
 
@@ -946,11 +1211,20 @@ vfs_s_free_inode (struct vfs_class *me, struct vfs_s_inode *ino)
 struct vfs_s_entry *
 vfs_s_new_entry (struct vfs_class *me, const char *name, struct vfs_s_inode *inode)
 {
+    struct vfs_s_arena *arena = inode->super->arena;
     struct vfs_s_entry *entry;
 
-    entry = g_new0 (struct vfs_s_entry, 1);
+    if (arena != NULL)
+    {
+        entry = vfs_s_arena_alloc0 (arena, sizeof (struct vfs_s_entry));
+        entry->name = g_string_chunk_insert_const (arena->strings, name);
+    }
+    else
+    {
+        entry = g_new0 (struct vfs_s_entry, 1);
+        entry->name = g_strdup (name);
+    }
 
-    entry->name = g_strdup (name);
     entry->ino = inode;
     entry->ino->ent = entry;
     CALL (init_entry) (me, entry);
@@ -963,10 +1237,28 @@ vfs_s_new_entry (struct vfs_class *me, const char *name, struct vfs_s_inode *ino
 void
 vfs_s_free_entry (struct vfs_class *me, struct vfs_s_entry *ent)
 {
+    struct vfs_s_arena *arena;
+
+    arena = vfs_s_entry_arena (ent);
+
     if (ent->dir != NULL)
-        g_queue_remove (ent->dir->subdir, ent);
+    {
+        if (arena == NULL)
+            g_queue_remove (ent->dir->subdir, ent);
+        else
+        {
+            GList *link;
+
+            /* list link is in arena too */
+            link = g_queue_find (ent->dir->subdir, ent);
+            if (link != NULL)
+                g_queue_unlink (ent->dir->subdir, link);
+        }
+    }
 
-    MC_PTR_FREE (ent->name);
+    if (arena == NULL)
+        g_free (ent->name);
+    ent->name = NULL;
 
     if (ent->ino != NULL)
     {
@@ -974,7 +1266,8 @@ vfs_s_free_entry (struct vfs_class *me, struct vfs_s_entry *ent)
         vfs_s_free_inode (me, ent->ino);
     }
 
-    g_free (ent);
+    if (arena == NULL)
+        g_free (ent);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -987,7 +1280,39 @@ vfs_s_insert_entry (struct vfs_class *me, struct vfs_s_inode *dir, struct vfs_s_
     ent->dir = dir;
 
     ent->ino->st.st_nlink++;
-    g_queue_push_tail (dir->subdir, ent);
+
+    if (dir->super->arena == NULL)
+        g_queue_push_tail (dir->subdir, ent);
+    else
+    {
+        GList *link;
+
+        link = vfs_s_arena_alloc0 (dir->super->arena, sizeof (GList));
+        link->data = ent;
+        g_queue_push_tail_link (dir->subdir, link);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Set contents of symlink. @linkname is copied, the previous contents is freed.
+ */
+
+void
+vfs_s_set_linkname (struct vfs_s_inode *ino, const char *linkname, gssize len)
+{
+    struct vfs_s_arena *arena = ino->super->arena;
+
+    if (len < 0)
+        len = (gssize) strlen (linkname);
+
+    if (arena != NULL)
+        ino->linkname = g_string_chunk_insert_len (arena->strings, linkname, len);
+    else
+    {
+        g_free (ino->linkname);
+        ino->linkname = g_strndup (linkname, (gsize) len);
+    }
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1198,6 +1523,9 @@ vfs_s_get_path (const vfs_path_t * vpath, struct vfs_s_super **archive, int flag
     super = subclass->new_archive != NULL ?
         subclass->new_archive (path_element->class) : vfs_s_new_super (path_element->class);
 
+    if (vfs_s_use_arena (path_element->class))
+        super->arena = vfs_s_arena_new ();
+
     if (subclass->open_archive != NULL)
     {
         vfs_path_t *vpath_archive;
@@ -1239,6 +1567,169 @@ vfs_s_invalidate (struct vfs_class *me, struct vfs_s_super *super)
     }
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Start collecting directories listed by dir_load_tree(). Directories are identified
+ * by their paths relative to the loaded one, which itself is "".
+ */
+
+vfs_s_tree_t *
+vfs_s_tree_new (struct vfs_class *me, struct vfs_s_super *super)
+{
+    vfs_s_tree_t *tree;
+
+    tree = g_new (vfs_s_tree_t, 1);
+    tree->me = me;
+    tree->super = super;
+    tree->dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    return tree;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get directory of the tree to insert entries to, create it if needed.
+ *
+ * @param complete TRUE if the listing has all entries of directory. Only such directories
+ *                 are put into cache by vfs_s_tree_store(), others can be e.g. unreadable
+ */
+
+struct vfs_s_inode *
+vfs_s_tree_dir (vfs_s_tree_t * tree, const char *relpath, gboolean complete)
+{
+    struct vfs_s_inode *dir;
+
+    dir = VFS_INODE (g_hash_table_lookup (tree->dirs, relpath));
+    if (dir == NULL)
+    {
+        dir = vfs_s_new_inode (tree->me, tree->super,
+                               vfs_s_default_stat (tree->me, S_IFDIR | 0755));
+        g_hash_table_insert (tree->dirs, g_strdup (relpath), dir);
+    }
+
+    if (complete)
+        dir->tree = TRUE;
+
+    return dir;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Check that all subdirectories of complete directory of the tree were listed completely too.
+ */
+
+static gboolean
+vfs_s_tree_loaded (vfs_s_tree_t * tree, const char *relpath, struct vfs_s_inode *dir)
+{
+    GList *iter;
+    gboolean result = TRUE;
+
+    for (iter = g_queue_peek_head_link (dir->subdir); iter != NULL && result;
+         iter = g_list_next (iter))
+    {
+        struct vfs_s_entry *ent = VFS_ENTRY (iter->data);
+        struct vfs_s_inode *sub;
+        char *subpath;
+
+        if (!S_ISDIR (ent->ino->st.st_mode) || DIR_IS_DOT (ent->name) || DIR_IS_DOTDOT (ent->name))
+            continue;
+
+        if (*relpath == '\0')
+            subpath = g_strdup (ent->name);
+        else
+            subpath = g_strconcat (relpath, PATH_SEP_STR, ent->name, (char *) NULL);
+
+        sub = VFS_INODE (g_hash_table_lookup (tree->dirs, subpath));
+        result = sub != NULL && sub->tree && vfs_s_tree_loaded (tree, subpath, sub);
+        g_free (subpath);
+    }
+
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Put complete directories of the tree into directory cache. Only those whose subdirectories
+ * were all listed completely are marked as loaded together with them; the listing may lack
+ * some subdirectories, e.g. unreadable ones or ones beyond a limit of the server, which are
+ * then loaded on their own.
+ *
+ * @param path canonical path of loaded directory, as looked up by vfs_s_find_entry_linear()
+ * @param timeout how long cached directories are valid, in seconds
+ */
+
+void
+vfs_s_tree_store (vfs_s_tree_t * tree, const char *path, int timeout)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    struct timeval expire;
+    GSList *partial = NULL;
+
+    gettimeofday (&expire, NULL);
+    expire.tv_sec += timeout;
+
+    /* check before anything is taken out of the tree */
+    g_hash_table_iter_init (&iter, tree->dirs);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        struct vfs_s_inode *dir = VFS_INODE (value);
+
+        if (dir->tree && !vfs_s_tree_loaded (tree, (const char *) key, dir))
+            partial = g_slist_prepend (partial, dir);
+    }
+
+    g_hash_table_iter_init (&iter, tree->dirs);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        const char *relpath = (const char *) key;
+        struct vfs_s_inode *dir = VFS_INODE (value);
+        char *dirpath;
+
+        if (!dir->tree)
+            continue;
+
+        if (*relpath == '\0')
+            dirpath = g_strdup (path);
+        else if (*path == '\0')
+            dirpath = g_strdup (relpath);
+        else
+            dirpath = g_strconcat (path, PATH_SEP_STR, relpath, (char *) NULL);
+
+        dir->timestamp = expire;
+        vfs_s_add_tree_dir (tree->me, tree->super, dirpath, dir);
+        g_free (dirpath);
+
+        g_hash_table_iter_steal (&iter);
+        g_free (key);
+    }
+
+    while (partial != NULL)
+    {
+        VFS_INODE (partial->data)->tree = FALSE;
+        partial = g_slist_delete_link (partial, partial);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Free directories which were not stored.
+ */
+
+void
+vfs_s_tree_free (vfs_s_tree_t * tree)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, tree->dirs);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+        vfs_s_free_inode (tree->me, VFS_INODE (value));
+
+    g_hash_table_destroy (tree->dirs);
+    g_free (tree);
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 char *
@@ -1285,6 +1776,25 @@ vfs_s_init_fh (vfs_file_handler_t * fh, struct vfs_s_inode *ino, gboolean change
     fh->handle = -1;
     fh->changed = changed;
     fh->linear = LS_NOT_LINEAR;
+    fh->cache = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * setctl() for archives where inode's data_offset is position of file data in the archive.
+ */
+
+int
+vfs_s_archive_setctl (const vfs_path_t * vpath, int ctlop, void *arg)
+{
+    struct vfs_s_inode *ino;
+
+    if (ctlop != VFS_SETCTL_DATA_OFFSET)
+        return 0;
+
+    ino = vfs_s_inode_from_path (vpath, 0);
+    *(off_t *) arg = ino != NULL ? vfs_s_data_offset (ino) : -1;
+    return 1;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1377,6 +1887,9 @@ vfs_s_open (const vfs_path_t * vpath, int flags, mode_t mode)
             fh->linear = LS_LINEAR_PREOPEN;
         }
     }
+    else if (s->read_range != NULL && (flags & O_ACCMODE) == O_RDONLY
+             && fh->ino->localname == NULL && fh->ino->st.st_size > 0)
+        fh->cache = vfs_blockcache_new (fh->ino->st.st_size, vfs_s_read_block, fh);
     else
     {
         if (s->fh_open != NULL && s->fh_open (path_element->class, fh, flags, mode) != 0)
@@ -52,59 +52,181 @@
 /* Parsing code is used by ftpfs, fish and extfs */
 #define MAXCOLS         30
 
+/* Number of months with resolved start time, power of 2 */
+#define MONTH_CACHE_SIZE 16
+
+#define SECS_PER_DAY (24 * 60 * 60)
+
 /*** file scope type declarations ****************************************************************/
 
+/* Column of the line. The line is not modified, so columns are not null-terminated */
+typedef struct
+{
+    const char *str;
+    size_t len;
+} ls_column_t;
+
+/* Local time of the month start */
+typedef struct
+{
+    gboolean valid;
+    int year;
+    int mon;
+    time_t start;
+    int days;                   /* 0 if length of some days is not 24 hours (DST change) */
+} month_start_t;
+
 /*** file scope variables ************************************************************************/
 
-static char *columns[MAXCOLS];  /* Points to the string in column n */
-static int column_ptr[MAXCOLS]; /* Index from 0 to the starting positions of the columns */
+static ls_column_t columns[MAXCOLS];
+static int columns_num = 0;
 static size_t vfs_parce_ls_final_num_spaces = 0;
 
+static month_start_t month_cache[MONTH_CACHE_SIZE];
+
 /* --------------------------------------------------------------------------------------------- */
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
 
+static const ls_column_t *
+get_column (int idx)
+{
+    return (idx >= 0 && idx < columns_num) ? &columns[idx] : NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static gboolean
 is_num (int idx)
 {
-    char *column = columns[idx];
+    const ls_column_t *column = get_column (idx);
+
+    return (column != NULL && isdigit ((unsigned char) column->str[0]));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Copy column to @buf as null-terminated string.
+ */
+
+static const char *
+column_to_str (const ls_column_t * column, char *buf, size_t size)
+{
+    size_t len = 0;
+
+    if (column != NULL)
+    {
+        len = MIN (column->len, size - 1);
+        memcpy (buf, column->str, len);
+    }
+    buf[len] = '\0';
+
+    return buf;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Parse decimal number like sscanf ("%Nd") does: whitespaces are skipped, then sign
+ * and digits are taken, at most @width characters (0 means no limit).
+ *
+ * @return TRUE if number was found, @str is moved past the number
+ */
+
+static gboolean
+scan_num (const char **str, const char *end, int width, long *ret)
+{
+    const char *p = *str;
+    const char *limit, *digits;
+    gboolean negative = FALSE;
+    long value = 0;
+
+    while (p < end && isspace ((unsigned char) *p))
+        p++;
+
+    limit = (width == 0 || end - p < width) ? end : p + width;
+
+    if (p < limit && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
 
-    return (column != NULL && isdigit (column[0]));
+    for (digits = p; p < limit && isdigit ((unsigned char) *p); p++)
+        value = value * 10 + (*p - '0');
+
+    if (p == digits)
+        return FALSE;
+
+    *str = p;
+    *ret = negative ? -value : value;
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static long
+column_atol (const ls_column_t * column)
+{
+    const char *p;
+    long value;
+
+    if (column == NULL)
+        return 0;
+
+    p = column->str;
+    return scan_num (&p, column->str + column->len, 0, &value) ? value : 0;
 }
 
 /* --------------------------------------------------------------------------------------------- */
 /* Return TRUE for MM-DD-YY and MM-DD-YYYY */
 
 static gboolean
-is_dos_date (const char *str)
+is_dos_date (const ls_column_t * column)
 {
-    size_t len;
+    const char *str;
 
-    if (str == NULL)
+    if (column == NULL)
         return FALSE;
 
-    len = strlen (str);
-    if (len != 8 && len != 10)
+    if (column->len != 8 && column->len != 10)
         return FALSE;
 
+    str = column->str;
     if (str[2] != str[5])
         return FALSE;
 
-    return (strchr ("\\-/", (int) str[2]) != NULL);
+    return (str[2] == '\\' || str[2] == '-' || str[2] == '/');
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Find column as substring of @names like strstr() does.
+ */
+
+static const char *
+find_name (const char *names, size_t names_len, const ls_column_t * column)
+{
+    size_t i;
+
+    if (column->len > names_len)
+        return NULL;
+
+    for (i = 0; i + column->len <= names_len; i++)
+        if (memcmp (names + i, column->str, column->len) == 0)
+            return names + i;
+
+    return NULL;
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
 static gboolean
-is_week (const char *str, struct tm *tim)
+is_week (const ls_column_t * column, struct tm *tim)
 {
-    static const char *week = "SunMonTueWedThuFriSat";
+    static const char week[] = "SunMonTueWedThuFriSat";
     const char *pos;
 
-    if (str == NULL)
+    if (column == NULL)
         return FALSE;
 
-    pos = strstr (week, str);
+    pos = find_name (week, sizeof (week) - 1, column);
     if (pos == NULL)
         return FALSE;
 
@@ -117,15 +239,15 @@ is_week (const char *str, struct tm *tim)
 /* --------------------------------------------------------------------------------------------- */
 
 static gboolean
-is_month (const char *str, struct tm *tim)
+is_month (const ls_column_t * column, struct tm *tim)
 {
-    static const char *month = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    static const char month[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
     const char *pos;
 
-    if (str == NULL)
+    if (column == NULL)
         return FALSE;
 
-    pos = strstr (month, str);
+    pos = find_name (month, sizeof (month) - 1, column);
     if (pos == NULL)
         return FALSE;
 
@@ -144,49 +266,56 @@ is_month (const char *str, struct tm *tim)
  * NB: It is assumed there are no whitespaces in month.
  */
 static gboolean
-is_localized_month (const char *month)
+is_localized_month (const ls_column_t * column)
 {
-    int i;
+    size_t i;
 
-    if (month == NULL)
+    if (column == NULL || column->len != 3)
         return FALSE;
 
-    for (i = 0;
-         i < 3 && *month != '\0' && !isdigit ((unsigned char) *month)
-         && !iscntrl ((unsigned char) *month) && !ispunct ((unsigned char) *month); i++, month++)
-        ;
+    for (i = 0; i < 3; i++)
+    {
+        unsigned char c = (unsigned char) column->str[i];
 
-    return (i == 3 && *month == '\0');
+        if (c == '\0' || isdigit (c) || iscntrl (c) || ispunct (c))
+            return FALSE;
+    }
+
+    return TRUE;
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/* Parse hh:mm[:ss] */
 
 static gboolean
-is_time (const char *str, struct tm *tim)
+is_time (const ls_column_t * column, struct tm *tim)
 {
-    const char *p, *p2;
+    const char *p, *end, *colon;
+    gboolean with_seconds;
+    long hour, min, sec = 0;
 
-    if (str == NULL)
+    if (column == NULL)
         return FALSE;
 
-    p = strchr (str, ':');
-    if (p == NULL)
+    p = column->str;
+    end = column->str + column->len;
+
+    colon = memchr (p, ':', column->len);
+    if (colon == NULL)
         return FALSE;
 
-    p2 = strrchr (str, ':');
-    if (p2 == NULL)
+    with_seconds = memchr (colon + 1, ':', (size_t) (end - colon - 1)) != NULL;
+
+    if (!scan_num (&p, end, 2, &hour) || p == end || *p++ != ':' || !scan_num (&p, end, 2, &min))
         return FALSE;
 
-    if (p != p2)
-    {
-        if (sscanf (str, "%2d:%2d:%2d", &tim->tm_hour, &tim->tm_min, &tim->tm_sec) != 3)
-            return FALSE;
-    }
-    else
-    {
-        if (sscanf (str, "%2d:%2d", &tim->tm_hour, &tim->tm_min) != 2)
-            return FALSE;
-    }
+    if (with_seconds && (p == end || *p++ != ':' || !scan_num (&p, end, 2, &sec)))
+        return FALSE;
+
+    tim->tm_hour = (int) hour;
+    tim->tm_min = (int) min;
+    if (with_seconds)
+        tim->tm_sec = (int) sec;
 
     return TRUE;
 }
@@ -194,21 +323,22 @@ is_time (const char *str, struct tm *tim)
 /* --------------------------------------------------------------------------------------------- */
 
 static gboolean
-is_year (char *str, struct tm *tim)
+is_year (const ls_column_t * column, struct tm *tim)
 {
+    const char *p;
     long year;
 
-    if (str == NULL)
+    if (column == NULL)
         return FALSE;
 
-    if (strchr (str, ':') != NULL)
+    if (memchr (column->str, ':', column->len) != NULL)
         return FALSE;
 
-    if (strlen (str) != 4)
+    if (column->len != 4)
         return FALSE;
 
-    /* cppcheck-suppress invalidscanf */
-    if (sscanf (str, "%ld", &year) != 1)
+    p = column->str;
+    if (!scan_num (&p, column->str + column->len, 0, &year))
         return FALSE;
 
     if (year < 1900 || year > 3000)
@@ -219,6 +349,163 @@ is_year (char *str, struct tm *tim)
     return TRUE;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Current local time. localtime() is called once per second at most.
+ */
+
+static const struct tm *
+get_local_time (void)
+{
+    static time_t cached_time = (time_t) (-1);
+    static struct tm cached_tm;
+    time_t current_time;
+
+    current_time = time (NULL);
+    if (current_time != cached_time)
+    {
+        cached_tm = *localtime (&current_time);
+        cached_time = current_time;
+    }
+
+    return &cached_tm;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static time_t
+month_day_time (int year, int mon, int mday)
+{
+    struct tm tim;
+
+    memset (&tim, 0, sizeof (tim));
+    tim.tm_year = year;
+    tim.tm_mon = mon;
+    tim.tm_mday = mday;
+    tim.tm_isdst = -1;
+
+    return mktime (&tim);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static const month_start_t *
+get_month_start (int year, int mon)
+{
+    month_start_t *m;
+
+    m = &month_cache[(unsigned int) (year * 12 + mon) & (MONTH_CACHE_SIZE - 1)];
+
+    if (!m->valid || m->year != year || m->mon != mon)
+    {
+        time_t middle, next;
+
+        m->valid = TRUE;
+        m->year = year;
+        m->mon = mon;
+        m->days = 0;
+        m->start = month_day_time (year, mon, 1);
+        middle = month_day_time (year, mon, 15);
+        next = month_day_time (year, mon + 1, 1);
+
+        /* days are computed directly only if there is no DST change within the month */
+        if (m->start != (time_t) (-1) && next != (time_t) (-1)
+            && (next - m->start) % SECS_PER_DAY == 0 && middle == m->start + 14 * SECS_PER_DAY)
+            m->days = (int) ((next - m->start) / SECS_PER_DAY);
+    }
+
+    return m;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * mktime() for listings. Files of a listing are usually dated by a few months,
+ * so start of the month is resolved once and the time within the month is added.
+ */
+
+static time_t
+ls_mktime (struct tm *tim)
+{
+    if (tim->tm_mon >= 0 && tim->tm_mon < 12 && tim->tm_mday >= 1
+        && tim->tm_hour >= 0 && tim->tm_hour < 24 && tim->tm_min >= 0 && tim->tm_min < 60
+        && tim->tm_sec >= 0 && tim->tm_sec <= 60)
+    {
+        const month_start_t *m;
+
+        m = get_month_start (tim->tm_year, tim->tm_mon);
+        if (tim->tm_mday <= m->days)
+            return m->start + (time_t) (tim->tm_mday - 1) * SECS_PER_DAY
+                + tim->tm_hour * 60 * 60 + tim->tm_min * 60 + tim->tm_sec;
+    }
+
+    return mktime (tim);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Split line into columns in one pass. The line is not modified.
+ */
+
+static int
+split_columns (const char *p)
+{
+    for (columns_num = 0; *p != '\0' && columns_num < MAXCOLS; columns_num++)
+    {
+        const char *start;
+
+        for (; *p == ' ' || *p == '\r' || *p == '\n'; p++)
+            ;
+
+        for (start = p; *p != '\0' && *p != ' ' && *p != '\r' && *p != '\n'; p++)
+            ;
+
+        columns[columns_num].str = start;
+        columns[columns_num].len = (size_t) (p - start);
+    }
+
+    return columns_num;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Parse time value of MLSx fact: YYYYMMDDHHMMSS[.sss], always in UTC.
+ */
+
+static gboolean
+mlsx_parse_time (const char *value, time_t * t)
+{
+    int year, mon, mday, hour, min, sec;
+    GDateTime *dt;
+
+    /* cppcheck-suppress invalidscanf */
+    if (sscanf (value, "%4d%2d%2d%2d%2d%2d", &year, &mon, &mday, &hour, &min, &sec) != 6)
+        return FALSE;
+
+    dt = g_date_time_new_utc (year, mon, mday, hour, min, (gdouble) sec);
+    if (dt == NULL)
+        return FALSE;
+
+    *t = (time_t) g_date_time_to_unix (dt);
+    g_date_time_unref (dt);
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Parse owner or group of MLSx fact: servers send either numeric id or name.
+ */
+
+static int
+mlsx_parse_id (const char *value, int (*find_id) (const char *))
+{
+    const char *p;
+
+    for (p = value; isdigit ((unsigned char) *p); p++)
+        ;
+
+    return (p != value && *p == '\0') ? atoi (value) : find_id (value);
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /*** public functions ****************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -515,17 +802,14 @@ vfs_parse_raw_filemode (const char *s, size_t * ret_skipped, mode_t * ret_mode)
 int
 vfs_parse_filedate (int idx, time_t * t)
 {
-    char *p;
+    const ls_column_t *p;
     struct tm tim;
-    int d[3];
     gboolean got_year = FALSE;
     gboolean l10n = FALSE;      /* Locale's abbreviated month name */
-    time_t current_time;
-    struct tm *local_time;
+    const struct tm *local_time;
 
     /* Let's setup default time values */
-    current_time = time (NULL);
-    local_time = localtime (&current_time);
+    local_time = get_local_time ();
     tim.tm_mday = local_time->tm_mday;
     tim.tm_mon = local_time->tm_mon;
     tim.tm_year = local_time->tm_year;
@@ -535,11 +819,11 @@ vfs_parse_filedate (int idx, time_t * t)
     tim.tm_sec = 0;
     tim.tm_isdst = -1;          /* Let mktime() try to guess correct dst offset */
 
-    p = columns[idx++];
+    p = get_column (idx++);
 
     /* We eat weekday name in case of extfs */
     if (is_week (p, &tim))
-        p = columns[idx++];
+        p = get_column (idx++);
 
     /*
        ALLOWED DATE FORMATS
@@ -574,16 +858,20 @@ vfs_parse_filedate (int idx, time_t * t)
         if (!is_num (idx))
             return 0;           /* No day */
 
-        tim.tm_mday = (int) atol (columns[idx++]);
+        tim.tm_mday = (int) column_atol (get_column (idx++));
 
     }
     else if (is_dos_date (p))
     {
         /* Case with MM-DD-YY or MM-DD-YYYY */
-        p[2] = p[5] = '-';
+        char date[11];
+        int d[3];
+
+        column_to_str (p, date, sizeof (date));
+        date[2] = date[5] = '-';
 
         /* cppcheck-suppress invalidscanf */
-        if (sscanf (p, "%2d-%2d-%d", &d[0], &d[1], &d[2]) != 3)
+        if (sscanf (date, "%2d-%2d-%d", &d[0], &d[1], &d[2]) != 3)
             return 0;           /* sscanf failed */
 
         /* Months are zero based */
@@ -608,8 +896,8 @@ vfs_parse_filedate (int idx, time_t * t)
         return 0;               /* unsupported format */
 
     /* Here we expect to find time or year */
-    if (!is_num (idx)
-        || !(is_time (columns[idx], &tim) || (got_year = is_year (columns[idx], &tim))))
+    p = get_column (idx);
+    if (!is_num (idx) || !(is_time (p, &tim) || (got_year = is_year (p, &tim))))
         return 0;               /* Neither time nor date */
 
     idx++;
@@ -624,7 +912,7 @@ vfs_parse_filedate (int idx, time_t * t)
         && tim.tm_mon - local_time->tm_mon >= 6)
         tim.tm_year--;
 
-    *t = mktime (&tim);
+    *t = ls_mktime (&tim);
     if (l10n || (*t < 0))
         *t = 0;
 
@@ -636,24 +924,7 @@ vfs_parse_filedate (int idx, time_t * t)
 int
 vfs_split_text (char *p)
 {
-    char *original = p;
-    int numcols;
-
-    memset (columns, 0, sizeof (columns));
-
-    for (numcols = 0; *p != '\0' && numcols < MAXCOLS; numcols++)
-    {
-        for (; *p == ' ' || *p == '\r' || *p == '\n'; p++)
-            *p = '\0';
-
-        columns[numcols] = p;
-        column_ptr[numcols] = p - original;
-
-        for (; *p != '\0' && *p != ' ' && *p != '\r' && *p != '\n'; p++)
-            ;
-    }
-
-    return numcols;
+    return split_columns (p);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -680,9 +951,10 @@ vfs_parse_ls_lga (const char *p, struct stat * s, char **filename, char **linkna
 {
     int idx, idx2, num_cols;
     int i;
-    char *p_copy = NULL;
     char *t = NULL;
     const char *line = p;
+    const ls_column_t *name;
+    char buf[BUF_SMALL];
     size_t skipped;
     mode_t mode;
 
@@ -721,23 +993,26 @@ vfs_parse_ls_lga (const char *p, struct stat * s, char **filename, char **linkna
         s->st_mode |= perms;
     }
 
-    p_copy = g_strdup (p);
-    num_cols = vfs_split_text (p_copy);
+    num_cols = split_columns (p);
 
-    s->st_nlink = atol (columns[0]);
+    s->st_nlink = column_atol (get_column (0));
     if (s->st_nlink <= 0)
         goto error;
 
     if (!is_num (1))
-        s->st_uid = vfs_finduid (columns[1]);
+        s->st_uid = vfs_finduid (column_to_str (get_column (1), buf, sizeof (buf)));
     else
-        s->st_uid = (uid_t) atol (columns[1]);
+        s->st_uid = (uid_t) column_atol (get_column (1));
 
     /* Mhm, the ls -lg did not produce a group field */
     for (idx = 3; idx <= 5; idx++)
-        if (is_month (columns[idx], NULL) || is_week (columns[idx], NULL)
-            || is_dos_date (columns[idx]) || is_localized_month (columns[idx]))
+    {
+        const ls_column_t *column = get_column (idx);
+
+        if (is_month (column, NULL) || is_week (column, NULL)
+            || is_dos_date (column) || is_localized_month (column))
             break;
+    }
 
     if (idx == 6 || (idx == 5 && !S_ISCHR (s->st_mode) && !S_ISBLK (s->st_mode)))
         goto error;
@@ -749,9 +1024,9 @@ vfs_parse_ls_lga (const char *p, struct stat * s, char **filename, char **linkna
     {
         /* We have gid field */
         if (is_num (2))
-            s->st_gid = (gid_t) atol (columns[2]);
+            s->st_gid = (gid_t) column_atol (get_column (2));
         else
-            s->st_gid = vfs_findgid (columns[2]);
+            s->st_gid = vfs_findgid (column_to_str (get_column (2), buf, sizeof (buf)));
         idx2 = 3;
     }
 
@@ -764,17 +1039,23 @@ vfs_parse_ls_lga (const char *p, struct stat * s, char **filename, char **linkna
         if (!is_num (idx2) && idx2 == 2)
         {
             /* cppcheck-suppress invalidscanf */
-            if (!is_num (++idx2) || sscanf (columns[idx2], " %d,%d", &maj, &min) != 2)
+            if (!is_num (++idx2)
+                || sscanf (column_to_str (get_column (idx2), buf, sizeof (buf)), " %d,%d", &maj,
+                           &min) != 2)
                 goto error;
         }
         else
         {
             /* cppcheck-suppress invalidscanf */
-            if (!is_num (idx2) || sscanf (columns[idx2], " %d,", &maj) != 1)
+            if (!is_num (idx2)
+                || sscanf (column_to_str (get_column (idx2), buf, sizeof (buf)), " %d,",
+                           &maj) != 1)
                 goto error;
 
             /* cppcheck-suppress invalidscanf */
-            if (!is_num (++idx2) || sscanf (columns[idx2], " %d", &min) != 1)
+            if (!is_num (++idx2)
+                || sscanf (column_to_str (get_column (idx2), buf, sizeof (buf)), " %d",
+                           &min) != 1)
                 goto error;
         }
 #ifdef HAVE_STRUCT_STAT_ST_RDEV
@@ -789,7 +1070,8 @@ vfs_parse_ls_lga (const char *p, struct stat * s, char **filename, char **linkna
         if (!is_num (idx2))
             goto error;
 
-        s->st_size = (off_t) g_ascii_strtoll (columns[idx2], NULL, 10);
+        /* number is followed by space or end of line */
+        s->st_size = (off_t) g_ascii_strtoll (get_column (idx2)->str, NULL, 10);
 #ifdef HAVE_STRUCT_STAT_ST_RDEV
         s->st_rdev = 0;
 #endif
@@ -811,15 +1093,22 @@ vfs_parse_ls_lga (const char *p, struct stat * s, char **filename, char **linkna
 #endif
     vfs_adjust_stat (s);
 
+    /* No file name */
+    name = get_column (idx);
+    if (name == NULL)
+        goto error;
+
     if (num_spaces != NULL)
     {
-        *num_spaces = column_ptr[idx] - column_ptr[idx - 1] - strlen (columns[idx - 1]);
-        if (DIR_IS_DOTDOT (columns[idx]))
+        const ls_column_t *prev = get_column (idx - 1);
+
+        *num_spaces = (size_t) (name->str - prev->str) - prev->len;
+        if (name->len == 2 && name->str[0] == '.' && name->str[1] == '.')
             vfs_parce_ls_final_num_spaces = *num_spaces;
     }
 
     for (i = idx + 1, idx2 = 0; i < num_cols; i++)
-        if (strcmp (columns[i], "->") == 0)
+        if (columns[i].len == 2 && columns[i].str[0] == '-' && columns[i].str[1] == '>')
         {
             idx2 = i;
             break;
@@ -829,23 +1118,23 @@ vfs_parse_ls_lga (const char *p, struct stat * s, char **filename, char **linkna
         && idx2 != 0)
     {
         if (filename != NULL)
-            *filename = g_strndup (p + column_ptr[idx], column_ptr[idx2] - column_ptr[idx] - 1);
+            *filename = g_strndup (name->str, columns[idx2].str - name->str - 1);
 
         if (linkname != NULL)
         {
-            t = g_strdup (p + column_ptr[idx2 + 1]);
+            t = g_strdup (idx2 + 1 < num_cols ? columns[idx2 + 1].str : "");
             *linkname = t;
         }
     }
     else
     {
-        /* Extract the filename from the string copy, not from the columns
+        /* Extract the filename from the line, not from the columns
          * this way we have a chance of entering hidden directories like ". ."
          */
         if (filename != NULL)
         {
             /* filename = g_strdup (columns [idx++]); */
-            t = g_strdup (p + column_ptr[idx]);
+            t = g_strdup (name->str);
             *filename = t;
         }
 
@@ -858,13 +1147,12 @@ vfs_parse_ls_lga (const char *p, struct stat * s, char **filename, char **linkna
         size_t p2;
 
         p2 = strlen (t);
-        if (--p2 > 0 && (t[p2] == '\r' || t[p2] == '\n'))
-            t[p2] = '\0';
-        if (--p2 > 0 && (t[p2] == '\r' || t[p2] == '\n'))
-            t[p2] = '\0';
+        if (p2 > 1 && (t[p2 - 1] == '\r' || t[p2 - 1] == '\n'))
+            t[p2 - 1] = '\0';
+        if (p2 > 2 && (t[p2 - 2] == '\r' || t[p2 - 2] == '\n'))
+            t[p2 - 2] = '\0';
     }
 
-    g_free (p_copy);
     return TRUE;
 
   error:
@@ -872,14 +1160,158 @@ vfs_parse_ls_lga (const char *p, struct stat * s, char **filename, char **linkna
         static int errorcount = 0;
 
         if (++errorcount < 5)
-            message (D_ERROR, _("Cannot parse:"), "%s",
-                     (p_copy != NULL && *p_copy != '\0') ? p_copy : line);
+            message (D_ERROR, _("Cannot parse:"), "%s", line);
         else if (errorcount == 5)
             message (D_ERROR, MSG_ERROR, _("More parsing errors will be ignored."));
     }
 
-    g_free (p_copy);
     return FALSE;
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Parse entry of machine-readable listing (RFC 3659): MLSD line or MLST reply line.
+ *
+ * The line is "fact=value;fact=value; name". The fields of @s that are not given by facts
+ * are kept, so @s should be initialized with default values by caller.
+ *
+ * @param p line to parse
+ * @param s stat structure to fill
+ * @param filename name of file, newly allocated
+ * @param linkname target of symlink if reported by server, newly allocated; may be NULL
+ *
+ * @return TRUE on success, FALSE if line is malformed or describes the listed directory
+ *         itself or its parent (cdir and pdir types)
+ */
+
+gboolean
+vfs_parse_mlsx (const char *p, struct stat *s, char **filename, char **linkname)
+{
+    const char *name;
+    char *facts_str;
+    char **facts, **f;
+    mode_t type = 0;
+    mode_t perms = 0;
+    gboolean have_mode = FALSE;
+    const char *perm = NULL;
+    const char *target = NULL;
+    size_t len;
+
+    /* facts are mandatory for us: without type the entry is useless */
+    name = strchr (p, ' ');
+    if (name == NULL || name == p)
+        return FALSE;
+
+    facts_str = g_strndup (p, (gsize) (name - p));
+    facts = g_strsplit (facts_str, ";", -1);
+    g_free (facts_str);
+
+    for (f = facts; *f != NULL; f++)
+    {
+        char *value;
+
+        value = strchr (*f, '=');
+        if (value == NULL)
+            continue;
+        *value++ = '\0';
+
+        if (g_ascii_strcasecmp (*f, "type") == 0)
+        {
+            if (g_ascii_strcasecmp (value, "file") == 0)
+                type = S_IFREG;
+            else if (g_ascii_strcasecmp (value, "dir") == 0)
+                type = S_IFDIR;
+            else if (g_ascii_strcasecmp (value, "cdir") == 0
+                     || g_ascii_strcasecmp (value, "pdir") == 0)
+                break;
+            else if (g_ascii_strncasecmp (value, "OS.unix=slink:", 14) == 0)
+            {
+                type = S_IFLNK;
+                target = value + 14;
+            }
+            else if (g_ascii_strcasecmp (value, "OS.unix=symlink") == 0
+                     || g_ascii_strcasecmp (value, "OS.unix=slink") == 0)
+                type = S_IFLNK;
+            else
+                type = S_IFREG;
+        }
+        else if (g_ascii_strcasecmp (*f, "size") == 0 || g_ascii_strcasecmp (*f, "sizd") == 0)
+            s->st_size = (off_t) g_ascii_strtoll (value, NULL, 10);
+        else if (g_ascii_strcasecmp (*f, "modify") == 0)
+            mlsx_parse_time (value, &s->st_mtime);
+        else if (g_ascii_strcasecmp (*f, "UNIX.mode") == 0)
+        {
+            perms = (mode_t) (g_ascii_strtoull (value, NULL, 8) & 07777);
+            have_mode = TRUE;
+        }
+        else if (g_ascii_strcasecmp (*f, "UNIX.owner") == 0
+                 || g_ascii_strcasecmp (*f, "UNIX.uid") == 0)
+            s->st_uid = (uid_t) mlsx_parse_id (value, vfs_finduid);
+        else if (g_ascii_strcasecmp (*f, "UNIX.group") == 0
+                 || g_ascii_strcasecmp (*f, "UNIX.gid") == 0)
+            s->st_gid = (gid_t) mlsx_parse_id (value, vfs_findgid);
+        else if (g_ascii_strcasecmp (*f, "perm") == 0)
+            perm = value;
+    }
+
+    if (type == 0 || *f != NULL)
+    {
+        g_strfreev (facts);
+        return FALSE;
+    }
+
+    if (!have_mode)
+    {
+        /* approximate permissions of current user with the perm fact */
+        if (perm == NULL)
+            perms = S_ISDIR (type) ? 0755 : 0644;
+        else if (S_ISDIR (type))
+        {
+            if (strpbrk (perm, "lL") != NULL)
+                perms |= S_IRUSR | S_IRGRP | S_IROTH;
+            if (strpbrk (perm, "eE") != NULL)
+                perms |= S_IXUSR | S_IXGRP | S_IXOTH;
+            if (strpbrk (perm, "cCmMpP") != NULL)
+                perms |= S_IWUSR;
+        }
+        else
+        {
+            if (strpbrk (perm, "rR") != NULL)
+                perms |= S_IRUSR | S_IRGRP | S_IROTH;
+            if (strpbrk (perm, "wWaA") != NULL)
+                perms |= S_IWUSR;
+        }
+    }
+
+    if (S_ISLNK (type))
+        perms = 0777;
+
+    s->st_mode = type | perms;
+    s->st_atime = s->st_ctime = s->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    s->st_atim.tv_nsec = s->st_mtim.tv_nsec = s->st_ctim.tv_nsec = 0;
+#endif
+#ifdef HAVE_STRUCT_STAT_ST_RDEV
+    s->st_rdev = 0;
+#endif
+    /* s->st_dev and s->st_ino must be initialized by vfs_s_new_inode () */
+#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
+    s->st_blksize = 512;
+#endif
+    vfs_adjust_stat (s);
+
+    /* exactly one space separates facts and name, the rest belongs to name */
+    name++;
+    len = strlen (name);
+    while (len != 0 && (name[len - 1] == '\r' || name[len - 1] == '\n'))
+        len--;
+
+    *filename = g_strndup (name, len);
+    if (linkname != NULL)
+        *linkname = target != NULL ? g_strdup (target) : NULL;
+
+    g_strfreev (facts);
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
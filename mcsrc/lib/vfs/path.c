@@ -57,6 +57,9 @@ extern GPtrArray *vfs__classes_list;
 
 /*** file scope variables ************************************************************************/
 
+/* interned VFS prefix -> struct vfs_class * (NULL if prefix is unknown) */
+static GHashTable *vfs_prefix_class_cache = NULL;
+
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
 
@@ -441,7 +444,7 @@ vfs_path_from_str_deprecated_parser (char *path)
         }
 
         if (*op != '\0')
-            element->vfs_prefix = g_strdup (op);
+            element->vfs_prefix = g_intern_string (op);
 
         g_array_prepend_val (vpath->path, element);
     }
@@ -503,7 +506,7 @@ vfs_path_from_str_uri_parser (char *path)
 
         element = g_new0 (vfs_path_element_t, 1);
         element->class = vfs_prefix_to_class (vfs_prefix_start);
-        element->vfs_prefix = g_strdup (vfs_prefix_start);
+        element->vfs_prefix = g_intern_string (vfs_prefix_start);
 
         url_delimiter += strlen (VFS_PATH_URL_DELIMITER);
 
@@ -635,6 +638,138 @@ vfs_path_strip_home (const char *dir)
     return g_strdup (dir);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Check if name is a single plain path component which can be appended to a path
+ * without reparsing the result.
+ *
+ * @param name file name
+ *
+ * @return TRUE if name contains neither path separators nor VFS/encoding markers
+ *         and isn't "." or "..", FALSE otherwise
+ */
+
+static gboolean
+vfs_path_is_plain_name (const char *name)
+{
+    const char *p;
+
+    if (name == NULL || *name == '\0' || DIR_IS_DOT (name) || DIR_IS_DOTDOT (name))
+        return FALSE;
+
+    /* '#' and ':' are rejected as a whole to keep #enc:, ://, and drive letters out */
+    for (p = name; *p != '\0'; p++)
+        if (IS_PATH_SEP (*p) || *p == '#' || *p == ':')
+            return FALSE;
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Check if a plain name can be appended to the last element of path in place.
+ * Path is expected to be canonical as produced by vfs_path_from_str().
+ *
+ * @param vpath pointer to vfs_path_t object
+ *
+ * @return TRUE if last path element can be extended without reparsing, FALSE otherwise
+ */
+
+static gboolean
+vfs_path_can_append_name (const vfs_path_t * vpath)
+{
+    const vfs_path_element_t *element;
+
+    if (vpath == NULL || vpath->relative || vpath->str == NULL
+        || vfs_path_elements_count (vpath) == 0)
+        return FALSE;
+
+    element = vfs_path_get_by_index (vpath, -1);
+    if (!vfs_path_element_valid (element) || element->path == NULL)
+        return FALSE;
+
+#ifdef HAVE_CHARSET
+    /* recoded elements are stored differently in vpath->str */
+    if (element->encoding != NULL)
+        return FALSE;
+#endif
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+vfs_path_append_component (GString * buffer, const char *name)
+{
+    if (buffer->len != 0 && !IS_PATH_SEP (buffer->str[buffer->len - 1]))
+        g_string_append_c (buffer, PATH_SEP);
+    g_string_append (buffer, name);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char *
+vfs_path_join_component (const char *path, const char *name)
+{
+    size_t len;
+
+    len = strlen (path);
+    if (len == 0 || IS_PATH_SEP (path[len - 1]))
+        return g_strconcat (path, name, (char *) NULL);
+
+    return g_strconcat (path, PATH_SEP_STR, name, (char *) NULL);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Append one plain name to path object without building and reparsing the whole path string.
+ *
+ * @param vpath path object
+ * @param name name of file inside vpath
+ *
+ * @return newly allocated path object or NULL if fast path isn't applicable
+ */
+
+static vfs_path_t *
+vfs_path_append_name_fast (const vfs_path_t * vpath, const char *name)
+{
+    vfs_path_t *ret_vpath;
+    vfs_path_element_t *element;
+    const char *tname;
+    char *old_path;
+    int vindex, count;
+
+    if (!vfs_path_is_plain_name (name) || !vfs_path_can_append_name (vpath))
+        return NULL;
+
+    ret_vpath = vfs_path_new ();
+    count = vfs_path_elements_count (vpath);
+
+    for (vindex = 0; vindex < count; vindex++)
+    {
+        element = vfs_path_element_clone (vfs_path_get_by_index (vpath, vindex));
+        g_array_append_val (ret_vpath->path, element);
+    }
+
+    /* result of vfs_translate_path() lives in the shared buffer: use it immediately */
+    tname = vfs_translate_path (name);
+    if (tname == NULL)
+    {
+        vfs_path_free (ret_vpath);
+        return NULL;
+    }
+
+    element = (vfs_path_element_t *) vfs_path_get_by_index (ret_vpath, -1);
+    old_path = element->path;
+    element->path = vfs_path_join_component (old_path, tname);
+    g_free (old_path);
+
+    ret_vpath->str = vfs_path_join_component (vpath->str, tname);
+
+    return ret_vpath;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /*** public functions ****************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -930,7 +1065,7 @@ vfs_path_element_clone (const vfs_path_element_t * element)
     new_element->port = element->port;
     new_element->path = g_strdup (element->path);
     new_element->class = element->class;
-    new_element->vfs_prefix = g_strdup (element->vfs_prefix);
+    new_element->vfs_prefix = element->vfs_prefix;
 #ifdef HAVE_CHARSET
     new_element->encoding = g_strdup (element->encoding);
     if (vfs_path_element_need_cleanup_converter (element) && new_element->encoding != NULL)
@@ -961,7 +1096,6 @@ vfs_path_element_free (vfs_path_element_t * element)
     g_free (element->password);
     g_free (element->host);
     g_free (element->path);
-    g_free (element->vfs_prefix);
 
 #ifdef HAVE_CHARSET
     g_free (element->encoding);
@@ -1070,26 +1204,53 @@ vfs_path_remove_element_by_index (vfs_path_t * vpath, int element_index)
 struct vfs_class *
 vfs_prefix_to_class (const char *prefix)
 {
+    const char *iprefix;
+    gpointer cached;
+    struct vfs_class *result = NULL;
     guint i;
 
+    /* which() callbacks are pure, so results are memoized per interned prefix */
+    iprefix = g_intern_string (prefix);
+    if (vfs_prefix_class_cache == NULL)
+        vfs_prefix_class_cache = g_hash_table_new (g_direct_hash, g_direct_equal);
+    else if (g_hash_table_lookup_extended
+             (vfs_prefix_class_cache, (gconstpointer) iprefix, NULL, &cached))
+        return VFS_CLASS (cached);
+
     /* Avoid first class (localfs) that would accept any prefix */
-    for (i = 1; i < vfs__classes_list->len; i++)
+    for (i = 1; i < vfs__classes_list->len && result == NULL; i++)
     {
         struct vfs_class *vfs;
 
         vfs = VFS_CLASS (g_ptr_array_index (vfs__classes_list, i));
         if (vfs->which != NULL)
         {
-            if (vfs->which (vfs, prefix) == -1)
-                continue;
-            return vfs;
+            if (vfs->which (vfs, prefix) != -1)
+                result = vfs;
         }
-
-        if (vfs->prefix != NULL && strncmp (prefix, vfs->prefix, strlen (vfs->prefix)) == 0)
-            return vfs;
+        else if (vfs->prefix != NULL && strncmp (prefix, vfs->prefix, strlen (vfs->prefix)) == 0)
+            result = vfs;
     }
 
-    return NULL;
+    g_hash_table_insert (vfs_prefix_class_cache, (gpointer) iprefix, result);
+
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Forget prefix-to-class lookups. Must be called whenever the list of registered
+ * VFS classes is changed.
+ */
+
+void
+vfs_path_reset_class_cache (void)
+{
+    if (vfs_prefix_class_cache != NULL)
+    {
+        g_hash_table_destroy (vfs_prefix_class_cache);
+        vfs_prefix_class_cache = NULL;
+    }
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1258,7 +1419,9 @@ vfs_path_deserialize (const char *data, GError ** mcerror)
             (element->encoding != NULL) ? str_crt_conv_from (element->encoding) : INVALID_CONV;
 #endif
 
-        element->vfs_prefix = mc_config_get_string_raw (cpath, groupname, "vfs_prefix", NULL);
+        cfg_value = mc_config_get_string_raw (cpath, groupname, "vfs_prefix", NULL);
+        element->vfs_prefix = g_intern_string (cfg_value);
+        g_free (cfg_value);
 
         element->user = mc_config_get_string_raw (cpath, groupname, "user", NULL);
         element->password = mc_config_get_string_raw (cpath, groupname, "password", NULL);
@@ -1326,10 +1489,23 @@ vfs_path_append_new (const vfs_path_t * vpath, const char *first_element, ...)
     char *str_path;
     const char *result_str;
     vfs_path_t *ret_vpath;
+    gboolean single;
 
     if (vpath == NULL || first_element == NULL)
         return NULL;
 
+    va_start (args, first_element);
+    single = va_arg (args, char *) == NULL;
+    va_end (args);
+
+    /* the most common case: one file name inside already parsed directory */
+    if (single)
+    {
+        ret_vpath = vfs_path_append_name_fast (vpath, first_element);
+        if (ret_vpath != NULL)
+            return ret_vpath;
+    }
+
     va_start (args, first_element);
     str_path = mc_build_filenamev (first_element, args);
     va_end (args);
@@ -1342,6 +1518,110 @@ vfs_path_append_new (const vfs_path_t * vpath, const char *first_element, ...)
 
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Prepare reusable object for building paths of files inside parent directory.
+ *
+ * Parent is cloned once; every following vfs_path_child_set() call only rewrites the tail of
+ * the last path element in place, so iterating over directory entries costs no allocations.
+ *
+ * @param child object to initialize
+ * @param parent directory path. Must remain valid until vfs_path_child_clean() is called
+ */
+
+void
+vfs_path_child_init (vfs_path_child_t * child, const vfs_path_t * parent)
+{
+    vfs_path_element_t *element;
+
+    memset (child, 0, sizeof (*child));
+    child->parent = parent;
+
+    if (!vfs_path_can_append_name (parent))
+        return;
+
+    child->vpath = vfs_path_clone (parent);
+    element = (vfs_path_element_t *) vfs_path_get_by_index (child->vpath, -1);
+
+    child->path = g_string_new (element->path);
+    child->path_len = child->path->len;
+    g_free (element->path);
+    element->path = child->path->str;
+
+    child->str = g_string_new (child->vpath->str);
+    child->str_len = child->str->len;
+    g_free (child->vpath->str);
+    child->vpath->str = child->str->str;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get path of file inside parent directory.
+ *
+ * @param child object initialized by vfs_path_child_init()
+ * @param name name of file
+ *
+ * @return path object owned by child. It's valid until next call of vfs_path_child_set()
+ *         or vfs_path_child_clean()
+ */
+
+const vfs_path_t *
+vfs_path_child_set (vfs_path_child_t * child, const char *name)
+{
+    vfs_path_element_t *element;
+    const char *tname = NULL;
+
+    if (child->vpath != NULL && vfs_path_is_plain_name (name))
+        tname = vfs_translate_path (name);
+
+    if (tname == NULL)
+    {
+        vfs_path_free (child->fallback);
+        child->fallback = vfs_path_append_new (child->parent, name, (char *) NULL);
+        return child->fallback;
+    }
+
+    element = (vfs_path_element_t *) vfs_path_get_by_index (child->vpath, -1);
+
+    g_string_truncate (child->path, child->path_len);
+    vfs_path_append_component (child->path, tname);
+    element->path = child->path->str;
+
+    g_string_truncate (child->str, child->str_len);
+    vfs_path_append_component (child->str, tname);
+    child->vpath->str = child->str->str;
+
+    return child->vpath;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Free resources of child path object.
+ *
+ * @param child object initialized by vfs_path_child_init()
+ */
+
+void
+vfs_path_child_clean (vfs_path_child_t * child)
+{
+    if (child->vpath != NULL)
+    {
+        vfs_path_element_t *element;
+
+        /* strings are owned by GString buffers */
+        element = (vfs_path_element_t *) vfs_path_get_by_index (child->vpath, -1);
+        element->path = NULL;
+        child->vpath->str = NULL;
+        vfs_path_free (child->vpath);
+
+        g_string_free (child->path, TRUE);
+        g_string_free (child->str, TRUE);
+    }
+
+    vfs_path_free (child->fallback);
+    memset (child, 0, sizeof (*child));
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 /**
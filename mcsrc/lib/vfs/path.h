@@ -42,7 +42,7 @@ typedef struct
 #ifdef HAVE_CHARSET
     char *encoding;
 #endif
-    char *vfs_prefix;
+    const char *vfs_prefix;     /* interned */
 
     struct
     {
@@ -53,6 +53,18 @@ typedef struct
     } dir;
 } vfs_path_element_t;
 
+/* reusable path of files inside one directory, see vfs_path_child_init() */
+typedef struct
+{
+    vfs_path_t *vpath;          /* private copy of parent, last element is rewritten in place */
+    vfs_path_t *fallback;       /* used for names which cannot be appended in place */
+    const vfs_path_t *parent;
+    GString *path;              /* storage of last element path */
+    GString *str;               /* storage of vpath->str */
+    size_t path_len;            /* length of parent's last element path */
+    size_t str_len;             /* length of parent's string representation */
+} vfs_path_child_t;
+
 /*** global variables defined in .c file *********************************************************/
 
 /*** declarations of public functions ************************************************************/
@@ -70,6 +82,9 @@ vfs_path_t *vfs_path_from_str_flags (const char *path_str, vfs_path_flag_t flags
 vfs_path_t *vfs_path_build_filename (const char *first_element, ...);
 vfs_path_t *vfs_path_append_new (const vfs_path_t * vpath, const char *first_element, ...);
 vfs_path_t *vfs_path_append_vpath_new (const vfs_path_t * first_vpath, ...);
+void vfs_path_child_init (vfs_path_child_t * child, const vfs_path_t * parent);
+const vfs_path_t *vfs_path_child_set (vfs_path_child_t * child, const char *name);
+void vfs_path_child_clean (vfs_path_child_t * child);
 size_t vfs_path_tokens_count (const vfs_path_t *);
 char *vfs_path_tokens_get (const vfs_path_t * vpath, ssize_t start_position, ssize_t length);
 vfs_path_t *vfs_path_vtokens_get (const vfs_path_t * vpath, ssize_t start_position, ssize_t length);
@@ -80,6 +95,7 @@ vfs_path_element_t *vfs_path_element_clone (const vfs_path_element_t * element);
 void vfs_path_element_free (vfs_path_element_t * element);
 
 struct vfs_class *vfs_prefix_to_class (const char *prefix);
+void vfs_path_reset_class_cache (void);
 
 #ifdef HAVE_CHARSET
 gboolean vfs_path_element_need_cleanup_converter (const vfs_path_element_t * element);
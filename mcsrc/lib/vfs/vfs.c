@@ -320,6 +320,7 @@ vfs_register_class (struct vfs_class * vfs)
             return FALSE;
 
     g_ptr_array_add (vfs__classes_list, vfs);
+    vfs_path_reset_class_cache ();
 
     return TRUE;
 }
@@ -333,6 +334,7 @@ vfs_unregister_class (struct vfs_class *vfs)
         vfs->done (vfs);
 
     g_ptr_array_remove (vfs__classes_list, vfs);
+    vfs_path_reset_class_cache ();
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -523,6 +525,7 @@ vfs_shut (void)
     vfs_openfiles = NULL;
     g_ptr_array_free (vfs__classes_list, TRUE);
     vfs__classes_list = NULL;
+    vfs_path_reset_class_cache ();
     g_string_free (vfs_str_buffer, TRUE);
     vfs_str_buffer = NULL;
     current_vfs = NULL;
@@ -684,40 +687,34 @@ vfs_preallocate (int dest_vfs_fd, off_t src_fsize, off_t dest_fsize)
 int
 vfs_clone_file (int dest_vfs_fd, int src_vfs_fd)
 {
-#ifdef FICLONE
     void *dest_fd = NULL;
     void *src_fd = NULL;
     struct vfs_class *dest_class;
     struct vfs_class *src_class;
 
     dest_class = vfs_class_find_by_handle (dest_vfs_fd, &dest_fd);
-    if ((dest_class->flags & VFSF_LOCAL) == 0)
-    {
-        errno = EOPNOTSUPP;
-        return (-1);
-    }
-    if (dest_fd == NULL)
+    src_class = vfs_class_find_by_handle (src_vfs_fd, &src_fd);
+    if (dest_class == NULL || dest_fd == NULL || src_class == NULL || src_fd == NULL)
     {
         errno = EBADF;
         return (-1);
     }
 
-    src_class = vfs_class_find_by_handle (src_vfs_fd, &src_fd);
-    if ((src_class->flags & VFSF_LOCAL) == 0)
-    {
-        errno = EOPNOTSUPP;
-        return (-1);
-    }
-    if (src_fd == NULL)
+    /* remote file system may copy the file on server side */
+    if ((dest_class->flags & VFSF_LOCAL) == 0 || (src_class->flags & VFSF_LOCAL) == 0)
     {
-        errno = EBADF;
-        return (-1);
+        if (dest_class != src_class || dest_class->copy_file == NULL)
+        {
+            errno = EOPNOTSUPP;
+            return (-1);
+        }
+
+        return dest_class->copy_file (dest_fd, src_fd);
     }
 
+#ifdef FICLONE
     return ioctl (*(int *) dest_fd, FICLONE, *(int *) src_fd);
 #else
-    (void) dest_vfs_fd;
-    (void) src_vfs_fd;
     errno = EOPNOTSUPP;
     return (-1);
 #endif
@@ -123,7 +123,14 @@ typedef enum
 /* Operations for mc_ctl - on open file */
 enum
 {
-    VFS_CTL_IS_NOTREADY
+    VFS_CTL_IS_NOTREADY,
+
+    /* Data is about to be written to the file opened for writing, arg is off_t * with
+       the amount of it. Filesystems which must announce the size before sending data
+       can then stream writes instead of collecting them in a temporary file.
+       Returns 1 if the hint was taken, after that exactly this amount of data must be
+       written, otherwise writing or closing the file fails */
+    VFS_CTL_EXPECTED_SIZE
 };
 
 /* Operations for mc_setctl - on path */
@@ -136,7 +143,25 @@ enum
 
     /* Setting this makes vfs layer give out potentially incorrect data,
        but it also makes some operations much faster. Use with caution. */
-    VFS_SETCTL_STALE_DATA
+    VFS_SETCTL_STALE_DATA,
+
+    /* Files in the directory are about to be read. arg is NULL-terminated array
+       of file names relative to the directory, directories are read recursively */
+    VFS_SETCTL_PREFETCH,
+
+    /* Get position of file data in archive, arg is off_t *. Directory position is
+       position of its first file. -1 is stored if file has no data */
+    VFS_SETCTL_DATA_OFFSET,
+
+    /* Directory tree is about to be walked. Remote filesystems which can list
+       the whole tree in one request put it into directory cache.
+       Returns 1 if the tree is in cache */
+    VFS_SETCTL_LOAD_TREE,
+
+    /* Directory may be entered soon. Remote filesystems with directory cache
+       load it unless it is cached and up to date; no connection is opened for it.
+       Returns 1 if the directory was loaded */
+    VFS_SETCTL_PREFETCH_DIR
 };
 
 /*** structures declarations (and typedefs of structures)*****************************************/
@@ -207,6 +232,9 @@ typedef struct vfs_class
 
     int (*ctl) (void *vfs_info, int ctlop, void *arg);
     int (*setctl) (const vfs_path_t * vpath, int ctlop, void *arg);
+
+    /* copy data between two open files of the same connection without transferring it */
+    int (*copy_file) (void *dest_vfs_info, void *src_vfs_info);
     /* *INDENT-ON* */
 } vfs_class;
 
@@ -16,6 +16,7 @@
 
 #include "lib/global.h"         /* GList */
 #include "lib/vfs/path.h"       /* vfs_path_t */
+#include "lib/vfs/blockcache.h" /* vfs_blockcache_t */
 
 /*** typedefs(not structures) and defined constants **********************************************/
 
@@ -58,6 +59,8 @@ typedef enum
 
 /*** structures declarations (and typedefs of structures)*****************************************/
 
+struct vfs_s_arena;
+
 /* Single connection or archive */
 struct vfs_s_super
 {
@@ -67,6 +70,7 @@ struct vfs_s_super
     int fd_usage;               /* Number of open files */
     int ino_usage;              /* Usage count of this superblock */
     gboolean want_stale;        /* If set, we do not flush cache properly */
+    struct vfs_s_arena *arena;  /* Memory of directory tree of read-only archive */
 #ifdef ENABLE_VFS_NET
     vfs_path_element_t *path_element;
 #endif                          /* ENABLE_VFS_NET */
@@ -96,8 +100,17 @@ struct vfs_s_inode
     char *localname;            /* Filename of local file, if we have one */
     struct timeval timestamp;   /* Subclass specific */
     off_t data_offset;          /* Subclass specific */
+    gboolean tree;              /* Subdirectories were loaded together with this directory */
 };
 
+/* Directories listed by dir_load_tree() before they are put into cache */
+typedef struct
+{
+    struct vfs_class *me;
+    struct vfs_s_super *super;
+    GHashTable *dirs;           /* path relative to loaded directory -> directory inode */
+} vfs_s_tree_t;
+
 /* Data associated with an open file */
 typedef struct
 {
@@ -106,6 +119,7 @@ typedef struct
     int handle;                 /* This is for module's use, but if != -1, will be mc_close()d */
     gboolean changed;           /* Did this file change? */
     vfs_linear_state_t linear;  /* Is that file open with O_LINEAR? */
+    vfs_blockcache_t *cache;    /* Parts of remote file read so far, if read by ranges */
 } vfs_file_handler_t;
 
 /*
@@ -136,18 +150,27 @@ struct vfs_s_subclass
     vfs_file_handler_t *(*fh_new) (struct vfs_s_inode * ino, gboolean changed);
     int (*fh_open) (struct vfs_class * me, vfs_file_handler_t * fh, int flags, mode_t mode);
     int (*fh_close) (struct vfs_class * me, vfs_file_handler_t * fh);
+    /* optional, used to write to the file which has no local handle */
+    ssize_t (*fh_write) (struct vfs_class * me, vfs_file_handler_t * fh, const char *buf,
+                         size_t len);
     void (*fh_free) (vfs_file_handler_t * fh);
 
     struct vfs_s_entry *(*find_entry) (struct vfs_class * me,
                                        struct vfs_s_inode * root,
                                        const char *path, int follow, int flags);
     int (*dir_load) (struct vfs_class * me, struct vfs_s_inode * ino, char *path);
+    /* optional, load directory with all subdirectories, see vfs_s_tree_new() */
+    int (*dir_load_tree) (struct vfs_class * me, struct vfs_s_super * super, const char *path);
     int (*dir_uptodate) (struct vfs_class * me, struct vfs_s_inode * ino);
     int (*file_store) (struct vfs_class * me, vfs_file_handler_t * fh, char *path, char *localname);
 
     int (*linear_start) (struct vfs_class * me, vfs_file_handler_t * fh, off_t from);
     ssize_t (*linear_read) (struct vfs_class * me, vfs_file_handler_t * fh, void *buf, size_t len);
     void (*linear_close) (struct vfs_class * me, vfs_file_handler_t * fh);
+
+    /* optional, read part of remote file instead of retrieving it as a whole */
+    ssize_t (*read_range) (struct vfs_class * me, vfs_file_handler_t * fh, off_t offset,
+                           char *buf, size_t len);
     /* *INDENT-ON* */
 };
 
@@ -164,6 +187,7 @@ struct vfs_s_entry *vfs_s_new_entry (struct vfs_class *me, const char *name,
                                      struct vfs_s_inode *inode);
 void vfs_s_free_entry (struct vfs_class *me, struct vfs_s_entry *ent);
 void vfs_s_insert_entry (struct vfs_class *me, struct vfs_s_inode *dir, struct vfs_s_entry *ent);
+void vfs_s_set_linkname (struct vfs_s_inode *ino, const char *linkname, gssize len);
 int vfs_s_entry_compare (const void *a, const void *b);
 struct stat *vfs_s_default_stat (struct vfs_class *me, mode_t mode);
 
@@ -181,9 +205,15 @@ const char *vfs_s_get_path (const vfs_path_t * vpath, struct vfs_s_super **archi
 struct vfs_s_super *vfs_get_super_by_vpath (const vfs_path_t * vpath);
 
 void vfs_s_invalidate (struct vfs_class *me, struct vfs_s_super *super);
+
+vfs_s_tree_t *vfs_s_tree_new (struct vfs_class *me, struct vfs_s_super *super);
+struct vfs_s_inode *vfs_s_tree_dir (vfs_s_tree_t * tree, const char *relpath, gboolean complete);
+void vfs_s_tree_store (vfs_s_tree_t * tree, const char *path, int timeout);
+void vfs_s_tree_free (vfs_s_tree_t * tree);
 char *vfs_s_fullpath (struct vfs_class *me, struct vfs_s_inode *ino);
 
 void vfs_s_init_fh (vfs_file_handler_t * fh, struct vfs_s_inode *ino, gboolean changed);
+int vfs_s_archive_setctl (const vfs_path_t * vpath, int ctlop, void *arg);
 
 /* network filesystems support */
 int vfs_s_select_on_two (int fd1, int fd2);
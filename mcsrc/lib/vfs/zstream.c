@@ -0,0 +1,1124 @@
+/*
+   Virtual File System: in-process decompression of archives
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * \brief Source: Virtual File System: in-process decompression of archives
+ *
+ * Compressed tar and cpio archives used to be decompressed by sfs into a temporary
+ * file before the archive was scanned. This module decodes the compressed file
+ * in place with zlib, libbz2, liblzma or libzstd (whatever is available at build time)
+ * and gives the archive filesystems a read-only stream with forward and backward seek.
+ *
+ * Seeking forward decodes and drops data. While data is decoded for the first time
+ * (usually during the archive scan), seek points are recorded where the decoder
+ * can be restarted: deflate block boundaries with a snapshot of the 32K window for gzip,
+ * frame boundaries for zstd. xz files have an index of their blocks at the end, so seek
+ * points of xz are block boundaries taken from it when the file is opened. Any later seek
+ * restarts decoding from the nearest seek point before the requested offset instead of
+ * from the beginning of file. bzip2 and legacy lzma decoders can't be resumed in the middle
+ * of a stream and always restart from the beginning.
+ *
+ * Seek points are taken every ZSTREAM_SPAN bytes of decompressed data. If there are
+ * too many of them, every second one is dropped and the span is doubled.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>             /* free() */
+#include <sys/types.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BZLIB
+#include <bzlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "lib/global.h"
+#include "lib/util.h"
+
+#include "vfs.h"
+#include "zstream.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define ZSTREAM_IN_SIZE (128 * 1024)
+#define ZSTREAM_OUT_SIZE (128 * 1024)
+
+/* initial distance between seek points */
+#define ZSTREAM_SPAN (1024 * 1024)
+/* limit of memory used by seek points: 32K window of zlib each */
+#define ZSTREAM_MAX_POINTS 512
+
+/*** file scope type declarations ****************************************************************/
+
+typedef enum
+{
+    ZSTREAM_OK,                 /* some input consumed or some output produced */
+    ZSTREAM_END,                /* end of compressed stream */
+    ZSTREAM_ERROR
+} zstream_status_t;
+
+typedef struct
+{
+    off_t in_offset;            /* offset in compressed file */
+    off_t out_offset;           /* offset in decompressed data */
+    int bits;                   /* gzip: number of bits of byte at in_offset - 1 to use */
+    unsigned char *window;      /* gzip: dictionary */
+    size_t window_len;
+} zstream_point_t;
+
+typedef struct
+{
+    enum compression_type type;
+    /* first byte of the next member of concatenated file,
+       0 if decoder handles concatenated streams itself */
+    int magic;
+    gboolean (*init) (vfs_zstream_t * zs);
+    zstream_status_t (*decode) (vfs_zstream_t * zs);
+    void (*done) (vfs_zstream_t * zs);
+    /* start decoding at seek point, NULL if decoder can't be resumed */
+    gboolean (*restore) (vfs_zstream_t * zs, const zstream_point_t * point);
+} zstream_codec_t;
+
+struct vfs_zstream_t
+{
+    int fd;                     /* compressed file */
+    const zstream_codec_t *codec;
+
+    union
+    {
+#ifdef HAVE_ZLIB
+        z_stream z;
+#endif
+#ifdef HAVE_BZLIB
+        bz_stream bz;
+#endif
+#ifdef HAVE_LZMA
+        lzma_stream xz;
+#endif
+#ifdef HAVE_ZSTD
+        ZSTD_DStream *zstd;
+#endif
+        int dummy;
+    } u;
+    gboolean raw;               /* decoding after restore from seek point: raw deflate data
+                                   of gzip, single blocks of xz */
+#ifdef HAVE_LZMA
+    lzma_index *xz_index;       /* xz: blocks of all streams, NULL if index can't be read */
+    lzma_block xz_block;        /* xz: options of the block being decoded in raw mode */
+    lzma_filter xz_filters[LZMA_FILTERS_MAX + 1];
+#endif
+
+    char *in_buf;
+    off_t in_offset;            /* offset of in_buf[0] in compressed file */
+    size_t in_pos;
+    size_t in_len;
+    gboolean in_eof;
+
+    char *out_buf;
+    size_t out_pos;
+    size_t out_len;
+    off_t out_offset;           /* uncompressed offset of out_buf[0] */
+    gboolean eof;
+
+    GArray *points;             /* seek points sorted by offset */
+    off_t span;
+};
+
+/*** file scope variables ************************************************************************/
+
+/*** forward declarations (file scope functions) *************************************************/
+
+static gboolean zstream_want_point (const vfs_zstream_t * zs, off_t out_offset);
+static void zstream_add_point (vfs_zstream_t * zs, off_t in_offset, off_t out_offset, int bits,
+                               const unsigned char *window, size_t window_len);
+#ifdef HAVE_LZMA
+static gboolean zstream_skip_input (vfs_zstream_t * zs, size_t count);
+static gboolean zstream_copy_input (vfs_zstream_t * zs, void *dest, size_t count);
+#endif
+
+/* --------------------------------------------------------------------------------------------- */
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_ZLIB
+static gboolean
+zstream_gzip_init (vfs_zstream_t * zs)
+{
+    memset (&zs->u.z, 0, sizeof (zs->u.z));
+    zs->raw = FALSE;
+    /* 15 bits of window, +32: detect gzip or zlib header */
+    return (inflateInit2 (&zs->u.z, 15 + 32) == Z_OK);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static zstream_status_t
+zstream_gzip_decode (vfs_zstream_t * zs)
+{
+    z_stream *z = &zs->u.z;
+    int ret;
+
+    z->next_in = (Bytef *) zs->in_buf + zs->in_pos;
+    z->avail_in = (uInt) (zs->in_len - zs->in_pos);
+    z->next_out = (Bytef *) zs->out_buf + zs->out_len;
+    z->avail_out = (uInt) (ZSTREAM_OUT_SIZE - zs->out_len);
+
+    /* stop at the end of each deflate block to look for seek point */
+    ret = inflate (z, Z_BLOCK);
+
+    zs->in_pos = zs->in_len - z->avail_in;
+    zs->out_len = ZSTREAM_OUT_SIZE - z->avail_out;
+
+    /* bit 7: at the end of block; bit 6: last block */
+    if (ret == Z_OK && (z->data_type & 128) != 0 && (z->data_type & 64) == 0)
+    {
+        off_t out_offset = zs->out_offset + (off_t) zs->out_len;
+
+        if (zstream_want_point (zs, out_offset))
+        {
+            unsigned char window[32 * 1024];
+            uInt window_len = sizeof (window);
+
+            if (inflateGetDictionary (z, window, &window_len) == Z_OK)
+                zstream_add_point (zs, zs->in_offset + (off_t) zs->in_pos, out_offset,
+                                   z->data_type & 7, window, window_len);
+        }
+    }
+
+    switch (ret)
+    {
+    case Z_OK:
+    case Z_BUF_ERROR:
+        return ZSTREAM_OK;
+    case Z_STREAM_END:
+        return ZSTREAM_END;
+    default:
+        return ZSTREAM_ERROR;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zstream_gzip_done (vfs_zstream_t * zs)
+{
+    inflateEnd (&zs->u.z);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+zstream_gzip_restore (vfs_zstream_t * zs, const zstream_point_t * point)
+{
+    z_stream *z = &zs->u.z;
+
+    memset (z, 0, sizeof (*z));
+    /* member header was parsed before, decode raw deflate data */
+    if (inflateInit2 (z, -15) != Z_OK)
+        return FALSE;
+    zs->raw = TRUE;
+
+    if (point->bits != 0)
+    {
+        /* input is positioned at the partially used byte */
+        if (zs->in_len == 0)
+            return FALSE;
+        inflatePrime (z, point->bits, ((unsigned char) zs->in_buf[0]) >> (8 - point->bits));
+        zs->in_pos = 1;
+    }
+
+    return (inflateSetDictionary (z, point->window, (uInt) point->window_len) == Z_OK);
+}
+#endif /* HAVE_ZLIB */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_BZLIB
+static gboolean
+zstream_bzip2_init (vfs_zstream_t * zs)
+{
+    memset (&zs->u.bz, 0, sizeof (zs->u.bz));
+    return (BZ2_bzDecompressInit (&zs->u.bz, 0, 0) == BZ_OK);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static zstream_status_t
+zstream_bzip2_decode (vfs_zstream_t * zs)
+{
+    bz_stream *bz = &zs->u.bz;
+    int ret;
+
+    bz->next_in = zs->in_buf + zs->in_pos;
+    bz->avail_in = (unsigned int) (zs->in_len - zs->in_pos);
+    bz->next_out = zs->out_buf + zs->out_len;
+    bz->avail_out = (unsigned int) (ZSTREAM_OUT_SIZE - zs->out_len);
+
+    ret = BZ2_bzDecompress (bz);
+
+    zs->in_pos = zs->in_len - bz->avail_in;
+    zs->out_len = ZSTREAM_OUT_SIZE - bz->avail_out;
+
+    switch (ret)
+    {
+    case BZ_OK:
+        return ZSTREAM_OK;
+    case BZ_STREAM_END:
+        return ZSTREAM_END;
+    default:
+        return ZSTREAM_ERROR;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zstream_bzip2_done (vfs_zstream_t * zs)
+{
+    BZ2_bzDecompressEnd (&zs->u.bz);
+}
+#endif /* HAVE_BZLIB */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_LZMA
+static gboolean
+zstream_pread (int fd, off_t offset, void *buf, size_t len)
+{
+    char *p = (char *) buf;
+
+    if (mc_lseek (fd, offset, SEEK_SET) != offset)
+        return FALSE;
+
+    while (len != 0)
+    {
+        ssize_t n;
+
+        n = mc_read (fd, p, len);
+        if (n <= 0)
+            return FALSE;
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read indexes of all streams of xz file from its end.
+ *
+ * @return combined index, NULL if file has no valid index
+ */
+
+static lzma_index *
+zstream_xz_read_index (int fd)
+{
+    lzma_index *combined = NULL;
+    uint8_t buf[LZMA_STREAM_HEADER_SIZE];
+    off_t pos;
+
+    pos = mc_lseek (fd, 0, SEEK_END);
+    if (pos < 0 || pos % 4 != 0)
+        return NULL;
+
+    while (pos > 0)
+    {
+        lzma_stream_flags footer, header;
+        lzma_index *index = NULL;
+        lzma_vli padding = 0, index_size;
+        uint64_t memlimit = UINT64_MAX;
+        uint8_t *index_buf;
+        size_t in_pos = 0;
+        gboolean ok;
+
+        /* Stream Padding: multiple of four null bytes */
+        while (TRUE)
+        {
+            if (pos < 2 * LZMA_STREAM_HEADER_SIZE || !zstream_pread (fd, pos - 4, buf, 4))
+                goto fail;
+            if (buf[0] != 0 || buf[1] != 0 || buf[2] != 0 || buf[3] != 0)
+                break;
+            pos -= 4;
+            padding += 4;
+        }
+
+        pos -= LZMA_STREAM_HEADER_SIZE;
+        if (!zstream_pread (fd, pos, buf, LZMA_STREAM_HEADER_SIZE)
+            || lzma_stream_footer_decode (&footer, buf) != LZMA_OK)
+            goto fail;
+
+        index_size = footer.backward_size;
+        if ((lzma_vli) pos < index_size + LZMA_STREAM_HEADER_SIZE)
+            goto fail;
+        pos -= (off_t) index_size;
+
+        index_buf = g_malloc (index_size);
+        ok = zstream_pread (fd, pos, index_buf, index_size)
+            && lzma_index_buffer_decode (&index, &memlimit, NULL, index_buf, &in_pos,
+                                         index_size) == LZMA_OK;
+        g_free (index_buf);
+        if (!ok)
+            goto fail;
+
+        /* Stream Header is followed by blocks */
+        ok = (lzma_vli) pos >= lzma_index_total_size (index) + LZMA_STREAM_HEADER_SIZE;
+        if (ok)
+        {
+            pos -= (off_t) (lzma_index_total_size (index) + LZMA_STREAM_HEADER_SIZE);
+            ok = zstream_pread (fd, pos, buf, LZMA_STREAM_HEADER_SIZE)
+                && lzma_stream_header_decode (&header, buf) == LZMA_OK
+                && lzma_stream_flags_compare (&header, &footer) == LZMA_OK
+                && lzma_index_stream_flags (index, &footer) == LZMA_OK
+                && lzma_index_stream_padding (index, padding) == LZMA_OK
+                && (combined == NULL || lzma_index_cat (index, combined, NULL) == LZMA_OK);
+        }
+        if (!ok)
+        {
+            lzma_index_end (index, NULL);
+            goto fail;
+        }
+
+        combined = index;
+    }
+
+    return combined;
+
+  fail:
+    if (combined != NULL)
+        lzma_index_end (combined, NULL);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+zstream_xz_init (vfs_zstream_t * zs)
+{
+    const lzma_stream init = LZMA_STREAM_INIT;
+
+    zs->u.xz = init;
+    zs->raw = FALSE;
+    /* handles both .xz and legacy .lzma formats */
+    return (lzma_auto_decoder (&zs->u.xz, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Start decoding of the block @iter points to. Input is positioned at the block header.
+ */
+
+static gboolean
+zstream_xz_start_block (vfs_zstream_t * zs, const lzma_index_iter * iter)
+{
+    uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+    lzma_ret ret;
+    int i;
+
+    /* null byte is Index Indicator */
+    if (!zstream_copy_input (zs, header, 1) || header[0] == 0)
+        return FALSE;
+
+    memset (&zs->xz_block, 0, sizeof (zs->xz_block));
+    zs->xz_block.header_size = lzma_block_header_size_decode (header[0]);
+    zs->xz_block.check = iter->stream.flags->check;
+    zs->xz_block.filters = zs->xz_filters;
+
+    if (!zstream_copy_input (zs, header + 1, zs->xz_block.header_size - 1)
+        || lzma_block_header_decode (&zs->xz_block, NULL, header) != LZMA_OK)
+        return FALSE;
+
+    ret = lzma_block_decoder (&zs->u.xz, &zs->xz_block);
+
+    /* filter options are only needed to initialize decoder */
+    for (i = 0; zs->xz_filters[i].id != LZMA_VLI_UNKNOWN; i++)
+        free (zs->xz_filters[i].options);
+
+    return (ret == LZMA_OK);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * In raw mode: block is decoded, go on with the next one, probably in the next stream.
+ */
+
+static zstream_status_t
+zstream_xz_next_block (vfs_zstream_t * zs)
+{
+    lzma_index_iter iter;
+    off_t in_offset, out_offset;
+
+    out_offset = zs->out_offset + (off_t) zs->out_len;
+
+    lzma_index_iter_init (&iter, zs->xz_index);
+    if (lzma_index_iter_locate (&iter, (lzma_vli) out_offset))
+        return ZSTREAM_END;
+
+    /* skip Index, Stream Footer and Stream Padding of the stream and Header of the next one */
+    in_offset = zs->in_offset + (off_t) zs->in_pos;
+    if (iter.block.uncompressed_file_offset != (lzma_vli) out_offset
+        || (off_t) iter.block.compressed_file_offset < in_offset
+        || !zstream_skip_input (zs, (size_t) ((off_t) iter.block.compressed_file_offset -
+                                              in_offset))
+        || !zstream_xz_start_block (zs, &iter))
+        return ZSTREAM_ERROR;
+
+    return ZSTREAM_OK;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static zstream_status_t
+zstream_xz_decode (vfs_zstream_t * zs)
+{
+    lzma_stream *xz = &zs->u.xz;
+    lzma_ret ret;
+
+    xz->next_in = (const uint8_t *) zs->in_buf + zs->in_pos;
+    xz->avail_in = zs->in_len - zs->in_pos;
+    xz->next_out = (uint8_t *) zs->out_buf + zs->out_len;
+    xz->avail_out = ZSTREAM_OUT_SIZE - zs->out_len;
+
+    ret = lzma_code (xz, zs->in_eof ? LZMA_FINISH : LZMA_RUN);
+
+    zs->in_pos = zs->in_len - xz->avail_in;
+    zs->out_len = ZSTREAM_OUT_SIZE - xz->avail_out;
+
+    switch (ret)
+    {
+    case LZMA_OK:
+    case LZMA_BUF_ERROR:
+        return ZSTREAM_OK;
+    case LZMA_STREAM_END:
+        return zs->raw ? zstream_xz_next_block (zs) : ZSTREAM_END;
+    default:
+        return ZSTREAM_ERROR;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zstream_xz_done (vfs_zstream_t * zs)
+{
+    lzma_end (&zs->u.xz);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+zstream_xz_restore (vfs_zstream_t * zs, const zstream_point_t * point)
+{
+    const lzma_stream init = LZMA_STREAM_INIT;
+    lzma_index_iter iter;
+
+    zs->u.xz = init;
+    zs->raw = TRUE;
+
+    lzma_index_iter_init (&iter, zs->xz_index);
+    return (!lzma_index_iter_locate (&iter, (lzma_vli) point->out_offset)
+            && iter.block.uncompressed_file_offset == (lzma_vli) point->out_offset
+            && zstream_xz_start_block (zs, &iter));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Take seek points at block boundaries from the index at the end of xz file.
+ */
+
+static void
+zstream_xz_add_points (vfs_zstream_t * zs)
+{
+    lzma_index_iter iter;
+
+    zs->xz_index = zstream_xz_read_index (zs->fd);
+    if (zs->xz_index == NULL)
+        return;
+
+    lzma_index_iter_init (&iter, zs->xz_index);
+    while (!lzma_index_iter_next (&iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK))
+    {
+        off_t out_offset = (off_t) iter.block.uncompressed_file_offset;
+
+        if (zstream_want_point (zs, out_offset))
+            zstream_add_point (zs, (off_t) iter.block.compressed_file_offset, out_offset, 0,
+                               NULL, 0);
+    }
+}
+#endif /* HAVE_LZMA */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_ZSTD
+static gboolean
+zstream_zstd_init (vfs_zstream_t * zs)
+{
+    zs->u.zstd = ZSTD_createDStream ();
+    return (zs->u.zstd != NULL && !ZSTD_isError (ZSTD_initDStream (zs->u.zstd)));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static zstream_status_t
+zstream_zstd_decode (vfs_zstream_t * zs)
+{
+    ZSTD_inBuffer in;
+    ZSTD_outBuffer out;
+    size_t ret;
+
+    in.src = zs->in_buf;
+    in.size = zs->in_len;
+    in.pos = zs->in_pos;
+    out.dst = zs->out_buf;
+    out.size = ZSTREAM_OUT_SIZE;
+    out.pos = zs->out_len;
+
+    /* next frame of concatenated file is started automatically */
+    ret = ZSTD_decompressStream (zs->u.zstd, &out, &in);
+
+    zs->in_pos = in.pos;
+    zs->out_len = out.pos;
+
+    /* frame is completely decoded and flushed: next frame can be decoded independently */
+    if (ret == 0)
+    {
+        off_t out_offset = zs->out_offset + (off_t) zs->out_len;
+
+        if (zstream_want_point (zs, out_offset))
+            zstream_add_point (zs, zs->in_offset + (off_t) zs->in_pos, out_offset, 0, NULL, 0);
+    }
+
+    return ZSTD_isError (ret) ? ZSTREAM_ERROR : ZSTREAM_OK;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zstream_zstd_done (vfs_zstream_t * zs)
+{
+    ZSTD_freeDStream (zs->u.zstd);
+    zs->u.zstd = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+zstream_zstd_restore (vfs_zstream_t * zs, const zstream_point_t * point)
+{
+    (void) point;
+
+    return zstream_zstd_init (zs);
+}
+#endif /* HAVE_ZSTD */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* *INDENT-OFF* */
+static const zstream_codec_t zstream_codecs[] =
+{
+#ifdef HAVE_ZLIB
+    { COMPRESSION_GZIP, 0x1f, zstream_gzip_init, zstream_gzip_decode, zstream_gzip_done,
+      zstream_gzip_restore },
+#endif
+#ifdef HAVE_BZLIB
+    { COMPRESSION_BZIP2, 'B', zstream_bzip2_init, zstream_bzip2_decode, zstream_bzip2_done,
+      NULL },
+#endif
+#ifdef HAVE_LZMA
+    { COMPRESSION_LZMA, 0, zstream_xz_init, zstream_xz_decode, zstream_xz_done, NULL },
+    { COMPRESSION_XZ, 0, zstream_xz_init, zstream_xz_decode, zstream_xz_done,
+      zstream_xz_restore },
+#endif
+#ifdef HAVE_ZSTD
+    { COMPRESSION_ZSTD, 0, zstream_zstd_init, zstream_zstd_decode, zstream_zstd_done,
+      zstream_zstd_restore },
+#endif
+    { COMPRESSION_NONE, 0, NULL, NULL, NULL, NULL }
+};
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+static const zstream_codec_t *
+zstream_find_codec (enum compression_type type)
+{
+    const zstream_codec_t *codec;
+
+    for (codec = zstream_codecs; codec->init != NULL; codec++)
+        if (codec->type == type)
+            return codec;
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+zstream_read_input (vfs_zstream_t * zs)
+{
+    ssize_t n;
+
+    zs->in_offset += (off_t) zs->in_len;
+
+    n = mc_read (zs->fd, zs->in_buf, ZSTREAM_IN_SIZE);
+    if (n < 0)
+        return FALSE;
+
+    zs->in_pos = 0;
+    zs->in_len = (size_t) n;
+    zs->in_eof = (n == 0);
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+zstream_skip_input (vfs_zstream_t * zs, size_t count)
+{
+    while (count != 0)
+    {
+        size_t n;
+
+        if (zs->in_pos == zs->in_len && (zs->in_eof || !zstream_read_input (zs) || zs->in_eof))
+            return FALSE;
+
+        n = MIN (count, zs->in_len - zs->in_pos);
+        zs->in_pos += n;
+        count -= n;
+    }
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_LZMA
+static gboolean
+zstream_copy_input (vfs_zstream_t * zs, void *dest, size_t count)
+{
+    char *p = (char *) dest;
+
+    while (count != 0)
+    {
+        size_t n;
+
+        if (zs->in_pos == zs->in_len && (zs->in_eof || !zstream_read_input (zs) || zs->in_eof))
+            return FALSE;
+
+        n = MIN (count, zs->in_len - zs->in_pos);
+        memcpy (p, zs->in_buf + zs->in_pos, n);
+        zs->in_pos += n;
+        p += n;
+        count -= n;
+    }
+
+    return TRUE;
+}
+#endif /* HAVE_LZMA */
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zstream_free_point (zstream_point_t * point)
+{
+    g_free (point->window);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Check if seek point at @out_offset is far enough from the previous one.
+ */
+
+static gboolean
+zstream_want_point (const vfs_zstream_t * zs, off_t out_offset)
+{
+    return (out_offset >= zs->span
+            && (zs->points->len == 0
+                || out_offset - g_array_index (zs->points, zstream_point_t,
+                                               zs->points->len - 1).out_offset >= zs->span));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zstream_add_point (vfs_zstream_t * zs, off_t in_offset, off_t out_offset, int bits,
+                   const unsigned char *window, size_t window_len)
+{
+    zstream_point_t point;
+
+    if (zs->points->len >= ZSTREAM_MAX_POINTS)
+    {
+        guint i, j;
+
+        /* keep every second point */
+        for (i = 0, j = 0; i < zs->points->len; i++)
+        {
+            zstream_point_t *p = &g_array_index (zs->points, zstream_point_t, i);
+
+            if (i % 2 == 0)
+                g_array_index (zs->points, zstream_point_t, j++) = *p;
+            else
+                zstream_free_point (p);
+        }
+        g_array_set_size (zs->points, j);
+        zs->span *= 2;
+    }
+
+    point.in_offset = in_offset;
+    point.out_offset = out_offset;
+    point.bits = bits;
+    point.window = window_len == 0 ? NULL : g_memdup (window, window_len);
+    point.window_len = window_len;
+    g_array_append_val (zs->points, point);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Find the last seek point before offset.
+ */
+
+static const zstream_point_t *
+zstream_find_point (const vfs_zstream_t * zs, off_t offset)
+{
+    guint lo = 0, hi = zs->points->len;
+
+    /* binary search for the first point after offset */
+    while (lo < hi)
+    {
+        guint mid = lo + (hi - lo) / 2;
+
+        if (g_array_index (zs->points, zstream_point_t, mid).out_offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo == 0 ? NULL : &g_array_index (zs->points, zstream_point_t, lo - 1);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+zstream_restore (vfs_zstream_t * zs, const zstream_point_t * point)
+{
+    off_t start;
+
+    start = point->in_offset - (point->bits != 0 ? 1 : 0);
+    if (mc_lseek (zs->fd, start, SEEK_SET) != start)
+        return FALSE;
+
+    zs->codec->done (zs);
+
+    zs->in_offset = start;
+    zs->in_pos = 0;
+    zs->in_len = 0;
+    zs->in_eof = FALSE;
+    zs->out_pos = 0;
+    zs->out_len = 0;
+    zs->out_offset = point->out_offset;
+    zs->eof = FALSE;
+
+    /* zstream_read_input() moves in_offset forward by in_len */
+    if (point->bits != 0 && !zstream_read_input (zs))
+        return FALSE;
+
+    return zs->codec->restore (zs, point);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Check if another compressed member follows the finished one (pigz, pbzip2 output).
+ * Trailing garbage (e.g. zero padding of tape blocks) is ignored.
+ */
+
+static gboolean
+zstream_next_member (vfs_zstream_t * zs)
+{
+    if (zs->codec->magic == 0)
+        return FALSE;
+
+    /* gzip trailer is not consumed by raw deflate decoder */
+    if (zs->raw && !zstream_skip_input (zs, 8))
+        return FALSE;
+
+    if (zs->in_pos == zs->in_len && (zs->in_eof || !zstream_read_input (zs) || zs->in_eof))
+        return FALSE;
+
+    if ((unsigned char) zs->in_buf[zs->in_pos] != zs->codec->magic)
+        return FALSE;
+
+    zs->codec->done (zs);
+    return zs->codec->init (zs);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Drop the output buffer and decode next portion of data.
+ *
+ * @return FALSE on error
+ */
+
+static gboolean
+zstream_fill (vfs_zstream_t * zs)
+{
+    zs->out_offset += (off_t) zs->out_len;
+    zs->out_pos = 0;
+    zs->out_len = 0;
+
+    while (zs->out_len == 0 && !zs->eof)
+    {
+        if (zs->in_pos == zs->in_len && !zs->in_eof && !zstream_read_input (zs))
+            return FALSE;
+
+        switch (zs->codec->decode (zs))
+        {
+        case ZSTREAM_END:
+            if (!zstream_next_member (zs))
+                zs->eof = TRUE;
+            break;
+        case ZSTREAM_ERROR:
+            return FALSE;
+        default:
+            /* truncated file: show as much as was decoded */
+            if (zs->in_eof && zs->in_pos == zs->in_len && zs->out_len == 0)
+                zs->eof = TRUE;
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+zstream_rewind (vfs_zstream_t * zs)
+{
+    if (mc_lseek (zs->fd, 0, SEEK_SET) != 0)
+        return FALSE;
+
+    zs->codec->done (zs);
+
+    zs->in_offset = 0;
+    zs->in_pos = 0;
+    zs->in_len = 0;
+    zs->in_eof = FALSE;
+    zs->out_pos = 0;
+    zs->out_len = 0;
+    zs->out_offset = 0;
+    zs->eof = FALSE;
+
+    return zs->codec->init (zs);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Create decompressing stream on top of open file.
+ *
+ * @param fd file descriptor of compressed file. It is not closed by vfs_zstream_close()
+ * @param type compression type detected by get_compression_type()
+ *
+ * @return new stream or NULL if this compression type can not be decoded in-process
+ *         and caller should fall back to sfs
+ */
+
+vfs_zstream_t *
+vfs_zstream_open (int fd, enum compression_type type)
+{
+    const zstream_codec_t *codec;
+    vfs_zstream_t *zs;
+
+    codec = zstream_find_codec (type);
+    if (codec == NULL || mc_lseek (fd, 0, SEEK_SET) != 0)
+        return NULL;
+
+    zs = g_new0 (vfs_zstream_t, 1);
+    zs->fd = fd;
+    zs->codec = codec;
+    zs->in_buf = g_malloc (ZSTREAM_IN_SIZE);
+    zs->out_buf = g_malloc (ZSTREAM_OUT_SIZE);
+    zs->points = g_array_new (FALSE, FALSE, sizeof (zstream_point_t));
+    zs->span = ZSTREAM_SPAN;
+
+    /* get_compression_type() treats compress, pack and pkzip as gzip: zlib can't decode them */
+    if (!zstream_read_input (zs) || (codec->magic != 0 && zs->in_len >= 2
+                                     && (unsigned char) zs->in_buf[0] != codec->magic)
+        || (type == COMPRESSION_GZIP && (zs->in_len < 2 || (unsigned char) zs->in_buf[1] != 0x8b))
+        || !codec->init (zs))
+    {
+        g_array_free (zs->points, TRUE);
+        g_free (zs->in_buf);
+        g_free (zs->out_buf);
+        g_free (zs);
+        mc_lseek (fd, 0, SEEK_SET);
+        return NULL;
+    }
+
+#ifdef HAVE_LZMA
+    if (type == COMPRESSION_XZ)
+    {
+        zstream_xz_add_points (zs);
+        /* continue reading after the first block of input */
+        if (mc_lseek (fd, zs->in_offset + (off_t) zs->in_len, SEEK_SET) == -1)
+        {
+            vfs_zstream_close (zs);
+            return NULL;
+        }
+    }
+#endif
+
+    return zs;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+void
+vfs_zstream_close (vfs_zstream_t * zs)
+{
+    guint i;
+
+    if (zs == NULL)
+        return;
+
+    zs->codec->done (zs);
+
+    for (i = 0; i < zs->points->len; i++)
+        zstream_free_point (&g_array_index (zs->points, zstream_point_t, i));
+    g_array_free (zs->points, TRUE);
+
+#ifdef HAVE_LZMA
+    if (zs->xz_index != NULL)
+        lzma_index_end (zs->xz_index, NULL);
+#endif
+
+    g_free (zs->in_buf);
+    g_free (zs->out_buf);
+    g_free (zs);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read decompressed data.
+ *
+ * @return number of bytes read, 0 at the end of data, -1 on decompression or I/O error
+ */
+
+ssize_t
+vfs_zstream_read (vfs_zstream_t * zs, char *buffer, size_t count)
+{
+    size_t done = 0;
+
+    while (done < count)
+    {
+        size_t n;
+
+        if (zs->out_pos == zs->out_len)
+        {
+            if (!zstream_fill (zs))
+                return done != 0 ? (ssize_t) done : -1;
+            if (zs->out_len == 0)
+                break;
+        }
+
+        n = MIN (count - done, zs->out_len - zs->out_pos);
+        memcpy (buffer + done, zs->out_buf + zs->out_pos, n);
+        zs->out_pos += n;
+        done += n;
+    }
+
+    return (ssize_t) done;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Set position in decompressed data.
+ *
+ * @return new position (less than offset if it's past the end of data), -1 on error
+ */
+
+off_t
+vfs_zstream_seek (vfs_zstream_t * zs, off_t offset)
+{
+    off_t end;
+
+    if (offset < 0)
+        return -1;
+
+    end = zs->out_offset + (off_t) zs->out_len;
+
+    /* going back or far forward: look for seek point */
+    if (offset < zs->out_offset || offset > end + zs->span)
+    {
+        const zstream_point_t *point = NULL;
+
+        if (zs->codec->restore != NULL)
+            point = zstream_find_point (zs, offset);
+
+        if (point != NULL && (offset < zs->out_offset || point->out_offset > end))
+        {
+            if (!zstream_restore (zs, point))
+                return -1;
+        }
+        else if (offset < zs->out_offset && !zstream_rewind (zs))
+            return -1;
+    }
+
+    while (offset > zs->out_offset + (off_t) zs->out_len)
+    {
+        if (zs->eof)
+        {
+            offset = zs->out_offset + (off_t) zs->out_len;
+            break;
+        }
+
+        if (!zstream_fill (zs))
+            return -1;
+    }
+
+    zs->out_pos = (size_t) (offset - zs->out_offset);
+
+    return offset;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+off_t
+vfs_zstream_tell (const vfs_zstream_t * zs)
+{
+    return zs->out_offset + (off_t) zs->out_pos;
+}
+
+/* --------------------------------------------------------------------------------------------- */
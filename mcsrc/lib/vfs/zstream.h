@@ -0,0 +1,32 @@
+/**
+ * \file
+ * \brief Header: Virtual File System: in-process decompression of archives
+ */
+
+#ifndef MC__VFS_ZSTREAM_H
+#define MC__VFS_ZSTREAM_H
+
+#include "lib/util.h"           /* enum compression_type */
+
+/*** typedefs(not structures) and defined constants **********************************************/
+
+/*** enums ***************************************************************************************/
+
+/*** structures declarations (and typedefs of structures)*****************************************/
+
+typedef struct vfs_zstream_t vfs_zstream_t;
+
+/*** global variables defined in .c file *********************************************************/
+
+/*** declarations of public functions ************************************************************/
+
+vfs_zstream_t *vfs_zstream_open (int fd, enum compression_type type);
+void vfs_zstream_close (vfs_zstream_t * zs);
+
+ssize_t vfs_zstream_read (vfs_zstream_t * zs, char *buffer, size_t count);
+off_t vfs_zstream_seek (vfs_zstream_t * zs, off_t offset);
+off_t vfs_zstream_tell (const vfs_zstream_t * zs);
+
+/*** inline functions ****************************************************************************/
+
+#endif /* MC__VFS_ZSTREAM_H */
@@ -18,6 +18,10 @@ m4_include([m4.include/vfs/mc-vfs-undelfs.m4])
 m4_include([m4.include/vfs/mc-vfs-tarfs.m4])
 m4_include([m4.include/vfs/mc-vfs-cpiofs.m4])
 m4_include([m4.include/vfs/mc-vfs-samba.m4])
+m4_include([m4.include/vfs/mc-vfs-decompress.m4])
+m4_include([m4.include/vfs/mc-vfs-zipfs.m4])
+m4_include([m4.include/vfs/mc-vfs-arfs.m4])
+m4_include([m4.include/vfs/mc-vfs-iso9660fs.m4])
 
 dnl mc_VFS_CHECKS
 dnl   Check for various functions needed by libvfs.
@@ -79,6 +83,11 @@ AC_DEFUN([mc_VFS_CHECKS],
     mc_VFS_TARFS
     mc_VFS_UNDELFS
 
+    mc_VFS_DECOMPRESS
+    mc_VFS_ZIPFS
+    mc_VFS_ARFS
+    mc_VFS_ISO9660FS
+
     AM_CONDITIONAL(ENABLE_VFS, [test x"$enable_vfs" = x"yes"])
 
     if test x"$enable_vfs_ftp" = x"yes" -o x"$enable_vfs_fish" = x"yes" -o x"$enable_vfs_smb" = x"yes"; then
@@ -0,0 +1,19 @@
+dnl ar filesystem support
+AC_DEFUN([mc_VFS_ARFS],
+[
+    AC_ARG_ENABLE([vfs-ar],
+		    AS_HELP_STRING([--enable-vfs-ar], [Support for ar filesystem @<:@yes@:>@]))
+    dnl prefixes used by mc.ext to open ar archives and deb packages
+    ARFS_PREFIX="uar"
+    DEBFS_PREFIX="deb"
+    if test "$enable_vfs" = "yes" -a x"$enable_vfs_ar" != x"no"; then
+	enable_vfs_ar="yes"
+	ARFS_PREFIX="ar"
+	DEBFS_PREFIX="ar"
+	AC_DEFINE([ENABLE_VFS_AR], [1], [Support for ar filesystem])
+	mc_VFS_ADDNAME([ar])
+    fi
+    AC_SUBST(ARFS_PREFIX)
+    AC_SUBST(DEBFS_PREFIX)
+    AM_CONDITIONAL(ENABLE_VFS_AR, [test "$enable_vfs" = "yes" -a x"$enable_vfs_ar" = x"yes"])
+])
@@ -0,0 +1,41 @@
+dnl mc_VFS_DECOMPRESS
+dnl    Check for compression libraries used by tar and cpio filesystems
+dnl    to read compressed archives without temporary files, and by zip filesystem.
+dnl    May define HAVE_ZLIB, HAVE_BZLIB, HAVE_LZMA and HAVE_ZSTD for cpp.
+
+AC_DEFUN([mc_VFS_DECOMPRESS],
+[
+    if test x"$enable_vfs_tar" = x"yes" -o x"$enable_vfs_cpio" = x"yes" \
+	    -o \( "$enable_vfs" = "yes" -a x"$enable_vfs_zip" != x"no" \); then
+	AC_CHECK_HEADER([zlib.h],
+	    [AC_CHECK_LIB([z], [inflate],
+		[
+		    AC_DEFINE([HAVE_ZLIB], [1], [Define if zlib is available])
+		    MCLIBS="$MCLIBS -lz"
+		    have_zlib=yes
+		])])
+
+	AC_CHECK_HEADER([bzlib.h],
+	    [AC_CHECK_LIB([bz2], [BZ2_bzDecompress],
+		[
+		    AC_DEFINE([HAVE_BZLIB], [1], [Define if libbz2 is available])
+		    MCLIBS="$MCLIBS -lbz2"
+		])])
+
+	AC_CHECK_HEADER([lzma.h],
+	    [AC_CHECK_LIB([lzma], [lzma_auto_decoder],
+		[
+		    AC_DEFINE([HAVE_LZMA], [1], [Define if liblzma is available])
+		    MCLIBS="$MCLIBS -llzma"
+		])])
+
+	AC_CHECK_HEADER([zstd.h],
+	    [AC_CHECK_LIB([zstd], [ZSTD_decompressStream],
+		[
+		    AC_DEFINE([HAVE_ZSTD], [1], [Define if libzstd is available])
+		    MCLIBS="$MCLIBS -lzstd"
+		])])
+    fi
+
+    AM_CONDITIONAL([ZLIB], [test x"$have_zlib" = x"yes"])
+])
@@ -0,0 +1,16 @@
+dnl ISO9660 filesystem support
+AC_DEFUN([mc_VFS_ISO9660FS],
+[
+    AC_ARG_ENABLE([vfs-iso9660],
+		    AS_HELP_STRING([--enable-vfs-iso9660], [Support for ISO9660 filesystem @<:@yes@:>@]))
+    dnl prefix used by mc.ext to open ISO images
+    ISO9660FS_PREFIX="iso9660"
+    if test "$enable_vfs" = "yes" -a x"$enable_vfs_iso9660" != x"no"; then
+	enable_vfs_iso9660="yes"
+	ISO9660FS_PREFIX="iso"
+	AC_DEFINE([ENABLE_VFS_ISO9660], [1], [Support for ISO9660 filesystem])
+	mc_VFS_ADDNAME([iso9660])
+    fi
+    AC_SUBST(ISO9660FS_PREFIX)
+    AM_CONDITIONAL(ENABLE_VFS_ISO9660, [test "$enable_vfs" = "yes" -a x"$enable_vfs_iso9660" = x"yes"])
+])
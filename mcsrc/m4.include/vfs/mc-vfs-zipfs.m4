@@ -0,0 +1,23 @@
+dnl ZIP filesystem support
+dnl    Needs zlib found by mc_VFS_DECOMPRESS.
+AC_DEFUN([mc_VFS_ZIPFS],
+[
+    AC_ARG_ENABLE([vfs-zip],
+		    AS_HELP_STRING([--enable-vfs-zip], [Support for zip filesystem @<:@yes@:>@]))
+    dnl prefix used by mc.ext to open zip archives
+    ZIPFS_PREFIX="uzip"
+    if test "$enable_vfs" = "yes" -a x"$enable_vfs_zip" != x"no"; then
+	if test x"$have_zlib" = x"yes"; then
+	    enable_vfs_zip="yes"
+	    ZIPFS_PREFIX="zip"
+	    mc_VFS_ADDNAME([zip])
+	    AC_DEFINE([ENABLE_VFS_ZIP], [1], [Support for zip filesystem])
+	elif test x"$enable_vfs_zip" = x"yes"; then
+	    AC_MSG_ERROR([zlib is required for zip filesystem])
+	else
+	    enable_vfs_zip="no"
+	fi
+    fi
+    AC_SUBST(ZIPFS_PREFIX)
+    AM_CONDITIONAL(ENABLE_VFS_ZIP, [test "$enable_vfs" = "yes" -a x"$enable_vfs_zip" = x"yes"])
+])
@@ -135,6 +135,13 @@ typedef enum
     HARDLINK_ABORT              /**< Stop file operation after hardlink creation error */
 } hardlink_status_t;
 
+/* Marked file and position of its data in the archive */
+typedef struct
+{
+    int index;
+    off_t offset;
+} marked_file_t;
+
 /*
  * This array introduced to avoid translation problems. The former (op_names)
  * is assumed to be nouns, suitable in dialog box titles; this one should
@@ -625,6 +632,7 @@ do_compute_dir_size (const vfs_path_t * dirname_vpath, dirsize_status_msg_t * ds
     struct stat s;
     DIR *dir;
     struct dirent *dirent;
+    vfs_path_child_t child;
     FileProgressStatus ret = FILE_CONT;
 
     if (!compute_symlinks)
@@ -644,18 +652,23 @@ do_compute_dir_size (const vfs_path_t * dirname_vpath, dirsize_status_msg_t * ds
 
     (*dir_count)++;
 
+    /* remote filesystem can list the whole tree in one request; no-op for its subdirectories */
+    mc_setctl (dirname_vpath, VFS_SETCTL_LOAD_TREE, NULL);
+
     dir = mc_opendir (dirname_vpath);
     if (dir == NULL)
         return ret;
 
+    vfs_path_child_init (&child, dirname_vpath);
+
     while (ret == FILE_CONT && (dirent = mc_readdir (dir)) != NULL)
     {
-        vfs_path_t *tmp_vpath;
+        const vfs_path_t *tmp_vpath;
 
         if (DIR_IS_DOT (dirent->d_name) || DIR_IS_DOTDOT (dirent->d_name))
             continue;
 
-        tmp_vpath = vfs_path_append_new (dirname_vpath, dirent->d_name, (char *) NULL);
+        tmp_vpath = vfs_path_child_set (&child, dirent->d_name);
 
         res = mc_lstat (tmp_vpath, &s);
         if (res == 0)
@@ -680,10 +693,9 @@ do_compute_dir_size (const vfs_path_t * dirname_vpath, dirsize_status_msg_t * ds
                 ret = sm->update (sm);
             }
         }
-
-        vfs_path_free (tmp_vpath);
     }
 
+    vfs_path_child_clean (&child);
     mc_closedir (dir);
     return ret;
 }
@@ -1415,33 +1427,36 @@ recursive_erase (file_op_total_context_t * tctx, file_op_context_t * ctx, const
     struct dirent *next;
     DIR *reading;
     const char *s;
+    vfs_path_child_t child;
     FileProgressStatus return_status = FILE_CONT;
 
     reading = mc_opendir (vpath);
     if (reading == NULL)
         return FILE_RETRY;
 
+    vfs_path_child_init (&child, vpath);
+
     while ((next = mc_readdir (reading)) && return_status != FILE_ABORT)
     {
-        vfs_path_t *tmp_vpath;
+        const vfs_path_t *tmp_vpath;
         struct stat buf;
 
         if (DIR_IS_DOT (next->d_name) || DIR_IS_DOTDOT (next->d_name))
             continue;
 
-        tmp_vpath = vfs_path_append_new (vpath, next->d_name, (char *) NULL);
+        tmp_vpath = vfs_path_child_set (&child, next->d_name);
         if (mc_lstat (tmp_vpath, &buf) != 0)
         {
             mc_closedir (reading);
-            vfs_path_free (tmp_vpath);
+            vfs_path_child_clean (&child);
             return FILE_RETRY;
         }
         if (S_ISDIR (buf.st_mode))
             return_status = recursive_erase (tctx, ctx, tmp_vpath);
         else
             return_status = erase_file (tctx, ctx, tmp_vpath);
-        vfs_path_free (tmp_vpath);
     }
+    vfs_path_child_clean (&child);
     mc_closedir (reading);
 
     if (return_status == FILE_ABORT)
@@ -2140,6 +2155,88 @@ operate_one_file (const WPanel * panel, FileOperation operation, file_op_total_c
     return value;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Let VFS know which files are about to be read. Archives that extract files with external
+ * programs can extract them all at once then.
+ */
+
+static void
+panel_operate_prefetch (const WPanel * panel, const char *source)
+{
+    GPtrArray *names;
+
+    names = g_ptr_array_new ();
+
+    if (source != NULL)
+        g_ptr_array_add (names, (char *) source);
+    else
+    {
+        int i;
+
+        for (i = 0; i < panel->dir.len; i++)
+            if (panel->dir.list[i].f.marked)
+                g_ptr_array_add (names, panel->dir.list[i].fname);
+    }
+
+    g_ptr_array_add (names, NULL);
+    mc_setctl (panel->cwd_vpath, VFS_SETCTL_PREFETCH, names->pdata);
+    g_ptr_array_free (names, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+marked_file_compare (const void *a, const void *b)
+{
+    const marked_file_t *m1 = (const marked_file_t *) a;
+    const marked_file_t *m2 = (const marked_file_t *) b;
+
+    if (m1->offset != m2->offset)
+        return m1->offset < m2->offset ? -1 : 1;
+
+    return m1->index - m2->index;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get marked files in order they should be processed. If VFS knows position of files
+ * in archive, files are read in archive order, so archive is read sequentially.
+ */
+
+static GArray *
+panel_operate_get_marked (const WPanel * panel, FileOperation operation)
+{
+    GArray *marked;
+    gboolean ordered = (operation != OP_DELETE);
+    int i;
+
+    marked = g_array_sized_new (FALSE, FALSE, sizeof (marked_file_t), panel->marked);
+
+    for (i = 0; i < panel->dir.len; i++)
+        if (panel->dir.list[i].f.marked)
+        {
+            marked_file_t m = { i, -1 };
+
+            if (ordered)
+            {
+                vfs_path_t *vpath;
+
+                vpath = vfs_path_append_new (panel->cwd_vpath, panel->dir.list[i].fname,
+                                             (char *) NULL);
+                ordered = (mc_setctl (vpath, VFS_SETCTL_DATA_OFFSET, &m.offset) == 1);
+                vfs_path_free (vpath);
+            }
+
+            g_array_append_val (marked, m);
+        }
+
+    if (ordered)
+        g_array_sort (marked, marked_file_compare);
+
+    return marked;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 #ifdef ENABLE_BACKGROUND
@@ -2463,8 +2560,17 @@ copy_file_file (file_op_total_context_t * tctx, file_op_context_t * ctx,
     appending = ctx->do_append;
     ctx->do_append = FALSE;
 
-    /* Try clone the file first. */
-    if (vfs_clone_file (dest_desc, src_desc) == 0)
+    /* Remote filesystems which need the size in advance can send data as it is written.
+       Only the size of a regular local file is reliable enough for that. */
+    if (S_ISREG (src_mode) && vfs_file_is_local (src_vpath))
+    {
+        off_t expected_size = file_size - ctx->do_reget;
+
+        mc_ctl (dest_desc, VFS_CTL_EXPECTED_SIZE, &expected_size);
+    }
+
+    /* Try clone the file first. Remote file system may copy it without transferring data. */
+    if (!appending && ctx->do_reget == 0 && vfs_clone_file (dest_desc, src_desc) == 0)
     {
         dst_status = DEST_FULL;
         return_status = FILE_CONT;
@@ -2956,6 +3062,9 @@ copy_dir_dir (file_op_total_context_t * tctx, file_op_context_t * ctx, const cha
         }
     }
 
+    /* remote filesystem can list the whole tree in one request; no-op for its subdirectories */
+    mc_setctl (src_vpath, VFS_SETCTL_LOAD_TREE, NULL);
+
     /* open the source dir for reading */
     reading = mc_opendir (src_vpath);
     if (reading == NULL)
@@ -3354,6 +3463,10 @@ panel_operate (void *source_panel, FileOperation operation, gboolean force_singl
             }
         }
 
+        if (operation != OP_DELETE && S_ISDIR (src_stat.st_mode)
+            && get_current_type () != view_tree)
+            panel_operate_prefetch (panel, source);
+
         value =
             operate_single_file (panel, operation, tctx, ctx, source, &src_stat, dest, dialog_type);
 
@@ -3389,14 +3502,20 @@ panel_operate (void *source_panel, FileOperation operation, gboolean force_singl
         if (panel_operate_init_totals (panel, NULL, NULL, ctx, file_op_compute_totals, dialog_type)
             == FILE_CONT)
         {
+            GArray *marked;
+            guint j;
+
+            if (operation != OP_DELETE)
+                panel_operate_prefetch (panel, NULL);
+
+            marked = panel_operate_get_marked (panel, operation);
+
             /* Loop for every file, perform the actual copy operation */
-            for (i = 0; i < panel->dir.len; i++)
+            for (j = 0; j < marked->len; j++)
             {
                 const char *source2;
 
-                if (!panel->dir.list[i].f.marked)
-                    continue;   /* Skip the unmarked ones */
-
+                i = g_array_index (marked, marked_file_t, j).index;
                 source2 = panel->dir.list[i].fname;
                 src_stat = panel->dir.list[i].st;
 
@@ -3422,6 +3541,8 @@ panel_operate (void *source_panel, FileOperation operation, gboolean force_singl
 
                 mc_refresh ();
             }                   /* Loop for every file */
+
+            g_array_free (marked, TRUE);
         }
     }                           /* Many entries */
 
@@ -84,6 +84,9 @@
 /* The hook list for the select file function */
 hook_t *select_file_hook = NULL;
 
+/* Number of subdirectories around the cursor loaded in advance on remote file systems */
+int panel_prefetch_dirs = 4;
+
 /* *INDENT-OFF* */
 panelized_panel_t panelized_panel = { {NULL, 0, -1, NULL}, NULL };
 /* *INDENT-ON* */
@@ -117,6 +120,9 @@ mc_fhl_t *mc_filehighlight = NULL;
 #define MARKED_SELECTED 3
 #define STATUS          5
 
+/* time a listing is loaded in advance for: the panel and its connection are busy meanwhile */
+#define PANEL_PREFETCH_BUDGET (G_USEC_PER_SEC / 2)
+
 /*** file scope type declarations ****************************************************************/
 
 typedef enum
@@ -370,6 +376,15 @@ static WPanel *mouse_mark_panel = NULL;
 static gboolean mouse_marking = FALSE;
 static int state_mark = 0;
 
+/* Directory whose subdirectories are loaded in advance */
+static vfs_path_t *prefetch_vpath = NULL;
+/* Names of subdirectories already tried */
+static GHashTable *prefetch_tried = NULL;
+/* Subdirectories loaded besides the selected ones */
+static int prefetch_loaded = 0;
+/* Full paths of directories whose listing took longer than PANEL_PREFETCH_BUDGET */
+static GHashTable *prefetch_slow = NULL;
+
 /* --------------------------------------------------------------------------------------------- */
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -4232,6 +4247,139 @@ panel_dir_list_callback (dir_list_cb_state_t state, void *data)
     }
 }
 
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+panel_prefetch_reset (const vfs_path_t * vpath)
+{
+    vfs_path_free (prefetch_vpath);
+    prefetch_vpath = vfs_path_clone (vpath);
+
+    if (prefetch_tried != NULL)
+        g_hash_table_remove_all (prefetch_tried);
+    else if (vpath != NULL)
+        prefetch_tried = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    prefetch_loaded = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* next subdirectory to load: selected one, then the nearest ones below and above it */
+static const char *
+panel_prefetch_next (const WPanel * panel, gboolean * neighbour)
+{
+    int i;
+
+    for (i = 0; i <= 2 * panel_prefetch_dirs; i++)
+    {
+        int idx;
+        const file_entry_t *fe;
+
+        *neighbour = i != 0;
+        if (*neighbour && prefetch_loaded >= panel_prefetch_dirs)
+            break;
+
+        idx = panel->selected + (i % 2 != 0 ? (i + 1) / 2 : -(i / 2));
+        if (idx < 0 || idx >= panel->dir.len)
+            continue;
+
+        fe = &panel->dir.list[idx];
+        if ((S_ISDIR (fe->st.st_mode) || link_isdir (fe)) && !DIR_IS_DOTDOT (fe->fname)
+            && g_hash_table_lookup (prefetch_tried, fe->fname) == NULL)
+        {
+            vfs_path_t *vpath;
+            gboolean slow;
+
+            vpath = vfs_path_append_new (panel->cwd_vpath, fe->fname, (char *) NULL);
+            slow = prefetch_slow != NULL
+                && g_hash_table_lookup (prefetch_slow, vfs_path_as_str (vpath)) != NULL;
+            vfs_path_free (vpath);
+
+            if (!slow)
+                return fe->fname;
+        }
+    }
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Idle hook: load listings of subdirectories user will likely enter next into the directory
+ * cache of remote file system, so that entering them doesn't wait for the server.
+ * One listing is loaded at a time while no key is pressed; changing the directory starts
+ * over for the new one.
+ *
+ * A listing can't be interrupted, and the panel waits for it and for the connection it uses.
+ * So a directory whose listing took longer than PANEL_PREFETCH_BUDGET is never loaded
+ * in advance again, and no more neighbours are loaded from the slow server until
+ * the directory is changed.
+ */
+
+static void
+panel_prefetch_hook (void *data)
+{
+    WPanel *panel = current_panel;
+
+    (void) data;
+
+    /* wait while other dialog is running */
+    if (top_dlg == NULL || DIALOG (top_dlg->data) != midnight_dlg)
+        return;
+
+    if (get_current_type () != view_listing || panel->is_panelized || panel_prefetch_dirs <= 0
+        || (vfs_path_get_by_index (panel->cwd_vpath, -1)->class->flags & VFSF_REMOTE) == 0)
+    {
+        delete_hook (&idle_hook, panel_prefetch_hook);
+        panel_prefetch_reset (NULL);
+        return;
+    }
+
+    if (!vfs_path_equal (prefetch_vpath, panel->cwd_vpath))
+        panel_prefetch_reset (panel->cwd_vpath);
+
+    while (is_idle ())
+    {
+        const char *fname;
+        char *name;
+        gboolean neighbour;
+        vfs_path_t *vpath;
+        guint64 start;
+
+        fname = panel_prefetch_next (panel, &neighbour);
+        if (fname == NULL)
+        {
+            /* restarted by select_item() */
+            delete_hook (&idle_hook, panel_prefetch_hook);
+            break;
+        }
+
+        name = g_strdup (fname);
+        g_hash_table_insert (prefetch_tried, name, name);
+
+        vpath = vfs_path_append_new (panel->cwd_vpath, name, (char *) NULL);
+        start = mc_timer_elapsed (mc_global.timer);
+        if (mc_setctl (vpath, VFS_SETCTL_PREFETCH_DIR, NULL) == 1 && neighbour)
+            prefetch_loaded++;
+
+        if (mc_timer_elapsed (mc_global.timer) - start > PANEL_PREFETCH_BUDGET)
+        {
+            char *path;
+
+            if (prefetch_slow == NULL)
+                prefetch_slow = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+            path = g_strdup (vfs_path_as_str (vpath));
+            g_hash_table_insert (prefetch_slow, path, path);
+
+            /* don't block the panel on the slow server any more */
+            prefetch_loaded = panel_prefetch_dirs;
+        }
+
+        vfs_path_free (vpath);
+    }
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /*** public functions ****************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -4551,6 +4699,10 @@ select_item (WPanel * panel)
     panel->dirty = 1;
 
     execute_hooks (select_file_hook);
+
+    if (panel_prefetch_dirs > 0 && !hook_present (idle_hook, panel_prefetch_hook)
+        && (vfs_path_get_by_index (panel->cwd_vpath, -1)->class->flags & VFSF_REMOTE) != 0)
+        add_hook (&idle_hook, panel_prefetch_hook, NULL);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -5028,6 +5180,19 @@ panel_deinit (void)
     g_free (panel_history_show_list_char);
     g_free (panel_filename_scroll_left_char);
     g_free (panel_filename_scroll_right_char);
+
+    delete_hook (&idle_hook, panel_prefetch_hook);
+    panel_prefetch_reset (NULL);
+    if (prefetch_tried != NULL)
+    {
+        g_hash_table_destroy (prefetch_tried);
+        prefetch_tried = NULL;
+    }
+    if (prefetch_slow != NULL)
+    {
+        g_hash_table_destroy (prefetch_slow);
+        prefetch_slow = NULL;
+    }
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -144,6 +144,7 @@ typedef struct
 extern panelized_panel_t panelized_panel;
 
 extern hook_t *select_file_hook;
+extern int panel_prefetch_dirs;
 
 extern mc_fhl_t *mc_filehighlight;
 
@@ -48,6 +48,9 @@
 #ifdef ENABLE_VFS_FISH
 #include "src/vfs/fish/fish.h"
 #endif
+#ifdef ENABLE_VFS_SFTP
+#include "src/vfs/sftpfs/init.h"
+#endif
 
 #ifdef HAVE_CHARSET
 #include "lib/charsets.h"
@@ -296,6 +299,7 @@ static const struct
     { "shell_patterns", &easy_patterns },
     { "auto_save_setup", &auto_save_setup },
     { "preallocate_space", &mc_global.vfs.preallocate_space },
+    { "vfs_archive_index", &mc_global.vfs.archive_index },
     { "auto_menu", &auto_menu },
     { "use_internal_view", &use_internal_view },
     { "use_internal_edit", &use_internal_edit },
@@ -342,6 +346,9 @@ static const struct
     { "ftpfs_first_cd_then_ls", &ftpfs_first_cd_then_ls },
     { "ignore_ftp_chattr_errors", & ftpfs_ignore_chattr_errors} ,
 #endif /* ENABLE_VFS_FTP */
+#ifdef ENABLE_VFS_SFTP
+    { "sftpfs_remote_copy", &sftpfs_remote_copy },
+#endif /* ENABLE_VFS_SFTP */
 #endif /* ENABLE_VFS */
 #ifdef USE_INTERNAL_EDIT
     { "editor_fill_tabs_with_spaces", &option_fill_tabs_with_spaces },
@@ -384,16 +391,23 @@ static const struct
     { "double_click_speed", &double_click_speed },
     { "old_esc_mode_timeout", &old_esc_mode_timeout },
     { "max_dirt_limit", &mcview_max_dirt_limit },
+    { "mcview_cache_size", &mcview_cache_size },
+    { "mcview_growbuf_size", &mcview_growbuf_size },
     { "num_history_items_recorded", &num_history_items_recorded },
 #ifdef ENABLE_VFS
     { "vfs_timeout", &vfs_timeout },
 #ifdef ENABLE_VFS_FTP
     { "ftpfs_directory_timeout", &ftpfs_directory_timeout },
     { "ftpfs_retry_seconds", &ftpfs_retry_seconds },
+    { "ftpfs_max_connections", &ftpfs_max_connections },
 #endif /* ENABLE_VFS_FTP */
 #ifdef ENABLE_VFS_FISH
     { "fish_directory_timeout", &fish_directory_timeout },
 #endif /* ENABLE_VFS_FISH */
+#ifdef ENABLE_VFS_SFTP
+    { "sftpfs_window_size", &sftpfs_window_size },
+#endif /* ENABLE_VFS_SFTP */
+    { "panel_prefetch_dirs", &panel_prefetch_dirs },
 #endif /* ENABLE_VFS */
     /* option_tab_spacing is used in internal viewer */
     { "editor_tab_spacing", &option_tab_spacing },
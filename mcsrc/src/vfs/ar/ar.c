@@ -0,0 +1,497 @@
+/*
+   Virtual File System: ar file system.
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * \brief Source: Virtual File System: ar file system
+ *
+ * Reads archives of ar(1): static libraries and Debian packages. GNU and
+ * BSD variants of long member names are supported, symbol tables are not
+ * shown. Members are read directly from the archive, so the data.tar.* of
+ * a .deb package can be opened with tarfs without temporary files.
+ *
+ * The class uses "ar" prefix, so the uar:// paths of the external helper
+ * stay available. It is read-only.
+ *
+ * Namespace: init_arfs
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "lib/global.h"
+#include "lib/util.h"
+#include "lib/widget.h"         /* message() */
+
+#include "lib/vfs/vfs.h"
+#include "lib/vfs/utilvfs.h"
+#include "lib/vfs/xdirentry.h"
+#include "lib/vfs/gc.h"         /* vfs_rmstamp */
+#include "lib/vfs/arcread.h"
+
+#include "ar.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define AR_SUPER(super) ((ar_super_t *) (super))
+
+#define AR_MAGIC "!<arch>\n"
+#define AR_MAGIC_LEN 8
+
+/* fields of member header */
+#define AR_HEADER_SIZE 60
+#define AR_NAME 0
+#define AR_NAME_LEN 16
+#define AR_DATE 16
+#define AR_DATE_LEN 12
+#define AR_UID 28
+#define AR_UID_LEN 6
+#define AR_GID 34
+#define AR_GID_LEN 6
+#define AR_MODE 40
+#define AR_MODE_LEN 8
+#define AR_SIZE 48
+#define AR_SIZE_LEN 10
+#define AR_FMAG 58
+
+#define AR_BSD_NAME "#1/"
+
+/*** file scope type declarations ****************************************************************/
+
+typedef struct
+{
+    struct vfs_s_super base;    /* base class */
+
+    int fd;
+    struct stat st;
+} ar_super_t;
+
+/*** file scope variables ************************************************************************/
+
+static struct vfs_s_subclass arfs_subclass;
+static struct vfs_class *vfs_arfs_ops = VFS_CLASS (&arfs_subclass);
+
+/* --------------------------------------------------------------------------------------------- */
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Parse space-padded number of header field.
+ *
+ * @return TRUE if field contains a number, FALSE if it is blank or invalid
+ */
+
+static gboolean
+ar_number (const char *p, size_t len, unsigned int base, guint64 * value)
+{
+    size_t i;
+
+    *value = 0;
+
+    for (i = 0; i < len && p[i] >= '0' && p[i] < (char) ('0' + base); i++)
+        *value = *value * base + (guint64) (p[i] - '0');
+
+    if (i == 0)
+        return FALSE;
+
+    for (; i < len; i++)
+        if (p[i] != ' ')
+            return FALSE;
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read exactly @len bytes from the current position of archive.
+ */
+
+static gboolean
+ar_read_exact (vfs_arcread_t * reader, char *buf, size_t len)
+{
+    return vfs_arcread_read (reader, buf, len) == (ssize_t) len;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get name of member.
+ *
+ * @param hdr member header
+ * @param names GNU long names table or NULL
+ * @param names_len length of @names
+ * @param data offset of member data; it is advanced over the BSD long name
+ * @param size size of member data; it is decreased by length of the BSD long name
+ *
+ * @return newly allocated name, or NULL if member is a symbol table or header is invalid
+ */
+
+static char *
+ar_member_name (vfs_arcread_t * reader, const char *hdr, const char *names, size_t names_len,
+                off_t * data, guint64 * size)
+{
+    const char *field = hdr + AR_NAME;
+    char *name;
+    guint64 n;
+    size_t len;
+
+    if (strncmp (field, AR_BSD_NAME, sizeof (AR_BSD_NAME) - 1) == 0)
+    {
+        /* BSD: name of given length precedes member data */
+        if (!ar_number (field + sizeof (AR_BSD_NAME) - 1, AR_NAME_LEN - sizeof (AR_BSD_NAME) + 1,
+                        10, &n) || n > *size)
+            return NULL;
+
+        name = g_malloc (n + 1);
+        if (!ar_read_exact (reader, name, n))
+        {
+            g_free (name);
+            return NULL;
+        }
+        name[n] = '\0';
+
+        *data += (off_t) n;
+        *size -= n;
+
+        if (strncmp (name, "__.SYMDEF", 9) == 0)
+            MC_PTR_FREE (name);
+
+        return name;
+    }
+
+    if (field[0] == '/' && field[1] != '/')
+    {
+        /* GNU: symbol tables are "/" and "/SYM64/", long names are "/offset" */
+        if (names == NULL || !ar_number (field + 1, AR_NAME_LEN - 1, 10, &n) || n >= names_len)
+            return NULL;
+
+        for (len = 0; n + len < names_len; len++)
+            if (names[n + len] == '\n' || names[n + len] == '\0')
+                break;
+
+        name = g_strndup (names + n, len);
+    }
+    else
+    {
+        for (len = AR_NAME_LEN; len != 0 && field[len - 1] == ' '; len--)
+            ;
+        name = g_strndup (field, len);
+    }
+
+    /* GNU names are terminated with slash */
+    len = strlen (name);
+    if (len != 0 && name[len - 1] == '/')
+        name[len - 1] = '\0';
+
+    if (strcmp (name, "__.SYMDEF") == 0)
+        MC_PTR_FREE (name);
+
+    return name;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+ar_add_entry (struct vfs_class *me, struct vfs_s_super *archive, const char *hdr,
+              const char *name, off_t data, guint64 size)
+{
+    ar_super_t *arch = AR_SUPER (archive);
+    struct stat st;
+    struct vfs_s_inode *inode;
+    struct vfs_s_entry *entry;
+    guint64 v;
+
+    memset (&st, 0, sizeof (st));
+    st.st_mode = S_IFREG | 0644;
+    if (ar_number (hdr + AR_MODE, AR_MODE_LEN, 8, &v) && (v & 07777) != 0)
+        st.st_mode = S_IFREG | (mode_t) (v & 07777);
+    st.st_uid = ar_number (hdr + AR_UID, AR_UID_LEN, 10, &v) ? (uid_t) v : arch->st.st_uid;
+    st.st_gid = ar_number (hdr + AR_GID, AR_GID_LEN, 10, &v) ? (gid_t) v : arch->st.st_gid;
+    st.st_mtime = ar_number (hdr + AR_DATE, AR_DATE_LEN, 10, &v) ? (time_t) v : arch->st.st_mtime;
+    st.st_atime = st.st_mtime;
+    st.st_ctime = st.st_mtime;
+    st.st_size = (off_t) size;
+#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
+    st.st_blksize = 8 * 1024;   /* FIXME */
+#endif
+    vfs_adjust_stat (&st);
+
+    inode = vfs_s_new_inode (me, archive, &st);
+    inode->data_offset = data;
+
+    entry = vfs_s_new_entry (me, name, inode);
+    vfs_s_insert_entry (me, archive->root, entry);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+ar_read_members (struct vfs_class *me, struct vfs_s_super *archive)
+{
+    ar_super_t *arch = AR_SUPER (archive);
+    vfs_arcread_t *reader;
+    char hdr[AR_HEADER_SIZE];
+    char *names = NULL;         /* GNU long names table */
+    size_t names_len = 0;
+    off_t pos = AR_MAGIC_LEN;
+    int ret = -1;
+
+    if (mc_lseek (arch->fd, 0, SEEK_SET) != 0)
+        return -1;
+
+    /* headers of small members are close to each other: read them through a large buffer */
+    reader = vfs_arcread_open (arch->fd, NULL);
+
+    if (!ar_read_exact (reader, hdr, AR_MAGIC_LEN) || memcmp (hdr, AR_MAGIC, AR_MAGIC_LEN) != 0)
+        goto ret;
+
+    while (pos < arch->st.st_size)
+    {
+        off_t data = pos + AR_HEADER_SIZE;
+        guint64 size;
+        char *name;
+
+        /* odd size of the last member may be not padded */
+        if (pos + 1 == arch->st.st_size)
+            break;
+
+        if (vfs_arcread_seek (reader, pos) != pos)
+            goto ret;
+
+        if (!ar_read_exact (reader, hdr, AR_HEADER_SIZE)
+            || hdr[AR_FMAG] != '`' || hdr[AR_FMAG + 1] != '\n'
+            || !ar_number (hdr + AR_SIZE, AR_SIZE_LEN, 10, &size)
+            || (guint64) (arch->st.st_size - data) < size)
+            goto ret;
+
+        /* member data is aligned to even offset */
+        pos = data + (off_t) size + (off_t) (size & 1);
+
+        if (strncmp (hdr + AR_NAME, "// ", 3) == 0)
+        {
+            g_free (names);
+            names_len = (size_t) size;
+            names = g_malloc (names_len);
+            if (!ar_read_exact (reader, names, names_len))
+                goto ret;
+            continue;
+        }
+
+        name = ar_member_name (reader, hdr, names, names_len, &data, &size);
+        if (name == NULL)
+            continue;
+
+        /* paths (e.g. in thin archives) can't be shown in flat directory */
+        if (*name != '\0' && strchr (name, PATH_SEP) == NULL && !DIR_IS_DOT (name)
+            && !DIR_IS_DOTDOT (name))
+            ar_add_entry (me, archive, hdr, name, data, size);
+        g_free (name);
+    }
+
+    ret = 0;
+
+  ret:
+    g_free (names);
+    vfs_arcread_close (reader);
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_super *
+ar_new_archive (struct vfs_class *me)
+{
+    ar_super_t *arch;
+
+    arch = g_new0 (ar_super_t, 1);
+    arch->base.me = me;
+    arch->fd = -1;
+
+    return VFS_SUPER (arch);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+ar_free_archive (struct vfs_class *me, struct vfs_s_super *archive)
+{
+    ar_super_t *arch = AR_SUPER (archive);
+
+    (void) me;
+
+    if (arch->fd != -1)
+    {
+        mc_close (arch->fd);
+        arch->fd = -1;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+ar_open_archive (struct vfs_s_super *archive, const vfs_path_t * vpath,
+                 const vfs_path_element_t * vpath_element)
+{
+    struct vfs_class *me = vpath_element->class;
+    ar_super_t *arch = AR_SUPER (archive);
+    mode_t mode;
+    struct vfs_s_inode *root;
+
+    arch->fd = mc_open (vpath, O_RDONLY);
+    if (arch->fd == -1 || mc_fstat (arch->fd, &arch->st) == -1)
+    {
+        message (D_ERROR, MSG_ERROR, _("Cannot open ar archive\n%s"), vfs_path_as_str (vpath));
+        ERRNOR (ENOENT, -1);
+    }
+
+    archive->name = g_strdup (vfs_path_as_str (vpath));
+
+    mode = arch->st.st_mode & 07777;
+    if (mode & 0400)
+        mode |= 0100;
+    if (mode & 0040)
+        mode |= 0010;
+    if (mode & 0004)
+        mode |= 0001;
+    mode |= S_IFDIR;
+
+    root = vfs_s_new_inode (me, archive, &arch->st);
+    root->st.st_mode = mode;
+    root->data_offset = -1;
+    root->st.st_nlink++;
+    root->st.st_dev = VFS_SUBCLASS (me)->rdev++;
+
+    archive->root = root;
+
+    if (ar_read_members (me, archive) == -1)
+    {
+        message (D_ERROR, MSG_ERROR, _("%s\ndoesn't look like an ar archive."),
+                 vfs_path_as_str (vpath));
+        ERRNOR (EIO, -1);
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void *
+ar_super_check (const vfs_path_t * vpath)
+{
+    static struct stat stat_buf;
+    int stat_result;
+
+    stat_result = mc_stat (vpath, &stat_buf);
+
+    return (stat_result != 0) ? NULL : &stat_buf;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+ar_super_same (const vfs_path_element_t * vpath_element, struct vfs_s_super *parc,
+               const vfs_path_t * vpath, void *cookie)
+{
+    struct stat *archive_stat = cookie; /* stat of main archive */
+
+    (void) vpath_element;
+
+    if (strcmp (parc->name, vfs_path_as_str (vpath)) != 0)
+        return 0;
+
+    /* Has the cached archive been changed on the disk? */
+    if (AR_SUPER (parc)->st.st_mtime < archive_stat->st_mtime
+        || AR_SUPER (parc)->st.st_size != archive_stat->st_size)
+    {
+        /* Yes, reload! */
+        vfs_arfs_ops->free ((vfsid) parc);
+        vfs_rmstamp (vfs_arfs_ops, (vfsid) parc);
+        return 2;
+    }
+    /* Hasn't been modified, give it a new timeout */
+    vfs_stamp (vfs_arfs_ops, (vfsid) parc);
+    return 1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+ar_read (void *fh, char *buffer, size_t count)
+{
+    struct vfs_s_super *archive = VFS_FILE_HANDLER_SUPER (fh);
+    struct vfs_class *me = archive->me;
+    vfs_file_handler_t *file = VFS_FILE_HANDLER (fh);
+    int fd = AR_SUPER (archive)->fd;
+    off_t offset = file->ino->data_offset + file->pos;
+    ssize_t res;
+
+    if (file->pos >= file->ino->st.st_size)
+        return 0;
+    if ((off_t) count > file->ino->st.st_size - file->pos)
+        count = (size_t) (file->ino->st.st_size - file->pos);
+
+    if (mc_lseek (fd, offset, SEEK_SET) != offset)
+        ERRNOR (EIO, -1);
+
+    res = mc_read (fd, buffer, count);
+    if (res == -1)
+        ERRNOR (errno, -1);
+
+    file->pos += res;
+    return res;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+ar_fh_open (struct vfs_class *me, vfs_file_handler_t * fh, int flags, mode_t mode)
+{
+    (void) fh;
+    (void) mode;
+
+    if ((flags & O_ACCMODE) != O_RDONLY)
+        ERRNOR (EROFS, -1);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+void
+vfs_init_arfs (void)
+{
+    vfs_init_subclass (&arfs_subclass, "arfs", VFSF_READONLY, "ar");
+    vfs_arfs_ops->read = ar_read;
+    vfs_arfs_ops->setctl = vfs_s_archive_setctl;
+    arfs_subclass.archive_check = ar_super_check;
+    arfs_subclass.archive_same = ar_super_same;
+    arfs_subclass.new_archive = ar_new_archive;
+    arfs_subclass.open_archive = ar_open_archive;
+    arfs_subclass.free_archive = ar_free_archive;
+    arfs_subclass.fh_open = ar_fh_open;
+    vfs_register_class (vfs_arfs_ops);
+}
+
+/* --------------------------------------------------------------------------------------------- */
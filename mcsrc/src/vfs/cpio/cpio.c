@@ -45,6 +45,9 @@
 #include "lib/vfs/utilvfs.h"
 #include "lib/vfs/xdirentry.h"
 #include "lib/vfs/gc.h"         /* vfs_rmstamp */
+#include "lib/vfs/arcindex.h"
+#include "lib/vfs/zstream.h"
+#include "lib/vfs/arcread.h"
 
 #include "cpio.h"
 
@@ -58,8 +61,8 @@
 /* If some time reentrancy should be needed change it to */
 /* #define CPIO_POS(super) (super)->u.arch.fd */
 
-#define CPIO_SEEK_SET(super, where) mc_lseek (CPIO_SUPER(super)->fd, CPIO_POS(super) = (where), SEEK_SET)
-#define CPIO_SEEK_CUR(super, where) mc_lseek (CPIO_SUPER(super)->fd, CPIO_POS(super) += (where), SEEK_SET)
+#define CPIO_SEEK_SET(super, where) cpio_seek (super, CPIO_POS(super) = (where))
+#define CPIO_SEEK_CUR(super, where) cpio_seek (super, CPIO_POS(super) += (where))
 
 #define MAGIC_LENGTH (6)        /* How many bytes we have to read ahead */
 #define SEEKBACK CPIO_SEEK_CUR(super, ptr - top)
@@ -134,6 +137,8 @@ typedef struct
     struct vfs_s_super base;    /* base class */
 
     int fd;
+    vfs_zstream_t *zs;          /* decompressor if archive is compressed */
+    vfs_arcread_t *ar;          /* buffered reader while archive is being scanned */
     struct stat st;
     int type;                   /* Type of the archive */
     GSList *deferred;           /* List of inodes for which another entries may appear */
@@ -169,6 +174,45 @@ cpio_defer_find (const void *a, const void *b)
 
 /* --------------------------------------------------------------------------------------------- */
 
+static ssize_t
+cpio_read_data (struct vfs_s_super *super, char *buffer, size_t count)
+{
+    cpio_super_t *arch = CPIO_SUPER (super);
+
+    if (arch->ar != NULL)
+        return vfs_arcread_read (arch->ar, buffer, count);
+
+    return (arch->zs != NULL) ? vfs_zstream_read (arch->zs, buffer, count)
+        : mc_read (arch->fd, buffer, count);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static off_t
+cpio_seek (struct vfs_s_super *super, off_t offset)
+{
+    cpio_super_t *arch = CPIO_SUPER (super);
+
+    if (arch->ar != NULL)
+        return vfs_arcread_seek (arch->ar, offset);
+
+    return (arch->zs != NULL) ? vfs_zstream_seek (arch->zs, offset)
+        : mc_lseek (arch->fd, offset, SEEK_SET);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+cpio_close_reader (struct vfs_s_super *super)
+{
+    cpio_super_t *arch = CPIO_SUPER (super);
+
+    vfs_arcread_close (arch->ar);
+    arch->ar = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static ssize_t
 cpio_skip_padding (struct vfs_s_super *super)
 {
@@ -212,6 +256,11 @@ cpio_free_archive (struct vfs_class *me, struct vfs_s_super *super)
 
     (void) me;
 
+    cpio_close_reader (super);
+
+    vfs_zstream_close (arch->zs);
+    arch->zs = NULL;
+
     if (arch->fd != -1)
     {
         mc_close (arch->fd);
@@ -224,29 +273,26 @@ cpio_free_archive (struct vfs_class *me, struct vfs_s_super *super)
 /* --------------------------------------------------------------------------------------------- */
 
 static int
-cpio_open_cpio_file (struct vfs_class *me, struct vfs_s_super *super, const vfs_path_t * vpath)
+cpio_open_archive_fd (struct vfs_s_super *super)
 {
     int fd, type;
-    cpio_super_t *arch;
-    mode_t mode;
-    struct vfs_s_inode *root;
+    vfs_path_t *vpath;
 
+    vpath = vfs_path_from_str (super->name);
     fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
     if (fd == -1)
     {
-        message (D_ERROR, MSG_ERROR, _("Cannot open cpio archive\n%s"), vfs_path_as_str (vpath));
+        message (D_ERROR, MSG_ERROR, _("Cannot open cpio archive\n%s"), super->name);
         return -1;
     }
 
-    super->name = g_strdup (vfs_path_as_str (vpath));
-    arch = CPIO_SUPER (super);
-    mc_stat (vpath, &arch->st);
-
     type = get_compression_type (fd, super->name);
     if (type == COMPRESSION_NONE)
         mc_lseek (fd, 0, SEEK_SET);
-    else
+    else if ((CPIO_SUPER (super)->zs = vfs_zstream_open (fd, type)) == NULL)
     {
+        /* can't decompress in-process: use sfs */
         char *s;
         vfs_path_t *tmp_vpath;
 
@@ -259,13 +305,47 @@ cpio_open_cpio_file (struct vfs_class *me, struct vfs_s_super *super, const vfs_
         {
             message (D_ERROR, MSG_ERROR, _("Cannot open cpio archive\n%s"), s);
             g_free (s);
-            MC_PTR_FREE (super->name);
             return -1;
         }
         g_free (s);
     }
 
-    arch->fd = fd;
+    CPIO_SUPER (super)->fd = fd;
+
+    return fd;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get fd of archive. If directory tree was loaded from the listing index,
+ * the archive is not opened until the first read of file content.
+ */
+
+static int
+cpio_get_fd (struct vfs_s_super *super)
+{
+    int fd = CPIO_SUPER (super)->fd;
+
+    return (fd != -1) ? fd : cpio_open_archive_fd (super);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+cpio_open_cpio_file (struct vfs_class *me, struct vfs_s_super *super, const vfs_path_t * vpath)
+{
+    cpio_super_t *arch = CPIO_SUPER (super);
+    mode_t mode;
+    struct vfs_s_inode *root;
+
+    if (mc_stat (vpath, &arch->st) == -1)
+    {
+        message (D_ERROR, MSG_ERROR, _("Cannot open cpio archive\n%s"), vfs_path_as_str (vpath));
+        return -1;
+    }
+
+    super->name = g_strdup (vfs_path_as_str (vpath));
+
     mode = arch->st.st_mode & 07777;
     mode |= (mode & 0444) >> 2; /* set eXec where Read is */
     mode |= S_IFDIR;
@@ -278,9 +358,7 @@ cpio_open_cpio_file (struct vfs_class *me, struct vfs_s_super *super, const vfs_
 
     super->root = root;
 
-    CPIO_SEEK_SET (super, 0);
-
-    return fd;
+    return 0;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -311,13 +389,12 @@ cpio_read_head (struct vfs_class *me, struct vfs_s_super *super)
 static ssize_t
 cpio_find_head (struct vfs_class *me, struct vfs_s_super *super)
 {
-    cpio_super_t *arch = CPIO_SUPER (super);
     char buf[BUF_SMALL * 2];
     ssize_t ptr = 0;
     ssize_t top;
     ssize_t tmp;
 
-    top = mc_read (arch->fd, buf, sizeof (buf));
+    top = cpio_read_data (super, buf, sizeof (buf));
     if (top > 0)
         CPIO_POS (super) += top;
 
@@ -331,7 +408,7 @@ cpio_find_head (struct vfs_class *me, struct vfs_s_super *super)
                 ptr -= top - sizeof (buf) / 2;
                 top = sizeof (buf) / 2;
             }
-            tmp = mc_read (arch->fd, buf, top);
+            tmp = cpio_read_data (super, buf, top);
             if (tmp == 0 || tmp == -1)
             {
                 message (D_ERROR, MSG_ERROR, _("Premature end of cpio archive\n%s"), super->name);
@@ -526,15 +603,18 @@ cpio_create_entry (struct vfs_class *me, struct vfs_s_super *super, struct stat
             {
                 /* FIXME: do we must read from arch->fd in case of inode != NULL only or in any case? */
 
-                inode->linkname = g_malloc (st->st_size + 1);
+                char *linkname;
+                gboolean eof;
 
-                if (mc_read (arch->fd, inode->linkname, st->st_size) < st->st_size)
-                {
-                    inode->linkname[0] = '\0';
-                    return STATUS_EOF;
-                }
+                linkname = g_malloc (st->st_size + 1);
+
+                /* Linkname stored without terminating \0 !!! */
+                eof = cpio_read_data (super, linkname, st->st_size) < st->st_size;
+                vfs_s_set_linkname (inode, linkname, eof ? 0 : st->st_size);
+                g_free (linkname);
 
-                inode->linkname[st->st_size] = '\0';    /* Linkname stored without terminating \0 !!! */
+                if (eof)
+                    return STATUS_EOF;
             }
 
             CPIO_POS (super) += st->st_size;
@@ -561,7 +641,7 @@ cpio_read_bin_head (struct vfs_class *me, struct vfs_s_super *super)
     char *name;
     struct stat st;
 
-    len = mc_read (arch->fd, (char *) &u.buf, HEAD_LENGTH);
+    len = cpio_read_data (super, (char *) &u.buf, HEAD_LENGTH);
     if (len < HEAD_LENGTH)
         return STATUS_EOF;
     CPIO_POS (super) += len;
@@ -578,7 +658,7 @@ cpio_read_bin_head (struct vfs_class *me, struct vfs_s_super *super)
         return STATUS_FAIL;
     }
     name = g_malloc (u.buf.c_namesize);
-    len = mc_read (arch->fd, name, u.buf.c_namesize);
+    len = cpio_read_data (super, name, u.buf.c_namesize);
     if (len < u.buf.c_namesize)
     {
         g_free (name);
@@ -620,7 +700,6 @@ cpio_read_bin_head (struct vfs_class *me, struct vfs_s_super *super)
 static ssize_t
 cpio_read_oldc_head (struct vfs_class *me, struct vfs_s_super *super)
 {
-    cpio_super_t *arch = CPIO_SUPER (super);
     struct new_cpio_header hd;
     union
     {
@@ -630,7 +709,7 @@ cpio_read_oldc_head (struct vfs_class *me, struct vfs_s_super *super)
     ssize_t len;
     char *name;
 
-    if (mc_read (arch->fd, u.buf, HEAD_LENGTH) != HEAD_LENGTH)
+    if (cpio_read_data (super, u.buf, HEAD_LENGTH) != HEAD_LENGTH)
         return STATUS_EOF;
     CPIO_POS (super) += HEAD_LENGTH;
     u.buf[HEAD_LENGTH] = 0;
@@ -650,7 +729,7 @@ cpio_read_oldc_head (struct vfs_class *me, struct vfs_s_super *super)
         return STATUS_FAIL;
     }
     name = g_malloc (hd.c_namesize);
-    len = mc_read (arch->fd, name, hd.c_namesize);
+    len = cpio_read_data (super, name, hd.c_namesize);
     if ((len == -1) || ((unsigned long) len < hd.c_namesize))
     {
         g_free (name);
@@ -702,7 +781,7 @@ cpio_read_crc_head (struct vfs_class *me, struct vfs_s_super *super)
     ssize_t len;
     char *name;
 
-    if (mc_read (arch->fd, u.buf, HEAD_LENGTH) != HEAD_LENGTH)
+    if (cpio_read_data (super, u.buf, HEAD_LENGTH) != HEAD_LENGTH)
         return STATUS_EOF;
 
     CPIO_POS (super) += HEAD_LENGTH;
@@ -730,7 +809,7 @@ cpio_read_crc_head (struct vfs_class *me, struct vfs_s_super *super)
     }
 
     name = g_malloc (hd.c_namesize);
-    len = mc_read (arch->fd, name, hd.c_namesize);
+    len = cpio_read_data (super, name, hd.c_namesize);
 
     if ((len == -1) || ((unsigned long) len < hd.c_namesize))
     {
@@ -772,18 +851,35 @@ static int
 cpio_open_archive (struct vfs_s_super *super, const vfs_path_t * vpath,
                    const vfs_path_element_t * vpath_element)
 {
-    (void) vpath_element;
+    const struct stat *archive_stat = NULL;
 
     if (cpio_open_cpio_file (vpath_element->class, super, vpath) == -1)
         return -1;
 
+    if (vfs_file_is_local (vpath))
+        archive_stat = &CPIO_SUPER (super)->st;
+
+    if (vfs_s_index_load (super, NULL, archive_stat))
+        return 0;
+
+    if (cpio_open_archive_fd (super) == -1)
+        return -1;
+
+    CPIO_SEEK_SET (super, 0);
+
+    /* scan headers through the big buffer to save a system call or two per member */
+    CPIO_SUPER (super)->ar = vfs_arcread_open (CPIO_SUPER (super)->fd, CPIO_SUPER (super)->zs);
+
     while (TRUE)
     {
         ssize_t status;
 
         status = cpio_read_head (vpath_element->class, super);
         if (status < 0)
+        {
+            cpio_close_reader (super);
             return (-1);
+        }
 
         switch (status)
         {
@@ -791,6 +887,7 @@ cpio_open_archive (struct vfs_s_super *super, const vfs_path_t * vpath,
             {
                 message (D_ERROR, MSG_ERROR, _("Unexpected end of file\n%s"),
                          vfs_path_as_str (vpath));
+                cpio_close_reader (super);
                 return 0;
             }
         case STATUS_OK:
@@ -803,6 +900,9 @@ cpio_open_archive (struct vfs_s_super *super, const vfs_path_t * vpath,
         break;
     }
 
+    cpio_close_reader (super);
+    vfs_s_index_save (super, NULL, archive_stat);
+
     return 0;
 }
 
@@ -852,16 +952,19 @@ cpio_read (void *fh, char *buffer, size_t count)
 {
     vfs_file_handler_t *file = VFS_FILE_HANDLER (fh);
     struct vfs_class *me = VFS_FILE_HANDLER_SUPER (fh)->me;
-    int fd = CPIO_SUPER (VFS_FILE_HANDLER_SUPER (fh))->fd;
     off_t begin = file->ino->data_offset;
+    struct vfs_s_super *super = VFS_FILE_HANDLER_SUPER (fh);
     ssize_t res;
 
-    if (mc_lseek (fd, begin + file->pos, SEEK_SET) != begin + file->pos)
+    if (cpio_get_fd (super) == -1)
+        ERRNOR (EIO, -1);
+
+    if (cpio_seek (super, begin + file->pos) != begin + file->pos)
         ERRNOR (EIO, -1);
 
     count = MIN (count, (size_t) (file->ino->st.st_size - file->pos));
 
-    res = mc_read (fd, buffer, count);
+    res = cpio_read_data (super, buffer, count);
     if (res == -1)
         ERRNOR (errno, -1);
 
@@ -892,7 +995,7 @@ vfs_init_cpiofs (void)
     /* FIXME: cpiofs used own temp files */
     vfs_init_subclass (&cpio_subclass, "cpiofs", VFSF_READONLY, "ucpio");
     vfs_cpiofs_ops->read = cpio_read;
-    vfs_cpiofs_ops->setctl = NULL;
+    vfs_cpiofs_ops->setctl = vfs_s_archive_setctl;
     cpio_subclass.archive_check = cpio_super_check;
     cpio_subclass.archive_same = cpio_super_same;
     cpio_subclass.new_archive = cpio_new_archive;
@@ -55,6 +55,7 @@
 #include "lib/mcconfig.h"
 #include "lib/util.h"
 #include "lib/widget.h"         /* message() */
+#include "lib/tty/tty.h"        /* tty_got_interrupt() */
 
 #include "src/execute.h"        /* For shell_execute */
 
@@ -62,6 +63,7 @@
 #include "lib/vfs/utilvfs.h"
 #include "lib/vfs/xdirentry.h"
 #include "lib/vfs/gc.h"         /* vfs_rmstamp */
+#include "lib/vfs/arcindex.h"
 
 #include "extfs.h"
 
@@ -93,6 +95,7 @@ typedef struct
     char *path;
     char *prefix;
     gboolean need_archive;
+    gboolean no_copyout_many;   /* helper doesn't support "copyout-many" command */
 } extfs_plugin_info_t;
 
 /*** file scope variables ************************************************************************/
@@ -333,6 +336,18 @@ extfs_fill_names (struct vfs_class *me, fill_names_f func)
 
 /* --------------------------------------------------------------------------------------------- */
 
+/* all inodes of archive, including ones loaded from the listing index, are on its device */
+static int
+extfs_init_inode (struct vfs_class *me, struct vfs_s_inode *ino)
+{
+    (void) me;
+
+    ino->st.st_dev = EXTFS_SUPER (ino->super)->rdev;
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 /* Create this function because VFSF_USETMP flag is not used in extfs */
 static void
 extfs_free_inode (struct vfs_class *me, struct vfs_s_inode *ino)
@@ -373,17 +388,44 @@ extfs_free_archive (struct vfs_class *me, struct vfs_s_super *psup)
 
 /* --------------------------------------------------------------------------------------------- */
 
+static void
+extfs_make_root (struct extfs_super_t *archive, const struct stat *archive_stat)
+{
+    static dev_t archive_counter = 0;
+    mode_t mode;
+    struct vfs_s_entry *root_entry;
+
+    archive->rdev = archive_counter++;
+
+    mode = archive_stat->st_mode & 07777;
+    if (mode & 0400)
+        mode |= 0100;
+    if (mode & 0040)
+        mode |= 0010;
+    if (mode & 0004)
+        mode |= 0001;
+    mode |= S_IFDIR;
+
+    root_entry = extfs_generate_entry (archive, PATH_SEP_STR, NULL, mode);
+    root_entry->ino->st.st_uid = archive_stat->st_uid;
+    root_entry->ino->st.st_gid = archive_stat->st_gid;
+    root_entry->ino->st.st_atime = archive_stat->st_atime;
+    root_entry->ino->st.st_ctime = archive_stat->st_ctime;
+    root_entry->ino->st.st_mtime = archive_stat->st_mtime;
+    root_entry->ino->ent = root_entry;
+    VFS_SUPER (archive)->root = root_entry->ino;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static FILE *
 extfs_open_archive (int fstype, const char *name, struct extfs_super_t **pparc)
 {
     const extfs_plugin_info_t *info;
-    static dev_t archive_counter = 0;
     FILE *result = NULL;
-    mode_t mode;
     char *cmd;
     struct stat mystat;
     struct extfs_super_t *current_archive;
-    struct vfs_s_entry *root_entry;
     char *tmp = NULL;
     vfs_path_t *local_name_vpath = NULL;
     vfs_path_t *name_vpath;
@@ -430,26 +472,8 @@ extfs_open_archive (int fstype, const char *name, struct extfs_super_t **pparc)
 #endif
 
     current_archive = extfs_super_new (vfs_extfs_ops, name, local_name_vpath, fstype);
-    current_archive->rdev = archive_counter++;
     vfs_path_free (local_name_vpath);
-
-    mode = mystat.st_mode & 07777;
-    if (mode & 0400)
-        mode |= 0100;
-    if (mode & 0040)
-        mode |= 0010;
-    if (mode & 0004)
-        mode |= 0001;
-    mode |= S_IFDIR;
-
-    root_entry = extfs_generate_entry (current_archive, PATH_SEP_STR, NULL, mode);
-    root_entry->ino->st.st_uid = mystat.st_uid;
-    root_entry->ino->st.st_gid = mystat.st_gid;
-    root_entry->ino->st.st_atime = mystat.st_atime;
-    root_entry->ino->st.st_ctime = mystat.st_ctime;
-    root_entry->ino->st.st_mtime = mystat.st_mtime;
-    root_entry->ino->ent = root_entry;
-    VFS_SUPER (current_archive)->root = root_entry->ino;
+    extfs_make_root (current_archive, &mystat);
 
     *pparc = current_archive;
 
@@ -610,23 +634,66 @@ extfs_which (struct vfs_class *me, const char *path)
 
 /* --------------------------------------------------------------------------------------------- */
 
+/**
+ * Try to build the directory tree of archive from the persistent listing index
+ * without running the "list" command of extfs helper.
+ *
+ * @return TRUE if archive was loaded from index
+ */
+
+static gboolean
+extfs_load_archive_index (int fstype, const char *name, const struct stat *archive_stat,
+                          struct extfs_super_t **archive)
+{
+    const extfs_plugin_info_t *info;
+    struct extfs_super_t *a;
+
+    info = &g_array_index (extfs_plugins, extfs_plugin_info_t, fstype);
+    a = extfs_super_new (vfs_extfs_ops, name, NULL, fstype);
+    extfs_make_root (a, archive_stat);
+
+    if (!vfs_s_index_load (VFS_SUPER (a), info->prefix, archive_stat))
+    {
+        VFS_SUPER (a)->me->free (VFS_SUPER (a));
+        return FALSE;
+    }
+
+    *archive = a;
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static int
 extfs_open_and_read_archive (int fstype, const char *name, struct extfs_super_t **archive)
 {
     int result = -1;
     FILE *extfsd;
     struct extfs_super_t *a;
+    const extfs_plugin_info_t *info;
+    struct stat archive_stat;
+    const struct stat *index_stat = NULL;
+
+    info = &g_array_index (extfs_plugins, extfs_plugin_info_t, fstype);
+
+    if (mc_global.vfs.archive_index && info->need_archive)
+    {
+        vfs_path_t *name_vpath;
+
+        name_vpath = vfs_path_from_str (name);
+        if (vfs_file_is_local (name_vpath) && mc_stat (name_vpath, &archive_stat) == 0)
+            index_stat = &archive_stat;
+        vfs_path_free (name_vpath);
+
+        if (index_stat != NULL && extfs_load_archive_index (fstype, name, index_stat, archive))
+            return 0;
+    }
 
     extfsd = extfs_open_archive (fstype, name, archive);
     a = *archive;
 
     if (extfsd == NULL)
-    {
-        const extfs_plugin_info_t *info;
-
-        info = &g_array_index (extfs_plugins, extfs_plugin_info_t, fstype);
         message (D_ERROR, MSG_ERROR, _("Cannot open %s archive\n%s"), info->prefix, name);
-    }
     else if (extfs_read_archive (extfsd, a) != 0)
     {
         pclose (extfsd);
@@ -640,6 +707,7 @@ extfs_open_and_read_archive (int fstype, const char *name, struct extfs_super_t
     else
     {
         close_error_pipe (D_ERROR, NULL);
+        vfs_s_index_save (VFS_SUPER (a), info->prefix, index_stat);
         result = 0;
     }
 
@@ -832,6 +900,318 @@ extfs_cmd (const char *str_extfs_cmd, const struct extfs_super_t *archive,
 
 /* --------------------------------------------------------------------------------------------- */
 
+static void
+extfs_remove_tree (const char *path)
+{
+    GDir *dir;
+
+    dir = g_dir_open (path, 0, NULL);
+    if (dir != NULL)
+    {
+        const char *name;
+
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            char *full_name;
+            struct stat st;
+
+            full_name = g_build_filename (path, name, (char *) NULL);
+            if (lstat (full_name, &st) == 0 && S_ISDIR (st.st_mode))
+                extfs_remove_tree (full_name);
+            else
+                unlink (full_name);
+            g_free (full_name);
+        }
+
+        g_dir_close (dir);
+    }
+
+    rmdir (path);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Collect regular files under @entry which were not extracted yet.
+ * Hardlinks share inode, so inodes are used as keys.
+ */
+
+static void
+extfs_collect_members (struct vfs_s_entry *entry, GHashTable * members)
+{
+    struct vfs_s_inode *ino = entry->ino;
+
+    if (S_ISDIR (ino->st.st_mode))
+    {
+        GList *l;
+
+        for (l = g_queue_peek_head_link (ino->subdir); l != NULL; l = g_list_next (l))
+            extfs_collect_members (VFS_ENTRY (l->data), members);
+    }
+    else if (S_ISREG (ino->st.st_mode) && ino->localname == NULL)
+        g_hash_table_insert (members, ino, entry);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char *
+extfs_extracted_name (const struct vfs_s_entry *entry, const char *extract_dir)
+{
+    char *file, *extracted;
+
+    file = extfs_get_path_from_entry (entry);
+    extracted = g_build_filename (extract_dir, file, (char *) NULL);
+    g_free (file);
+
+    return extracted;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Run "copyout-many" command. Show how many files are extracted and check for abort
+ * while the helper works.
+ *
+ * @return exit status of helper, -1 if it can't be run or is interrupted by user
+ */
+
+static int
+extfs_copyout_many_run (const char *cmd, const GPtrArray * entries, const char *extract_dir)
+{
+    const char *argv[] = { mc_global.shell->path, "-c", cmd, NULL };
+    GPid pid;
+    pid_t res;
+    int status = 0;
+    guint done = 0;
+
+    /* helpers without this command complain about it, this is not an error for us */
+    if (!g_spawn_async (NULL, (gchar **) argv, NULL,
+                        G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDOUT_TO_DEV_NULL |
+                        G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, &pid, NULL))
+        return (-1);
+
+    tty_enable_interrupt_key ();
+
+    while ((res = waitpid (pid, &status, WNOHANG)) == 0 || (res == -1 && errno == EINTR))
+    {
+        /* helpers usually extract files in the order of the list */
+        while (done < entries->len)
+        {
+            char *extracted;
+            gboolean exists;
+
+            extracted = extfs_extracted_name (VFS_ENTRY (g_ptr_array_index (entries, done)),
+                                              extract_dir);
+            exists = g_file_test (extracted, G_FILE_TEST_EXISTS);
+            g_free (extracted);
+            if (!exists)
+                break;
+            done++;
+        }
+
+        vfs_print_message (_("extfs: extracting files %u of %u"), done, entries->len);
+
+        if (tty_got_interrupt ())
+        {
+            kill (pid, SIGTERM);
+            while (waitpid (pid, &status, 0) == -1 && errno == EINTR)
+                ;
+            res = -1;
+            break;
+        }
+
+        g_usleep (G_USEC_PER_SEC / 10);
+    }
+
+    tty_disable_interrupt_key ();
+
+    return (res == -1 || !WIFEXITED (status)) ? -1 : WEXITSTATUS (status);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Extract many files in one helper run:
+ *
+ *   helper copyout-many archivename extractdir listfile
+ *
+ * listfile contains one stored file name per line, each file is extracted to
+ * extractdir/storedfilename.  Extracted files become local copies of inodes,
+ * so following extfs_open() calls don't run the helper.  Files that weren't
+ * extracted are left to the usual "copyout" command.  A helper that extracts
+ * none of the files, even if it exits successfully, doesn't support the command
+ * and isn't asked again.
+ */
+
+static void
+extfs_copyout_many (struct extfs_super_t *archive, GHashTable * members)
+{
+    extfs_plugin_info_t *info;
+    GHashTableIter iter;
+    gpointer value;
+    GPtrArray *entries;
+    GString *list;
+    char *extract_dir, *list_name;
+    char *archive_name, *quoted_archive_name, *quoted_extract_dir, *quoted_list_name;
+    char *cmd;
+    int retval;
+    guint i;
+
+    info = &g_array_index (extfs_plugins, extfs_plugin_info_t, archive->fstype);
+    if (info->no_copyout_many || g_hash_table_size (members) < 2)
+        return;
+
+    extract_dir = g_build_filename (mc_tmpdir (), "extfs-many-XXXXXX", (char *) NULL);
+    if (g_mkdtemp (extract_dir) == NULL)
+    {
+        g_free (extract_dir);
+        return;
+    }
+
+    entries = g_ptr_array_sized_new (g_hash_table_size (members));
+    list = g_string_sized_new (BUF_8K);
+
+    g_hash_table_iter_init (&iter, members);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        struct vfs_s_entry *entry = VFS_ENTRY (value);
+        char *file;
+
+        file = extfs_get_path_from_entry (entry);
+        /* file names with newlines can't be passed in the list */
+        if (strchr (file, '\n') == NULL)
+        {
+            g_string_append (list, file);
+            g_string_append_c (list, '\n');
+            g_ptr_array_add (entries, entry);
+        }
+        g_free (file);
+    }
+
+    list_name = g_strconcat (extract_dir, ".list", (char *) NULL);
+    if (!g_file_set_contents (list_name, list->str, list->len, NULL))
+    {
+        g_string_free (list, TRUE);
+        g_ptr_array_free (entries, TRUE);
+        rmdir (extract_dir);
+        g_free (extract_dir);
+        g_free (list_name);
+        return;
+    }
+    g_string_free (list, TRUE);
+
+    archive_name = extfs_get_archive_name (archive);
+    quoted_archive_name = name_quote (archive_name, FALSE);
+    g_free (archive_name);
+    quoted_extract_dir = name_quote (extract_dir, FALSE);
+    quoted_list_name = name_quote (list_name, FALSE);
+    cmd = g_strconcat (info->path, info->prefix, " copyout-many ", quoted_archive_name, " ",
+                       quoted_extract_dir, " ", quoted_list_name, (char *) NULL);
+    g_free (quoted_archive_name);
+    g_free (quoted_extract_dir);
+    g_free (quoted_list_name);
+
+    retval = extfs_copyout_many_run (cmd, entries, extract_dir);
+    g_free (cmd);
+
+    unlink (list_name);
+    g_free (list_name);
+
+    if (retval == 0)
+    {
+        guint extracted_count = 0;
+
+        for (i = 0; i < entries->len; i++)
+        {
+            struct vfs_s_entry *entry = VFS_ENTRY (g_ptr_array_index (entries, i));
+            char *extracted;
+            struct stat st;
+
+            extracted = extfs_extracted_name (entry, extract_dir);
+
+            if (lstat (extracted, &st) == 0 && S_ISREG (st.st_mode))
+            {
+                vfs_path_t *local_filename_vpath;
+                int local_handle;
+
+                local_handle = vfs_mkstemps (&local_filename_vpath, "extfs", entry->name);
+                if (local_handle != -1)
+                {
+                    const char *local_filename;
+
+                    close (local_handle);
+                    local_filename = vfs_path_get_by_index (local_filename_vpath, -1)->path;
+                    /* rename() can't replace existing file on some systems */
+                    unlink (local_filename);
+                    if (rename (extracted, local_filename) == 0)
+                        entry->ino->localname = g_strdup (local_filename);
+                    vfs_path_free (local_filename_vpath);
+                }
+                extracted_count++;
+            }
+
+            g_free (extracted);
+        }
+
+        /* some helpers silently ignore unknown commands */
+        info->no_copyout_many = (extracted_count == 0);
+    }
+    else if (retval > 0)
+    {
+        GDir *dir;
+
+        /* nothing was extracted: assume command is not supported by helper */
+        dir = g_dir_open (extract_dir, 0, NULL);
+        if (dir != NULL)
+        {
+            info->no_copyout_many = (g_dir_read_name (dir) == NULL);
+            g_dir_close (dir);
+        }
+    }
+
+    g_ptr_array_free (entries, TRUE);
+    extfs_remove_tree (extract_dir);
+    g_free (extract_dir);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+extfs_prefetch (const vfs_path_t * vpath, const char *const *names)
+{
+    struct extfs_super_t *archive = NULL;
+    GHashTable *members;
+
+    members = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    for (; *names != NULL; names++)
+    {
+        vfs_path_t *name_vpath;
+        struct extfs_super_t *a = NULL;
+        const char *q;
+
+        name_vpath = vfs_path_append_new (vpath, *names, (char *) NULL);
+        q = extfs_get_path (name_vpath, &a, FL_NONE);
+        /* all files are in the same directory */
+        if (q != NULL && (archive == NULL || a == archive))
+        {
+            struct vfs_s_entry *entry;
+
+            entry = extfs_find_entry (VFS_SUPER (a)->root, q, FL_NONE);
+            if (entry != NULL)
+            {
+                archive = a;
+                extfs_collect_members (entry, members);
+            }
+        }
+        vfs_path_free (name_vpath);
+    }
+
+    if (archive != NULL)
+        extfs_copyout_many (archive, members);
+
+    g_hash_table_destroy (members);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static void
 extfs_run (const vfs_path_t * vpath)
 {
@@ -1474,6 +1854,7 @@ extfs_get_plugins (const char *where, gboolean silent)
                  */
                 len = strlen (filename);
                 info.need_archive = (filename[len - 1] != '+');
+                info.no_copyout_many = FALSE;
                 info.path = g_strconcat (dirname, PATH_SEP_STR, (char *) NULL);
                 info.prefix = g_strdup (filename);
 
@@ -1566,14 +1947,17 @@ extfs_done (struct vfs_class *me)
 static int
 extfs_setctl (const vfs_path_t * vpath, int ctlop, void *arg)
 {
-    (void) arg;
-
-    if (ctlop == VFS_SETCTL_RUN)
+    switch (ctlop)
     {
+    case VFS_SETCTL_RUN:
         extfs_run (vpath);
         return 1;
+    case VFS_SETCTL_PREFETCH:
+        extfs_prefetch (vpath, (const char *const *) arg);
+        return 1;
+    default:
+        return 0;
     }
-    return 0;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1611,6 +1995,7 @@ vfs_init_extfs (void)
     vfs_extfs_ops->mkdir = extfs_mkdir;
     vfs_extfs_ops->rmdir = extfs_rmdir;
     vfs_extfs_ops->setctl = extfs_setctl;
+    extfs_subclass.init_inode = extfs_init_inode;
     extfs_subclass.free_inode = extfs_free_inode;
     extfs_subclass.free_archive = extfs_free_archive;
     vfs_register_class (vfs_extfs_ops);
@@ -55,6 +55,7 @@
 #include <pwd.h>
 #include <grp.h>
 #include <sys/time.h>           /* gettimeofday() */
+#include <stddef.h>             /* offsetof() */
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>           /* uintmax_t */
@@ -120,6 +121,9 @@ int fish_directory_timeout = 900;
 #define FISH_SUPER(super) ((fish_super_t *) (super))
 #define FISH_FILE_HANDLER(fh) ((fish_file_handler_t *) fh)
 
+#define FISH_AGENT_SCRIPT(fish_super, i) \
+    (*(char **) ((char *) (fish_super) + fish_agent_scripts[i].offset))
+
 /*** file scope type declarations ****************************************************************/
 
 typedef struct
@@ -140,11 +144,15 @@ typedef struct
     char *scr_mv;
     char *scr_hardlink;
     char *scr_get;
+    char *scr_read;
     char *scr_send;
     char *scr_append;
     char *scr_info;
+    char *scr_lstree;
     int host_flags;
     char *scr_env;
+    gboolean agent;             /* scripts are defined as shell functions on remote side */
+    gboolean no_tree;           /* remote side cannot list directory trees */
 } fish_super_t;
 
 typedef struct
@@ -154,6 +162,8 @@ typedef struct
     off_t got;
     off_t total;
     gboolean append;
+    gboolean write_only;        /* opened for writing only, no need of remote data */
+    gboolean stream;            /* data is sent to remote side as it is written */
 } fish_file_handler_t;
 
 /*** file scope variables ************************************************************************/
@@ -163,6 +173,33 @@ static char reply_str[80];
 static struct vfs_s_subclass fish_subclass;
 static struct vfs_class *vfs_fish_ops = VFS_CLASS (&fish_subclass);
 
+/* scripts uploaded as mc_fish_<name> shell functions once per connection */
+/* *INDENT-OFF* */
+static const struct
+{
+    const char *name;
+    size_t offset;
+} fish_agent_scripts[] =
+{
+    { "ls", offsetof (fish_super_t, scr_ls) },
+    { "chmod", offsetof (fish_super_t, scr_chmod) },
+    { "utime", offsetof (fish_super_t, scr_utime) },
+    { "exists", offsetof (fish_super_t, scr_exists) },
+    { "mkdir", offsetof (fish_super_t, scr_mkdir) },
+    { "unlink", offsetof (fish_super_t, scr_unlink) },
+    { "chown", offsetof (fish_super_t, scr_chown) },
+    { "rmdir", offsetof (fish_super_t, scr_rmdir) },
+    { "ln", offsetof (fish_super_t, scr_ln) },
+    { "mv", offsetof (fish_super_t, scr_mv) },
+    { "hardlink", offsetof (fish_super_t, scr_hardlink) },
+    { "get", offsetof (fish_super_t, scr_get) },
+    { "read", offsetof (fish_super_t, scr_read) },
+    { "send", offsetof (fish_super_t, scr_send) },
+    { "append", offsetof (fish_super_t, scr_append) },
+    { "lstree", offsetof (fish_super_t, scr_lstree) }
+};
+/* *INDENT-ON* */
+
 /* --------------------------------------------------------------------------------------------- */
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -307,12 +344,29 @@ G_GNUC_PRINTF (5, 0)
 fish_command_va (struct vfs_class *me, struct vfs_s_super *super, int wait_reply, const char *scr,
                  const char *vars, va_list ap)
 {
+    fish_super_t *fish_super = FISH_SUPER (super);
     int r;
     GString *command;
 
-    command = g_string_new (FISH_SUPER (super)->scr_env);
+    command = g_string_new (fish_super->agent ? NULL : fish_super->scr_env);
     g_string_append_vprintf (command, vars, ap);
-    g_string_append (command, scr);
+
+    if (!fish_super->agent)
+        g_string_append (command, scr);
+    else
+    {
+        size_t i;
+
+        for (i = 0; i < G_N_ELEMENTS (fish_agent_scripts); i++)
+            if (FISH_AGENT_SCRIPT (fish_super, i) == scr)
+                break;
+
+        if (i < G_N_ELEMENTS (fish_agent_scripts))
+            g_string_append_printf (command, "mc_fish_%s\n", fish_agent_scripts[i].name);
+        else
+            g_string_append (command, scr);
+    }
+
     r = fish_command (me, super, wait_reply, command->str, command->len);
     g_string_free (command, TRUE);
 
@@ -399,9 +453,11 @@ fish_free_archive (struct vfs_class *me, struct vfs_s_super *super)
     g_free (fish_super->scr_mv);
     g_free (fish_super->scr_hardlink);
     g_free (fish_super->scr_get);
+    g_free (fish_super->scr_read);
     g_free (fish_super->scr_send);
     g_free (fish_super->scr_append);
     g_free (fish_super->scr_info);
+    g_free (fish_super->scr_lstree);
     g_free (fish_super->scr_env);
 }
 
@@ -503,6 +559,43 @@ fish_info (struct vfs_class *me, struct vfs_s_super *super)
     ERRNOR (E_PROTO, FALSE);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Define scripts as shell functions on remote side. After that, each command sends the values
+ * of its variables and the name of function instead of whole script and environment.
+ * If the functions cannot be defined (e.g. remote side is a real fish server and not a shell),
+ * scripts are sent with every command as before.
+ */
+
+static void
+fish_agent_start (struct vfs_class *me, struct vfs_s_super *super)
+{
+    fish_super_t *fish_super = FISH_SUPER (super);
+    GString *command;
+    size_t i;
+
+    command = g_string_new ("#AGENT\n");
+    if (fish_super->scr_env != NULL)
+        g_string_append_printf (command, "%s\n", fish_super->scr_env);
+
+    /* function body can't be empty: ':' keeps it valid if the script is empty
+       or has only comments */
+    for (i = 0; i < G_N_ELEMENTS (fish_agent_scripts); i++)
+        g_string_append_printf (command, "mc_fish_%s ()\n{\n:\n%s\n}\n",
+                                fish_agent_scripts[i].name, FISH_AGENT_SCRIPT (fish_super, i));
+
+    /* reply in any case to not get stuck if some definition is broken */
+    g_string_append (command, "res=200\nfor f in");
+    for (i = 0; i < G_N_ELEMENTS (fish_agent_scripts); i++)
+        g_string_append_printf (command, " mc_fish_%s", fish_agent_scripts[i].name);
+    g_string_append (command, "; do\n"
+                     "    type $f >/dev/null 2>&1 || res=500\n"
+                     "done\n" "echo \"### $res\"\n");
+
+    fish_super->agent = fish_command (me, super, WAIT_REPLY, command->str, command->len) == COMPLETE;
+    g_string_free (command, TRUE);
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static void
@@ -646,6 +739,9 @@ fish_open_archive_int (struct vfs_class *me, struct vfs_s_super *super)
     if (fish_info (me, super))
         FISH_SUPER (super)->scr_env = fish_set_env (FISH_SUPER (super)->host_flags);
 
+    vfs_print_message ("%s", _("fish: Sending scripts..."));
+    fish_agent_start (me, super);
+
 #if 0
     super->name =
         g_strconcat ("sh://", super->path_element->user, "@", super->path_element->host,
@@ -706,6 +802,9 @@ fish_open_archive (struct vfs_s_super *super,
                                     FISH_HARDLINK_DEF_CONTENT);
     fish_super->scr_get =
         fish_load_script_from_file (super->path_element->host, FISH_GET_FILE, FISH_GET_DEF_CONTENT);
+    fish_super->scr_read =
+        fish_load_script_from_file (super->path_element->host, FISH_READ_FILE,
+                                    FISH_READ_DEF_CONTENT);
     fish_super->scr_send =
         fish_load_script_from_file (super->path_element->host, FISH_SEND_FILE,
                                     FISH_SEND_DEF_CONTENT);
@@ -715,6 +814,9 @@ fish_open_archive (struct vfs_s_super *super,
     fish_super->scr_info =
         fish_load_script_from_file (super->path_element->host, FISH_INFO_FILE,
                                     FISH_INFO_DEF_CONTENT);
+    fish_super->scr_lstree =
+        fish_load_script_from_file (super->path_element->host, FISH_LSTREE_FILE,
+                                    FISH_LSTREE_DEF_CONTENT);
 
     return fish_open_archive_int (vpath_element->class, super);
 }
@@ -736,15 +838,92 @@ fish_archive_same (const vfs_path_element_t * vpath_element, struct vfs_s_super
     if (path_element->user == NULL)
         path_element->user = vfs_get_local_username ();
 
-    result = ((strcmp (path_element->host, super->path_element->host) == 0)
-              && (strcmp (path_element->user, super->path_element->user) == 0)
-              && (path_element->port == super->path_element->port)) ? 1 : 0;
+    /* connection was dropped, open another one */
+    if (FISH_SUPER (super)->sockw == -1)
+        result = 0;
+    else
+        result = ((strcmp (path_element->host, super->path_element->host) == 0)
+                  && (strcmp (path_element->user, super->path_element->user) == 0)
+                  && (path_element->port == super->path_element->port)) ? 1 : 0;
 
     vfs_path_element_free (path_element);
 
     return result;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Parse line of directory listing which is not the name of file.
+ */
+
+static void
+fish_parse_stat_line (struct stat *st, char *buffer)
+{
+    switch (buffer[0])
+    {
+    case 'S':
+        st->st_size = (off_t) g_ascii_strtoll (buffer + 1, NULL, 10);
+        break;
+    case 'P':
+        {
+            size_t skipped;
+
+            vfs_parse_filemode (buffer + 1, &skipped, &st->st_mode);
+            break;
+        }
+    case 'R':
+        {
+            /*
+               raw filemode:
+               we expect: Roctal-filemode octal-filetype uid.gid
+             */
+            size_t skipped;
+
+            vfs_parse_raw_filemode (buffer + 1, &skipped, &st->st_mode);
+            break;
+        }
+    case 'd':
+        {
+            vfs_split_text (buffer + 1);
+            if (vfs_parse_filedate (0, &st->st_ctime) == 0)
+                break;
+            st->st_atime = st->st_mtime = st->st_ctime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+            st->st_atim.tv_nsec = st->st_mtim.tv_nsec = st->st_ctim.tv_nsec = 0;
+#endif
+        }
+        break;
+    case 'D':
+        {
+            struct tm tim;
+
+            /* cppcheck-suppress invalidscanf */
+            if (sscanf (buffer + 1, "%d %d %d %d %d %d", &tim.tm_year, &tim.tm_mon,
+                        &tim.tm_mday, &tim.tm_hour, &tim.tm_min, &tim.tm_sec) != 6)
+                break;
+            st->st_atime = st->st_mtime = st->st_ctime = mktime (&tim);
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+            st->st_atim.tv_nsec = st->st_mtim.tv_nsec = st->st_ctim.tv_nsec = 0;
+#endif
+        }
+        break;
+    case 'E':
+        {
+            int maj, min;
+
+            /* cppcheck-suppress invalidscanf */
+            if (sscanf (buffer + 1, "%d,%d", &maj, &min) != 2)
+                break;
+#ifdef HAVE_STRUCT_STAT_ST_RDEV
+            st->st_rdev = makedev (maj, min);
+#endif
+        }
+        break;
+    default:
+        break;
+    }
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static int
@@ -883,81 +1062,126 @@ fish_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path)
                 }
                 break;
             }
-        case 'S':
-            ST.st_size = (off_t) g_ascii_strtoll (buffer + 1, NULL, 10);
+        default:
+            fish_parse_stat_line (&ST, buffer);
             break;
-        case 'P':
-            {
-                size_t skipped;
+        }
+    }
 
-                vfs_parse_filemode (buffer + 1, &skipped, &ST.st_mode);
-                break;
-            }
-        case 'R':
-            {
-                /*
-                   raw filemode:
-                   we expect: Roctal-filemode octal-filetype uid.gid
-                 */
-                size_t skipped;
+    vfs_s_free_entry (me, ent);
+    reply_code = fish_decode_reply (buffer + 4, 0);
+    if (reply_code == COMPLETE)
+    {
+        vfs_print_message (_("%s: done."), me->name);
+        return 0;
+    }
 
-                vfs_parse_raw_filemode (buffer + 1, &skipped, &ST.st_mode);
-                break;
-            }
-        case 'd':
-            {
-                vfs_split_text (buffer + 1);
-                if (vfs_parse_filedate (0, &ST.st_ctime) == 0)
-                    break;
-                ST.st_atime = ST.st_mtime = ST.st_ctime;
-#ifdef HAVE_STRUCT_STAT_ST_MTIM
-                ST.st_atim.tv_nsec = ST.st_mtim.tv_nsec = ST.st_ctim.tv_nsec = 0;
-#endif
-            }
-            break;
-        case 'D':
-            {
-                struct tm tim;
+    me->verrno = reply_code == ERROR ? EACCES : E_REMOTE;
 
-                /* cppcheck-suppress invalidscanf */
-                if (sscanf (buffer + 1, "%d %d %d %d %d %d", &tim.tm_year, &tim.tm_mon,
-                            &tim.tm_mday, &tim.tm_hour, &tim.tm_min, &tim.tm_sec) != 6)
-                    break;
-                ST.st_atime = ST.st_mtime = ST.st_ctime = mktime (&tim);
-#ifdef HAVE_STRUCT_STAT_ST_MTIM
-                ST.st_atim.tv_nsec = ST.st_mtim.tv_nsec = ST.st_ctim.tv_nsec = 0;
-#endif
-            }
+  error:
+    vfs_print_message (_("%s: failure"), me->name);
+    return -1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Load directory with all subdirectories in one command. Entries come with paths relative
+ * to the loaded directory; only subdirectories announced with "/<relpath>" line could be
+ * read completely and are put into cache.
+ */
+
+static int
+fish_dir_load_tree (struct vfs_class *me, struct vfs_s_super *super, const char *path)
+{
+    fish_super_t *fish_super = FISH_SUPER (super);
+    char buffer[BUF_8K] = "\0";
+    vfs_s_tree_t *tree;
+    struct vfs_s_entry *ent;
+    char *quoted_path;
+    int reply_code = TRANSIENT;
+
+    if (fish_super->no_tree)
+        return (-1);
+
+    vfs_print_message (_("fish: Reading directory tree %s..."), path);
+
+    quoted_path = strutils_shell_escape (path);
+    (void) fish_command_v (me, super, NONE, fish_super->scr_lstree, "FISH_FILENAME=%s;\n",
+                           quoted_path);
+    g_free (quoted_path);
+
+    tree = vfs_s_tree_new (me, super);
+    vfs_s_tree_dir (tree, "", TRUE);
+    ent = vfs_s_generate_entry (me, NULL, super->root, 0);
+
+    while (TRUE)
+    {
+        int res;
+
+        res = vfs_s_get_line_interruptible (me, buffer, sizeof (buffer), fish_super->sockr);
+        if ((res == 0) || (res == EINTR))
+        {
+            me->verrno = ECONNRESET;
+            goto done;
+        }
+        if (me->logfile != NULL)
+        {
+            fputs (buffer, me->logfile);
+            fputs ("\n", me->logfile);
+            fflush (me->logfile);
+        }
+        if (strncmp (buffer, "### ", 4) == 0)
             break;
-        case 'E':
+
+        switch (buffer[0])
+        {
+        case '\0':
+            if (ent->name != NULL)
             {
-                int maj, min;
+                char *relpath, *p;
 
-                /* cppcheck-suppress invalidscanf */
-                if (sscanf (buffer + 1, "%d,%d", &maj, &min) != 2)
-                    break;
-#ifdef HAVE_STRUCT_STAT_ST_RDEV
-                ST.st_rdev = makedev (maj, min);
-#endif
+                /* split path to directory and name */
+                relpath = ent->name;
+                p = strrchr (relpath, PATH_SEP);
+                ent->name = g_strdup (p == NULL ? relpath : p + 1);
+                *(p == NULL ? relpath : p) = '\0';
+                vfs_s_insert_entry (me, vfs_s_tree_dir (tree, relpath, FALSE), ent);
+                g_free (relpath);
+
+                ent = vfs_s_generate_entry (me, NULL, super->root, 0);
             }
+            break;
+        case '/':
+            vfs_s_tree_dir (tree, buffer + 1, TRUE);
+            break;
+        case ':':
+            /* path relative to loaded directory until the entry is inserted */
+            g_free (ent->name);
+            ent->name = g_strdup (buffer + 1);
+            break;
+        case 'L':
+            vfs_s_set_linkname (ent->ino, buffer + 1, -1);
+            break;
         default:
+            fish_parse_stat_line (&ent->ino->st, buffer);
             break;
         }
     }
 
-    vfs_s_free_entry (me, ent);
     reply_code = fish_decode_reply (buffer + 4, 0);
     if (reply_code == COMPLETE)
     {
+        vfs_s_tree_store (tree, path, fish_directory_timeout);
         vfs_print_message (_("%s: done."), me->name);
-        return 0;
     }
+    else if (reply_code == ERROR)
+        fish_super->no_tree = TRUE;
 
-    me->verrno = reply_code == ERROR ? EACCES : E_REMOTE;
+  done:
+    vfs_s_free_entry (me, ent);
+    vfs_s_tree_free (tree);
 
-  error:
-    vfs_print_message (_("%s: failure"), me->name);
-    return -1;
+    return reply_code == COMPLETE ? 0 : -1;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1072,6 +1296,156 @@ fish_file_store (struct vfs_class *me, vfs_file_handler_t * fh, char *name, char
     return -1;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Break off the upload of a file streamed to remote side.  Remote side waits for
+ * the announced amount of data, so the connection is dropped instead of padding
+ * the file; the next access opens a new one.
+ */
+
+static void
+fish_stream_abort (vfs_file_handler_t * fh)
+{
+    struct vfs_s_super *super = VFS_FILE_HANDLER_SUPER (fh);
+    fish_super_t *fish_super = FISH_SUPER (super);
+
+    if (fish_super->sockw == -1)
+        return;
+
+    vfs_print_message (_("fish: Disconnecting from %s"), super->name ? super->name : "???");
+    close (fish_super->sockw);
+    close (fish_super->sockr);
+    fish_super->sockw = fish_super->sockr = -1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Start the store command for the file opened for writing and drop its temporary file,
+ * so that data goes to remote side as it is written.
+ *
+ * @return 1 if streaming was started, 0 if data should be collected in temporary file
+ */
+
+static int
+fish_stream_start (struct vfs_class *me, vfs_file_handler_t * fh, off_t size)
+{
+    fish_file_handler_t *fish = FISH_FILE_HANDLER (fh);
+    struct vfs_s_super *super = VFS_FILE_HANDLER_SUPER (fh);
+    fish_super_t *fish_super = FISH_SUPER (super);
+    struct stat s;
+    char *name;
+    char *quoted_name;
+    int code;
+
+    /* connection cannot be shared with another transfer, e.g. copying within the same host */
+    if (!fish->write_only || fish->stream || size < 0 || fh->handle == -1
+        || fh->ino->localname == NULL || super->fd_usage > 1)
+        return 0;
+
+    /* something has been written already */
+    if (fstat (fh->handle, &s) != 0 || s.st_size != 0)
+        return 0;
+
+    name = vfs_s_fullpath (me, fh->ino);
+    if (name == NULL)
+        return 0;
+    quoted_name = strutils_shell_escape (name);
+    g_free (name);
+
+    vfs_print_message (_("fish: store %s: sending command..."), quoted_name);
+    code =
+        fish_command_v (me, super, WAIT_REPLY,
+                        fish->append ? fish_super->scr_append : fish_super->scr_send,
+                        "FISH_FILENAME=%s FISH_FILESIZE=%" PRIuMAX ";\n", quoted_name,
+                        (uintmax_t) size);
+    g_free (quoted_name);
+
+    if (code != PRELIM)
+        return 0;
+
+    close (fh->handle);
+    fh->handle = -1;
+    unlink (fh->ino->localname);
+    MC_PTR_FREE (fh->ino->localname);
+
+    fish->stream = TRUE;
+    fish->got = 0;
+    fish->total = size;
+    return 1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+fish_fh_write (struct vfs_class *me, vfs_file_handler_t * fh, const char *buf, size_t len)
+{
+    fish_file_handler_t *fish = FISH_FILE_HANDLER (fh);
+    struct vfs_s_super *super = VFS_FILE_HANDLER_SUPER (fh);
+    ssize_t n;
+
+    if (!fish->stream)
+        ERRNOR (EBADF, -1);
+
+    /* remote side reads exactly the announced amount of data */
+    if ((off_t) len > fish->total - fish->got)
+    {
+        fish_stream_abort (fh);
+        ERRNOR (EFBIG, -1);
+    }
+
+    if (FISH_SUPER (super)->sockw == -1)
+        ERRNOR (EIO, -1);
+
+    while ((n = write (FISH_SUPER (super)->sockw, buf, len)) < 0)
+    {
+        if (errno == EINTR && !tty_got_interrupt ())
+            continue;
+        ERRNOR (errno, -1);
+    }
+
+    fish->got += n;
+    fh->pos += n;
+    vfs_print_message ("%s: %" PRIuMAX "/%" PRIuMAX, _("fish: storing file"),
+                       (uintmax_t) fish->got, (uintmax_t) fish->total);
+    return n;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+fish_fh_close (struct vfs_class *me, vfs_file_handler_t * fh)
+{
+    fish_file_handler_t *fish = FISH_FILE_HANDLER (fh);
+    struct vfs_s_super *super = VFS_FILE_HANDLER_SUPER (fh);
+    fish_super_t *fish_super = FISH_SUPER (super);
+    int res = 0;
+
+    if (!fish->stream)
+        return 0;
+
+    fish->stream = FALSE;
+
+    /* file is stored already, so prevent fish_file_store() call from vfs_s_close() */
+    fh->changed = FALSE;
+
+    /* amount of data differs from the announced one */
+    if (fish->got != fish->total || fish_super->sockw == -1)
+    {
+        fish_stream_abort (fh);
+        me->verrno = EIO;
+        return (-1);
+    }
+
+    if (fish_get_reply (me, fish_super->sockr, NULL, 0) != COMPLETE)
+    {
+        me->verrno = E_REMOTE;
+        res = -1;
+    }
+
+    vfs_s_invalidate (me, super);
+    return res;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static int
@@ -1187,14 +1561,92 @@ fish_linear_close (struct vfs_class *me, vfs_file_handler_t * fh)
         fish_linear_abort (me, fh);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read part of remote file with the 'read' script.
+ */
+
+static ssize_t
+fish_read_range (struct vfs_class *me, vfs_file_handler_t * fh, off_t offset, char *buf,
+                 size_t len)
+{
+    struct vfs_s_super *super = VFS_FILE_HANDLER_SUPER (fh);
+    fish_super_t *fish_super = FISH_SUPER (super);
+    char *name;
+    char *quoted_name;
+    off_t total, got = 0;
+    int code;
+
+    name = vfs_s_fullpath (me, fh->ino);
+    if (name == NULL)
+        return (-1);
+    quoted_name = strutils_shell_escape (name);
+    g_free (name);
+
+    code =
+        fish_command_v (me, super, WANT_STRING, fish_super->scr_read,
+                        "FISH_FILENAME=%s FISH_START_OFFSET=%" PRIuMAX " FISH_LENGTH=%" PRIuMAX
+                        ";\n", quoted_name, (uintmax_t) offset, (uintmax_t) len);
+    g_free (quoted_name);
+
+    if (code != PRELIM)
+        ERRNOR (E_REMOTE, -1);
+
+    errno = 0;
+#if SIZEOF_OFF_T == SIZEOF_LONG
+    total = (off_t) strtol (reply_str, NULL, 10);
+#else
+    total = (off_t) g_ascii_strtoll (reply_str, NULL, 10);
+#endif
+    if (errno != 0 || total < 0)
+        ERRNOR (E_REMOTE, -1);
+
+    tty_enable_interrupt_key ();
+    while (got < total)
+    {
+        char discard[BUF_8K];
+        char *dest;
+        size_t count;
+        ssize_t n;
+
+        /* script must not send more than asked, but stay in sync if it does */
+        if (got < (off_t) len)
+        {
+            dest = buf + got;
+            count = (size_t) MIN ((off_t) len, total) - (size_t) got;
+        }
+        else
+        {
+            dest = discard;
+            count = (size_t) MIN ((off_t) sizeof (discard), total - got);
+        }
+
+        n = read (fish_super->sockr, dest, count);
+        if (n < 0 && errno == EINTR && !tty_got_interrupt ())
+            continue;
+        if (n <= 0)
+        {
+            tty_disable_interrupt_key ();
+            ERRNOR (n == 0 ? ECONNRESET : errno, -1);
+        }
+        got += n;
+    }
+    tty_disable_interrupt_key ();
+
+    if (fish_get_reply (me, fish_super->sockr, NULL, 0) != COMPLETE)
+        ERRNOR (E_REMOTE, -1);
+
+    return (ssize_t) MIN ((off_t) len, total);
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static int
 fish_ctl (void *fh, int ctlop, void *arg)
 {
-    (void) arg;
-    (void) fh;
-    (void) ctlop;
+    if (ctlop == VFS_CTL_EXPECTED_SIZE)
+        return fish_stream_start (VFS_FILE_HANDLER_SUPER (fh)->me, VFS_FILE_HANDLER (fh),
+                                  *(off_t *) arg);
 
     return 0;
 
@@ -1659,6 +2111,7 @@ fish_fh_open (struct vfs_class *me, vfs_file_handler_t * fh, int flags, mode_t m
         /* user pressed the button [ Append ] in the "Copy" dialog */
         if ((flags & O_APPEND) != 0)
             fish->append = TRUE;
+        fish->write_only = TRUE;
 
         if (fh->ino->localname == NULL)
         {
@@ -1772,11 +2225,15 @@ vfs_init_fish (void)
     fish_subclass.free_archive = fish_free_archive;
     fish_subclass.fh_new = fish_fh_new;
     fish_subclass.fh_open = fish_fh_open;
+    fish_subclass.fh_close = fish_fh_close;
+    fish_subclass.fh_write = fish_fh_write;
     fish_subclass.dir_load = fish_dir_load;
+    fish_subclass.dir_load_tree = fish_dir_load_tree;
     fish_subclass.file_store = fish_file_store;
     fish_subclass.linear_start = fish_linear_start;
     fish_subclass.linear_read = fish_linear_read;
     fish_subclass.linear_close = fish_linear_close;
+    fish_subclass.read_range = fish_read_range;
     vfs_register_class (vfs_fish_ops);
 }
 
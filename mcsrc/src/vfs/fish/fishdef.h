@@ -143,6 +143,47 @@
 "    echo \"### 500\"\n"                                                        \
 "fi\n"
 
+/* default 'read' script */
+#define FISH_READ_DEF_CONTENT ""                                                  \
+"#READ $FISH_START_OFFSET $FISH_LENGTH $FISH_FILENAME\n"                          \
+"FILENAME=\"/${FISH_FILENAME}\"\n"                                                \
+"OFFSET=${FISH_START_OFFSET}\n"                                                   \
+"LENGTH=${FISH_LENGTH}\n"                                                         \
+"LC_TIME=C\n"                                                                     \
+"export LC_TIME\n"                                                                \
+"if dd if=\"${FILENAME}\" of=/dev/null bs=1 count=1 2>/dev/null ; then\n"         \
+"    file_size=`ls -ln \"${FILENAME}\" 2>/dev/null | (\n"                         \
+"       read p l u g s r\n"                                                       \
+"       echo $s\n"                                                                \
+"    )`\n"                                                                        \
+"    rest=`expr $file_size - $OFFSET`\n"                                          \
+"    if [ $rest -lt 0 ]; then\n"                                                  \
+"        rest=0\n"                                                                \
+"    fi\n"                                                                        \
+"    if [ $rest -lt $LENGTH ]; then\n"                                            \
+"        LENGTH=$rest\n"                                                          \
+"    fi\n"                                                                        \
+"    echo $LENGTH\n"                                                              \
+"    echo \"### 100\"\n"                                                          \
+"    if [ $LENGTH -gt 0 ]; then\n"                                                \
+"        bs=4096\n"                                                               \
+"        if [ `expr $OFFSET % $bs` -ne 0 ]; then\n"                               \
+"            bs=1\n"                                                              \
+"        fi\n"                                                                    \
+"        skip=`expr $OFFSET / $bs`\n"                                             \
+"        cnt=`expr $LENGTH + $bs - 1`\n"                                          \
+"        cnt=`expr $cnt / $bs`\n"                                                 \
+"        cut=cat\n"                                                               \
+"        if [ -n \"${FISH_HAVE_HEAD}\" ]; then\n"                                 \
+"            cut=\"head -c $LENGTH\"\n"                                           \
+"        fi\n"                                                                    \
+"        dd if=\"${FILENAME}\" bs=$bs skip=$skip count=$cnt 2>/dev/null | $cut\n" \
+"    fi\n"                                                                        \
+"    echo \"### 200\"\n"                                                          \
+"else\n"                                                                          \
+"    echo \"### 500\"\n"                                                          \
+"fi\n"
+
 /* default 'stor'  script */
 #define FISH_SEND_DEF_CONTENT ""                                          \
 "FILENAME=\"/${FISH_FILENAME}\"\n"                                        \
@@ -224,6 +265,31 @@
 "echo $res\n"                                                             \
 "echo \"### 200\"\n"
 
+/* default 'lstree' script */
+#define FISH_LSTREE_DEF_CONTENT ""                                              \
+"#LSTREE /${FISH_FILENAME}\n"                                                   \
+"FISH_DIR=\"/${FISH_FILENAME}\"\n"                                              \
+"LC_TIME=C\n"                                                                   \
+"export LC_TIME\n"                                                              \
+"nl='\n"                                                                        \
+"'\n"                                                                           \
+"if ! find / -maxdepth 0 -readable -printf '' >/dev/null 2>&1; then\n"          \
+"    echo '### 500'\n"                                                          \
+"elif [ ! -r \"${FISH_DIR}\" ] || [ ! -x \"${FISH_DIR}\" ]; then\n"             \
+"    echo '### 400'\n"                                                          \
+"elif [ -n \"`find \"${FISH_DIR}\" -mindepth 1 \\( -name \"*${nl}*\" -o -lname \"*${nl}*\" \\) \\\n" \
+"             -print -quit 2>/dev/null`\" ]; then\n"                            \
+"    # names are sent one per line: let the client list directories one by one\n" \
+"    echo '### 400'\n"                                                          \
+"else\n"                                                                        \
+"    find \"${FISH_DIR}\" -mindepth 1 \\\n"                                     \
+"        \\( -type d -readable -executable -printf '/%P\\n' -o -true \\) \\\n"  \
+"        -printf 'P%M %U.%G\\nS%s\\nd%Tm-%Td-%TY %TH:%TM\\n' \\\n"              \
+"        \\( -type l -printf 'L%l\\n' -o -true \\) \\\n"                        \
+"        -printf ':%P\\n\\n' 2>/dev/null\n"                                     \
+"    echo '### 200'\n"                                                          \
+"fi\n"
+
 /*** enums ***************************************************************************************/
 
 /*** structures declarations (and typedefs of structures)*****************************************/
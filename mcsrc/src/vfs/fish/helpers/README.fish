@@ -177,14 +177,44 @@ echo $result
 echo '### 200'
 
 #READ <offset> <size> /path/and/filename
-cat /path/and/filename | ( dd bs=4096 count=<offset/4096> > /dev/null;
-dd bs=<offset%4096> count=1 > /dev/null;
-dd bs=4096 count=<offset/4096>;
-dd bs=<offset%4096> count=1; )
-
-Returns ### 200 on successful exit, ### 291 on successful exit when
-reading ended at eof, ### 292 on successfull exit when reading did not
-end at eof.
+ls -l /path/and/filename | ( read a b c d x e; echo <min(size, x - offset)> ); echo '### 100';
+dd if=/path/and/filename bs=4096 skip=<offset/4096> count=<size/4096>; echo '### 200'
+
+Reply is the same as for RETR, except that only (at most size) bytes
+starting at offset are sent. The client uses it to read parts of big
+files, e.g. the end of a log in the viewer, without downloading the
+whole file.
+
+#LSTREE /directory
+find /directory -mindepth 1 ...; echo '### 200'
+
+Lists the directory with all its subdirectories at once. Entries are
+the same as for #LIST, except that :<filename> is the path relative to
+the directory, the name is not quoted and symlink target comes in
+L<target> line. Line /<relative path> announces a subdirectory which
+could be read completely. The reply is ### 500 if the server cannot
+list trees, then the client lists directories one by one. The reply is
+### 400 if a name or a symlink target in the tree contains a newline,
+which can't be sent in this format; the client then lists directories of
+this tree one by one.
+
+#AGENT
+mc_fish_ls ()
+{
+...ls script...
+}
+...the same for other scripts...
+echo '### 200'
+
+This command is sent once after #INFO. It defines every script as
+shell function named mc_fish_<script>, so later commands send only
+values of their variables followed by name of function, e.g.
+
+FISH_FILENAME=/some/name;
+mc_fish_ls
+
+instead of whole script. If server replies anything but ### 200, the
+client keeps sending whole scripts.
 
 #WRITE <offset> <size> /path/and/filename
 
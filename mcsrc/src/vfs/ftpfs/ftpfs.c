@@ -118,6 +118,9 @@ What to do with this?
 /* Delay to retry a connection */
 int ftpfs_retry_seconds = 30;
 
+/* Maximum number of control connections to one server */
+int ftpfs_max_connections = 4;
+
 /* Method to use to connect to ftp sites */
 gboolean ftpfs_use_passive_connections = TRUE;
 gboolean ftpfs_use_passive_connections_over_proxy = FALSE;
@@ -156,6 +159,7 @@ gboolean ftpfs_ignore_chattr_errors = TRUE;
 #define FTP_SUPER(super) ((ftp_super_t *) (super))
 #define FTP_FILE_HANDLER(fh) ((ftp_file_handler_t *) (fh))
 #define FH_SOCK FTP_FILE_HANDLER(fh)->sock
+#define FH_CONN FTP_FILE_HANDLER(fh)->conn
 
 #ifndef INADDR_NONE
 #define INADDR_NONE 0xffffffff
@@ -221,6 +225,13 @@ typedef struct
                                  */
     gboolean ctl_connection_busy;
     char *current_dir;
+    gboolean use_mlsd;          /* server supports MLST and MLSD (RFC 3659) */
+    gboolean features_known;    /* FEAT has been sent to this server already */
+    char *mlst_opts;            /* MLST facts to ask for, NULL if none */
+    gboolean no_tree;           /* server does not list directory trees with LIST -R */
+    GList *pool;                /* more connections to the same server, used when this one is busy */
+    gboolean pooled;            /* this is one of connections in the pool */
+    gboolean pool_full;         /* server refused one more connection */
 } ftp_super_t;
 
 typedef struct
@@ -229,6 +240,7 @@ typedef struct
 
     int sock;
     gboolean append;
+    struct vfs_s_super *conn;   /* connection of running transfer */
 } ftp_file_handler_t;
 
 /*** file scope variables ************************************************************************/
@@ -438,6 +450,50 @@ ftpfs_get_reply (struct vfs_class *me, int sock, char *string_buf, int string_le
     }
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get reply and keep its data lines: in multi-line replies of FEAT and MLST they start
+ * with a space, which is removed.
+ */
+
+static int
+ftpfs_get_reply_lines (struct vfs_class *me, int sock, GPtrArray * lines)
+{
+    char answer[BUF_1K];
+
+    /* cppcheck-suppress invalidscanf */
+    if (vfs_s_get_line (me, sock, answer, sizeof (answer), '\n') == 0
+        || sscanf (answer, "%d", &code) != 1)
+    {
+        code = 421;
+        return 4;
+    }
+
+    if (answer[3] == '-')
+        while (TRUE)
+        {
+            int i;
+
+            if (vfs_s_get_line (me, sock, answer, sizeof (answer), '\n') == 0)
+            {
+                code = 421;
+                return 4;
+            }
+            /* cppcheck-suppress invalidscanf */
+            if ((sscanf (answer, "%d", &i) > 0) && (code == i) && (answer[3] == ' '))
+                break;
+            if (answer[0] == ' ')
+            {
+                char *line;
+
+                line = g_strdup (answer + 1);
+                g_ptr_array_add (lines, g_strchomp (line));
+            }
+        }
+
+    return code / 100;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static gboolean
@@ -584,6 +640,18 @@ static void
 ftpfs_free_archive (struct vfs_class *me, struct vfs_s_super *super)
 {
     ftp_super_t *ftp_super = FTP_SUPER (super);
+    GList *iter;
+
+    for (iter = ftp_super->pool; iter != NULL; iter = g_list_next (iter))
+    {
+        struct vfs_s_super *conn = VFS_SUPER (iter->data);
+
+        ftpfs_free_archive (me, conn);
+        vfs_path_element_free (conn->path_element);
+        g_free (conn->name);
+        g_free (conn);
+    }
+    g_list_free (ftp_super->pool);
 
     if (ftp_super->sock != -1)
     {
@@ -592,6 +660,7 @@ ftpfs_free_archive (struct vfs_class *me, struct vfs_s_super *super)
         close (ftp_super->sock);
     }
     g_free (ftp_super->current_dir);
+    g_free (ftp_super->mlst_opts);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -608,6 +677,94 @@ ftpfs_changetype (struct vfs_class *me, struct vfs_s_super *super, int binary)
     return binary;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Look for machine-readable listings (RFC 3659) in FEAT reply and ask the server
+ * for the facts we understand.
+ */
+
+static void
+ftpfs_check_features (struct vfs_class *me, struct vfs_s_super *super)
+{
+    static const char *wanted[] = {
+        "type", "size", "modify", "perm", "UNIX.mode", "UNIX.owner", "UNIX.uid", "UNIX.group",
+        "UNIX.gid", NULL
+    };
+
+    ftp_super_t *ftp_super = FTP_SUPER (super);
+    GPtrArray *lines;
+    GString *opts = NULL;
+    guint i;
+
+    /* the server doesn't change between sessions: just restore the facts in the new one */
+    if (ftp_super->features_known)
+    {
+        if (ftp_super->mlst_opts != NULL)
+            ftpfs_command (me, super, WAIT_REPLY, "OPTS MLST %s", ftp_super->mlst_opts);
+        return;
+    }
+
+    ftp_super->use_mlsd = FALSE;
+
+    if (ftpfs_command (me, super, NONE, "%s", "FEAT") != COMPLETE)
+        return;
+
+    ftp_super->features_known = TRUE;
+
+    lines = g_ptr_array_new_with_free_func (g_free);
+
+    if (ftpfs_get_reply_lines (me, ftp_super->sock, lines) == COMPLETE)
+        for (i = 0; i < lines->len; i++)
+        {
+            const char *feat = (const char *) g_ptr_array_index (lines, i);
+            char **facts, **f;
+
+            if (g_ascii_strncasecmp (feat, "MLST", 4) != 0 || (feat[4] != ' ' && feat[4] != '\0'))
+                continue;
+
+            ftp_super->use_mlsd = TRUE;
+
+            /* "MLST type*;size*;modify*;UNIX.mode;" -- enabled facts are marked by asterisk */
+            opts = g_string_new ("");
+            facts = g_strsplit (feat + 4, ";", -1);
+            for (f = facts; *f != NULL; f++)
+            {
+                const char **w;
+                char *fact;
+
+                fact = g_strstrip (*f);
+                if (*fact != '\0' && fact[strlen (fact) - 1] == '*')
+                    fact[strlen (fact) - 1] = '\0';
+
+                for (w = wanted; *w != NULL; w++)
+                    if (g_ascii_strcasecmp (fact, *w) == 0)
+                    {
+                        g_string_append_printf (opts, "%s;", fact);
+                        break;
+                    }
+            }
+            g_strfreev (facts);
+        }
+
+    g_ptr_array_free (lines, TRUE);
+
+    if (opts != NULL)
+    {
+        if (opts->len != 0)
+        {
+            ftp_super->mlst_opts = g_strdup (opts->str);
+            ftpfs_command (me, super, WAIT_REPLY, "OPTS MLST %s", opts->str);
+        }
+        g_string_free (opts, TRUE);
+    }
+
+    if (me->logfile != NULL)
+    {
+        fprintf (me->logfile, "MC -- use_mlsd = %s\n", ftp_super->use_mlsd ? "yes" : "no");
+        fflush (me->logfile);
+    }
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /* This routine logs the user in */
 
@@ -713,6 +870,7 @@ ftpfs_login_server (struct vfs_class *me, struct vfs_s_super *super, const char
             vfs_print_message ("%s", _("ftpfs: logged in"));
             wipe_password (pass);
             g_free (name);
+            ftpfs_check_features (me, super);
             return TRUE;
 
         default:
@@ -723,8 +881,10 @@ ftpfs_login_server (struct vfs_class *me, struct vfs_s_super *super, const char
         }
     }
 
-    message (D_ERROR, MSG_ERROR, _("ftpfs: Login incorrect for user %s "),
-             super->path_element->user);
+    /* the server may just limit the number of sessions */
+    if (!ftp_super->pooled)
+        message (D_ERROR, MSG_ERROR, _("ftpfs: Login incorrect for user %s "),
+                 super->path_element->user);
 
   login_fail:
     wipe_password (pass);
@@ -1378,11 +1538,73 @@ ftpfs_initconn (struct vfs_class *me, struct vfs_s_super *super)
     return (-1);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get control connection for a new transfer. FTP allows one transfer per connection,
+ * so if the main connection is busy (e.g. file is being copied from or to the server),
+ * an idle one from the pool is used, or a new one is logged in, up to ftpfs_max_connections.
+ *
+ * @return connection to use; the main one, busy, if no other is available
+ */
+
+static struct vfs_s_super *
+ftpfs_get_connection (struct vfs_class *me, struct vfs_s_super *super)
+{
+    ftp_super_t *ftp_super = FTP_SUPER (super);
+    struct vfs_s_super *conn;
+    ftp_super_t *ftp_conn;
+    GList *iter;
+
+    if (!ftp_super->ctl_connection_busy)
+        return super;
+
+    for (iter = ftp_super->pool; iter != NULL; iter = g_list_next (iter))
+        if (!FTP_SUPER (iter->data)->ctl_connection_busy)
+            return VFS_SUPER (iter->data);
+
+    if (ftp_super->pool_full || (int) g_list_length (ftp_super->pool) + 1 >= ftpfs_max_connections)
+        return super;
+
+    conn = ftpfs_new_archive (me);
+    conn->path_element = vfs_path_element_clone (super->path_element);
+    ftp_conn = FTP_SUPER (conn);
+    ftp_conn->pooled = TRUE;
+    ftp_conn->proxy = ftp_super->proxy;
+    ftp_conn->use_passive_connection = ftp_super->use_passive_connection;
+    ftp_conn->strict = ftp_super->strict;
+    ftp_conn->use_mlsd = ftp_super->use_mlsd;
+    ftp_conn->features_known = ftp_super->features_known;
+    ftp_conn->mlst_opts = g_strdup (ftp_super->mlst_opts);
+
+    vfs_print_message (_("ftpfs: Opening another connection to %s"), super->path_element->host);
+
+    ftp_conn->sock = ftpfs_open_socket (me, conn);
+    if (ftp_conn->sock != -1 && ftpfs_login_server (me, conn, NULL))
+    {
+        ftp_conn->current_dir = ftpfs_get_current_directory (me, conn);
+        if (ftp_conn->current_dir == NULL)
+            ftp_conn->current_dir = g_strdup (PATH_SEP_STR);
+        ftp_super->pool = g_list_append (ftp_super->pool, conn);
+        return conn;
+    }
+
+    /* don't try again: server doesn't allow more sessions */
+    if (ftp_conn->sock != -1)
+        close (ftp_conn->sock);
+    vfs_path_element_free (conn->path_element);
+    g_free (ftp_conn->mlst_opts);
+    g_free (conn->name);
+    g_free (conn);
+    ftp_super->pool_full = TRUE;
+
+    return super;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static int
 ftpfs_open_data_connection (struct vfs_class *me, struct vfs_s_super *super, const char *cmd,
-                            const char *remote, int isbinary, int reget)
+                            const char *remote, int isbinary, off_t reget)
 {
     ftp_super_t *ftp_super = FTP_SUPER (super);
     int s, j, data;
@@ -1403,7 +1625,7 @@ ftpfs_open_data_connection (struct vfs_class *me, struct vfs_s_super *super, con
 
     if (reget > 0)
     {
-        j = ftpfs_command (me, super, WAIT_REPLY, "REST %d", reget);
+        j = ftpfs_command (me, super, WAIT_REPLY, "REST %" PRIuMAX, (uintmax_t) reget);
         if (j != CONTINUE)
         {
             close (s);
@@ -1456,7 +1678,7 @@ ftpfs_open_data_connection (struct vfs_class *me, struct vfs_s_super *super, con
 static void
 ftpfs_linear_abort (struct vfs_class *me, vfs_file_handler_t * fh)
 {
-    struct vfs_s_super *super = VFS_FILE_HANDLER_SUPER (fh);
+    struct vfs_s_super *super = FH_CONN;
     ftp_super_t *ftp_super = FTP_SUPER (super);
     static unsigned char const ipbuf[3] = { IAC, IP, IAC };
     fd_set mask;
@@ -1717,6 +1939,91 @@ resolve_symlink (struct vfs_class *me, struct vfs_s_super *super, struct vfs_s_i
 }
 #endif
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Load directory with MLSD. Sizes are exact, times are in UTC and there is nothing to guess
+ * about the format of lines.
+ *
+ * @return 0 on success, -1 on error, 1 if directory should be listed with LIST
+ */
+
+static int
+ftpfs_dir_load_mlsd (struct vfs_class *me, struct vfs_s_inode *dir, struct vfs_s_super *conn,
+                     const char *remote_path)
+{
+    ftp_super_t *ftp_conn = FTP_SUPER (conn);
+    int sock;
+
+    vfs_print_message (_("ftpfs: Reading FTP directory %s... %s"), remote_path, "(MLSD)");
+
+    gettimeofday (&dir->timestamp, NULL);
+    dir->timestamp.tv_sec += ftpfs_directory_timeout;
+
+    sock = ftpfs_open_data_connection (me, conn, "MLSD", remote_path, TYPE_ASCII, 0);
+    if (sock == -1)
+    {
+        if (code == 550)
+        {
+            vfs_print_message (_("%s: failure"), me->name);
+            ERRNOR (ENOENT, -1);
+        }
+
+        /* command is not accepted after all, don't try it again */
+        if (code == 500 || code == 502 || code == 504)
+            FTP_SUPER (dir->super)->use_mlsd = FALSE;
+        return 1;
+    }
+
+    while (TRUE)
+    {
+        struct vfs_s_entry *ent;
+        int i, res;
+        char lc_buffer[BUF_8K] = "\0";
+
+        res = vfs_s_get_line_interruptible (me, lc_buffer, sizeof (lc_buffer), sock);
+        if (res == 0)
+            break;
+
+        if (res == EINTR)
+        {
+            me->verrno = ECONNRESET;
+            close (sock);
+            ftp_conn->ctl_connection_busy = FALSE;
+            ftpfs_get_reply (me, ftp_conn->sock, NULL, 0);
+            vfs_print_message (_("%s: failure"), me->name);
+            return (-1);
+        }
+
+        if (me->logfile != NULL)
+        {
+            fputs (lc_buffer, me->logfile);
+            fputs ("\n", me->logfile);
+            fflush (me->logfile);
+        }
+
+        ent = vfs_s_generate_entry (me, NULL, dir, 0);
+        i = ent->ino->st.st_nlink;
+
+        if (!vfs_parse_mlsx (lc_buffer, &ent->ino->st, &ent->name, &ent->ino->linkname)
+            || strchr (ent->name, PATH_SEP) != NULL || DIR_IS_DOT (ent->name)
+            || DIR_IS_DOTDOT (ent->name))
+            vfs_s_free_entry (me, ent);
+        else
+        {
+            ent->ino->st.st_nlink = i;  /* Ouch, we need to preserve our counts :-( */
+            vfs_s_insert_entry (me, dir, ent);
+        }
+    }
+
+    close (sock);
+    ftp_conn->ctl_connection_busy = FALSE;
+    if (ftpfs_get_reply (me, ftp_conn->sock, NULL, 0) != COMPLETE)
+        ERRNOR (E_REMOTE, -1);
+
+    vfs_print_message (_("%s: done."), me->name);
+    return 0;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static int
@@ -1725,9 +2032,24 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
     struct vfs_s_entry *ent;
     struct vfs_s_super *super = dir->super;
     ftp_super_t *ftp_super = FTP_SUPER (super);
+    struct vfs_s_super *conn;
+    ftp_super_t *ftp_conn;
     int sock, num_entries = 0;
     gboolean cd_first;
 
+    /* list directory while file is being transferred */
+    conn = ftpfs_get_connection (me, super);
+    ftp_conn = FTP_SUPER (conn);
+
+    if (ftp_super->use_mlsd)
+    {
+        int res;
+
+        res = ftpfs_dir_load_mlsd (me, dir, conn, remote_path);
+        if (res != 1)
+            return res;
+    }
+
     cd_first = ftpfs_first_cd_then_ls || (ftp_super->strict == RFC_STRICT)
         || (strchr (remote_path, ' ') != NULL);
 
@@ -1737,7 +2059,7 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
                        ftp_super->strict ==
                        RFC_STRICT ? _("(strict rfc959)") : "", cd_first ? _("(chdir first)") : "");
 
-    if (cd_first && ftpfs_chdir_internal (me, super, remote_path) != COMPLETE)
+    if (cd_first && ftpfs_chdir_internal (me, conn, remote_path) != COMPLETE)
     {
         ftpfs_errno = ENOENT;
         vfs_print_message ("%s", _("ftpfs: CWD failed."));
@@ -1748,18 +2070,18 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
     dir->timestamp.tv_sec += ftpfs_directory_timeout;
 
     if (ftp_super->strict == RFC_STRICT)
-        sock = ftpfs_open_data_connection (me, super, "LIST", 0, TYPE_ASCII, 0);
+        sock = ftpfs_open_data_connection (me, conn, "LIST", 0, TYPE_ASCII, 0);
     else if (cd_first)
         /* Dirty hack to avoid autoprepending / to . */
         /* Wu-ftpd produces strange output for '/' if 'LIST -la .' used */
-        sock = ftpfs_open_data_connection (me, super, "LIST -la", 0, TYPE_ASCII, 0);
+        sock = ftpfs_open_data_connection (me, conn, "LIST -la", 0, TYPE_ASCII, 0);
     else
     {
         char *path;
 
         /* Trailing "/." is necessary if remote_path is a symlink */
         path = mc_build_filename (remote_path, ".", (char *) NULL);
-        sock = ftpfs_open_data_connection (me, super, "LIST -la", path, TYPE_ASCII, 0);
+        sock = ftpfs_open_data_connection (me, conn, "LIST -la", path, TYPE_ASCII, 0);
         g_free (path);
     }
 
@@ -1798,8 +2120,8 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
         {
             me->verrno = ECONNRESET;
             close (sock);
-            ftp_super->ctl_connection_busy = FALSE;
-            ftpfs_get_reply (me, ftp_super->sock, NULL, 0);
+            ftp_conn->ctl_connection_busy = FALSE;
+            ftpfs_get_reply (me, ftp_conn->sock, NULL, 0);
             vfs_print_message (_("%s: failure"), me->name);
             return (-1);
         }
@@ -1827,9 +2149,9 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
     }
 
     close (sock);
-    ftp_super->ctl_connection_busy = FALSE;
+    ftp_conn->ctl_connection_busy = FALSE;
     me->verrno = E_REMOTE;
-    if ((ftpfs_get_reply (me, ftp_super->sock, NULL, 0) != COMPLETE))
+    if ((ftpfs_get_reply (me, ftp_conn->sock, NULL, 0) != COMPLETE))
         goto fallback;
 
     if (num_entries == 0 && !cd_first)
@@ -1858,12 +2180,186 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Load directory with all subdirectories with LIST -R. Listing of each subdirectory starts
+ * with "<relative path>:" line after an empty line. If the server ignores -R, the tree is
+ * not asked for again.
+ *
+ * The server may cut the listing short, e.g. at its limit of files or depth, without telling.
+ * So a directory is complete only if another listing follows it, and the last one only if no
+ * subdirectory is missing. Directories which are not complete are listed on their own later.
+ */
 
 static int
-ftpfs_file_store (struct vfs_class *me, vfs_file_handler_t * fh, char *name, char *localname)
+ftpfs_dir_load_tree (struct vfs_class *me, struct vfs_s_super *super, const char *path)
 {
-    struct vfs_s_super *super = VFS_FILE_HANDLER_SUPER (fh);
     ftp_super_t *ftp_super = FTP_SUPER (super);
+    struct vfs_s_super *conn;
+    ftp_super_t *ftp_conn;
+    vfs_s_tree_t *tree;
+    struct vfs_s_inode *dir;
+    char *block;                /* relative path of directory being listed */
+    gboolean header = TRUE;     /* line can start listing of subdirectory */
+    int num_subdirs = 0;        /* subdirectories found in listings */
+    int num_headers = 0;        /* listings of subdirectories */
+    int sock, num_entries = 0;
+
+    if (ftp_super->no_tree || ftp_super->strict == RFC_STRICT)
+        return (-1);
+
+    conn = ftpfs_get_connection (me, super);
+    ftp_conn = FTP_SUPER (conn);
+
+    vfs_print_message (_("ftpfs: Reading FTP directory tree %s..."), path);
+
+    if (ftpfs_chdir_internal (me, conn, path) != COMPLETE)
+        ERRNOR (ENOENT, -1);
+
+    sock = ftpfs_open_data_connection (me, conn, "LIST -laR", 0, TYPE_ASCII, 0);
+    if (sock == -1)
+    {
+        ftp_super->no_tree = TRUE;
+        ERRNOR (EACCES, -1);
+    }
+
+    tree = vfs_s_tree_new (me, super);
+    dir = vfs_s_tree_dir (tree, "", FALSE);
+    block = g_strdup ("");
+    vfs_parse_ls_lga_init ();
+
+    while (TRUE)
+    {
+        struct vfs_s_entry *ent;
+        size_t count_spaces = 0;
+        size_t len;
+        int i, res;
+        char lc_buffer[BUF_8K] = "\0";
+
+        res = vfs_s_get_line_interruptible (me, lc_buffer, sizeof (lc_buffer), sock);
+        if (res == 0)
+            break;
+
+        if (res == EINTR)
+        {
+            me->verrno = ECONNRESET;
+            close (sock);
+            ftp_conn->ctl_connection_busy = FALSE;
+            ftpfs_get_reply (me, ftp_conn->sock, NULL, 0);
+            g_free (block);
+            vfs_s_tree_free (tree);
+            vfs_print_message (_("%s: failure"), me->name);
+            return (-1);
+        }
+
+        if (me->logfile != NULL)
+        {
+            fputs (lc_buffer, me->logfile);
+            fputs ("\n", me->logfile);
+            fflush (me->logfile);
+        }
+
+        len = strlen (lc_buffer);
+        if (len == 0)
+        {
+            header = TRUE;
+            continue;
+        }
+
+        if (header && lc_buffer[len - 1] == ':')
+        {
+            char *relpath = lc_buffer;
+
+            if (dir != NULL)
+                vfs_s_normalize_filename_leading_spaces (dir,
+                                                         vfs_parse_ls_lga_get_final_spaces ());
+            vfs_parse_ls_lga_init ();
+
+            lc_buffer[len - 1] = '\0';
+            if (strcmp (relpath, ".") == 0)
+                relpath += 1;
+            else if (strncmp (relpath, "./", 2) == 0)
+                relpath += 2;
+
+            /* listing of the previous directory is over */
+            if (block != NULL && strcmp (block, relpath) != 0)
+                vfs_s_tree_dir (tree, block, TRUE);
+            MC_PTR_FREE (block);
+
+            /* absolute paths are not expected, skip such listing */
+            if (IS_PATH_SEP (*relpath))
+                dir = NULL;
+            else
+            {
+                dir = vfs_s_tree_dir (tree, relpath, FALSE);
+                block = g_strdup (relpath);
+                if (*relpath != '\0')
+                    num_headers++;
+            }
+
+            header = FALSE;
+            continue;
+        }
+
+        header = FALSE;
+        if (dir == NULL)
+            continue;
+
+        ent = vfs_s_generate_entry (me, NULL, dir, 0);
+        i = ent->ino->st.st_nlink;
+
+        if (!vfs_parse_ls_lga
+            (lc_buffer, &ent->ino->st, &ent->name, &ent->ino->linkname, &count_spaces))
+            vfs_s_free_entry (me, ent);
+        else
+        {
+            ent->ino->st.st_nlink = i;  /* Ouch, we need to preserve our counts :-( */
+            num_entries++;
+            if (S_ISDIR (ent->ino->st.st_mode) && !DIR_IS_DOT (ent->name)
+                && !DIR_IS_DOTDOT (ent->name))
+                num_subdirs++;
+            vfs_s_store_filename_leading_spaces (ent, count_spaces);
+            vfs_s_insert_entry (me, dir, ent);
+        }
+    }
+
+    if (dir != NULL)
+        vfs_s_normalize_filename_leading_spaces (dir, vfs_parse_ls_lga_get_final_spaces ());
+
+    /* the last listing may be cut short if some subdirectories are missing */
+    if (block != NULL && num_headers >= num_subdirs)
+        vfs_s_tree_dir (tree, block, TRUE);
+    g_free (block);
+
+    close (sock);
+    ftp_conn->ctl_connection_busy = FALSE;
+    if (ftpfs_get_reply (me, ftp_conn->sock, NULL, 0) != COMPLETE)
+    {
+        vfs_s_tree_free (tree);
+        ERRNOR (E_REMOTE, -1);
+    }
+
+    /* -R was ignored or taken as name of file */
+    if (num_entries == 0 || (num_subdirs != 0 && num_headers == 0))
+    {
+        ftp_super->no_tree = TRUE;
+        vfs_s_tree_free (tree);
+        ERRNOR (E_REMOTE, -1);
+    }
+
+    vfs_s_tree_store (tree, path, ftpfs_directory_timeout);
+    vfs_s_tree_free (tree);
+
+    vfs_print_message (_("%s: done."), me->name);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+ftpfs_file_store (struct vfs_class *me, vfs_file_handler_t * fh, char *name, char *localname)
+{
+    struct vfs_s_super *super;
+    ftp_super_t *ftp_super;
     ftp_file_handler_t *ftp = FTP_FILE_HANDLER (fh);
 
     int h, sock;
@@ -1887,6 +2383,9 @@ ftpfs_file_store (struct vfs_class *me, vfs_file_handler_t * fh, char *name, cha
         return (-1);
     }
 
+    super = ftpfs_get_connection (me, VFS_FILE_HANDLER_SUPER (fh));
+    ftp_super = FTP_SUPER (super);
+
     sock =
         ftpfs_open_data_connection (me, super, ftp->append ? "APPE" : "STOR", name, TYPE_BINARY, 0);
     if (sock < 0)
@@ -1975,9 +2474,8 @@ ftpfs_linear_start (struct vfs_class *me, vfs_file_handler_t * fh, off_t offset)
     if (name == NULL)
         return 0;
 
-    FH_SOCK =
-        ftpfs_open_data_connection (me, VFS_FILE_HANDLER_SUPER (fh), "RETR", name, TYPE_BINARY,
-                                    offset);
+    FH_CONN = ftpfs_get_connection (me, VFS_FILE_HANDLER_SUPER (fh));
+    FH_SOCK = ftpfs_open_data_connection (me, FH_CONN, "RETR", name, TYPE_BINARY, offset);
     g_free (name);
     if (FH_SOCK == -1)
         ERRNOR (EACCES, 0);
@@ -1993,7 +2491,7 @@ static ssize_t
 ftpfs_linear_read (struct vfs_class *me, vfs_file_handler_t * fh, void *buf, size_t len)
 {
     ssize_t n;
-    struct vfs_s_super *super = VFS_FILE_HANDLER_SUPER (fh);
+    struct vfs_s_super *super = FH_CONN;
 
     while ((n = read (FH_SOCK, buf, len)) < 0)
     {
@@ -2026,6 +2524,62 @@ ftpfs_linear_close (struct vfs_class *me, vfs_file_handler_t * fh)
         ftpfs_linear_abort (me, fh);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read part of remote file: start RETR at offset and abort it once enough data is received.
+ */
+
+static ssize_t
+ftpfs_read_range (struct vfs_class *me, vfs_file_handler_t * fh, off_t offset, char *buf,
+                  size_t len)
+{
+    struct vfs_s_super *super;
+    char *name;
+    size_t got = 0;
+    ssize_t n = 0;
+
+    name = vfs_s_fullpath (me, fh->ino);
+    if (name == NULL)
+        return (-1);
+
+    super = ftpfs_get_connection (me, VFS_FILE_HANDLER_SUPER (fh));
+    FH_CONN = super;
+    FH_SOCK = ftpfs_open_data_connection (me, super, "RETR", name, TYPE_BINARY, offset);
+    g_free (name);
+    if (FH_SOCK == -1)
+        ERRNOR (EACCES, -1);
+
+    while (got < len)
+    {
+        n = read (FH_SOCK, buf + got, len - got);
+        if (n < 0)
+        {
+            if (errno == EINTR && !tty_got_interrupt ())
+                continue;
+            ftpfs_errno = errno;
+            ftpfs_linear_abort (me, fh);
+            ERRNOR (ftpfs_errno, -1);
+        }
+        if (n == 0)
+            break;
+        got += n;
+    }
+
+    if (n != 0)
+        ftpfs_linear_abort (me, fh);
+    else
+    {
+        /* end of file */
+        FTP_SUPER (super)->ctl_connection_busy = FALSE;
+        close (FH_SOCK);
+        FH_SOCK = -1;
+        if (ftpfs_get_reply (me, FTP_SUPER (super)->sock, NULL, 0) != COMPLETE)
+            ERRNOR (E_REMOTE, -1);
+    }
+
+    return (ssize_t) got;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static int
@@ -2089,12 +2643,100 @@ ftpfs_send_command (const vfs_path_t * vpath, const char *cmd, int flags)
 
 /* --------------------------------------------------------------------------------------------- */
 
+/**
+ * Stat single file with MLST instead of loading whole parent directory.
+ * If the parent directory is cached already, the cache is used.
+ *
+ * @return 0 on success, -1 on error, 1 if the directory listing should be used
+ */
+
+static int
+ftpfs_stat_mlst (const vfs_path_t * vpath, struct stat *buf)
+{
+    const vfs_path_element_t *path_element;
+    struct vfs_class *me;
+    struct vfs_s_super *super, *conn;
+    const char *rpath;
+    char *path, *dirname, *p;
+    char *name = NULL;
+    GList *iter;
+    GPtrArray *lines;
+    int ret = 1;
+
+    path_element = vfs_path_get_by_index (vpath, -1);
+    me = path_element->class;
+
+    rpath = vfs_s_get_path (vpath, &super, 0);
+    if (rpath == NULL)
+        return (-1);
+    if (!FTP_SUPER (super)->use_mlsd || *rpath == '\0')
+        return 1;
+
+    /* canonicalize the way vfs_s_find_entry_linear() does to look up cached directory */
+    path = g_strdup (rpath);
+    custom_canonicalize_pathname (path, CANON_PATH_ALL & (~CANON_PATH_REMDOUBLEDOTS));
+    dirname = g_path_get_dirname (path);
+    iter = g_queue_find_custom (super->root->subdir, dirname, (GCompareFunc) vfs_s_entry_compare);
+    g_free (dirname);
+    if (iter != NULL && VFS_SUBCLASS (me)->dir_uptodate (me, VFS_ENTRY (iter->data)->ino))
+        goto done;
+
+    conn = ftpfs_get_connection (me, super);
+    if (FTP_SUPER (conn)->ctl_connection_busy)
+        goto done;
+
+    p = ftpfs_translate_path (me, conn, path);
+    ret = ftpfs_command (me, conn, NONE, "MLST /%s", IS_PATH_SEP (*p) ? p + 1 : p);
+    g_free (p);
+    vfs_stamp_create (vfs_ftpfs_ops, super);
+
+    if (ret != COMPLETE)
+    {
+        ret = 1;
+        goto done;
+    }
+
+    lines = g_ptr_array_new_with_free_func (g_free);
+    ret = ftpfs_get_reply_lines (me, FTP_SUPER (conn)->sock, lines);
+    if (ret == COMPLETE && lines->len != 0)
+    {
+        *buf = *vfs_s_default_stat (me, S_IFREG | 0644);
+        /* symlink means server doesn't follow it, the listing does */
+        if (vfs_parse_mlsx (g_ptr_array_index (lines, 0), buf, &name, NULL)
+            && !S_ISLNK (buf->st_mode))
+        {
+            buf->st_ino = VFS_SUBCLASS (me)->inode_counter++;
+            buf->st_dev = VFS_SUBCLASS (me)->rdev;
+            ret = 0;
+        }
+        else
+            ret = 1;
+        g_free (name);
+    }
+    else if (code == 550)
+    {
+        me->verrno = ENOENT;
+        ret = -1;
+    }
+    else
+        ret = 1;
+    g_ptr_array_free (lines, TRUE);
+
+  done:
+    g_free (path);
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static int
 ftpfs_stat (const vfs_path_t * vpath, struct stat *buf)
 {
     int ret;
 
-    ret = vfs_s_stat (vpath, buf);
+    ret = ftpfs_stat_mlst (vpath, buf);
+    if (ret == 1)
+        ret = vfs_s_stat (vpath, buf);
     ftpfs_set_blksize (buf);
     return ret;
 }
@@ -2242,6 +2884,7 @@ ftpfs_fh_new (struct vfs_s_inode *ino, gboolean changed)
     fh = g_new0 (ftp_file_handler_t, 1);
     vfs_s_init_fh (VFS_FILE_HANDLER (fh), ino, changed);
     fh->sock = -1;
+    fh->conn = ino->super;
 
     return VFS_FILE_HANDLER (fh);
 }
@@ -2269,7 +2912,8 @@ ftpfs_fh_open (struct vfs_class *me, vfs_file_handler_t * fh, int flags, mode_t
          * to local temporary file and stored to ftp server
          * by vfs_s_close later
          */
-        if (FTP_SUPER (VFS_FILE_HANDLER_SUPER (fh))->ctl_connection_busy)
+        FH_CONN = ftpfs_get_connection (me, VFS_FILE_HANDLER_SUPER (fh));
+        if (FTP_SUPER (FH_CONN)->ctl_connection_busy)
         {
             if (fh->ino->localname == NULL)
             {
@@ -2294,9 +2938,8 @@ ftpfs_fh_open (struct vfs_class *me, vfs_file_handler_t * fh, int flags, mode_t
             return (-1);
 
         fh->handle =
-            ftpfs_open_data_connection (me, VFS_FILE_HANDLER_SUPER (fh),
-                                        (flags & O_APPEND) != 0 ? "APPE" : "STOR", name,
-                                        TYPE_BINARY, 0);
+            ftpfs_open_data_connection (me, FH_CONN, (flags & O_APPEND) != 0 ? "APPE" : "STOR",
+                                        name, TYPE_BINARY, 0);
         g_free (name);
 
         if (fh->handle < 0)
@@ -2331,7 +2974,7 @@ ftpfs_fh_close (struct vfs_class *me, vfs_file_handler_t * fh)
 {
     if (fh->handle != -1 && fh->ino->localname == NULL)
     {
-        ftp_super_t *ftp = FTP_SUPER (VFS_FILE_HANDLER_SUPER (fh));
+        ftp_super_t *ftp = FTP_SUPER (FH_CONN);
 
         close (fh->handle);
         fh->handle = -1;
@@ -2718,10 +3361,12 @@ vfs_init_ftpfs (void)
     ftpfs_subclass.fh_open = ftpfs_fh_open;
     ftpfs_subclass.fh_close = ftpfs_fh_close;
     ftpfs_subclass.dir_load = ftpfs_dir_load;
+    ftpfs_subclass.dir_load_tree = ftpfs_dir_load_tree;
     ftpfs_subclass.file_store = ftpfs_file_store;
     ftpfs_subclass.linear_start = ftpfs_linear_start;
     ftpfs_subclass.linear_read = ftpfs_linear_read;
     ftpfs_subclass.linear_close = ftpfs_linear_close;
+    ftpfs_subclass.read_range = ftpfs_read_range;
     vfs_register_class (vfs_ftpfs_ops);
 }
 
@@ -28,6 +28,7 @@ extern gboolean ftpfs_always_use_proxy;
 extern gboolean ftpfs_ignore_chattr_errors;
 
 extern int ftpfs_retry_seconds;
+extern int ftpfs_max_connections;
 extern gboolean ftpfs_use_passive_connections;
 extern gboolean ftpfs_use_passive_connections_over_proxy;
 extern gboolean ftpfs_use_unix_list_options;
@@ -0,0 +1,1102 @@
+/*
+   Virtual File System: ISO9660 file system.
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * \brief Source: Virtual File System: ISO9660 file system
+ *
+ * The directory tree is read from the image directly: only the volume
+ * descriptors and the directory extents are touched when the image is
+ * opened, and member data is read from its extents on demand. Rock Ridge
+ * names, attributes, symlinks and relocated directories are used if the
+ * image has them, otherwise Joliet names are preferred over the primary
+ * volume ones. Multi-extent files (larger than 4 GiB) are supported.
+ *
+ * The class uses "iso" prefix and is read-only. The iso9660:// paths are
+ * left to the extfs helper, which can also write images with xorriso.
+ *
+ * Namespace: init_iso9660fs
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib/global.h"
+#include "lib/unixcompat.h"     /* makedev() */
+#include "lib/util.h"
+#include "lib/widget.h"         /* message() */
+
+#include "lib/vfs/vfs.h"
+#include "lib/vfs/utilvfs.h"
+#include "lib/vfs/xdirentry.h"
+#include "lib/vfs/gc.h"         /* vfs_rmstamp */
+
+#include "iso9660.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define ISO_SUPER(super) ((iso_super_t *) (super))
+
+#define ISO_SECTOR_SIZE 2048
+#define ISO_VD_FIRST 16         /* sector of the first volume descriptor */
+#define ISO_VD_MAX 32           /* don't look for the terminator forever */
+#define ISO_VD_PRIMARY 1
+#define ISO_VD_SUPPLEMENTARY 2
+#define ISO_VD_TERMINATOR 255
+#define ISO_VD_BLOCK_SIZE 128   /* offset of logical block size in volume descriptor */
+#define ISO_VD_ESCAPES 88       /* offset of escape sequences in volume descriptor */
+#define ISO_VD_ROOT 156         /* offset of root directory record in volume descriptor */
+
+#define ISO_DIRREC_SIZE 33      /* size of directory record without name */
+
+#define ISO_FLAG_DIRECTORY 0x02
+#define ISO_FLAG_ASSOCIATED 0x04
+#define ISO_FLAG_MULTI_EXTENT 0x80
+
+#define ISO_XA_SIZE 14          /* CD-ROM XA data preceding System Use entries */
+#define ISO_CE_MAX 16           /* limit of continuation areas of one record */
+
+#define ISO_NM_CONTINUE 0x01
+#define ISO_NM_CURRENT 0x02
+#define ISO_NM_PARENT 0x04
+
+#define ISO_SL_CONTINUE 0x01
+#define ISO_SL_CURRENT 0x02
+#define ISO_SL_PARENT 0x04
+#define ISO_SL_ROOT 0x08
+
+#define ISO_TF_MODIFY 1
+#define ISO_TF_ACCESS 2
+#define ISO_TF_ATTRIBUTES 3
+#define ISO_TF_LONG_FORM 0x80
+
+#define ISO_SIG(p, s) ((p)[0] == (s)[0] && (p)[1] == (s)[1])
+
+/*** file scope type declarations ****************************************************************/
+
+typedef struct
+{
+    struct vfs_s_super base;    /* base class */
+
+    int fd;
+    struct stat st;
+    guint32 block_size;
+    gboolean rock_ridge;
+    size_t susp_offset;         /* bytes to skip at the beginning of System Use areas */
+    gboolean joliet;
+    GHashTable *extents;        /* inode -> GArray of iso_extent_t for multi-extent files */
+    GHashTable *dirs;           /* directory extents already read, to break loops */
+} iso_super_t;
+
+/* Decoded directory record */
+typedef struct
+{
+    size_t length;              /* length of the whole record */
+    guint8 ext_attr_len;
+    guint32 extent;
+    guint32 size;
+    time_t mtime;               /* -1 if not recorded */
+    guint8 flags;
+    const guint8 *name;
+    size_t name_len;
+    const guint8 *sua;          /* System Use area */
+    size_t sua_len;
+} iso_dirrec_t;
+
+/* Rock Ridge attributes of directory record */
+typedef struct
+{
+    gboolean have_px;
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
+    gboolean have_pn;
+    dev_t rdev;
+    time_t mtime;
+    time_t atime;
+    time_t ctime;
+    GString *name;
+    GString *link;
+    gboolean link_sep;          /* next symlink component needs a separator */
+    guint32 child;              /* extent of relocated directory, 0 if none */
+    gboolean relocated;
+} iso_rr_t;
+
+typedef struct
+{
+    off_t offset;
+    off_t size;
+} iso_extent_t;
+
+/*** file scope variables ************************************************************************/
+
+static struct vfs_s_subclass iso9660fs_subclass;
+static struct vfs_class *vfs_iso9660fs_ops = VFS_CLASS (&iso9660fs_subclass);
+
+/* --------------------------------------------------------------------------------------------- */
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+static inline guint16
+iso_get16 (const guint8 * p)
+{
+    return (guint16) (p[0] | (p[1] << 8));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get 32-bit value. ISO9660 stores numbers in both byte orders, the little-endian copy
+ * goes first.
+ */
+
+static inline guint32
+iso_get32 (const guint8 * p)
+{
+    return (guint32) p[0] | ((guint32) p[1] << 8) | ((guint32) p[2] << 16) | ((guint32) p[3] << 24);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read exactly @len bytes at @offset of the image.
+ *
+ * @return TRUE on success
+ */
+
+static gboolean
+iso_pread (struct vfs_s_super *archive, off_t offset, void *buf, size_t len)
+{
+    int fd = ISO_SUPER (archive)->fd;
+    char *p = (char *) buf;
+
+    if (mc_lseek (fd, offset, SEEK_SET) != offset)
+        return FALSE;
+
+    while (len != 0)
+    {
+        ssize_t n;
+
+        n = mc_read (fd, p, len);
+        if (n <= 0)
+            return FALSE;
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Convert broken-down time with GMT offset in 15 minute intervals to time_t.
+ *
+ * @return time or -1 if date isn't recorded
+ */
+
+static time_t
+iso_make_time (int year, int mon, int mday, int hour, int min, int sec, int gmtoff)
+{
+    gint64 y, era, yoe, doy, doe, days;
+
+    if (mon < 1 || mon > 12 || mday < 1 || mday > 31)
+        return -1;
+
+    /* days since 1970-01-01 in proleptic Gregorian calendar */
+    y = year - (mon <= 2 ? 1 : 0);
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + mday - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    days = era * 146097 + doe - 719468;
+
+    return (time_t) (days * 86400 + hour * 3600 + min * 60 + sec - gmtoff * 15 * 60);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Decode 7-byte date of directory record.
+ */
+
+static time_t
+iso_short_time (const guint8 * p)
+{
+    return iso_make_time (1900 + p[0], p[1], p[2], p[3], p[4], p[5], (signed char) p[6]);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Decode 17-byte date of volume descriptor format ("YYYYMMDDHHMMSScc" and GMT offset).
+ */
+
+static time_t
+iso_long_time (const guint8 * p)
+{
+    int v[6];
+    size_t i, j;
+    const size_t width[6] = { 4, 2, 2, 2, 2, 2 };
+
+    for (i = 0; i < 6; i++)
+    {
+        v[i] = 0;
+        for (j = 0; j < width[i]; j++, p++)
+        {
+            if (*p < '0' || *p > '9')
+                return -1;
+            v[i] = v[i] * 10 + (*p - '0');
+        }
+    }
+
+    /* skip hundredths of second */
+    p += 2;
+
+    return iso_make_time (v[0], v[1], v[2], v[3], v[4], v[5], (signed char) *p);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Decode directory record.
+ *
+ * @param p pointer to the record
+ * @param avail number of bytes available at @p
+ * @param rec decoded record
+ *
+ * @return TRUE if record is valid and fits in @avail bytes
+ */
+
+static gboolean
+iso_parse_dirrec (const guint8 * p, size_t avail, iso_dirrec_t * rec)
+{
+    size_t len = p[0];
+    size_t sua;
+
+    if (len < ISO_DIRREC_SIZE + 1 || len > avail || ISO_DIRREC_SIZE + (size_t) p[32] > len)
+        return FALSE;
+
+    rec->length = len;
+    rec->ext_attr_len = p[1];
+    rec->extent = iso_get32 (p + 2);
+    rec->size = iso_get32 (p + 10);
+    rec->mtime = iso_short_time (p + 18);
+    rec->flags = p[25];
+    rec->name_len = p[32];
+    rec->name = p + ISO_DIRREC_SIZE;
+
+    /* System Use area follows the name padded to even length */
+    sua = ISO_DIRREC_SIZE + rec->name_len + (rec->name_len % 2 == 0 ? 1 : 0);
+    rec->sua = p + sua;
+    rec->sua_len = sua < len ? len - sua : 0;
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+iso_dirrec_is_dot (const iso_dirrec_t * rec)
+{
+    return rec->name_len == 1 && (rec->name[0] == '\0' || rec->name[0] == '\1');
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read the first ("." ) record of directory at @extent.
+ *
+ * @param buf buffer of ISO_SECTOR_SIZE bytes the record will point to
+ */
+
+static gboolean
+iso_read_dot (struct vfs_s_super *archive, guint32 extent, guint8 * buf, iso_dirrec_t * rec)
+{
+    off_t offset = (off_t) extent * ISO_SUPER (archive)->block_size;
+
+    return offset + ISO_SECTOR_SIZE <= ISO_SUPER (archive)->st.st_size
+        && iso_pread (archive, offset, buf, ISO_SECTOR_SIZE)
+        && iso_parse_dirrec (buf, ISO_SECTOR_SIZE, rec) && iso_dirrec_is_dot (rec);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+iso_rr_init (iso_rr_t * rr)
+{
+    memset (rr, 0, sizeof (*rr));
+    rr->mtime = -1;
+    rr->atime = -1;
+    rr->ctime = -1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+iso_rr_free (iso_rr_t * rr)
+{
+    if (rr->name != NULL)
+        g_string_free (rr->name, TRUE);
+    if (rr->link != NULL)
+        g_string_free (rr->link, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+iso_rr_symlink (iso_rr_t * rr, const guint8 * p, const guint8 * end)
+{
+    if (rr->link == NULL)
+        rr->link = g_string_sized_new (32);
+
+    while (p + 2 <= end && p + 2 + p[1] <= end)
+    {
+        guint8 flags = p[0];
+
+        if (rr->link_sep)
+            g_string_append_c (rr->link, PATH_SEP);
+
+        if ((flags & ISO_SL_CURRENT) != 0)
+            g_string_append_c (rr->link, '.');
+        else if ((flags & ISO_SL_PARENT) != 0)
+            g_string_append (rr->link, "..");
+        else if ((flags & ISO_SL_ROOT) != 0)
+            g_string_append_c (rr->link, PATH_SEP);
+        else
+            g_string_append_len (rr->link, (const char *) p + 2, p[1]);
+
+        /* component may be continued in the next one */
+        rr->link_sep = (flags & (ISO_SL_CONTINUE | ISO_SL_ROOT)) == 0;
+
+        p += 2 + p[1];
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+iso_rr_times (iso_rr_t * rr, const guint8 * p, const guint8 * end)
+{
+    guint8 flags = p[4];
+    size_t step = (flags & ISO_TF_LONG_FORM) != 0 ? 17 : 7;
+    int bit;
+
+    p += 5;
+
+    for (bit = 0; bit < 7 && p + step <= end; bit++)
+    {
+        time_t t;
+
+        if ((flags & (1 << bit)) == 0)
+            continue;
+
+        t = step == 17 ? iso_long_time (p) : iso_short_time (p);
+        p += step;
+
+        switch (bit)
+        {
+        case ISO_TF_MODIFY:
+            rr->mtime = t;
+            break;
+        case ISO_TF_ACCESS:
+            rr->atime = t;
+            break;
+        case ISO_TF_ATTRIBUTES:
+            rr->ctime = t;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Collect Rock Ridge attributes from System Use Sharing Protocol entries of directory record,
+ * following continuation areas.
+ */
+
+static void
+iso_parse_susp (struct vfs_s_super *archive, const iso_dirrec_t * rec, iso_rr_t * rr)
+{
+    iso_super_t *arch = ISO_SUPER (archive);
+    const guint8 *area;
+    size_t area_len;
+    guint8 *ce_buf = NULL;
+    int ce_count = 0;
+    gboolean stop = FALSE;
+
+    if (rec->sua_len <= arch->susp_offset)
+        return;
+
+    area = rec->sua + arch->susp_offset;
+    area_len = rec->sua_len - arch->susp_offset;
+
+    while (!stop)
+    {
+        const guint8 *p = area, *end = area + area_len;
+        off_t ce_offset = -1;
+        size_t ce_len = 0;
+
+        while (!stop && p + 4 <= end)
+        {
+            size_t len = p[2];
+            const guint8 *next = p + len;
+
+            if (len < 4 || next > end)
+                break;
+
+            if (ISO_SIG (p, "PX") && len >= 36)
+            {
+                rr->have_px = TRUE;
+                rr->mode = (mode_t) iso_get32 (p + 4);
+                rr->uid = (uid_t) iso_get32 (p + 20);
+                rr->gid = (gid_t) iso_get32 (p + 28);
+            }
+            else if (ISO_SIG (p, "PN") && len >= 20)
+            {
+                rr->have_pn = TRUE;
+                rr->rdev = makedev (iso_get32 (p + 4), iso_get32 (p + 12));
+            }
+            else if (ISO_SIG (p, "NM") && len >= 5)
+            {
+                if ((p[4] & (ISO_NM_CURRENT | ISO_NM_PARENT)) == 0)
+                {
+                    if (rr->name == NULL)
+                        rr->name = g_string_sized_new (len);
+                    g_string_append_len (rr->name, (const char *) p + 5, len - 5);
+                }
+            }
+            else if (ISO_SIG (p, "SL") && len >= 5)
+                iso_rr_symlink (rr, p + 5, next);
+            else if (ISO_SIG (p, "TF") && len >= 5)
+                iso_rr_times (rr, p, next);
+            else if (ISO_SIG (p, "CL") && len >= 12)
+                rr->child = iso_get32 (p + 4);
+            else if (ISO_SIG (p, "RE"))
+                rr->relocated = TRUE;
+            else if (ISO_SIG (p, "CE") && len >= 28)
+            {
+                ce_offset = (off_t) iso_get32 (p + 4) * arch->block_size + iso_get32 (p + 12);
+                ce_len = iso_get32 (p + 20);
+            }
+            else if (ISO_SIG (p, "ST"))
+                stop = TRUE;
+
+            p = next;
+        }
+
+        if (stop || ce_offset < 0 || ce_len == 0 || ++ce_count > ISO_CE_MAX
+            || ce_offset + (off_t) ce_len > arch->st.st_size)
+            break;
+
+        g_free (ce_buf);
+        ce_buf = g_malloc (ce_len);
+        if (!iso_pread (archive, ce_offset, ce_buf, ce_len))
+            break;
+
+        area = ce_buf;
+        area_len = ce_len;
+    }
+
+    g_free (ce_buf);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Strip ";version" and the dot of empty extension from name of primary or Joliet volume.
+ */
+
+static void
+iso_strip_version (char *name)
+{
+    char *p;
+    size_t len;
+
+    p = strrchr (name, ';');
+    if (p != NULL && p != name && strspn (p + 1, "0123456789") == strlen (p + 1))
+        *p = '\0';
+
+    len = strlen (name);
+    if (len > 1 && name[len - 1] == '.')
+        name[len - 1] = '\0';
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char *
+iso_joliet_name (const guint8 * name, size_t len)
+{
+    gunichar2 *u;
+    size_t i, n = len / 2;
+    char *ret;
+
+    u = g_new (gunichar2, n + 1);
+    for (i = 0; i < n; i++)
+        u[i] = (gunichar2) ((name[2 * i] << 8) | name[2 * i + 1]);
+    ret = g_utf16_to_utf8 (u, (glong) n, NULL, NULL, NULL);
+    g_free (u);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char *
+iso_entry_name (const iso_super_t * arch, const iso_dirrec_t * rec, const iso_rr_t * rr)
+{
+    char *name;
+
+    if (rr->name != NULL)
+        return g_strndup (rr->name->str, rr->name->len);
+
+    if (arch->joliet)
+        name = iso_joliet_name (rec->name, rec->name_len);
+    else
+        name = g_strndup ((const char *) rec->name, rec->name_len);
+
+    if (name != NULL && (rec->flags & ISO_FLAG_DIRECTORY) == 0)
+        iso_strip_version (name);
+
+    return name;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Append next extent of multi-extent file to @inode.
+ */
+
+static void
+iso_add_extent (iso_super_t * arch, struct vfs_s_inode *inode, const iso_dirrec_t * rec)
+{
+    GArray *extents;
+    iso_extent_t e;
+
+    extents = g_hash_table_lookup (arch->extents, inode);
+    if (extents == NULL)
+    {
+        extents = g_array_new (FALSE, FALSE, sizeof (iso_extent_t));
+        e.offset = inode->data_offset;
+        e.size = inode->st.st_size;
+        g_array_append_val (extents, e);
+        g_hash_table_insert (arch->extents, inode, extents);
+    }
+
+    e.offset = ((off_t) rec->extent + rec->ext_attr_len) * arch->block_size;
+    e.size = rec->size;
+    g_array_append_val (extents, e);
+
+    inode->st.st_size += e.size;
+    vfs_adjust_stat (&inode->st);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean iso_read_dir (struct vfs_class *me, struct vfs_s_super *archive,
+                              struct vfs_s_inode *dir, guint32 extent, guint32 size);
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+iso_add_entry (struct vfs_class *me, struct vfs_s_super *archive, struct vfs_s_inode *dir,
+               const iso_dirrec_t * rec, struct vfs_s_inode **pending)
+{
+    iso_super_t *arch = ISO_SUPER (archive);
+    iso_rr_t rr;
+    struct stat st;
+    struct vfs_s_inode *inode;
+    struct vfs_s_entry *entry;
+    char *name;
+    guint32 extent = rec->extent, size = rec->size;
+    gboolean is_dir = (rec->flags & ISO_FLAG_DIRECTORY) != 0;
+    gboolean ret = TRUE;
+
+    iso_rr_init (&rr);
+    if (arch->rock_ridge)
+        iso_parse_susp (archive, rec, &rr);
+
+    /* relocated directory is shown in place of its child link */
+    if (rr.relocated)
+    {
+        iso_rr_free (&rr);
+        return TRUE;
+    }
+
+    if (rr.child != 0)
+    {
+        guint8 buf[ISO_SECTOR_SIZE];
+        iso_dirrec_t dot;
+
+        if (!iso_read_dot (archive, rr.child, buf, &dot))
+        {
+            iso_rr_free (&rr);
+            return TRUE;
+        }
+
+        extent = rr.child;
+        size = dot.size;
+        is_dir = TRUE;
+    }
+
+    name = iso_entry_name (arch, rec, &rr);
+    if (name == NULL || *name == '\0' || DIR_IS_DOT (name) || DIR_IS_DOTDOT (name)
+        || strchr (name, PATH_SEP) != NULL)
+    {
+        g_free (name);
+        iso_rr_free (&rr);
+        return TRUE;
+    }
+
+    memset (&st, 0, sizeof (st));
+    st.st_mode = is_dir ? S_IFDIR | 0555 : S_IFREG | 0444;
+    st.st_uid = arch->st.st_uid;
+    st.st_gid = arch->st.st_gid;
+    st.st_mtime = rec->mtime != -1 ? rec->mtime : arch->st.st_mtime;
+
+    if (rr.have_px)
+    {
+        st.st_mode = rr.mode;
+        st.st_uid = rr.uid;
+        st.st_gid = rr.gid;
+
+        /* trust the directory flag */
+        if (is_dir && !S_ISDIR (st.st_mode))
+            st.st_mode = S_IFDIR | (st.st_mode & 07777);
+        else if (!is_dir && S_ISDIR (st.st_mode))
+            st.st_mode = S_IFREG | (st.st_mode & 07777);
+    }
+
+    if (rr.mtime != -1)
+        st.st_mtime = rr.mtime;
+    st.st_atime = rr.atime != -1 ? rr.atime : st.st_mtime;
+    st.st_ctime = rr.ctime != -1 ? rr.ctime : st.st_mtime;
+
+#ifdef HAVE_STRUCT_STAT_ST_RDEV
+    if ((S_ISCHR (st.st_mode) || S_ISBLK (st.st_mode)) && rr.have_pn)
+        st.st_rdev = rr.rdev;
+#endif
+
+    if (S_ISLNK (st.st_mode))
+        st.st_size = rr.link != NULL ? (off_t) rr.link->len : 0;
+    else if (S_ISREG (st.st_mode) || S_ISDIR (st.st_mode))
+        st.st_size = size;
+
+#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
+    st.st_blksize = arch->block_size;
+#endif
+    vfs_adjust_stat (&st);
+
+    inode = vfs_s_new_inode (me, archive, &st);
+    inode->data_offset = S_ISREG (st.st_mode)
+        ? ((off_t) extent + rec->ext_attr_len) * arch->block_size : -1;
+
+    if (S_ISLNK (st.st_mode) && rr.link != NULL)
+        vfs_s_set_linkname (inode, rr.link->str, (gssize) rr.link->len);
+
+    entry = vfs_s_new_entry (me, name, inode);
+    vfs_s_insert_entry (me, dir, entry);
+
+    if (S_ISREG (st.st_mode) && (rec->flags & ISO_FLAG_MULTI_EXTENT) != 0)
+        *pending = inode;
+    else if (S_ISDIR (st.st_mode))
+        ret = iso_read_dir (me, archive, inode, extent, size);
+
+    g_free (name);
+    iso_rr_free (&rr);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+iso_read_dir (struct vfs_class *me, struct vfs_s_super *archive, struct vfs_s_inode *dir,
+              guint32 extent, guint32 size)
+{
+    iso_super_t *arch = ISO_SUPER (archive);
+    off_t offset = (off_t) extent * arch->block_size;
+    struct vfs_s_inode *pending = NULL;
+    guint8 *buf;
+    size_t pos;
+    gboolean ret = TRUE;
+
+    /* each directory is read once, even if a broken image links it several times */
+    if (g_hash_table_lookup_extended (arch->dirs, GUINT_TO_POINTER (extent), NULL, NULL))
+        return TRUE;
+    g_hash_table_insert (arch->dirs, GUINT_TO_POINTER (extent), NULL);
+
+    if (offset + (off_t) size > arch->st.st_size)
+        return FALSE;
+
+    buf = g_malloc (size);
+    if (!iso_pread (archive, offset, buf, size))
+    {
+        g_free (buf);
+        return FALSE;
+    }
+
+    for (pos = 0; ret && pos < size;)
+    {
+        size_t sector_left = ISO_SECTOR_SIZE - pos % ISO_SECTOR_SIZE;
+        iso_dirrec_t rec;
+
+        /* records don't cross sector boundaries, the rest of sector is padding */
+        if (buf[pos] == 0)
+        {
+            pos += sector_left;
+            continue;
+        }
+
+        if (!iso_parse_dirrec (buf + pos, MIN (size - pos, sector_left), &rec))
+        {
+            ret = FALSE;
+            break;
+        }
+
+        pos += rec.length;
+
+        if (iso_dirrec_is_dot (&rec) || (rec.flags & ISO_FLAG_ASSOCIATED) != 0)
+            continue;
+
+        if (pending != NULL)
+        {
+            iso_add_extent (arch, pending, &rec);
+            if ((rec.flags & ISO_FLAG_MULTI_EXTENT) == 0)
+                pending = NULL;
+            continue;
+        }
+
+        ret = iso_add_entry (me, archive, dir, &rec, &pending);
+    }
+
+    g_free (buf);
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Look for Rock Ridge SP entry in the "." record of the root directory.
+ */
+
+static void
+iso_detect_rock_ridge (struct vfs_s_super *archive, const iso_dirrec_t * root)
+{
+    iso_super_t *arch = ISO_SUPER (archive);
+    guint8 buf[ISO_SECTOR_SIZE];
+    iso_dirrec_t dot;
+    size_t offset;
+
+    if (!iso_read_dot (archive, root->extent, buf, &dot))
+        return;
+
+    /* SP may follow CD-ROM XA data */
+    for (offset = 0; offset <= ISO_XA_SIZE; offset += ISO_XA_SIZE)
+    {
+        const guint8 *p = dot.sua + offset;
+
+        if (dot.sua_len >= offset + 7 && ISO_SIG (p, "SP") && p[2] >= 7
+            && p[4] == 0xBE && p[5] == 0xEF)
+        {
+            arch->rock_ridge = TRUE;
+            arch->susp_offset = offset + p[6];
+            return;
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read volume descriptors and choose the directory tree to show.
+ *
+ * @param root buffer for root directory record of chosen tree
+ */
+
+static gboolean
+iso_read_volume (struct vfs_s_super *archive, guint8 * root)
+{
+    iso_super_t *arch = ISO_SUPER (archive);
+    guint8 vd[ISO_SECTOR_SIZE];
+    guint8 joliet_root[ISO_DIRREC_SIZE + 1];
+    gboolean have_primary = FALSE;
+    int i;
+    iso_dirrec_t rec;
+
+    for (i = 0; i < ISO_VD_MAX; i++)
+    {
+        if (!iso_pread (archive, (off_t) (ISO_VD_FIRST + i) * ISO_SECTOR_SIZE, vd, sizeof (vd))
+            || memcmp (vd + 1, "CD001", 5) != 0)
+            break;
+
+        if (vd[0] == ISO_VD_TERMINATOR)
+            break;
+
+        if (vd[0] == ISO_VD_PRIMARY && !have_primary)
+        {
+            have_primary = TRUE;
+            arch->block_size = iso_get16 (vd + ISO_VD_BLOCK_SIZE);
+            memcpy (root, vd + ISO_VD_ROOT, ISO_DIRREC_SIZE + 1);
+        }
+        else if (vd[0] == ISO_VD_SUPPLEMENTARY && !arch->joliet
+                 && vd[ISO_VD_ESCAPES] == '%' && vd[ISO_VD_ESCAPES + 1] == '/'
+                 && vd[ISO_VD_ESCAPES + 2] != '\0'
+                 && strchr ("@CE", vd[ISO_VD_ESCAPES + 2]) != NULL)
+        {
+            arch->joliet = TRUE;
+            memcpy (joliet_root, vd + ISO_VD_ROOT, ISO_DIRREC_SIZE + 1);
+        }
+    }
+
+    if (!have_primary)
+        return FALSE;
+
+    /* logical block size is 512, 1024 or 2048 */
+    if (arch->block_size != 512 && arch->block_size != 1024)
+        arch->block_size = ISO_SECTOR_SIZE;
+
+    if (!iso_parse_dirrec (root, ISO_DIRREC_SIZE + 1, &rec))
+        return FALSE;
+
+    iso_detect_rock_ridge (archive, &rec);
+
+    if (arch->rock_ridge)
+        arch->joliet = FALSE;
+    else if (arch->joliet)
+        memcpy (root, joliet_root, ISO_DIRREC_SIZE + 1);
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_super *
+iso_new_archive (struct vfs_class *me)
+{
+    iso_super_t *arch;
+
+    arch = g_new0 (iso_super_t, 1);
+    arch->base.me = me;
+    arch->fd = -1;
+    arch->extents =
+        g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                               (GDestroyNotify) g_array_unref);
+    arch->dirs = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    return VFS_SUPER (arch);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+iso_free_archive (struct vfs_class *me, struct vfs_s_super *archive)
+{
+    iso_super_t *arch = ISO_SUPER (archive);
+
+    (void) me;
+
+    if (arch->fd != -1)
+    {
+        mc_close (arch->fd);
+        arch->fd = -1;
+    }
+
+    g_hash_table_destroy (arch->extents);
+    g_hash_table_destroy (arch->dirs);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+iso_open_archive (struct vfs_s_super *archive, const vfs_path_t * vpath,
+                  const vfs_path_element_t * vpath_element)
+{
+    struct vfs_class *me = vpath_element->class;
+    iso_super_t *arch = ISO_SUPER (archive);
+    guint8 root_rec[ISO_DIRREC_SIZE + 1];
+    iso_dirrec_t rec;
+    mode_t mode;
+    struct vfs_s_inode *root;
+
+    arch->fd = mc_open (vpath, O_RDONLY);
+    if (arch->fd == -1 || mc_fstat (arch->fd, &arch->st) == -1)
+    {
+        message (D_ERROR, MSG_ERROR, _("Cannot open ISO9660 image\n%s"), vfs_path_as_str (vpath));
+        ERRNOR (ENOENT, -1);
+    }
+
+    archive->name = g_strdup (vfs_path_as_str (vpath));
+
+    mode = arch->st.st_mode & 07777;
+    if (mode & 0400)
+        mode |= 0100;
+    if (mode & 0040)
+        mode |= 0010;
+    if (mode & 0004)
+        mode |= 0001;
+    mode |= S_IFDIR;
+
+    root = vfs_s_new_inode (me, archive, &arch->st);
+    root->st.st_mode = mode;
+    root->data_offset = -1;
+    root->st.st_nlink++;
+    root->st.st_dev = VFS_SUBCLASS (me)->rdev++;
+
+    archive->root = root;
+
+    if (!iso_read_volume (archive, root_rec)
+        || !iso_parse_dirrec (root_rec, sizeof (root_rec), &rec)
+        || !iso_read_dir (me, archive, root, rec.extent, rec.size))
+    {
+        message (D_ERROR, MSG_ERROR, _("%s\ndoesn't look like an ISO9660 image."),
+                 vfs_path_as_str (vpath));
+        ERRNOR (EIO, -1);
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void *
+iso_super_check (const vfs_path_t * vpath)
+{
+    static struct stat stat_buf;
+    int stat_result;
+
+    stat_result = mc_stat (vpath, &stat_buf);
+
+    return (stat_result != 0) ? NULL : &stat_buf;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+iso_super_same (const vfs_path_element_t * vpath_element, struct vfs_s_super *parc,
+                const vfs_path_t * vpath, void *cookie)
+{
+    struct stat *archive_stat = cookie; /* stat of main archive */
+
+    (void) vpath_element;
+
+    if (strcmp (parc->name, vfs_path_as_str (vpath)) != 0)
+        return 0;
+
+    /* Has the cached archive been changed on the disk? */
+    if (ISO_SUPER (parc)->st.st_mtime < archive_stat->st_mtime
+        || ISO_SUPER (parc)->st.st_size != archive_stat->st_size)
+    {
+        /* Yes, reload! */
+        vfs_iso9660fs_ops->free ((vfsid) parc);
+        vfs_rmstamp (vfs_iso9660fs_ops, (vfsid) parc);
+        return 2;
+    }
+    /* Hasn't been modified, give it a new timeout */
+    vfs_stamp (vfs_iso9660fs_ops, (vfsid) parc);
+    return 1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+iso_read (void *fh, char *buffer, size_t count)
+{
+    struct vfs_s_super *archive = VFS_FILE_HANDLER_SUPER (fh);
+    struct vfs_class *me = archive->me;
+    vfs_file_handler_t *file = VFS_FILE_HANDLER (fh);
+    iso_super_t *arch = ISO_SUPER (archive);
+    off_t offset, left;
+    GArray *extents;
+    ssize_t res;
+
+    left = file->ino->st.st_size - file->pos;
+    if (left <= 0)
+        return 0;
+    if ((off_t) count > left)
+        count = (size_t) left;
+
+    offset = file->ino->data_offset + file->pos;
+
+    extents = g_hash_table_lookup (arch->extents, file->ino);
+    if (extents != NULL)
+    {
+        off_t pos = file->pos;
+        guint i;
+
+        /* don't read across the end of extent: the next one may be anywhere */
+        for (i = 0; i < extents->len; i++)
+        {
+            const iso_extent_t *e = &g_array_index (extents, iso_extent_t, i);
+
+            if (pos < e->size)
+            {
+                offset = e->offset + pos;
+                if ((off_t) count > e->size - pos)
+                    count = (size_t) (e->size - pos);
+                break;
+            }
+
+            pos -= e->size;
+        }
+    }
+
+    if (mc_lseek (arch->fd, offset, SEEK_SET) != offset)
+        ERRNOR (EIO, -1);
+
+    res = mc_read (arch->fd, buffer, count);
+    if (res == -1)
+        ERRNOR (errno, -1);
+
+    file->pos += res;
+    return res;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+iso_fh_open (struct vfs_class *me, vfs_file_handler_t * fh, int flags, mode_t mode)
+{
+    (void) fh;
+    (void) mode;
+
+    if ((flags & O_ACCMODE) != O_RDONLY)
+        ERRNOR (EROFS, -1);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+void
+vfs_init_iso9660fs (void)
+{
+    vfs_init_subclass (&iso9660fs_subclass, "iso9660fs", VFSF_READONLY, "iso");
+    vfs_iso9660fs_ops->read = iso_read;
+    vfs_iso9660fs_ops->setctl = vfs_s_archive_setctl;
+    iso9660fs_subclass.archive_check = iso_super_check;
+    iso9660fs_subclass.archive_same = iso_super_same;
+    iso9660fs_subclass.new_archive = iso_new_archive;
+    iso9660fs_subclass.open_archive = iso_open_archive;
+    iso9660fs_subclass.free_archive = iso_free_archive;
+    iso9660fs_subclass.fh_open = iso_fh_open;
+    vfs_register_class (vfs_iso9660fs_ops);
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -38,6 +38,10 @@
 
 #include "local/local.h"
 
+#ifdef ENABLE_VFS_AR
+#include "ar/ar.h"
+#endif
+
 #ifdef ENABLE_VFS_CPIO
 #include "cpio/cpio.h"
 #endif
@@ -54,6 +58,10 @@
 #include "ftpfs/ftpfs.h"
 #endif
 
+#ifdef ENABLE_VFS_ISO9660
+#include "iso9660/iso9660.h"
+#endif
+
 #ifdef ENABLE_VFS_SFTP
 #include "sftpfs/init.h"
 #endif
@@ -74,6 +82,10 @@
 #include "undelfs/undelfs.h"
 #endif
 
+#ifdef ENABLE_VFS_ZIP
+#include "zip/zip.h"
+#endif
+
 #include "plugins_init.h"
 
 /*** global variables ****************************************************************************/
@@ -106,6 +118,15 @@ vfs_plugins_init (void)
 #ifdef ENABLE_VFS_SFS
     vfs_init_sfs ();
 #endif /* ENABLE_VFS_SFS */
+#ifdef ENABLE_VFS_ZIP
+    vfs_init_zipfs ();
+#endif /* ENABLE_VFS_ZIP */
+#ifdef ENABLE_VFS_AR
+    vfs_init_arfs ();
+#endif /* ENABLE_VFS_AR */
+#ifdef ENABLE_VFS_ISO9660
+    vfs_init_iso9660fs ();
+#endif /* ENABLE_VFS_ISO9660 */
 #ifdef ENABLE_VFS_EXTFS
     vfs_init_extfs ();
 #endif /* ENABLE_VFS_EXTFS */
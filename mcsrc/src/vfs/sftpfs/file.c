@@ -32,15 +32,30 @@
 
 #include "lib/global.h"
 #include "lib/util.h"
+#include "lib/tty/tty.h"        /* tty_got_interrupt() */
 
 #include "internal.h"
+#include "init.h"
 
 /*** global variables ****************************************************************************/
 
+/* Size of read-ahead and write-behind windows, in kilobytes */
+int sftpfs_window_size = 256;
+
+/* Copy files within one server by running cp there */
+gboolean sftpfs_remote_copy = TRUE;
+
 /*** file scope macro definitions ****************************************************************/
 
 #define SFTP_FILE_HANDLER(a) ((sftpfs_file_handler_t *) a)
 
+/* printed by the copy command after cp succeeded: the exit status alone is not reliable,
+   libssh2 reports 0 if the server sent none, e.g. when cp was killed by a signal */
+#define SFTPFS_COPY_DONE "mc-cp-done"
+
+/* exit status of command that was interrupted or ended without printing its marker */
+#define SFTPFS_EXEC_UNKNOWN 255
+
 /*** file scope type declarations ****************************************************************/
 
 typedef struct
@@ -50,6 +65,12 @@ typedef struct
     LIBSSH2_SFTP_HANDLE *handle;
     int flags;
     mode_t mode;
+
+    char *rbuf;                 /* read-ahead window */
+    size_t rbuf_len;            /* data in read-ahead window */
+    size_t rbuf_pos;            /* data in read-ahead window already returned */
+    char *wbuf;                 /* write-behind window */
+    size_t wbuf_len;            /* data in write-behind window */
 } sftpfs_file_handler_t;
 
 /*** file scope variables ************************************************************************/
@@ -96,6 +117,232 @@ sftpfs_file__handle_error (sftpfs_super_t * super, int sftp_res, GError ** mcerr
     return 0;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Each libssh2_sftp_read() keeps requests for four times the size of its buffer outstanding,
+ * and libssh2_sftp_write() sends all the data it gets in one go and returns as soon as
+ * the first part is acknowledged. So the throughput is the size of buffer per round trip.
+ * Callers read and write in small blocks (the viewer, copying to local disk), so data is
+ * passed to libssh2 through windows of sftpfs_window_size kilobytes.
+ */
+
+static size_t
+sftpfs_file__window (void)
+{
+    return sftpfs_window_size > 0 ? (size_t) sftpfs_window_size * 1024 : 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+sftpfs_file__read (sftpfs_super_t * super, LIBSSH2_SFTP_HANDLE * handle, char *buffer,
+                   size_t count, GError ** mcerror)
+{
+    ssize_t rc;
+
+    do
+    {
+        int err;
+
+        rc = libssh2_sftp_read (handle, buffer, count);
+        if (rc >= 0)
+            break;
+
+        err = sftpfs_file__handle_error (super, (int) rc, mcerror);
+        if (err < 0)
+            return err;
+    }
+    while (rc == LIBSSH2_ERROR_EAGAIN);
+
+    return rc;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+sftpfs_file__write (sftpfs_super_t * super, LIBSSH2_SFTP_HANDLE * handle, const char *buffer,
+                    size_t count, GError ** mcerror)
+{
+    ssize_t rc;
+
+    do
+    {
+        int err;
+
+        rc = libssh2_sftp_write (handle, buffer, count);
+        if (rc >= 0)
+            break;
+
+        err = sftpfs_file__handle_error (super, (int) rc, mcerror);
+        if (err < 0)
+            return err;
+    }
+    while (rc == LIBSSH2_ERROR_EAGAIN);
+
+    return rc;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Send the rest of write-behind window and wait until the server acknowledges all of it.
+ *
+ * @return 0 on success, negative value otherwise
+ */
+
+static int
+sftpfs_file__flush (vfs_file_handler_t * fh, GError ** mcerror)
+{
+    sftpfs_file_handler_t *file = SFTP_FILE_HANDLER (fh);
+    sftpfs_super_t *super = SFTP_SUPER (VFS_FILE_HANDLER_SUPER (fh));
+
+    while (file->wbuf_len != 0)
+    {
+        ssize_t rc;
+
+        rc = sftpfs_file__write (super, file->handle, file->wbuf, file->wbuf_len, mcerror);
+        if (rc < 0)
+        {
+            file->wbuf_len = 0;
+            return (int) rc;
+        }
+        if (rc == 0)
+        {
+            file->wbuf_len = 0;
+            return -1;
+        }
+
+        file->wbuf_len -= (size_t) rc;
+        memmove (file->wbuf, file->wbuf + rc, file->wbuf_len);
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Forget read-ahead data. Position in SFTP handle is moved back to the logical one.
+ */
+
+static void
+sftpfs_file__drop_readahead (vfs_file_handler_t * fh)
+{
+    sftpfs_file_handler_t *file = SFTP_FILE_HANDLER (fh);
+
+    if (file->rbuf_pos < file->rbuf_len)
+        libssh2_sftp_seek64 (file->handle, fh->pos);
+
+    file->rbuf_len = 0;
+    file->rbuf_pos = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Quote file name for POSIX shell. Unlike strutils_shell_escape(), newlines are kept
+ * literally, so the name can't end the command.
+ */
+
+static char *
+sftpfs_file__quote (const char *name)
+{
+    GString *quoted;
+
+    quoted = g_string_new ("'");
+    for (; *name != '\0'; name++)
+        if (*name == '\'')
+            g_string_append (quoted, "'\\''");
+        else
+            g_string_append_c (quoted, *name);
+    g_string_append_c (quoted, '\'');
+
+    return g_string_free (quoted, FALSE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Run a command on the server in a channel of its own, beside the SFTP one.
+ * Waiting for the command can be interrupted by user.
+ *
+ * @param output the end of command output is stored here
+ *
+ * @return exit status of the command, -1 if the command could not be run,
+ *         SFTPFS_EXEC_UNKNOWN if it was interrupted
+ */
+
+static int
+sftpfs_file__exec (sftpfs_super_t * super, const char *command, GString * output,
+                   GError ** mcerror)
+{
+    LIBSSH2_CHANNEL *channel;
+    char buf[BUF_MEDIUM];
+    ssize_t n;
+    int rc;
+    gboolean interrupted = FALSE;
+    int status = -1;
+
+    /* server may refuse other channels than SFTP one; that is not an error */
+    while ((channel = libssh2_channel_open_session (super->session)) == NULL)
+        if (libssh2_session_last_errno (super->session) != LIBSSH2_ERROR_EAGAIN
+            || !sftpfs_waitsocket (super, LIBSSH2_ERROR_EAGAIN, mcerror))
+            return (-1);
+
+    libssh2_channel_handle_extended_data2 (channel, LIBSSH2_CHANNEL_EXTENDED_DATA_MERGE);
+
+    while ((rc = libssh2_channel_exec (channel, command)) == LIBSSH2_ERROR_EAGAIN)
+        if (!sftpfs_waitsocket (super, rc, mcerror))
+            break;
+
+    if (rc == 0)
+    {
+        vfs_print_message ("%s", _("sftp: (Ctrl-G break) Copying on server..."));
+        tty_enable_interrupt_key ();
+
+        /* wait for end of command, it takes as long as copying of the file */
+        while ((n = libssh2_channel_read (channel, buf, sizeof (buf))) != 0)
+        {
+            if (n > 0)
+            {
+                g_string_append_len (output, buf, n);
+                if (output->len > sizeof (buf))
+                    g_string_erase (output, 0, output->len - sizeof (buf));
+                continue;
+            }
+
+            if (n != LIBSSH2_ERROR_EAGAIN)
+                break;
+
+            interrupted = tty_got_interrupt ();
+            if (interrupted || !sftpfs_waitsocket (super, (int) n, mcerror))
+                break;
+        }
+
+        /* select() in sftpfs_waitsocket() is broken by interrupt, that is not an error */
+        if (!interrupted)
+            interrupted = tty_got_interrupt ();
+        if (interrupted && mcerror != NULL)
+            g_clear_error (mcerror);
+
+        tty_disable_interrupt_key ();
+
+        if (interrupted)
+            status = SFTPFS_EXEC_UNKNOWN;
+        else if (n == 0)
+        {
+            while ((rc = libssh2_channel_close (channel)) == LIBSSH2_ERROR_EAGAIN)
+                if (!sftpfs_waitsocket (super, rc, mcerror))
+                    break;
+            while ((rc = libssh2_channel_wait_closed (channel)) == LIBSSH2_ERROR_EAGAIN)
+                if (!sftpfs_waitsocket (super, rc, mcerror))
+                    break;
+            if (rc == 0)
+                status = libssh2_channel_get_exit_status (channel);
+        }
+    }
+
+    libssh2_channel_free (channel);
+
+    return status;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /*** public functions ****************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -237,6 +484,11 @@ sftpfs_fstat (void *data, struct stat *buf, GError ** mcerror)
     if (sftpfs_fh->handle == NULL)
         return -1;
 
+    /* size must include data in write-behind window */
+    res = sftpfs_file__flush (fh, mcerror);
+    if (res < 0)
+        return res;
+
     do
     {
         int err;
@@ -274,6 +526,7 @@ sftpfs_read_file (vfs_file_handler_t * fh, char *buffer, size_t count, GError **
     ssize_t rc;
     sftpfs_file_handler_t *file = SFTP_FILE_HANDLER (fh);
     sftpfs_super_t *super;
+    size_t window;
 
     mc_return_val_if_error (mcerror, -1);
 
@@ -286,21 +539,43 @@ sftpfs_read_file (vfs_file_handler_t * fh, char *buffer, size_t count, GError **
 
     super = SFTP_SUPER (VFS_FILE_HANDLER_SUPER (fh));
 
-    do
+    if (file->wbuf_len != 0)
     {
-        int err;
+        rc = sftpfs_file__flush (fh, mcerror);
+        if (rc < 0)
+            return rc;
+    }
 
-        rc = libssh2_sftp_read (file->handle, buffer, count);
-        if (rc >= 0)
-            break;
+    if (file->rbuf_pos == file->rbuf_len)
+    {
+        window = sftpfs_file__window ();
 
-        err = sftpfs_file__handle_error (super, (int) rc, mcerror);
-        if (err < 0)
-            return err;
+        if (count >= window)
+        {
+            /* big enough to keep the pipe full */
+            rc = sftpfs_file__read (super, file->handle, buffer, count, mcerror);
+            if (rc >= 0)
+                fh->pos = (off_t) libssh2_sftp_tell64 (file->handle);
+            return rc;
+        }
+
+        if (file->rbuf == NULL)
+            file->rbuf = g_malloc (window);
+
+        rc = sftpfs_file__read (super, file->handle, file->rbuf, window, mcerror);
+        if (rc <= 0)
+            return rc;
+
+        file->rbuf_len = (size_t) rc;
+        file->rbuf_pos = 0;
     }
-    while (rc == LIBSSH2_ERROR_EAGAIN);
 
-    fh->pos = (off_t) libssh2_sftp_tell64 (file->handle);
+    rc = (ssize_t) MIN (count, file->rbuf_len - file->rbuf_pos);
+    memcpy (buffer, file->rbuf + file->rbuf_pos, (size_t) rc);
+    file->rbuf_pos += (size_t) rc;
+
+    fh->pos =
+        (off_t) libssh2_sftp_tell64 (file->handle) - (off_t) (file->rbuf_len - file->rbuf_pos);
 
     return rc;
 }
@@ -324,24 +599,40 @@ sftpfs_write_file (vfs_file_handler_t * fh, const char *buffer, size_t count, GE
     ssize_t rc;
     sftpfs_file_handler_t *file = SFTP_FILE_HANDLER (fh);
     sftpfs_super_t *super = SFTP_SUPER (VFS_FILE_HANDLER_SUPER (fh));
+    size_t window;
 
     mc_return_val_if_error (mcerror, -1);
 
-    fh->pos = (off_t) libssh2_sftp_tell64 (file->handle);
+    sftpfs_file__drop_readahead (fh);
 
-    do
+    window = sftpfs_file__window ();
+    if (window == 0 || (file->wbuf_len == 0 && count >= window))
     {
-        int err;
-
-        rc = libssh2_sftp_write (file->handle, buffer, count);
+        rc = sftpfs_file__write (super, file->handle, buffer, count, mcerror);
         if (rc >= 0)
-            break;
+            fh->pos = (off_t) libssh2_sftp_tell64 (file->handle);
+        return rc;
+    }
 
-        err = sftpfs_file__handle_error (super, (int) rc, mcerror);
-        if (err < 0)
-            return err;
+    if (file->wbuf == NULL)
+        file->wbuf = g_malloc (window);
+
+    if (file->wbuf_len == window)
+    {
+        /* Pass the whole window: new data is sent, and libssh2 returns what is acknowledged
+           already. Unacknowledged data must be passed again next time. */
+        rc = sftpfs_file__write (super, file->handle, file->wbuf, file->wbuf_len, mcerror);
+        if (rc < 0)
+            return rc;
+
+        file->wbuf_len -= (size_t) rc;
+        memmove (file->wbuf, file->wbuf + rc, file->wbuf_len);
     }
-    while (rc == LIBSSH2_ERROR_EAGAIN);
+
+    rc = (ssize_t) MIN (count, window - file->wbuf_len);
+    memcpy (file->wbuf + file->wbuf_len, buffer, (size_t) rc);
+    file->wbuf_len += (size_t) rc;
+    fh->pos += rc;
 
     return rc;
 }
@@ -360,13 +651,20 @@ sftpfs_write_file (vfs_file_handler_t * fh, const char *buffer, size_t count, GE
 int
 sftpfs_close_file (vfs_file_handler_t * fh, GError ** mcerror)
 {
-    int ret;
+    sftpfs_file_handler_t *file = SFTP_FILE_HANDLER (fh);
+    int flushed, ret;
 
     mc_return_val_if_error (mcerror, -1);
 
-    ret = libssh2_sftp_close (SFTP_FILE_HANDLER (fh)->handle);
+    flushed = sftpfs_file__flush (fh, mcerror);
 
-    return ret == 0 ? 0 : -1;
+    ret = libssh2_sftp_close (file->handle);
+
+    MC_PTR_FREE (file->rbuf);
+    MC_PTR_FREE (file->wbuf);
+    file->rbuf_len = file->rbuf_pos = 0;
+
+    return (flushed == 0 && ret == 0) ? 0 : -1;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -389,6 +687,10 @@ sftpfs_lseek (vfs_file_handler_t * fh, off_t offset, int whence, GError ** mcerr
 
     mc_return_val_if_error (mcerror, 0);
 
+    if (sftpfs_file__flush (fh, mcerror) < 0)
+        return 0;
+    sftpfs_file__drop_readahead (fh);
+
     switch (whence)
     {
     case SEEK_SET:
@@ -425,3 +727,73 @@ sftpfs_lseek (vfs_file_handler_t * fh, off_t offset, int whence, GError ** mcerr
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Copy the file on the server, without transferring its data through the client.
+ *
+ * The SFTP extensions for this (copy-data, copy-file) are not available through libssh2,
+ * so cp is run over an exec channel of the same session. If the server does not allow it,
+ * it is not tried again for this connection. The copy succeeds only if cp exited with 0
+ * and the marker printed after it has arrived.
+ *
+ * @param dest_fh destination file handler, just opened for writing
+ * @param src_fh  source file handler, just opened for reading
+ * @param mcerror pointer to the error handler
+ *
+ * @return 0 on success, -1 if the file has to be copied by reading and writing it
+ */
+
+int
+sftpfs_copy_file (vfs_file_handler_t * dest_fh, vfs_file_handler_t * src_fh, GError ** mcerror)
+{
+    sftpfs_super_t *super = SFTP_SUPER (VFS_FILE_HANDLER_SUPER (src_fh));
+    char *src_name, *dest_name;
+    char *src_quoted, *dest_quoted;
+    char *command;
+    GString *output;
+    unsigned int len;
+    int status;
+
+    mc_return_val_if_error (mcerror, -1);
+
+    if (!sftpfs_remote_copy || super->no_remote_copy
+        || VFS_FILE_HANDLER_SUPER (dest_fh) != VFS_FILE_HANDLER_SUPER (src_fh)
+        || (SFTP_FILE_HANDLER (dest_fh)->flags & O_APPEND) != 0
+        || SFTP_FILE_HANDLER (dest_fh)->wbuf_len != 0)
+        return (-1);
+
+    src_name = vfs_s_fullpath (sftpfs_class, src_fh->ino);
+    dest_name = vfs_s_fullpath (sftpfs_class, dest_fh->ino);
+    if (src_name == NULL || dest_name == NULL)
+    {
+        g_free (src_name);
+        g_free (dest_name);
+        return (-1);
+    }
+
+    /* sftpfs_fix_filename() returns the same buffer each time */
+    src_quoted = sftpfs_file__quote (sftpfs_fix_filename (src_name, &len));
+    dest_quoted = sftpfs_file__quote (sftpfs_fix_filename (dest_name, &len));
+    g_free (src_name);
+    g_free (dest_name);
+
+    command = g_strdup_printf ("cp -- %s %s && echo " SFTPFS_COPY_DONE, src_quoted, dest_quoted);
+    g_free (src_quoted);
+    g_free (dest_quoted);
+
+    output = g_string_new ("");
+    status = sftpfs_file__exec (super, command, output, mcerror);
+    g_free (command);
+
+    /* killed cp or shell: no status is sent, libssh2 reports 0 */
+    if (status == 0 && !g_str_has_suffix (output->str, SFTPFS_COPY_DONE "\n"))
+        status = SFTPFS_EXEC_UNKNOWN;
+    g_string_free (output, TRUE);
+
+    /* no exec channel, no shell or no cp: read and write files for the rest of the session */
+    if (status == -1 || status == 126 || status == 127)
+        super->no_remote_copy = TRUE;
+
+    return status == 0 ? 0 : -1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -14,6 +14,9 @@
 
 /*** global variables defined in .c file *********************************************************/
 
+extern int sftpfs_window_size;
+extern gboolean sftpfs_remote_copy;
+
 /*** declarations of public functions ************************************************************/
 
 void vfs_init_sftpfs (void);
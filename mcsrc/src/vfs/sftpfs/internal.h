@@ -52,6 +52,7 @@ typedef struct
 
     int socket_handle;
     const char *fingerprint;
+    gboolean no_remote_copy;    /* server can't run cp for sftpfs_copy_file() */
     vfs_path_element_t *original_connection_info;
 } sftpfs_super_t;
 
@@ -103,6 +104,8 @@ ssize_t sftpfs_write_file (vfs_file_handler_t * fh, const char *buffer, size_t c
 int sftpfs_close_file (vfs_file_handler_t * fh, GError ** mcerror);
 int sftpfs_fstat (void *data, struct stat *buf, GError ** mcerror);
 off_t sftpfs_lseek (vfs_file_handler_t * fh, off_t offset, int whence, GError ** mcerror);
+int sftpfs_copy_file (vfs_file_handler_t * dest_fh, vfs_file_handler_t * src_fh,
+                      GError ** mcerror);
 
 /*** inline functions ****************************************************************************/
 
@@ -618,6 +618,26 @@ sftpfs_cb_rename (const vfs_path_t * vpath1, const vfs_path_t * vpath2)
     return rc;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Callback for copy_file VFS-function.
+ *
+ * @param dest_data destination file handler
+ * @param src_data  source file handler
+ * @return 0 if file was copied on server, -1 otherwise
+ */
+
+static int
+sftpfs_cb_copy_file (void *dest_data, void *src_data)
+{
+    int rc;
+    GError *mcerror = NULL;
+
+    rc = sftpfs_copy_file (VFS_FILE_HANDLER (dest_data), VFS_FILE_HANDLER (src_data), &mcerror);
+    mc_error_message (&mcerror, NULL);
+    return rc;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /**
  * Callback for errno VFS-function.
@@ -702,6 +722,7 @@ sftpfs_init_class (void)
     sftpfs_class->lseek = sftpfs_cb_lseek;
     sftpfs_class->unlink = sftpfs_cb_unlink;
     sftpfs_class->rename = sftpfs_cb_rename;
+    sftpfs_class->copy_file = sftpfs_cb_copy_file;
     sftpfs_class->ferrno = sftpfs_cb_errno;
 }
 
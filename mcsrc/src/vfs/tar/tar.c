@@ -54,6 +54,9 @@
 #include "lib/vfs/utilvfs.h"
 #include "lib/vfs/xdirentry.h"
 #include "lib/vfs/gc.h"         /* vfs_rmstamp */
+#include "lib/vfs/arcindex.h"
+#include "lib/vfs/zstream.h"
+#include "lib/vfs/arcread.h"
 
 #include "tar.h"
 
@@ -256,6 +259,8 @@ typedef struct
     struct vfs_s_super base;    /* base class */
 
     int fd;
+    vfs_zstream_t *zs;          /* decompressor if archive is compressed */
+    vfs_arcread_t *ar;          /* buffered reader while archive is being scanned */
     struct stat st;
     enum archive_format type;   /* Type of the archive */
 } tar_super_t;
@@ -319,6 +324,17 @@ tar_new_archive (struct vfs_class *me)
 
 /* --------------------------------------------------------------------------------------------- */
 
+static void
+tar_close_reader (struct vfs_s_super *archive)
+{
+    tar_super_t *arch = TAR_SUPER (archive);
+
+    vfs_arcread_close (arch->ar);
+    arch->ar = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static void
 tar_free_archive (struct vfs_class *me, struct vfs_s_super *archive)
 {
@@ -326,6 +342,11 @@ tar_free_archive (struct vfs_class *me, struct vfs_s_super *archive)
 
     (void) me;
 
+    tar_close_reader (archive);
+
+    vfs_zstream_close (arch->zs);
+    arch->zs = NULL;
+
     if (arch->fd != -1)
     {
         mc_close (arch->fd);
@@ -337,30 +358,28 @@ tar_free_archive (struct vfs_class *me, struct vfs_s_super *archive)
 
 /* Returns fd of the open tar file */
 static int
-tar_open_archive_int (struct vfs_class *me, const vfs_path_t * vpath, struct vfs_s_super *archive)
+tar_open_archive_fd (struct vfs_s_super *archive)
 {
+    struct vfs_class *me = archive->me;
     int result, type;
-    tar_super_t *arch;
-    mode_t mode;
-    struct vfs_s_inode *root;
+    vfs_path_t *vpath;
 
+    vpath = vfs_path_from_str (archive->name);
     result = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
     if (result == -1)
     {
-        message (D_ERROR, MSG_ERROR, _("Cannot open tar archive\n%s"), vfs_path_as_str (vpath));
+        message (D_ERROR, MSG_ERROR, _("Cannot open tar archive\n%s"), archive->name);
         ERRNOR (ENOENT, -1);
     }
 
-    archive->name = g_strdup (vfs_path_as_str (vpath));
-    arch = TAR_SUPER (archive);
-    mc_stat (vpath, &arch->st);
-
     /* Find out the method to handle this tar file */
     type = get_compression_type (result, archive->name);
     if (type == COMPRESSION_NONE)
         mc_lseek (result, 0, SEEK_SET);
-    else
+    else if ((TAR_SUPER (archive)->zs = vfs_zstream_open (result, type)) == NULL)
     {
+        /* can't decompress in-process: use sfs */
         char *s;
         vfs_path_t *tmp_vpath;
 
@@ -373,13 +392,45 @@ tar_open_archive_int (struct vfs_class *me, const vfs_path_t * vpath, struct vfs
             message (D_ERROR, MSG_ERROR, _("Cannot open tar archive\n%s"), s);
         g_free (s);
         if (result == -1)
-        {
-            MC_PTR_FREE (archive->name);
             ERRNOR (ENOENT, -1);
-        }
     }
 
-    arch->fd = result;
+    TAR_SUPER (archive)->fd = result;
+
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get fd of archive. If directory tree was loaded from the listing index,
+ * the archive is not opened until the first read of file content.
+ */
+
+static int
+tar_get_fd (struct vfs_s_super *archive)
+{
+    int fd = TAR_SUPER (archive)->fd;
+
+    return (fd != -1) ? fd : tar_open_archive_fd (archive);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+tar_open_archive_int (struct vfs_class *me, const vfs_path_t * vpath, struct vfs_s_super *archive)
+{
+    tar_super_t *arch = TAR_SUPER (archive);
+    mode_t mode;
+    struct vfs_s_inode *root;
+
+    if (mc_stat (vpath, &arch->st) == -1)
+    {
+        message (D_ERROR, MSG_ERROR, _("Cannot open tar archive\n%s"), vfs_path_as_str (vpath));
+        ERRNOR (ENOENT, -1);
+    }
+
+    archive->name = g_strdup (vfs_path_as_str (vpath));
+
     mode = arch->st.st_mode & 07777;
     if (mode & 0400)
         mode |= 0100;
@@ -397,7 +448,35 @@ tar_open_archive_int (struct vfs_class *me, const vfs_path_t * vpath, struct vfs
 
     archive->root = root;
 
-    return result;
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+tar_read_data (struct vfs_s_super *archive, int tard, char *buffer, size_t count)
+{
+    tar_super_t *arch = TAR_SUPER (archive);
+
+    if (arch->ar != NULL)
+        return vfs_arcread_read (arch->ar, buffer, count);
+
+    return (arch->zs != NULL) ? vfs_zstream_read (arch->zs, buffer, count)
+        : mc_read (tard, buffer, count);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static off_t
+tar_seek (struct vfs_s_super *archive, int tard, off_t offset)
+{
+    tar_super_t *arch = TAR_SUPER (archive);
+
+    if (arch->ar != NULL)
+        return vfs_arcread_seek (arch->ar, offset);
+
+    return (arch->zs != NULL) ? vfs_zstream_seek (arch->zs, offset)
+        : mc_lseek (tard, offset, SEEK_SET);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -405,11 +484,9 @@ tar_open_archive_int (struct vfs_class *me, const vfs_path_t * vpath, struct vfs
 static union block *
 tar_get_next_block (struct vfs_s_super *archive, int tard)
 {
-    int n;
-
-    (void) archive;
+    ssize_t n;
 
-    n = mc_read (tard, block_buf.buffer, sizeof (block_buf.buffer));
+    n = tar_read_data (archive, tard, block_buf.buffer, sizeof (block_buf.buffer));
     if (n != sizeof (block_buf.buffer))
         return NULL;            /* An error has occurred */
     current_tar_position += sizeof (block_buf.buffer);
@@ -421,10 +498,8 @@ tar_get_next_block (struct vfs_s_super *archive, int tard)
 static void
 tar_skip_n_records (struct vfs_s_super *archive, int tard, size_t n)
 {
-    (void) archive;
-
-    mc_lseek (tard, n * sizeof (block_buf.buffer), SEEK_CUR);
     current_tar_position += n * sizeof (block_buf.buffer);
+    tar_seek (archive, tard, current_tar_position);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -808,9 +883,8 @@ tar_read_header (struct vfs_class *me, struct vfs_s_super *archive, int tard, si
         inode->data_offset = data_position;
 
         if (*current_link_name != '\0')
-            inode->linkname = current_link_name;
-        else if (current_link_name != next_long_link)
-            g_free (current_link_name);
+            vfs_s_set_linkname (inode, current_link_name, -1);
+        g_free (current_link_name);
 
         entry = vfs_s_new_entry (me, p, inode);
         vfs_s_insert_entry (me, parent, entry);
@@ -842,14 +916,27 @@ tar_open_archive (struct vfs_s_super *archive, const vfs_path_t * vpath,
 {
     /* Initial status at start of archive */
     ReadStatus status = STATUS_EOFMARK;
+    const struct stat *archive_stat = NULL;
     int tard;
 
+    if (tar_open_archive_int (vpath_element->class, vpath, archive) == -1)
+        return -1;
+
+    if (vfs_file_is_local (vpath))
+        archive_stat = &TAR_SUPER (archive)->st;
+
+    if (vfs_s_index_load (archive, NULL, archive_stat))
+        return 0;
+
     current_tar_position = 0;
     /* Open for reading */
-    tard = tar_open_archive_int (vpath_element->class, vpath, archive);
+    tard = tar_open_archive_fd (archive);
     if (tard == -1)
         return -1;
 
+    /* scan headers through the big buffer to save a system call or two per member */
+    TAR_SUPER (archive)->ar = vfs_arcread_open (tard, TAR_SUPER (archive)->zs);
+
     while (TRUE)
     {
         size_t h_size = 0;
@@ -885,11 +972,10 @@ tar_open_archive (struct vfs_s_super *archive, const vfs_path_t * vpath,
                 /* Error after error */
 
             case STATUS_BADCHECKSUM:
+                tar_close_reader (archive);
                 return -1;
 
             case STATUS_EOF:
-                return 0;
-
             default:
                 break;
             }
@@ -906,6 +992,10 @@ tar_open_archive (struct vfs_s_super *archive, const vfs_path_t * vpath,
         }
         break;
     }
+
+    tar_close_reader (archive);
+    vfs_s_index_save (archive, NULL, archive_stat);
+
     return 0;
 }
 
@@ -956,15 +1046,20 @@ tar_read (void *fh, char *buffer, size_t count)
     struct vfs_class *me = VFS_FILE_HANDLER_SUPER (fh)->me;
     vfs_file_handler_t *file = VFS_FILE_HANDLER (fh);
     off_t begin = file->ino->data_offset;
-    int fd = TAR_SUPER (VFS_FILE_HANDLER_SUPER (fh))->fd;
+    struct vfs_s_super *archive = VFS_FILE_HANDLER_SUPER (fh);
+    int fd;
     ssize_t res;
 
-    if (mc_lseek (fd, begin + file->pos, SEEK_SET) != begin + file->pos)
+    fd = tar_get_fd (archive);
+    if (fd == -1)
+        ERRNOR (EIO, -1);
+
+    if (tar_seek (archive, fd, begin + file->pos) != begin + file->pos)
         ERRNOR (EIO, -1);
 
     count = MIN (count, (size_t) (file->ino->st.st_size - file->pos));
 
-    res = mc_read (fd, buffer, count);
+    res = tar_read_data (archive, fd, buffer, count);
     if (res == -1)
         ERRNOR (errno, -1);
 
@@ -995,7 +1090,7 @@ vfs_init_tarfs (void)
     /* FIXME: tarfs used own temp files */
     vfs_init_subclass (&tarfs_subclass, "tarfs", VFSF_READONLY, "utar");
     vfs_tarfs_ops->read = tar_read;
-    vfs_tarfs_ops->setctl = NULL;
+    vfs_tarfs_ops->setctl = vfs_s_archive_setctl;
     tarfs_subclass.archive_check = tar_super_check;
     tarfs_subclass.archive_same = tar_super_same;
     tarfs_subclass.new_archive = tar_new_archive;
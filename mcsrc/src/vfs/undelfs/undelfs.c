@@ -64,6 +64,7 @@
 #include "lib/global.h"
 
 #include "lib/util.h"
+#include "lib/tty/tty.h"        /* tty_got_interrupt() */
 #include "lib/widget.h"         /* message() */
 #include "lib/vfs/xdirentry.h"
 #include "lib/vfs/utilvfs.h"
@@ -105,18 +106,14 @@ struct lsdel_struct
 typedef struct
 {
     int f_index;                /* file index into delarray */
-    char *buf;
-    int error_code;             /*  */
+    char *buf;                  /* one block for reads of its part */
     off_t pos;                  /* file position */
-    off_t current;              /* used to determine current position in itereate */
-    gboolean finished;
     ext2_ino_t inode;
-    int bytes_read;
     off_t size;
 
-    /* Used by undelfs_read: */
-    char *dest_buffer;          /* destination buffer */
-    size_t count;               /* bytes to read */
+    /* Built once by undelfs_file_new, used by undelfs_read: */
+    blk_t *blocks;              /* physical block of each block of file, 0 for holes */
+    blk_t num_blocks;           /* number of blocks in file */
 } undelfs_file;
 
 /*** file scope variables ************************************************************************/
@@ -230,6 +227,8 @@ undelfs_lsdel_proc (ext2_filsys _fs, blk_t * block_nr, int blockcnt, void *priva
 /**
  * Load information about deleted files.
  * Don't abort if there is not enough memory - load as much as we can.
+ * The scan of all inodes may take long on a big file system, so it can be interrupted
+ * with Ctrl-C.
  */
 
 static int
@@ -267,10 +266,16 @@ undelfs_loaddel (void)
         goto error_out;
     }
     count = 0;
+    tty_enable_interrupt_key ();
     while (ino)
     {
         if ((count++ % 1024) == 0)
-            vfs_print_message (_("undelfs: loading deleted files information %d inodes"), count);
+        {
+            vfs_print_message (_("undelfs: loading deleted files information %d of %u inodes"),
+                               count, (unsigned int) fs->super->s_inodes_count);
+            if (tty_got_interrupt ())
+                goto error_out;
+        }
         if (inode.i_dtime == 0)
             goto next;
 
@@ -324,11 +329,13 @@ undelfs_loaddel (void)
             goto error_out;
         }
     }
+    tty_disable_interrupt_key ();
     readdir_ptr = READDIR_PTR_INIT;
     ext2fs_close_inode_scan (scan);
     return 1;
 
   error_out:
+    tty_disable_interrupt_key ();
     ext2fs_close_inode_scan (scan);
   free_block_buf:
     MC_PTR_FREE (block_buf);
@@ -372,6 +379,8 @@ undelfs_opendir (const vfs_path_t * vpath)
     if (ext2fs_open (ext2_fname, 0, 0, 0, unix_io_manager, &fs))
     {
         message (D_ERROR, undelfserr, _("Cannot open file %s"), ext2_fname);
+        fs = NULL;
+        undelfs_shutdown ();
         return 0;
     }
     vfs_print_message ("%s", _("undelfs: reading inode bitmap..."));
@@ -393,8 +402,8 @@ undelfs_opendir (const vfs_path_t * vpath)
     return fs;
   quit_opendir:
     vfs_print_message (_("%s: failure"), path_element->class->name);
-    ext2fs_close (fs);
-    fs = NULL;
+    /* forget the file system, otherwise next chdir would find it without deleted files */
+    undelfs_shutdown ();
     return 0;
 }
 
@@ -433,7 +442,68 @@ undelfs_closedir (void *vfs_info)
 }
 
 /* --------------------------------------------------------------------------------------------- */
-/* We do not support lseek */
+static int
+undelfs_map_proc (ext2_filsys param_fs, blk_t * blocknr, int blockcnt, void *private)
+{
+    undelfs_file *p = (undelfs_file *) private;
+
+    (void) param_fs;
+
+    /* indirect blocks are walked by iterator itself */
+    if (blockcnt < 0)
+        return 0;
+
+    if ((blk_t) blockcnt >= p->num_blocks)
+        return BLOCK_ABORT;
+
+    p->blocks[blockcnt] = *blocknr;
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Setup all the structures needed by read.
+ * Block list of deleted inode is walked once here: reads and seeks use the block map.
+ */
+
+static undelfs_file *
+undelfs_file_new (int f_index)
+{
+    undelfs_file *p;
+    int retval;
+
+    p = g_new0 (undelfs_file, 1);
+    p->f_index = f_index;
+    p->inode = delarray[f_index].ino;
+    p->size = delarray[f_index].size;
+    p->num_blocks = (p->size + fs->blocksize - 1) / fs->blocksize;
+
+    p->buf = g_try_malloc (fs->blocksize);
+    /* holes are left zero */
+    p->blocks = g_try_new0 (blk_t, MAX (p->num_blocks, 1));
+    if (p->buf == NULL || p->blocks == NULL)
+    {
+        message (D_ERROR, undelfserr, "%s", _("not enough memory"));
+        goto error;
+    }
+
+    retval = ext2fs_block_iterate (fs, p->inode, 0, block_buf, undelfs_map_proc, p);
+    if (retval != 0)
+    {
+        message (D_ERROR, undelfserr, _("while calling ext2_block_iterate %d"), retval);
+        goto error;
+    }
+
+    return p;
+
+  error:
+    g_free (p->blocks);
+    g_free (p->buf);
+    g_free (p);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
 
 static void *
 undelfs_open (const vfs_path_t * vpath, int flags, mode_t mode)
@@ -463,36 +533,16 @@ undelfs_open (const vfs_path_t * vpath, int flags, mode_t mode)
 
     /* Search the file into delarray */
     for (i = 0; i < (ext2_ino_t) num_delarray; i++)
-    {
-        if (inode != delarray[i].ino)
-            continue;
-
-        /* Found: setup all the structures needed by read */
-        p = (undelfs_file *) g_try_malloc (((gsize) sizeof (undelfs_file)));
-        if (!p)
-        {
-            g_free (file);
-            g_free (f);
-            return 0;
-        }
-        p->buf = g_try_malloc (fs->blocksize);
-        if (!p->buf)
+        if (inode == delarray[i].ino)
         {
-            g_free (p);
-            g_free (file);
-            g_free (f);
-            return 0;
+            p = undelfs_file_new (i);
+            break;
         }
-        p->inode = inode;
-        p->finished = FALSE;
-        p->f_index = i;
-        p->error_code = 0;
-        p->pos = 0;
-        p->size = delarray[i].size;
-    }
+
     g_free (file);
     g_free (f);
-    undelfs_usage++;
+    if (p != NULL)
+        undelfs_usage++;
     return p;
 }
 
@@ -502,6 +552,7 @@ static int
 undelfs_close (void *vfs_info)
 {
     undelfs_file *p = vfs_info;
+    g_free (p->blocks);
     g_free (p->buf);
     g_free (p);
     undelfs_usage--;
@@ -510,103 +561,67 @@ undelfs_close (void *vfs_info)
 
 /* --------------------------------------------------------------------------------------------- */
 
-static int
-undelfs_dump_read (ext2_filsys param_fs, blk_t * blocknr, int blockcnt, void *private)
+static ssize_t
+undelfs_read (void *vfs_info, char *buffer, size_t count)
 {
-    int copy_count;
-    undelfs_file *p = (undelfs_file *) private;
+    undelfs_file *p = vfs_info;
+    size_t total = 0;
 
-    if (blockcnt < 0)
+    if (p->pos >= p->size)
         return 0;
 
-    if (*blocknr)
-    {
-        p->error_code = io_channel_read_blk (param_fs->io, *blocknr, 1, p->buf);
-        if (p->error_code)
-            return BLOCK_ABORT;
-    }
-    else
-        memset (p->buf, 0, param_fs->blocksize);
+    count = MIN (count, (size_t) (p->size - p->pos));
 
-    if (p->pos + (off_t) p->count < p->current)
-    {
-        p->finished = TRUE;
-        return BLOCK_ABORT;
-    }
-    if (p->pos > p->current + param_fs->blocksize)
-    {
-        p->current += param_fs->blocksize;
-        return 0;               /* we have not arrived yet */
-    }
-
-    /* Now, we know we have to extract some data */
-    if (p->pos >= p->current)
+    while (total < count)
     {
+        blk_t index = p->pos / fs->blocksize;
+        blk_t block = p->blocks[index];
+        size_t offset = p->pos % fs->blocksize;
+        size_t n;
+        errcode_t retval = 0;
 
-        /* First case: starting pointer inside this block */
-        if (p->pos + (off_t) p->count <= p->current + param_fs->blocksize)
+        if (offset != 0 || count - total < fs->blocksize)
         {
-            /* Fully contained */
-            copy_count = p->count;
-            p->finished = (p->count != 0);
+            /* part of block */
+            n = MIN (count - total, fs->blocksize - offset);
+            if (block == 0)
+                memset (buffer + total, 0, n);
+            else
+            {
+                retval = io_channel_read_blk (fs->io, block, 1, p->buf);
+                if (retval == 0)
+                    memcpy (buffer + total, p->buf + offset, n);
+            }
         }
         else
         {
-            /* Still some more data */
-            copy_count = param_fs->blocksize - (p->pos - p->current);
+            /* whole blocks: one read for adjacent ones */
+            blk_t run, max_run;
+
+            max_run = (count - total) / fs->blocksize;
+            for (run = 1; run < max_run; run++)
+                if (p->blocks[index + run] != (block == 0 ? 0 : block + run))
+                    break;
+
+            n = (size_t) run * fs->blocksize;
+            if (block == 0)
+                memset (buffer + total, 0, n);
+            else
+                retval = io_channel_read_blk (fs->io, block, (int) run, buffer + total);
         }
-        memcpy (p->dest_buffer, p->buf + (p->pos - p->current), copy_count);
-    }
-    else
-    {
-        /* Second case: we already have passed p->pos */
-        if (p->pos + (off_t) p->count < p->current + param_fs->blocksize)
-        {
-            copy_count = (p->pos + p->count) - p->current;
-            p->finished = (p->count != 0);
-        }
-        else
+
+        if (retval != 0)
         {
-            copy_count = param_fs->blocksize;
+            message (D_ERROR, undelfserr, _("while reading block %u: %ld"), (unsigned int) block,
+                     (long) retval);
+            return total != 0 ? (ssize_t) total : -1;
         }
-        memcpy (p->dest_buffer, p->buf, copy_count);
-    }
-    p->dest_buffer += copy_count;
-    p->current += param_fs->blocksize;
-    if (p->finished)
-    {
-        return BLOCK_ABORT;
-    }
-    return 0;
-}
 
-/* --------------------------------------------------------------------------------------------- */
-
-static ssize_t
-undelfs_read (void *vfs_info, char *buffer, size_t count)
-{
-    undelfs_file *p = vfs_info;
-    int retval;
-
-    p->dest_buffer = buffer;
-    p->current = 0;
-    p->finished = FALSE;
-    p->count = count;
-
-    if (p->pos + (off_t) p->count > p->size)
-    {
-        p->count = p->size - p->pos;
-    }
-    retval = ext2fs_block_iterate (fs, p->inode, 0, NULL, undelfs_dump_read, p);
-    if (retval)
-    {
-        message (D_ERROR, undelfserr, "%s", _("while iterating over blocks"));
-        return -1;
+        total += n;
+        p->pos += n;
     }
-    if (p->error_code && !p->finished)
-        return 0;
-    p->pos = p->pos + (p->dest_buffer - buffer);
-    return p->dest_buffer - buffer;
+
+    return (ssize_t) total;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -735,15 +750,31 @@ undelfs_chdir (const vfs_path_t * vpath)
 
 /* --------------------------------------------------------------------------------------------- */
 
-/* this has to stay here for now: vfs layer does not know how to emulate it */
 static off_t
 undelfs_lseek (void *vfs_info, off_t offset, int whence)
 {
-    (void) vfs_info;
-    (void) offset;
-    (void) whence;
+    undelfs_file *p = vfs_info;
 
-    return -1;
+    switch (whence)
+    {
+    case SEEK_CUR:
+        offset += p->pos;
+        break;
+    case SEEK_END:
+        offset += p->size;
+        break;
+    default:
+        break;
+    }
+
+    if (offset < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    p->pos = offset;
+    return offset;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,944 @@
+/*
+   Virtual File System: ZIP file system.
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * \brief Source: Virtual File System: ZIP file system
+ *
+ * The directory tree is built from the central directory at the end of
+ * the archive (zip64 records are supported), so listing an archive does
+ * not touch member data. Stored members are read directly and deflated
+ * ones are inflated with zlib on the fly, without temporary files.
+ *
+ * The class uses "zip" prefix and is read-only. Encrypted members and
+ * compression methods other than stored and deflated can't be read: the
+ * user is told to open the archive with the uzip extfs helper (uzip://).
+ *
+ * Namespace: init_zipfs
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#include "lib/global.h"
+#include "lib/util.h"
+#include "lib/widget.h"         /* message() */
+
+#include "lib/vfs/vfs.h"
+#include "lib/vfs/utilvfs.h"
+#include "lib/vfs/xdirentry.h"
+#include "lib/vfs/gc.h"         /* vfs_rmstamp */
+
+#include "zip.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define ZIP_SUPER(super) ((zip_super_t *) (super))
+#define ZIP_FILE_HANDLER(fh) ((zip_fh_t *) (fh))
+
+#define ZIP_LOCAL_HEADER_SIG 0x04034b50
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_CDIR_HEADER_SIG 0x02014b50
+#define ZIP_CDIR_HEADER_SIZE 46
+#define ZIP_EOCD_SIG 0x06054b50
+#define ZIP_EOCD_SIZE 22
+#define ZIP_EOCD_MAX_COMMENT 65535
+#define ZIP64_EOCD_LOCATOR_SIG 0x07064b50
+#define ZIP64_EOCD_LOCATOR_SIZE 20
+#define ZIP64_EOCD_SIG 0x06064b50
+#define ZIP64_EOCD_SIZE 56
+
+#define ZIP_EXTRA_ZIP64 0x0001
+#define ZIP_EXTRA_TIMESTAMP 0x5455
+
+#define ZIP_FLAG_ENCRYPTED 0x0001
+
+#define ZIP_METHOD_STORED 0
+#define ZIP_METHOD_DEFLATED 8
+
+#define ZIP_HOST_UNIX 3
+
+#define ZIP_DOS_DIRECTORY 0x10
+#define ZIP_DOS_READONLY 0x01
+
+#define ZIP_BUF_SIZE (64 * 1024)
+
+/*** file scope type declarations ****************************************************************/
+
+typedef struct
+{
+    struct vfs_s_super base;    /* base class */
+
+    int fd;
+    struct stat st;
+    off_t bias;                 /* size of data prepended to the archive (e.g. SFX stub) */
+} zip_super_t;
+
+/* Decoded central directory header */
+typedef struct
+{
+    guint16 host;
+    guint16 flags;
+    guint16 method;
+    guint16 dos_time;
+    guint16 dos_date;
+    guint32 ext_attr;
+    off_t csize;
+    off_t usize;
+    off_t local_offset;
+    time_t mtime;               /* from extended timestamp, -1 if absent */
+    const char *name;
+    size_t name_len;
+    size_t length;              /* length of the whole record */
+} zip_cdir_t;
+
+/* Reader of one member */
+typedef struct
+{
+    int method;
+    off_t data_start;           /* offset of member data in the archive */
+    off_t csize;
+    off_t usize;
+    off_t in_pos;               /* compressed bytes consumed */
+    off_t out_pos;              /* uncompressed bytes produced */
+    z_stream zs;
+    gboolean zs_ready;
+    unsigned char *inbuf;
+} zip_member_t;
+
+typedef struct
+{
+    vfs_file_handler_t base;    /* base class */
+
+    zip_member_t member;
+} zip_fh_t;
+
+/*** file scope variables ************************************************************************/
+
+static struct vfs_s_subclass zipfs_subclass;
+static struct vfs_class *vfs_zipfs_ops = VFS_CLASS (&zipfs_subclass);
+
+/* --------------------------------------------------------------------------------------------- */
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+static inline guint16
+zip_get16 (const unsigned char *p)
+{
+    return (guint16) (p[0] | (p[1] << 8));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static inline guint32
+zip_get32 (const unsigned char *p)
+{
+    return (guint32) p[0] | ((guint32) p[1] << 8) | ((guint32) p[2] << 16) | ((guint32) p[3] << 24);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static inline guint64
+zip_get64 (const unsigned char *p)
+{
+    return (guint64) zip_get32 (p) | ((guint64) zip_get32 (p + 4) << 32);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read exactly @len bytes at @offset of the archive.
+ *
+ * @return TRUE on success
+ */
+
+static gboolean
+zip_pread (struct vfs_s_super *archive, off_t offset, void *buf, size_t len)
+{
+    int fd = ZIP_SUPER (archive)->fd;
+    char *p = (char *) buf;
+
+    if (mc_lseek (fd, offset, SEEK_SET) != offset)
+        return FALSE;
+
+    while (len != 0)
+    {
+        ssize_t n;
+
+        n = mc_read (fd, p, len);
+        if (n <= 0)
+            return FALSE;
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static time_t
+zip_dos_time (guint16 dos_time, guint16 dos_date)
+{
+    struct tm tm;
+
+    memset (&tm, 0, sizeof (tm));
+    tm.tm_sec = (dos_time & 0x1f) * 2;
+    tm.tm_min = (dos_time >> 5) & 0x3f;
+    tm.tm_hour = dos_time >> 11;
+    tm.tm_mday = dos_date & 0x1f;
+    tm.tm_mon = ((dos_date >> 5) & 0x0f) - 1;
+    tm.tm_year = (dos_date >> 9) + 80;
+    tm.tm_isdst = -1;
+
+    return mktime (&tm);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Decode central directory header.
+ *
+ * @param p pointer to the record
+ * @param avail number of bytes available at @p
+ * @param cd decoded header
+ *
+ * @return TRUE if record is valid and fits in @avail bytes
+ */
+
+static gboolean
+zip_parse_cdir (const unsigned char *p, size_t avail, zip_cdir_t * cd)
+{
+    size_t extra_len;
+    const unsigned char *extra, *extra_end;
+    guint32 csize, usize, offset;
+
+    if (avail < ZIP_CDIR_HEADER_SIZE || zip_get32 (p) != ZIP_CDIR_HEADER_SIG)
+        return FALSE;
+
+    cd->host = zip_get16 (p + 4) >> 8;
+    cd->flags = zip_get16 (p + 8);
+    cd->method = zip_get16 (p + 10);
+    cd->dos_time = zip_get16 (p + 12);
+    cd->dos_date = zip_get16 (p + 14);
+    csize = zip_get32 (p + 20);
+    usize = zip_get32 (p + 24);
+    cd->name_len = zip_get16 (p + 28);
+    extra_len = zip_get16 (p + 30);
+    cd->ext_attr = zip_get32 (p + 38);
+    offset = zip_get32 (p + 42);
+    cd->length = ZIP_CDIR_HEADER_SIZE + cd->name_len + extra_len + zip_get16 (p + 32);
+
+    /* the comment is not needed to open a member, so allow it to be absent */
+    if (avail < ZIP_CDIR_HEADER_SIZE + cd->name_len + extra_len)
+        return FALSE;
+
+    cd->name = (const char *) p + ZIP_CDIR_HEADER_SIZE;
+    cd->csize = csize;
+    cd->usize = usize;
+    cd->local_offset = offset;
+    cd->mtime = -1;
+
+    extra = p + ZIP_CDIR_HEADER_SIZE + cd->name_len;
+    extra_end = extra + extra_len;
+
+    while (extra + 4 <= extra_end)
+    {
+        guint16 id, size;
+        const unsigned char *data;
+
+        id = zip_get16 (extra);
+        size = zip_get16 (extra + 2);
+        data = extra + 4;
+        if (data + size > extra_end)
+            break;
+
+        if (id == ZIP_EXTRA_ZIP64)
+        {
+            const unsigned char *d = data;
+
+            /* only fields saturated in the main record are present, in this order */
+            if (usize == 0xFFFFFFFF && d + 8 <= data + size)
+            {
+                cd->usize = (off_t) zip_get64 (d);
+                d += 8;
+            }
+            if (csize == 0xFFFFFFFF && d + 8 <= data + size)
+            {
+                cd->csize = (off_t) zip_get64 (d);
+                d += 8;
+            }
+            if (offset == 0xFFFFFFFF && d + 8 <= data + size)
+                cd->local_offset = (off_t) zip_get64 (d);
+        }
+        else if (id == ZIP_EXTRA_TIMESTAMP && size >= 5 && (data[0] & 1) != 0)
+            cd->mtime = (time_t) (gint32) zip_get32 (data + 1);
+
+        extra = data + size;
+    }
+
+    return (cd->csize >= 0 && cd->usize >= 0 && cd->local_offset >= 0);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*
+ * Locate the central directory.
+ *
+ * @return TRUE on success, @cd_offset is the absolute offset of the central directory
+ */
+
+static gboolean
+zip_find_cdir (struct vfs_s_super *archive, off_t * cd_offset, off_t * cd_size)
+{
+    zip_super_t *arch = ZIP_SUPER (archive);
+    unsigned char *buf, *p = NULL;
+    size_t tail_len, i;
+    off_t tail_offset, eocd_offset, cd_end, offset;
+    gboolean ret = FALSE;
+
+    if (arch->st.st_size < ZIP_EOCD_SIZE)
+        return FALSE;
+
+    tail_len = (size_t) MIN (arch->st.st_size, ZIP_EOCD_SIZE + ZIP_EOCD_MAX_COMMENT);
+    tail_offset = arch->st.st_size - (off_t) tail_len;
+
+    buf = g_malloc (tail_len);
+    if (!zip_pread (archive, tail_offset, buf, tail_len))
+        goto ret;
+
+    /* scan backwards over the archive comment */
+    for (i = tail_len - ZIP_EOCD_SIZE + 1; i != 0 && p == NULL; i--)
+        if (zip_get32 (buf + i - 1) == ZIP_EOCD_SIG
+            && i - 1 + ZIP_EOCD_SIZE + zip_get16 (buf + i - 1 + 20) <= tail_len)
+            p = buf + i - 1;
+
+    if (p == NULL)
+        goto ret;
+
+    eocd_offset = tail_offset + (p - buf);
+    *cd_size = zip_get32 (p + 12);
+    offset = zip_get32 (p + 16);
+    cd_end = eocd_offset;
+
+    if (eocd_offset >= ZIP64_EOCD_LOCATOR_SIZE)
+    {
+        unsigned char loc[ZIP64_EOCD_LOCATOR_SIZE];
+        unsigned char rec[ZIP64_EOCD_SIZE];
+
+        if (zip_pread (archive, eocd_offset - ZIP64_EOCD_LOCATOR_SIZE, loc, sizeof (loc))
+            && zip_get32 (loc) == ZIP64_EOCD_LOCATOR_SIG)
+        {
+            off_t zip64_offset;
+
+            zip64_offset = (off_t) zip_get64 (loc + 8);
+            /* the record is right before the locator, account for prepended data */
+            cd_end = eocd_offset - ZIP64_EOCD_LOCATOR_SIZE - ZIP64_EOCD_SIZE;
+            if (cd_end < 0 || !zip_pread (archive, cd_end, rec, sizeof (rec))
+                || zip_get32 (rec) != ZIP64_EOCD_SIG)
+            {
+                cd_end = zip64_offset;
+                if (!zip_pread (archive, cd_end, rec, sizeof (rec))
+                    || zip_get32 (rec) != ZIP64_EOCD_SIG)
+                    goto ret;
+            }
+
+            *cd_size = (off_t) zip_get64 (rec + 40);
+            offset = (off_t) zip_get64 (rec + 48);
+        }
+    }
+
+    if (*cd_size < 0 || offset < 0 || cd_end < *cd_size)
+        goto ret;
+
+    *cd_offset = cd_end - *cd_size;
+    arch->bias = *cd_offset - offset;
+    ret = arch->bias >= 0;
+
+  ret:
+    g_free (buf);
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zip_member_close (zip_member_t * m)
+{
+    if (m->zs_ready)
+    {
+        inflateEnd (&m->zs);
+        m->zs_ready = FALSE;
+    }
+
+    MC_PTR_FREE (m->inbuf);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Prepare reading of member described by central directory header at @cdir_offset.
+ *
+ * @return 0 on success, errno value on failure
+ */
+
+static int
+zip_member_open (struct vfs_s_super *archive, off_t cdir_offset, zip_member_t * m)
+{
+    unsigned char header[ZIP_CDIR_HEADER_SIZE];
+    unsigned char local[ZIP_LOCAL_HEADER_SIZE];
+    unsigned char *buf;
+    zip_cdir_t cd;
+    size_t len;
+    gboolean ok;
+    off_t local_offset;
+
+    memset (m, 0, sizeof (*m));
+
+    if (!zip_pread (archive, cdir_offset, header, sizeof (header)))
+        return EIO;
+
+    /* re-read the record with its name and extra field */
+    len = ZIP_CDIR_HEADER_SIZE + zip_get16 (header + 28) + zip_get16 (header + 30);
+    buf = g_malloc (len);
+    ok = zip_pread (archive, cdir_offset, buf, len) && zip_parse_cdir (buf, len, &cd);
+    g_free (buf);
+    if (!ok)
+        return EIO;
+
+    if ((cd.flags & ZIP_FLAG_ENCRYPTED) != 0)
+        return EACCES;
+    if (cd.method != ZIP_METHOD_STORED && cd.method != ZIP_METHOD_DEFLATED)
+        return EOPNOTSUPP;
+
+    /* name and extra field of local header may differ from the central ones */
+    local_offset = cd.local_offset + ZIP_SUPER (archive)->bias;
+    if (!zip_pread (archive, local_offset, local, sizeof (local))
+        || zip_get32 (local) != ZIP_LOCAL_HEADER_SIG)
+        return EIO;
+
+    m->method = cd.method;
+    m->data_start =
+        local_offset + ZIP_LOCAL_HEADER_SIZE + zip_get16 (local + 26) + zip_get16 (local + 28);
+    m->csize = cd.csize;
+    m->usize = cd.usize;
+
+    if (m->method == ZIP_METHOD_DEFLATED)
+    {
+        if (inflateInit2 (&m->zs, -MAX_WBITS) != Z_OK)
+            return ENOMEM;
+        m->zs_ready = TRUE;
+        m->inbuf = g_malloc (ZIP_BUF_SIZE);
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+zip_member_read (struct vfs_s_super *archive, zip_member_t * m, char *buffer, size_t count)
+{
+    size_t done;
+
+    count = (size_t) MIN ((off_t) count, m->usize - m->out_pos);
+    if (count == 0)
+        return 0;
+
+    if (m->method == ZIP_METHOD_STORED)
+    {
+        count = (size_t) MIN ((off_t) count, m->csize - m->out_pos);
+        if (!zip_pread (archive, m->data_start + m->out_pos, buffer, count))
+            return -1;
+        m->out_pos += count;
+        return (ssize_t) count;
+    }
+
+    m->zs.next_out = (Bytef *) buffer;
+    m->zs.avail_out = (uInt) count;
+
+    while (m->zs.avail_out != 0)
+    {
+        int err;
+
+        if (m->zs.avail_in == 0)
+        {
+            size_t len;
+
+            if (m->in_pos >= m->csize)
+                break;          /* truncated member */
+
+            len = (size_t) MIN ((off_t) ZIP_BUF_SIZE, m->csize - m->in_pos);
+            if (!zip_pread (archive, m->data_start + m->in_pos, m->inbuf, len))
+                return -1;
+            m->in_pos += len;
+            m->zs.next_in = m->inbuf;
+            m->zs.avail_in = (uInt) len;
+        }
+
+        err = inflate (&m->zs, Z_NO_FLUSH);
+        if (err == Z_STREAM_END)
+            break;
+        if (err != Z_OK)
+            return -1;
+    }
+
+    done = count - m->zs.avail_out;
+    m->out_pos += done;
+    return (ssize_t) done;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Set read position of member. Deflate streams have no seek points, so backward seek
+ * restarts inflating from the beginning of the member.
+ */
+
+static gboolean
+zip_member_seek (struct vfs_s_super *archive, zip_member_t * m, off_t offset)
+{
+    char buf[BUF_8K];
+
+    if (m->method == ZIP_METHOD_STORED)
+    {
+        m->out_pos = offset;
+        return TRUE;
+    }
+
+    if (offset < m->out_pos)
+    {
+        if (inflateReset (&m->zs) != Z_OK)
+            return FALSE;
+        m->zs.avail_in = 0;
+        m->in_pos = 0;
+        m->out_pos = 0;
+    }
+
+    while (m->out_pos < offset)
+    {
+        ssize_t n;
+
+        n = zip_member_read (archive, m, buf, (size_t) MIN ((off_t) sizeof (buf),
+                                                            offset - m->out_pos));
+        if (n <= 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zip_read_link (struct vfs_s_super *archive, struct vfs_s_inode *inode)
+{
+    zip_member_t m;
+    char buf[MC_MAXPATHLEN];
+    ssize_t n;
+
+    if (zip_member_open (archive, inode->data_offset, &m) == 0)
+    {
+        n = zip_member_read (archive, &m, buf, sizeof (buf) - 1);
+        if (n > 0)
+            vfs_s_set_linkname (inode, buf, n);
+    }
+
+    zip_member_close (&m);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zip_fill_stat (struct vfs_s_super *archive, const zip_cdir_t * cd, gboolean is_dir,
+               struct stat *st)
+{
+    zip_super_t *arch = ZIP_SUPER (archive);
+    mode_t mode = 0;
+
+    memset (st, 0, sizeof (*st));
+
+    if (cd->host == ZIP_HOST_UNIX)
+        mode = (mode_t) (cd->ext_attr >> 16);
+
+    if ((mode & S_IFMT) == 0)
+    {
+        gboolean dir = is_dir || (cd->ext_attr & ZIP_DOS_DIRECTORY) != 0;
+
+        if ((mode & 07777) == 0)
+        {
+            mode = dir ? 0755 : 0644;
+            if ((cd->ext_attr & ZIP_DOS_READONLY) != 0)
+                mode &= ~0222;
+        }
+        mode |= dir ? S_IFDIR : S_IFREG;
+    }
+
+    /* trailing slash always means directory */
+    if (is_dir)
+        mode = S_IFDIR | (mode & 07777);
+
+    st->st_mode = mode;
+    st->st_uid = arch->st.st_uid;
+    st->st_gid = arch->st.st_gid;
+    st->st_size = S_ISDIR (mode) ? 0 : cd->usize;
+    st->st_mtime = cd->mtime != -1 ? cd->mtime : zip_dos_time (cd->dos_time, cd->dos_date);
+    st->st_atime = st->st_mtime;
+    st->st_ctime = st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
+    st->st_blksize = 8 * 1024;  /* FIXME */
+#endif
+    vfs_adjust_stat (st);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+zip_add_entry (struct vfs_class *me, struct vfs_s_super *archive, const zip_cdir_t * cd,
+               off_t cdir_offset)
+{
+    struct stat st;
+    struct vfs_s_entry *entry;
+    struct vfs_s_inode *inode, *parent;
+    char *name, *p, *q;
+    size_t len;
+    gboolean is_dir;
+
+    name = g_strndup (cd->name, cd->name_len);
+    len = strlen (name);
+    is_dir = len != 0 && IS_PATH_SEP (name[len - 1]);
+
+    canonicalize_pathname (name);
+    len = strlen (name);
+
+    /* skip entries for the root directory */
+    if (len == 0 || strcmp (name, PATH_SEP_STR) == 0 || strcmp (name, ".") == 0)
+    {
+        g_free (name);
+        return TRUE;
+    }
+
+    p = strrchr (name, PATH_SEP);
+    if (p == NULL)
+    {
+        p = name;
+        q = name + len;         /* "" */
+    }
+    else
+    {
+        *(p++) = '\0';
+        q = name;
+    }
+
+    parent = vfs_s_find_inode (me, archive, q, LINK_NO_FOLLOW, FL_MKDIR);
+    if (parent == NULL)
+    {
+        g_free (name);
+        return FALSE;
+    }
+
+    zip_fill_stat (archive, cd, is_dir, &st);
+
+    if (S_ISDIR (st.st_mode))
+    {
+        entry = VFS_SUBCLASS (me)->find_entry (me, parent, p, LINK_NO_FOLLOW, FL_NONE);
+        if (entry != NULL)
+        {
+            /* directory was created for one of previous entries: update its attributes */
+            entry->ino->st.st_mode = st.st_mode;
+            entry->ino->st.st_mtime = st.st_mtime;
+            entry->ino->st.st_atime = st.st_atime;
+            entry->ino->st.st_ctime = st.st_ctime;
+            g_free (name);
+            return TRUE;
+        }
+    }
+
+    inode = vfs_s_new_inode (me, archive, &st);
+    inode->data_offset = cdir_offset;
+
+    if (S_ISLNK (st.st_mode))
+        zip_read_link (archive, inode);
+
+    entry = vfs_s_new_entry (me, p, inode);
+    vfs_s_insert_entry (me, parent, entry);
+    g_free (name);
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+zip_read_cdir (struct vfs_class *me, struct vfs_s_super *archive)
+{
+    off_t cd_offset, cd_size;
+    unsigned char *buf;
+    size_t pos;
+    int ret = -1;
+
+    if (!zip_find_cdir (archive, &cd_offset, &cd_size)
+        || cd_offset + cd_size > ZIP_SUPER (archive)->st.st_size)
+        return -1;
+
+    buf = g_malloc ((gsize) cd_size);
+    if (!zip_pread (archive, cd_offset, buf, (size_t) cd_size))
+        goto ret;
+
+    /* don't trust number of entries: it is truncated in archives with >65535 ones */
+    for (pos = 0; pos < (size_t) cd_size;)
+    {
+        zip_cdir_t cd;
+
+        if (!zip_parse_cdir (buf + pos, (size_t) cd_size - pos, &cd)
+            || !zip_add_entry (me, archive, &cd, cd_offset + (off_t) pos))
+            goto ret;
+
+        pos += cd.length;
+    }
+
+    ret = 0;
+
+  ret:
+    g_free (buf);
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_super *
+zip_new_archive (struct vfs_class *me)
+{
+    zip_super_t *arch;
+
+    arch = g_new0 (zip_super_t, 1);
+    arch->base.me = me;
+    arch->fd = -1;
+
+    return VFS_SUPER (arch);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zip_free_archive (struct vfs_class *me, struct vfs_s_super *archive)
+{
+    zip_super_t *arch = ZIP_SUPER (archive);
+
+    (void) me;
+
+    if (arch->fd != -1)
+    {
+        mc_close (arch->fd);
+        arch->fd = -1;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+zip_open_archive (struct vfs_s_super *archive, const vfs_path_t * vpath,
+                  const vfs_path_element_t * vpath_element)
+{
+    struct vfs_class *me = vpath_element->class;
+    zip_super_t *arch = ZIP_SUPER (archive);
+    mode_t mode;
+    struct vfs_s_inode *root;
+
+    arch->fd = mc_open (vpath, O_RDONLY);
+    if (arch->fd == -1 || mc_fstat (arch->fd, &arch->st) == -1)
+    {
+        message (D_ERROR, MSG_ERROR, _("Cannot open zip archive\n%s"), vfs_path_as_str (vpath));
+        ERRNOR (ENOENT, -1);
+    }
+
+    archive->name = g_strdup (vfs_path_as_str (vpath));
+
+    mode = arch->st.st_mode & 07777;
+    if (mode & 0400)
+        mode |= 0100;
+    if (mode & 0040)
+        mode |= 0010;
+    if (mode & 0004)
+        mode |= 0001;
+    mode |= S_IFDIR;
+
+    root = vfs_s_new_inode (me, archive, &arch->st);
+    root->st.st_mode = mode;
+    root->data_offset = -1;
+    root->st.st_nlink++;
+    root->st.st_dev = VFS_SUBCLASS (me)->rdev++;
+
+    archive->root = root;
+
+    if (zip_read_cdir (me, archive) == -1)
+    {
+        message (D_ERROR, MSG_ERROR, _("%s\ndoesn't look like a zip archive."),
+                 vfs_path_as_str (vpath));
+        ERRNOR (EIO, -1);
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void *
+zip_super_check (const vfs_path_t * vpath)
+{
+    static struct stat stat_buf;
+    int stat_result;
+
+    stat_result = mc_stat (vpath, &stat_buf);
+
+    return (stat_result != 0) ? NULL : &stat_buf;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+zip_super_same (const vfs_path_element_t * vpath_element, struct vfs_s_super *parc,
+                const vfs_path_t * vpath, void *cookie)
+{
+    struct stat *archive_stat = cookie; /* stat of main archive */
+
+    (void) vpath_element;
+
+    if (strcmp (parc->name, vfs_path_as_str (vpath)) != 0)
+        return 0;
+
+    /* Has the cached archive been changed on the disk? */
+    if (ZIP_SUPER (parc)->st.st_mtime < archive_stat->st_mtime
+        || ZIP_SUPER (parc)->st.st_size != archive_stat->st_size)
+    {
+        /* Yes, reload! */
+        vfs_zipfs_ops->free ((vfsid) parc);
+        vfs_rmstamp (vfs_zipfs_ops, (vfsid) parc);
+        return 2;
+    }
+    /* Hasn't been modified, give it a new timeout */
+    vfs_stamp (vfs_zipfs_ops, (vfsid) parc);
+    return 1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+zip_read (void *fh, char *buffer, size_t count)
+{
+    struct vfs_s_super *archive = VFS_FILE_HANDLER_SUPER (fh);
+    struct vfs_class *me = archive->me;
+    vfs_file_handler_t *file = VFS_FILE_HANDLER (fh);
+    zip_member_t *m = &ZIP_FILE_HANDLER (fh)->member;
+    ssize_t res;
+
+    if (m->out_pos != file->pos && !zip_member_seek (archive, m, file->pos))
+        ERRNOR (EIO, -1);
+
+    res = zip_member_read (archive, m, buffer, count);
+    if (res == -1)
+        ERRNOR (EIO, -1);
+
+    file->pos += res;
+    return res;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static vfs_file_handler_t *
+zip_fh_new (struct vfs_s_inode *ino, gboolean changed)
+{
+    zip_fh_t *fh;
+
+    fh = g_new0 (zip_fh_t, 1);
+    vfs_s_init_fh (VFS_FILE_HANDLER (fh), ino, changed);
+
+    return VFS_FILE_HANDLER (fh);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+zip_fh_open (struct vfs_class *me, vfs_file_handler_t * fh, int flags, mode_t mode)
+{
+    int err;
+
+    (void) mode;
+
+    if ((flags & O_ACCMODE) != O_RDONLY)
+        ERRNOR (EROFS, -1);
+
+    err = zip_member_open (fh->ino->super, fh->ino->data_offset, &ZIP_FILE_HANDLER (fh)->member);
+    if (err == EACCES || err == EOPNOTSUPP)
+    {
+        char *name;
+
+        /* the uzip extfs helper runs unzip, which can deal with such members */
+        name = vfs_s_fullpath (me, fh->ino);
+        message (D_ERROR, MSG_ERROR,
+                 err == EACCES ?
+                 _("Member of zip archive is encrypted\n%s\n"
+                   "Open the archive with uzip:// to extract it") :
+                 _("Member of zip archive is compressed with unsupported method\n%s\n"
+                   "Open the archive with uzip:// to extract it"), name);
+        g_free (name);
+    }
+    if (err != 0)
+        ERRNOR (err, -1);
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+zip_fh_free (vfs_file_handler_t * fh)
+{
+    zip_member_close (&ZIP_FILE_HANDLER (fh)->member);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+void
+vfs_init_zipfs (void)
+{
+    vfs_init_subclass (&zipfs_subclass, "zipfs", VFSF_READONLY, "zip");
+    vfs_zipfs_ops->read = zip_read;
+    /* members are copied in order of their central directory records, which is the order
+       of the data in archives written by usual tools */
+    vfs_zipfs_ops->setctl = vfs_s_archive_setctl;
+    zipfs_subclass.archive_check = zip_super_check;
+    zipfs_subclass.archive_same = zip_super_same;
+    zipfs_subclass.new_archive = zip_new_archive;
+    zipfs_subclass.open_archive = zip_open_archive;
+    zipfs_subclass.free_archive = zip_free_archive;
+    zipfs_subclass.fh_new = zip_fh_new;
+    zipfs_subclass.fh_open = zip_fh_open;
+    zipfs_subclass.fh_free = zip_fh_free;
+    vfs_register_class (vfs_zipfs_ops);
+}
+
+/* --------------------------------------------------------------------------------------------- */
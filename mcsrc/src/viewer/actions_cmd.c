@@ -224,9 +224,7 @@ mcview_handle_editkey (WView * view, int key)
     int byte_val = -1;
 
     /* Has there been a change at this position? */
-    node = view->change_list;
-    while ((node != NULL) && (node->offset != view->hex_cursor))
-        node = node->next;
+    node = mcview_hexedit_find_change (view, view->hex_cursor);
 
     if (!view->hexview_in_text)
     {
@@ -267,12 +265,7 @@ mcview_handle_editkey (WView * view, int key)
         view->locked = lock_file (view->filename_vpath);
 
     if (node == NULL)
-    {
-        node = g_new (struct hexedit_change_node, 1);
-        node->offset = view->hex_cursor;
-        node->value = byte_val;
-        mcview_enqueue_change (&view->change_list, node);
-    }
+        mcview_enqueue_change (view, view->hex_cursor, byte_val);
     else
         node->value = byte_val;
 
@@ -50,10 +50,19 @@
    data source. If the growing buffer is used, this size may increase
    later on. Use the mcview_may_still_grow() function when you want to
    know if the size can change later.
+
+   Data of a file is kept in blocks of VIEW_FILE_BLOCK bytes, up to
+   mcview_cache_size KiB of them; the least recently used are dropped.
+   A miss right after the range read last time is taken as reading forward
+   and one right before it as reading backward (scrolling up, searching
+   for the beginning of a line), and the next range read in that direction
+   is doubled up to VIEW_FILE_MAX_AHEAD blocks.
  */
 
 #include <config.h>
 
+#include <string.h>
+
 #include "lib/global.h"
 #include "lib/vfs/vfs.h"
 #include "lib/util.h"
@@ -65,8 +74,19 @@
 
 /*** file scope macro definitions ****************************************************************/
 
+#define VIEW_FILE_BLOCK (64 * 1024)
+#define VIEW_FILE_MAX_AHEAD 16
+
 /*** file scope type declarations ****************************************************************/
 
+typedef struct
+{
+    gint64 index;               /* number of block in file, hash key */
+    GList link;                 /* in LRU queue */
+    size_t len;                 /* less than VIEW_FILE_BLOCK at end of file */
+    byte data[VIEW_FILE_BLOCK];
+} mcview_file_block_t;
+
 /*** file scope variables ************************************************************************/
 
 /* --------------------------------------------------------------------------------------------- */
@@ -87,6 +107,170 @@ mcview_set_datasource_stdio_pipe (WView * view, mc_pipe_t * p)
     mcview_growbuf_init (view);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+
+static guint
+mcview_file_max_blocks (void)
+{
+    return (guint) MAX (mcview_cache_size / (VIEW_FILE_BLOCK / 1024), 2);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+mcview_file_add_block (WView * view, mcview_file_block_t * blk)
+{
+    const guint max_blocks = mcview_file_max_blocks ();
+
+    g_hash_table_insert (view->ds_file_blocks, &blk->index, blk);
+    g_queue_push_head_link (&view->ds_file_lru, &blk->link);
+
+    while (view->ds_file_lru.length > max_blocks)
+    {
+        blk = (mcview_file_block_t *) g_queue_peek_tail (&view->ds_file_lru);
+        g_queue_unlink (&view->ds_file_lru, &blk->link);
+        g_hash_table_remove (view->ds_file_blocks, &blk->index);
+        g_free (blk);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+mcview_file_drop_block (WView * view, gint64 index)
+{
+    mcview_file_block_t *blk;
+
+    blk = (mcview_file_block_t *) g_hash_table_lookup (view->ds_file_blocks, &index);
+    if (blk != NULL)
+    {
+        g_queue_unlink (&view->ds_file_lru, &blk->link);
+        g_hash_table_remove (view->ds_file_blocks, &blk->index);
+        g_free (blk);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+mcview_file_drop_blocks (WView * view)
+{
+    GList *link;
+
+    while ((link = g_queue_pop_head_link (&view->ds_file_lru)) != NULL)
+        g_free (link->data);
+    g_hash_table_remove_all (view->ds_file_blocks);
+
+    view->ds_file_first = -1;
+    view->ds_file_next = -1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+mcview_file_is_cached (WView * view, gint64 index)
+{
+    return g_hash_table_lookup (view->ds_file_blocks, &index) != NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read block with given index together with the blocks ahead of or behind it.
+ *
+ * @return the block, or NULL on error
+ */
+
+static mcview_file_block_t *
+mcview_file_fetch (WView * view, gint64 index)
+{
+    mcview_file_block_t *blk[VIEW_FILE_MAX_AHEAD];
+    gint64 first, last, last_block, ahead, i;
+    gboolean backward;
+
+    backward = index == view->ds_file_first - 1;
+    if (index == view->ds_file_next || backward)
+        view->ds_file_ahead *= 2;
+    else
+        view->ds_file_ahead = 1;
+    view->ds_file_ahead = MIN (view->ds_file_ahead, VIEW_FILE_MAX_AHEAD);
+    ahead = MIN (view->ds_file_ahead, (gint64) mcview_file_max_blocks ());
+
+    /* read up to the nearest cached block */
+    last_block = (view->ds_file_filesize - 1) / VIEW_FILE_BLOCK;
+    first = index;
+    last = index;
+    if (backward)
+        while (last - first + 1 < ahead && first > 0 && !mcview_file_is_cached (view, first - 1))
+            first--;
+    else
+        while (last - first + 1 < ahead && last < last_block
+               && !mcview_file_is_cached (view, last + 1))
+            last++;
+
+    view->ds_file_first = -1;
+    view->ds_file_next = -1;
+
+    if (mc_lseek (view->ds_file_fd, (off_t) first * VIEW_FILE_BLOCK, SEEK_SET) == -1)
+        return NULL;
+
+    for (i = first; i <= last; i++)
+    {
+        mcview_file_block_t *b;
+
+        b = g_new (mcview_file_block_t, 1);
+        b->index = i;
+        b->len = 0;
+        b->link.data = b;
+        b->link.prev = b->link.next = NULL;
+        blk[i - first] = b;
+
+        while (b->len < VIEW_FILE_BLOCK)
+        {
+            ssize_t res;
+
+            res = mc_read (view->ds_file_fd, b->data + b->len, VIEW_FILE_BLOCK - b->len);
+            if (res == -1)
+            {
+                for (; i >= first; i--)
+                    g_free (blk[i - first]);
+                return NULL;
+            }
+            if (res == 0)
+                break;
+            b->len += (size_t) res;
+        }
+
+        /* the file has grown in the meantime -- stick to the old size */
+        b->len =
+            (size_t) MIN ((off_t) b->len, view->ds_file_filesize - (off_t) i * VIEW_FILE_BLOCK);
+
+        /* the file may have shrunk in the meantime */
+        if (b->len < VIEW_FILE_BLOCK)
+        {
+            last = i;
+            break;
+        }
+    }
+
+    if (index > last)
+    {
+        for (i = first; i <= last; i++)
+            g_free (blk[i - first]);
+        return NULL;
+    }
+
+    /* add requested block last to keep it the most recently used */
+    for (i = first; i <= last; i++)
+        if (i != index)
+            mcview_file_add_block (view, blk[i - first]);
+    mcview_file_add_block (view, blk[index - first]);
+
+    view->ds_file_first = first;
+    view->ds_file_next = last + 1;
+
+    return blk[index - first];
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /*** public functions ****************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -124,8 +308,24 @@ mcview_update_filesize (WView * view)
     if (view->datasource == DS_FILE)
     {
         struct stat st;
-        if (mc_fstat (view->ds_file_fd, &st) != -1)
-            view->ds_file_filesize = st.st_size;
+
+        if (mc_fstat (view->ds_file_fd, &st) == -1 || st.st_size == view->ds_file_filesize)
+            return;
+
+        view->ds_file_datalen = 0;
+        if (st.st_size < view->ds_file_filesize)
+        {
+            /* the file was truncated */
+            mcview_file_drop_blocks (view);
+        }
+        else
+        {
+            /* the last block has grown */
+            mcview_file_drop_block (view, view->ds_file_filesize / VIEW_FILE_BLOCK);
+            view->ds_file_next = -1;
+        }
+
+        view->ds_file_filesize = st.st_size;
     }
 }
 
@@ -142,6 +342,43 @@ mcview_get_ptr_file (WView * view, off_t byte_index)
     return NULL;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get pointer to data at byte_index and the length of data available there
+ * without another read.
+ */
+
+const char *
+mcview_get_ptr_block (WView * view, off_t byte_index, size_t * len)
+{
+    const char *str = NULL;
+
+    *len = 0;
+
+    switch (view->datasource)
+    {
+    case DS_STDIO_PIPE:
+    case DS_VFS_PIPE:
+        str = mcview_get_block_growing_buffer (view, byte_index, len);
+        break;
+    case DS_FILE:
+        str = mcview_get_ptr_file (view, byte_index);
+        if (str != NULL)
+            *len = view->ds_file_offset + (off_t) view->ds_file_datalen - byte_index;
+        break;
+    case DS_STRING:
+        str = mcview_get_ptr_string (view, byte_index);
+        if (str != NULL)
+            *len = view->ds_string_len - byte_index;
+        break;
+    case DS_NONE:
+    default:
+        break;
+    }
+
+    return str;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 /* Invalid UTF-8 is reported as negative integers (one for each byte),
@@ -150,6 +387,7 @@ gboolean
 mcview_get_utf (WView * view, off_t byte_index, int *ch, int *ch_len)
 {
     gchar *str = NULL;
+    gssize max_len = -1;
     int res;
     gchar utf8buf[UTF8_CHAR_LEN + 1];
 
@@ -157,10 +395,20 @@ mcview_get_utf (WView * view, off_t byte_index, int *ch, int *ch_len)
     {
     case DS_STDIO_PIPE:
     case DS_VFS_PIPE:
-        str = mcview_get_ptr_growing_buffer (view, byte_index);
+        {
+            size_t len;
+
+            /* pages of growing buffer aren't contiguous */
+            str = (gchar *) mcview_get_block_growing_buffer (view, byte_index, &len);
+            if (str != NULL)
+                max_len = len;
+        }
         break;
     case DS_FILE:
         str = mcview_get_ptr_file (view, byte_index);
+        /* cached block isn't terminated */
+        if (str != NULL)
+            max_len = view->ds_file_offset + (off_t) view->ds_file_datalen - byte_index;
         break;
     case DS_STRING:
         str = mcview_get_ptr_string (view, byte_index);
@@ -175,7 +423,7 @@ mcview_get_utf (WView * view, off_t byte_index, int *ch, int *ch_len)
     if (str == NULL)
         return FALSE;
 
-    res = g_utf8_get_char_validated (str, -1);
+    res = g_utf8_get_char_validated (str, max_len);
 
     if (res < 0)
     {
@@ -272,7 +520,9 @@ mcview_set_byte (WView * view, off_t offset, byte b)
     g_assert (offset < mcview_get_filesize (view));
     g_assert (view->datasource == DS_FILE);
 
-    view->ds_file_datalen = 0;  /* just force reloading */
+    /* just force reloading */
+    view->ds_file_datalen = 0;
+    mcview_file_drop_block (view, offset / VIEW_FILE_BLOCK);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -281,48 +531,36 @@ mcview_set_byte (WView * view, off_t offset, byte b)
 void
 mcview_file_load_data (WView * view, off_t byte_index)
 {
-    off_t blockoffset;
-    ssize_t res;
-    size_t bytes_read;
+    gint64 index;
+    mcview_file_block_t *blk;
 
     g_assert (view->datasource == DS_FILE);
 
     if (mcview_already_loaded (view->ds_file_offset, byte_index, view->ds_file_datalen))
         return;
 
-    if (byte_index >= view->ds_file_filesize)
+    if (byte_index < 0 || byte_index >= view->ds_file_filesize)
         return;
 
-    blockoffset = mcview_offset_rounddown (byte_index, view->ds_file_datasize);
-    if (mc_lseek (view->ds_file_fd, blockoffset, SEEK_SET) == -1)
-        goto error;
-
-    bytes_read = 0;
-    while (bytes_read < view->ds_file_datasize)
+    index = byte_index / VIEW_FILE_BLOCK;
+    blk = (mcview_file_block_t *) g_hash_table_lookup (view->ds_file_blocks, &index);
+    if (blk == NULL)
+        blk = mcview_file_fetch (view, index);
+    else if (view->ds_file_lru.head != &blk->link)
     {
-        res =
-            mc_read (view->ds_file_fd, view->ds_file_data + bytes_read,
-                     view->ds_file_datasize - bytes_read);
-        if (res == -1)
-            goto error;
-        if (res == 0)
-            break;
-        bytes_read += (size_t) res;
+        g_queue_unlink (&view->ds_file_lru, &blk->link);
+        g_queue_push_head_link (&view->ds_file_lru, &blk->link);
     }
-    view->ds_file_offset = blockoffset;
-    if ((off_t) bytes_read > view->ds_file_filesize - view->ds_file_offset)
-    {
-        /* the file has grown in the meantime -- stick to the old size */
-        view->ds_file_datalen = view->ds_file_filesize - view->ds_file_offset;
-    }
-    else
+
+    if (blk == NULL)
     {
-        view->ds_file_datalen = bytes_read;
+        view->ds_file_datalen = 0;
+        return;
     }
-    return;
 
-  error:
-    view->ds_file_datalen = 0;
+    view->ds_file_offset = (off_t) index * VIEW_FILE_BLOCK;
+    view->ds_file_data = blk->data;
+    view->ds_file_datalen = blk->len;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -350,7 +588,10 @@ mcview_close_datasource (WView * view)
     case DS_FILE:
         (void) mc_close (view->ds_file_fd);
         view->ds_file_fd = -1;
-        MC_PTR_FREE (view->ds_file_data);
+        mcview_file_drop_blocks (view);
+        g_hash_table_destroy (view->ds_file_blocks);
+        view->ds_file_blocks = NULL;
+        view->ds_file_data = NULL;
         break;
     case DS_STRING:
         MC_PTR_FREE (view->ds_string_data);
@@ -369,9 +610,13 @@ mcview_set_datasource_file (WView * view, int fd, const struct stat *st)
     view->ds_file_fd = fd;
     view->ds_file_filesize = st->st_size;
     view->ds_file_offset = 0;
-    view->ds_file_data = g_malloc (4096);
+    view->ds_file_data = NULL;
     view->ds_file_datalen = 0;
-    view->ds_file_datasize = 4096;
+    view->ds_file_blocks = g_hash_table_new (g_int64_hash, g_int64_equal);
+    g_queue_init (&view->ds_file_lru);
+    view->ds_file_first = -1;
+    view->ds_file_next = -1;
+    view->ds_file_ahead = 1;
 }
 
 /* --------------------------------------------------------------------------------------------- */
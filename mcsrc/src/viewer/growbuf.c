@@ -35,6 +35,7 @@
 
 #include <config.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include "lib/global.h"
 #include "lib/vfs/vfs.h"
@@ -44,7 +45,7 @@
 #include "internal.h"
 
 /* Block size for reading files in parts */
-#define VIEW_PAGE_SIZE ((size_t) 8192)
+#define VIEW_PAGE_SIZE ((size_t) 65536)
 
 /*** global variables ****************************************************************************/
 
@@ -52,11 +53,188 @@
 
 /*** file scope type declarations ****************************************************************/
 
+/* Pages are kept in memory up to mcview_growbuf_size KiB. When there are more of them,
+   full pages are written to an unlinked temporary file, the least recently used ones are
+   dropped from memory and read from that file again when needed. */
+typedef struct
+{
+    GList link;                 /* in growbuf_lru, data points to the page itself */
+    off_t pageno;
+    byte data[VIEW_PAGE_SIZE];
+} mcview_growbuf_page_t;
+
 /*** file scope variables ************************************************************************/
 
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
 
+static guint
+mcview_growbuf_max_pages (void)
+{
+    return (guint) MAX (mcview_growbuf_size / (VIEW_PAGE_SIZE / 1024), 2);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static mcview_growbuf_page_t *
+mcview_growbuf_page (WView * view, off_t pageno)
+{
+    return (mcview_growbuf_page_t *) g_ptr_array_index (view->growbuf_blockptr, pageno);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Write full pages which aren't there yet to the spill file.
+ *
+ * @return TRUE if all full pages are in the file
+ */
+
+static gboolean
+mcview_growbuf_spill (WView * view)
+{
+    /* the last page is still being filled */
+    const off_t last = (off_t) view->growbuf_blockptr->len - 1;
+
+    if (view->growbuf_spill_failed)
+        return FALSE;
+
+    if (view->growbuf_spill_fd == -1)
+    {
+        vfs_path_t *tmp_vpath;
+
+        view->growbuf_spill_fd = mc_mkstemps (&tmp_vpath, "mcview", NULL);
+        if (view->growbuf_spill_fd == -1)
+        {
+            view->growbuf_spill_failed = TRUE;
+            return FALSE;
+        }
+
+        /* the file is used through the descriptor only; open file can't be unlinked on
+           some systems (Windows), then it is removed after closing */
+        if (unlink (vfs_path_as_str (tmp_vpath)) == 0)
+            vfs_path_free (tmp_vpath);
+        else
+            view->growbuf_spill_vpath = tmp_vpath;
+    }
+
+    if (view->growbuf_spilled < last
+        && lseek (view->growbuf_spill_fd, view->growbuf_spilled * (off_t) VIEW_PAGE_SIZE,
+                  SEEK_SET) == -1)
+    {
+        view->growbuf_spill_failed = TRUE;
+        return FALSE;
+    }
+
+    for (; view->growbuf_spilled < last; view->growbuf_spilled++)
+    {
+        const byte *data = mcview_growbuf_page (view, view->growbuf_spilled)->data;
+        size_t written = 0;
+
+        while (written < VIEW_PAGE_SIZE)
+        {
+            ssize_t n;
+
+            n = write (view->growbuf_spill_fd, data + written, VIEW_PAGE_SIZE - written);
+            if (n == -1 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                /* no space left: keep the rest in memory */
+                view->growbuf_spill_failed = TRUE;
+                return FALSE;
+            }
+            written += n;
+        }
+    }
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/* Drop the least recently used pages which are in the spill file */
+
+static void
+mcview_growbuf_shrink (WView * view)
+{
+    const guint max_pages = mcview_growbuf_max_pages ();
+    GList *l;
+
+    if (view->growbuf_lru.length <= max_pages)
+        return;
+
+    (void) mcview_growbuf_spill (view);
+
+    /* page used last is kept */
+    for (l = view->growbuf_lru.tail;
+         l != view->growbuf_lru.head && view->growbuf_lru.length > max_pages;)
+    {
+        mcview_growbuf_page_t *page = (mcview_growbuf_page_t *) l->data;
+
+        l = l->prev;
+
+        if (page->pageno < view->growbuf_spilled)
+        {
+            g_queue_unlink (&view->growbuf_lru, &page->link);
+            g_ptr_array_index (view->growbuf_blockptr, page->pageno) = NULL;
+            g_free (page);
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static byte *
+mcview_growbuf_load_page (WView * view, off_t pageno)
+{
+    mcview_growbuf_page_t *page;
+    size_t got = 0;
+
+    page = mcview_growbuf_page (view, pageno);
+    if (page != NULL)
+    {
+        if (view->growbuf_lru.head != &page->link)
+        {
+            g_queue_unlink (&view->growbuf_lru, &page->link);
+            g_queue_push_head_link (&view->growbuf_lru, &page->link);
+        }
+        return page->data;
+    }
+
+    /* dropped pages are in the spill file */
+    page = g_try_new (mcview_growbuf_page_t, 1);
+    if (page == NULL)
+        return NULL;
+
+    if (lseek (view->growbuf_spill_fd, pageno * (off_t) VIEW_PAGE_SIZE, SEEK_SET) == -1)
+    {
+        g_free (page);
+        return NULL;
+    }
+
+    while (got < VIEW_PAGE_SIZE)
+    {
+        ssize_t n;
+
+        n = read (view->growbuf_spill_fd, page->data + got, VIEW_PAGE_SIZE - got);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            g_free (page);
+            return NULL;
+        }
+        got += n;
+    }
+
+    page->pageno = pageno;
+    page->link.data = page;
+    page->link.prev = page->link.next = NULL;
+    g_ptr_array_index (view->growbuf_blockptr, pageno) = page;
+    g_queue_push_head_link (&view->growbuf_lru, &page->link);
+    mcview_growbuf_shrink (view);
+
+    return page->data;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /*** public functions ****************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -68,6 +246,11 @@ mcview_growbuf_init (WView * view)
     view->growbuf_blockptr = g_ptr_array_new ();
     view->growbuf_lastindex = VIEW_PAGE_SIZE;
     view->growbuf_finished = FALSE;
+    g_queue_init (&view->growbuf_lru);
+    view->growbuf_spill_fd = -1;
+    view->growbuf_spill_vpath = NULL;
+    view->growbuf_spill_failed = FALSE;
+    view->growbuf_spilled = 0;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -100,6 +283,19 @@ mcview_growbuf_free (WView * view)
 
     (void) g_ptr_array_free (view->growbuf_blockptr, TRUE);
 
+    g_queue_init (&view->growbuf_lru);
+    if (view->growbuf_spill_fd != -1)
+    {
+        (void) close (view->growbuf_spill_fd);
+        view->growbuf_spill_fd = -1;
+    }
+    if (view->growbuf_spill_vpath != NULL)
+    {
+        (void) unlink (vfs_path_as_str (view->growbuf_spill_vpath));
+        vfs_path_free (view->growbuf_spill_vpath);
+        view->growbuf_spill_vpath = NULL;
+    }
+
     view->growbuf_blockptr = NULL;
     view->growbuf_in_use = FALSE;
 }
@@ -142,15 +338,23 @@ mcview_growbuf_read_until (WView * view, off_t ofs)
         if (view->growbuf_lastindex == VIEW_PAGE_SIZE)
         {
             /* Append a new block to the growing buffer */
-            byte *newblock = g_try_malloc (VIEW_PAGE_SIZE);
+            mcview_growbuf_page_t *newblock;
+
+            newblock = g_try_new (mcview_growbuf_page_t, 1);
             if (newblock == NULL)
                 return;
 
+            newblock->pageno = view->growbuf_blockptr->len;
+            newblock->link.data = newblock;
+            newblock->link.prev = newblock->link.next = NULL;
             g_ptr_array_add (view->growbuf_blockptr, newblock);
+            g_queue_push_head_link (&view->growbuf_lru, &newblock->link);
             view->growbuf_lastindex = 0;
+            mcview_growbuf_shrink (view);
         }
-        p = ((byte *)g_ptr_array_index (view->growbuf_blockptr,
-					view->growbuf_blockptr->len - 1)) + view->growbuf_lastindex;
+        /* last page is never dropped */
+        p = mcview_growbuf_page (view, view->growbuf_blockptr->len - 1)->data
+            + view->growbuf_lastindex;
 
         bytesfree = VIEW_PAGE_SIZE - view->growbuf_lastindex;
 
@@ -280,12 +484,43 @@ mcview_get_ptr_growing_buffer (WView * view, off_t byte_index)
     mcview_growbuf_read_until (view, byte_index + 1);
     if (view->growbuf_blockptr->len == 0)
         return NULL;
-    if (pageno < (off_t) view->growbuf_blockptr->len - 1)
-        return ((char *) g_ptr_array_index (view->growbuf_blockptr, pageno) + pageindex);
-    if (pageno == (off_t) view->growbuf_blockptr->len - 1
-        && pageindex < (off_t) view->growbuf_lastindex)
-        return ((char *) g_ptr_array_index (view->growbuf_blockptr, pageno) + pageindex);
+    if (pageno < (off_t) view->growbuf_blockptr->len - 1
+        || (pageno == (off_t) view->growbuf_blockptr->len - 1
+            && pageindex < (off_t) view->growbuf_lastindex))
+    {
+        byte *data;
+
+        /* valid until another page is got */
+        data = mcview_growbuf_load_page (view, pageno);
+        if (data != NULL)
+            return ((char *) data + pageindex);
+    }
     return NULL;
 }
 
 /* --------------------------------------------------------------------------------------------- */
+
+/* Get pointer to data at byte_index and the length of data in its page */
+
+const char *
+mcview_get_block_growing_buffer (WView * view, off_t byte_index, size_t * len)
+{
+    char *p;
+    off_t pageno;
+
+    *len = 0;
+
+    p = mcview_get_ptr_growing_buffer (view, byte_index);
+    if (p == NULL)
+        return NULL;
+
+    pageno = byte_index / VIEW_PAGE_SIZE;
+    if (pageno < (off_t) view->growbuf_blockptr->len - 1)
+        *len = VIEW_PAGE_SIZE - byte_index % VIEW_PAGE_SIZE;
+    else
+        *len = view->growbuf_lastindex - byte_index % VIEW_PAGE_SIZE;
+
+    return p;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -55,6 +55,9 @@
 
 /*** file scope macro definitions ****************************************************************/
 
+/* largest range of adjacent changed bytes written at once */
+#define HEXEDIT_SAVE_BLOCK (64 * 1024)
+
 /*** file scope type declarations ****************************************************************/
 
 typedef enum
@@ -72,6 +75,67 @@ static const char hex_char[] = "0123456789ABCDEF";
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
 
+static int
+mcview_hexedit_change_cmp (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const struct hexedit_change_node *na = (const struct hexedit_change_node *) a;
+    const struct hexedit_change_node *nb = (const struct hexedit_change_node *) b;
+
+    (void) user_data;
+
+    return na->offset < nb->offset ? -1 : na->offset > nb->offset ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Find the first change at offset or after it.
+ *
+ * @param view viewer object
+ * @param offset offset
+ *
+ * @return iterator of change, NULL if there are no changes there
+ */
+
+static GSequenceIter *
+mcview_hexedit_first_change (WView * view, off_t offset)
+{
+    struct hexedit_change_node key;
+    GSequenceIter *iter;
+
+    if (view->change_list == NULL)
+        return NULL;
+
+    key.offset = offset;
+    /* position after changes at offset or before it */
+    iter = g_sequence_search (view->change_list, &key, mcview_hexedit_change_cmp, NULL);
+    if (!g_sequence_iter_is_begin (iter))
+    {
+        GSequenceIter *prev;
+
+        prev = g_sequence_iter_prev (iter);
+        if (((struct hexedit_change_node *) g_sequence_get (prev))->offset == offset)
+            iter = prev;
+    }
+
+    return g_sequence_iter_is_end (iter) ? NULL : iter;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct hexedit_change_node *
+mcview_hexedit_change (GSequenceIter * iter)
+{
+    return iter == NULL ? NULL : (struct hexedit_change_node *) g_sequence_get (iter);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static GSequenceIter *
+mcview_hexedit_next_change (GSequenceIter * iter)
+{
+    iter = g_sequence_iter_next (iter);
+    return g_sequence_iter_is_end (iter) ? NULL : iter;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /** Determine the state of the current byte.
  *
@@ -114,7 +178,7 @@ mcview_display_hex (WView * view)
     off_t from;
     mark_t boldflag_byte = MARK_NORMAL;
     mark_t boldflag_char = MARK_NORMAL;
-    struct hexedit_change_node *curr = view->change_list;
+    GSequenceIter *curr;
 #ifdef HAVE_CHARSET
     int cont_bytes = 0;         /* number of continuation bytes remanining from current UTF-8 */
     gboolean cjk_right = FALSE; /* whether the second byte of a CJK is to be processed */
@@ -144,10 +208,7 @@ mcview_display_hex (WView * view)
         }
     }
 #endif /* HAVE_CHARSET */
-    while (curr && (curr->offset < from))
-    {
-        curr = curr->next;
-    }
+    curr = mcview_hexedit_first_change (view, from);
 
     for (; mcview_get_byte (view, from, NULL) && row < (int) height; row++)
     {
@@ -170,12 +231,13 @@ mcview_display_hex (WView * view)
         for (bytes = 0; bytes < view->bytes_per_line; bytes++, from++)
         {
             int c;
+            struct hexedit_change_node *change;
 #ifdef HAVE_CHARSET
             int ch = 0;
 
             if (view->utf8)
             {
-                struct hexedit_change_node *corr = curr;
+                GSequenceIter *corr = curr;
 
                 if (cont_bytes != 0)
                 {
@@ -192,6 +254,7 @@ mcview_display_hex (WView * view)
                 else
                 {
                     int j;
+                    struct hexedit_change_node *node;
                     gchar utf8buf[UTF8_CHAR_LEN + 1];
                     int res;
                     int first_changed = -1;
@@ -205,14 +268,15 @@ mcview_display_hex (WView * view)
                             utf8buf[j] = '\0';
                             break;
                         }
-                        if (curr != NULL && from + j == curr->offset)
+                        node = mcview_hexedit_change (curr);
+                        if (node != NULL && from + j == node->offset)
                         {
-                            utf8buf[j] = curr->value;
+                            utf8buf[j] = node->value;
                             if (first_changed == -1)
                                 first_changed = j;
                         }
-                        if (curr != NULL && from + j >= curr->offset)
-                            curr = curr->next;
+                        if (node != NULL && from + j >= node->offset)
+                            curr = mcview_hexedit_next_change (curr);
                     }
                     utf8buf[UTF8_CHAR_LEN] = '\0';
 
@@ -240,10 +304,11 @@ mcview_display_hex (WView * view)
 
             /* For negative rows, the only thing we care about is overflowing
              * UTF-8 continuation bytes which were handled above. */
+            change = mcview_hexedit_change (curr);
             if (row < 0)
             {
-                if (curr != NULL && from == curr->offset)
-                    curr = curr->next;
+                if (change != NULL && from == change->offset)
+                    curr = mcview_hexedit_next_change (curr);
                 continue;
             }
 
@@ -258,14 +323,14 @@ mcview_display_hex (WView * view)
             }
 
             /* Determine the state of the current byte */
-            boldflag_byte = mcview_hex_calculate_boldflag (view, from, curr, FALSE);
-            boldflag_char = mcview_hex_calculate_boldflag (view, from, curr, utf8_changed);
+            boldflag_byte = mcview_hex_calculate_boldflag (view, from, change, FALSE);
+            boldflag_char = mcview_hex_calculate_boldflag (view, from, change, utf8_changed);
 
             /* Determine the value of the current byte */
-            if (curr != NULL && from == curr->offset)
+            if (change != NULL && from == change->offset)
             {
-                c = curr->value;
-                curr = curr->next;
+                c = change->value;
+                curr = mcview_hexedit_next_change (curr);
             }
 
             /* Select the color for the hex number */
@@ -388,28 +453,50 @@ mcview_hexedit_save_changes (WView * view)
     {
         int fp;
         char *text;
-        struct hexedit_change_node *curr, *next;
+        byte *buf = NULL;
 
         g_assert (view->filename_vpath != NULL);
 
         fp = mc_open (view->filename_vpath, O_WRONLY);
         if (fp != -1)
         {
-            for (curr = view->change_list; curr != NULL; curr = next)
+            GSequenceIter *begin;
+
+            buf = g_malloc (HEXEDIT_SAVE_BLOCK);
+
+            /* write adjacent changed bytes at once */
+            while (!g_sequence_iter_is_end (begin = g_sequence_get_begin_iter (view->change_list)))
             {
-                next = curr->next;
+                GSequenceIter *curr = begin;
+                off_t offset;
+                size_t len, i;
 
-                if (mc_lseek (fp, curr->offset, SEEK_SET) == -1
-                    || mc_write (fp, &(curr->value), 1) != 1)
+                offset = mcview_hexedit_change (begin)->offset;
+
+                for (len = 0; len < HEXEDIT_SAVE_BLOCK && !g_sequence_iter_is_end (curr); len++)
+                {
+                    struct hexedit_change_node *node;
+
+                    node = mcview_hexedit_change (curr);
+                    if (node->offset != offset + (off_t) len)
+                        break;
+                    buf[len] = node->value;
+                    curr = g_sequence_iter_next (curr);
+                }
+
+                if (mc_lseek (fp, offset, SEEK_SET) == -1
+                    || mc_write (fp, buf, len) != (ssize_t) len)
                     goto save_error;
 
-                /* delete the saved item from the change list */
-                view->change_list = next;
+                /* delete the saved items from the change list */
+                g_sequence_remove_range (begin, curr);
                 view->dirty++;
-                mcview_set_byte (view, curr->offset, curr->value);
-                g_free (curr);
+                for (i = 0; i < len; i++)
+                    mcview_set_byte (view, offset + (off_t) i, buf[i]);
             }
 
+            g_free (buf);
+            g_sequence_free (view->change_list);
             view->change_list = NULL;
 
             if (view->locked)
@@ -427,6 +514,7 @@ mcview_hexedit_save_changes (WView * view)
       save_error:
         text = g_strdup_printf (_("Cannot save file:\n%s"), unix_error_string (errno));
         (void) mc_close (fp);
+        g_free (buf);
 
         answer = query_dialog (_("Save file"), text, D_ERROR, 2, _("&Retry"), _("&Cancel"));
         g_free (text);
@@ -450,14 +538,11 @@ mcview_toggle_hexedit_mode (WView * view)
 void
 mcview_hexedit_free_change_list (WView * view)
 {
-    struct hexedit_change_node *curr, *next;
-
-    for (curr = view->change_list; curr != NULL; curr = next)
+    if (view->change_list != NULL)
     {
-        next = curr->next;
-        g_free (curr);
+        g_sequence_free (view->change_list);
+        view->change_list = NULL;
     }
-    view->change_list = NULL;
 
     if (view->locked)
         view->locked = unlock_file (view->filename_vpath);
@@ -467,19 +552,47 @@ mcview_hexedit_free_change_list (WView * view)
 
 /* --------------------------------------------------------------------------------------------- */
 
+/** Get the change of byte at offset.
+ *
+ * @param view viewer object
+ * @param offset offset
+ *
+ * @return change at offset, NULL if byte isn't changed
+ */
+
+struct hexedit_change_node *
+mcview_hexedit_find_change (WView * view, off_t offset)
+{
+    struct hexedit_change_node key;
+
+    if (view->change_list == NULL)
+        return NULL;
+
+    key.offset = offset;
+    return mcview_hexedit_change (g_sequence_lookup (view->change_list, &key,
+                                                     mcview_hexedit_change_cmp, NULL));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Add the change of byte at offset which isn't changed yet.
+ *
+ * @param view viewer object
+ * @param offset offset
+ * @param value new value of byte
+ */
+
 void
-mcview_enqueue_change (struct hexedit_change_node **head, struct hexedit_change_node *node)
+mcview_enqueue_change (WView * view, off_t offset, byte value)
 {
-    /* chnode always either points to the head of the list or
-     * to one of the ->next fields in the list. The value at
-     * this location will be overwritten with the new node.   */
-    struct hexedit_change_node **chnode = head;
+    struct hexedit_change_node *node;
 
-    while (*chnode != NULL && (*chnode)->offset < node->offset)
-        chnode = &((*chnode)->next);
+    if (view->change_list == NULL)
+        view->change_list = g_sequence_new (g_free);
 
-    node->next = *chnode;
-    *chnode = node;
+    node = g_new (struct hexedit_change_node, 1);
+    node->offset = offset;
+    node->value = value;
+    g_sequence_insert_sorted (view->change_list, node, mcview_hexedit_change_cmp, NULL);
 }
 
 /* --------------------------------------------------------------------------------------------- */
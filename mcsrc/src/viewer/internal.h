@@ -50,10 +50,9 @@ typedef enum
 
 /*** structures declarations (and typedefs of structures)*****************************************/
 
-/* A node for building a change list on change_list */
+/* A changed byte kept in change_list */
 struct hexedit_change_node
 {
-    struct hexedit_change_node *next;
     off_t offset;
     byte value;
 };
@@ -118,10 +117,14 @@ struct WView
     /* vfs file data source */
     int ds_file_fd;             /* File with random access */
     off_t ds_file_filesize;     /* Size of the file */
-    off_t ds_file_offset;       /* Offset of the currently loaded data */
-    byte *ds_file_data;         /* Currently loaded data */
+    off_t ds_file_offset;       /* Offset of the currently used data */
+    byte *ds_file_data;         /* Currently used data: a cached block */
     size_t ds_file_datalen;     /* Number of valid bytes in file_data */
-    size_t ds_file_datasize;    /* Number of allocated bytes in file_data */
+    GHashTable *ds_file_blocks; /* Cached blocks of the file by their index */
+    GQueue ds_file_lru;         /* Cached blocks, most recently used first */
+    gint64 ds_file_first;       /* First block of the range read last time */
+    gint64 ds_file_next;        /* Block after the range read last time */
+    gint64 ds_file_ahead;       /* Blocks to read next time if reading goes on */
 
     /* string data source */
     byte *ds_string_data;       /* The characters of the string */
@@ -133,6 +136,11 @@ struct WView
     size_t growbuf_lastindex;   /* Number of bytes in the last page of the
                                    growing buffer */
     gboolean growbuf_finished;  /* TRUE when all data has been read. */
+    GQueue growbuf_lru;         /* Pages in memory, most recently used first */
+    int growbuf_spill_fd;       /* File with pages dropped from memory, or -1 */
+    vfs_path_t *growbuf_spill_vpath;    /* That file if it couldn't be unlinked while open */
+    gboolean growbuf_spill_failed;      /* TRUE if pages can't be written there */
+    off_t growbuf_spilled;      /* Number of first pages written to that file */
 
     mcview_mode_flags_t mode_flags;
 
@@ -163,7 +171,7 @@ struct WView
                                  * text mode */
     screen_dimen cursor_col;    /* Cursor column */
     screen_dimen cursor_row;    /* Cursor row */
-    struct hexedit_change_node *change_list;    /* Linked list of changes */
+    GSequence *change_list;     /* Changes ordered by offset, NULL if none */
     struct area status_area;    /* Where the status line is displayed */
     struct area ruler_area;     /* Where the ruler is displayed */
     struct area data_area;      /* Where the data is displayed */
@@ -255,6 +263,7 @@ off_t mcview_get_filesize (WView *);
 void mcview_update_filesize (WView * view);
 char *mcview_get_ptr_file (WView *, off_t);
 char *mcview_get_ptr_string (WView *, off_t);
+const char *mcview_get_ptr_block (WView * view, off_t byte_index, size_t * len);
 gboolean mcview_get_utf (WView * view, off_t byte_index, int *ch, int *ch_len);
 gboolean mcview_get_byte_string (WView *, off_t, int *);
 gboolean mcview_get_byte_none (WView *, off_t, int *);
@@ -287,13 +296,15 @@ off_t mcview_growbuf_filesize (WView * view);
 void mcview_growbuf_read_until (WView * view, off_t p);
 gboolean mcview_get_byte_growing_buffer (WView * view, off_t p, int *);
 char *mcview_get_ptr_growing_buffer (WView * view, off_t p);
+const char *mcview_get_block_growing_buffer (WView * view, off_t p, size_t * len);
 
 /* hex.c: */
 void mcview_display_hex (WView * view);
 gboolean mcview_hexedit_save_changes (WView * view);
 void mcview_toggle_hexedit_mode (WView * view);
 void mcview_hexedit_free_change_list (WView * view);
-void mcview_enqueue_change (struct hexedit_change_node **, struct hexedit_change_node *);
+struct hexedit_change_node *mcview_hexedit_find_change (WView * view, off_t offset);
+void mcview_enqueue_change (WView * view, off_t offset, byte value);
 
 /* lib.c: */
 void mcview_toggle_magic_mode (WView * view);
@@ -340,6 +351,8 @@ int mcview_nroff_seq_prev (mcview_nroff_t *);
 /* search.c: */
 mc_search_cbret_t mcview_search_cmd_callback (const void *user_data, gsize char_offset,
                                               int *current_char);
+mc_search_cbret_t mcview_search_block_callback (const void *user_data, gsize offset,
+                                                const char **block, gsize * len);
 mc_search_cbret_t mcview_search_update_cmd_callback (const void *user_data, gsize char_offset);
 void mcview_do_search (WView * view, off_t want_search_start);
 
@@ -69,6 +69,12 @@ gboolean mcview_remember_file_position = FALSE;
 /* Maxlimit for skipping updates */
 int mcview_max_dirt_limit = 10;
 
+/* Size of cache of file data in KiB */
+int mcview_cache_size = 4096;
+
+/* Size of data of pipes kept in memory in KiB */
+int mcview_growbuf_size = 65536;
+
 /* Scrolling is done in pages or line increments */
 gboolean mcview_mouse_move_pages = TRUE;
 
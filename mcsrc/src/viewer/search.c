@@ -131,6 +131,9 @@ mcview_find (mcview_search_status_msg_t * ssm, off_t search_start, off_t search_
     view->search_numNeedSkipChar = 0;
     search_cb_char_curr_index = -1;
 
+    /* nroff sequences are decoded char by char */
+    view->search->search_block_fn = view->mode_flags.nroff ? NULL : mcview_search_block_callback;
+
     if (mcview_search_options.backwards)
     {
         search_end = mcview_get_filesize (view);
@@ -253,6 +256,20 @@ mcview_search_cmd_callback (const void *user_data, gsize char_offset, int *curre
 
 /* --------------------------------------------------------------------------------------------- */
 
+mc_search_cbret_t
+mcview_search_block_callback (const void *user_data, gsize offset, const char **block, gsize * len)
+{
+    WView *view = ((const mcview_search_status_msg_t *) user_data)->view;
+    size_t block_len;
+
+    *block = mcview_get_ptr_block (view, (off_t) offset, &block_len);
+    *len = block_len;
+
+    return MC_SEARCH_CB_OK;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 mc_search_cbret_t
 mcview_search_update_cmd_callback (const void *user_data, gsize char_offset)
 {
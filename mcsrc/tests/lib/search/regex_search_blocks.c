@@ -0,0 +1,340 @@
+/*
+   libmc - checks for searching data got by blocks
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "lib/search/regex"
+
+#include "tests/mctest.h"
+
+#include "regex.c"              /* for testing static functions */
+
+/* small blocks to get matches across their boundaries */
+#define TEST_BLOCK 5
+
+typedef struct
+{
+    const char *data;
+    gsize len;
+    gsize block;
+    int updates;
+    int abort_after;
+} test_source_t;
+
+static const char test_data[] =
+    "first line\n" "second Line here\n" "third line with needle\n" "last NEEDLE";
+
+/* --------------------------------------------------------------------------------------------- */
+
+static mc_search_cbret_t
+test_search_block_fn (const void *user_data, gsize offset, const char **block, gsize * len)
+{
+    const test_source_t *src = (const test_source_t *) user_data;
+
+    if (offset >= src->len)
+    {
+        *block = NULL;
+        *len = 0;
+    }
+    else
+    {
+        *block = src->data + offset;
+        *len = MIN (src->block, src->len - offset);
+    }
+
+    return MC_SEARCH_CB_OK;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static mc_search_cbret_t
+test_search_fn (const void *user_data, gsize char_offset, int *current_char)
+{
+    const test_source_t *src = (const test_source_t *) user_data;
+
+    if (char_offset >= src->len)
+        return MC_SEARCH_CB_NOTFOUND;
+
+    *current_char = (unsigned char) src->data[char_offset];
+    return MC_SEARCH_CB_OK;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static mc_search_cbret_t
+test_update_fn (const void *user_data, gsize char_offset)
+{
+    test_source_t *src = (test_source_t *) user_data;
+
+    (void) char_offset;
+
+    src->updates++;
+    return (src->abort_after != 0 && src->updates >= src->abort_after)
+        ? MC_SEARCH_CB_ABORT : MC_SEARCH_CB_OK;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static mc_search_t *
+test_search_new (const char *str, mc_search_type_t type, gboolean case_sens, gboolean blocks)
+{
+    mc_search_t *s;
+
+    s = mc_search_new (str, NULL);
+    s->search_type = type;
+    s->is_case_sensitive = case_sens;
+    s->search_fn = test_search_fn;
+    s->update_fn = test_update_fn;
+    if (blocks)
+        s->search_block_fn = test_search_block_fn;
+
+    return s;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @DataSource("test_regex_search_blocks_ds") */
+/* *INDENT-OFF* */
+static const struct test_regex_search_blocks_ds
+{
+    const char *search_str;
+    mc_search_type_t search_type;
+    gboolean case_sens;
+    gsize start;
+    gboolean expected_found;
+    gsize expected_offset;
+    gsize expected_len;
+} test_regex_search_blocks_ds[] =
+{
+    { /* 0. plain string across blocks */
+        "needle",
+        MC_SEARCH_T_NORMAL,
+        TRUE,
+        0,
+        TRUE,
+        44,
+        6
+    },
+    { /* 1. in last line without line break */
+        "NEEDLE",
+        MC_SEARCH_T_NORMAL,
+        TRUE,
+        0,
+        TRUE,
+        56,
+        6
+    },
+    { /* 2. */
+        "line h",
+        MC_SEARCH_T_NORMAL,
+        FALSE,
+        0,
+        TRUE,
+        18,
+        6
+    },
+    { /* 3. */
+        "needle",
+        MC_SEARCH_T_NORMAL,
+        FALSE,
+        45,
+        TRUE,
+        56,
+        6
+    },
+    { /* 4. text with line break is searched by lines */
+        "here\n",
+        MC_SEARCH_T_NORMAL,
+        TRUE,
+        0,
+        TRUE,
+        23,
+        5
+    },
+    { /* 5. */
+        "w.th n",
+        MC_SEARCH_T_REGEX,
+        TRUE,
+        0,
+        TRUE,
+        39,
+        6
+    },
+    { /* 6. */
+        "NEE.LE$",
+        MC_SEARCH_T_REGEX,
+        TRUE,
+        0,
+        TRUE,
+        56,
+        6
+    },
+    { /* 7. */
+        "sec*here",
+        MC_SEARCH_T_GLOB,
+        TRUE,
+        0,
+        TRUE,
+        11,
+        16
+    },
+    { /* 8. */
+        "6E 65 65",
+        MC_SEARCH_T_HEX,
+        TRUE,
+        0,
+        TRUE,
+        44,
+        3
+    },
+    { /* 9. */
+        "absent",
+        MC_SEARCH_T_NORMAL,
+        FALSE,
+        0,
+        FALSE,
+        0,
+        0
+    },
+    { /* 10. */
+        "^absent",
+        MC_SEARCH_T_REGEX,
+        TRUE,
+        0,
+        FALSE,
+        0,
+        0
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_regex_search_blocks_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_regex_search_blocks, test_regex_search_blocks_ds)
+/* *INDENT-ON* */
+{
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        /* given: data by blocks and by chars */
+        test_source_t src = { test_data, sizeof (test_data) - 1, TEST_BLOCK, 0, 0 };
+        mc_search_t *s;
+        gsize found_len = 0;
+        gboolean found;
+
+        s = test_search_new (data->search_str, data->search_type, data->case_sens, i == 0);
+
+        /* when */
+        found = mc_search_run (s, &src, data->start, src.len, &found_len);
+
+        /* then */
+        mctest_assert_int_eq (found, data->expected_found);
+        if (found)
+        {
+            mctest_assert_int_eq (s->normal_offset, data->expected_offset);
+            mctest_assert_int_eq (found_len, data->expected_len);
+        }
+        else
+            mctest_assert_int_eq (s->error, MC_SEARCH_E_NOTFOUND);
+
+        mc_search_free (s);
+    }
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_regex_search_blocks_end)
+/* *INDENT-ON* */
+{
+    /* given */
+    test_source_t src = { test_data, sizeof (test_data) - 1, TEST_BLOCK, 0, 0 };
+    mc_search_t *s;
+
+    s = test_search_new ("needle", MC_SEARCH_T_NORMAL, TRUE, TRUE);
+
+    /* then: last byte to search is included */
+    mctest_assert_true (mc_search_run (s, &src, 0, 49, NULL));
+    mctest_assert_false (mc_search_run (s, &src, 0, 48, NULL));
+
+    mc_search_free (s);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_regex_search_blocks_abort)
+/* *INDENT-ON* */
+{
+    /* given */
+    test_source_t src = { test_data, sizeof (test_data) - 1, TEST_BLOCK, 0, 2 };
+    mc_search_t *s;
+
+    s = test_search_new ("absent", MC_SEARCH_T_NORMAL, TRUE, TRUE);
+
+    /* when */
+    mctest_assert_false (mc_search_run (s, &src, 0, src.len, NULL));
+
+    /* then: progress is reported after each block */
+    mctest_assert_int_eq (s->error, MC_SEARCH_E_ABORT);
+    mctest_assert_int_eq (src.updates, 2);
+
+    mc_search_free (s);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    /* Add new tests here: *************** */
+    mctest_add_parameterized_test (tc_core, test_regex_search_blocks, test_regex_search_blocks_ds);
+    tcase_add_test (tc_core, test_regex_search_blocks_end);
+    tcase_add_test (tc_core, test_regex_search_blocks_abort);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "regex_search_blocks.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,266 @@
+/* lib/vfs - test buffered sequential reader of archives
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include "tests/mctest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "lib/strutil.h"
+#include "lib/vfs/arcread.h"
+
+#include "src/vfs/local/local.c"
+
+#define DATA_SIZE (3 * 1024 * 1024 + 1000)
+
+static char *test_file = NULL;
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char
+test_data_byte (off_t offset)
+{
+    return (char) ((offset * 7 + offset / 1024) % 251);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+test_check_data (const char *buf, off_t offset, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        if (buf[i] != test_data_byte (offset + i))
+            return FALSE;
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_open (void)
+{
+    vfs_path_t *vpath;
+    int fd;
+
+    vpath = vfs_path_from_str (test_file);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+
+    return fd;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    char *buf;
+    off_t i;
+    FILE *f;
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_setup_work_dir ();
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-arcread.bin", (char *) NULL);
+
+    buf = g_malloc (DATA_SIZE);
+    for (i = 0; i < DATA_SIZE; i++)
+        buf[i] = test_data_byte (i);
+    f = fopen (test_file, "wb");
+    fwrite (buf, 1, DATA_SIZE, f);
+    fclose (f);
+    g_free (buf);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    unlink (test_file);
+    g_free (test_file);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* steps of test_vfs_arcread_sequence, each starts where previous one ended */
+/* *INDENT-OFF* */
+static const struct test_vfs_arcread_steps
+{
+    off_t seek;                 /* -1: don't seek */
+    size_t len;
+} test_vfs_arcread_steps[] =
+{
+    { /* 0. from beginning */
+        -1,
+        512
+    },
+    { /* 1. seek back inside of block */
+        100,
+        110
+    },
+    { /* 2. seek forward inside of block */
+        40000,
+        76
+    },
+    { /* 3. crosses end of block */
+        65500,
+        100
+    },
+    { /* 4. seek past block */
+        2000000,
+        512
+    },
+    { /* 5. read bigger than block */
+        -1,
+        1024 * 1024 + 5
+    },
+    { /* 6. back before block */
+        10,
+        10
+    },
+    { /* 7. short read at end of file */
+        DATA_SIZE - 100,
+        100
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_arcread_sequence)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_arcread_t *ar;
+    char *buf;
+    off_t pos = 0;
+    size_t i;
+    int fd;
+
+    fd = test_open ();
+    mctest_assert_int_ne (fd, -1);
+    ar = vfs_arcread_open (fd, NULL);
+    buf = g_malloc (2 * 1024 * 1024);
+
+    for (i = 0; i < G_N_ELEMENTS (test_vfs_arcread_steps); i++)
+    {
+        const struct test_vfs_arcread_steps *data = &test_vfs_arcread_steps[i];
+
+        /* when */
+        if (data->seek != -1)
+        {
+            mctest_assert_int_eq (vfs_arcread_seek (ar, data->seek), data->seek);
+            pos = data->seek;
+        }
+
+        /* then */
+        mctest_assert_int_eq (vfs_arcread_read (ar, buf, data->len), data->len);
+        mctest_assert_true (test_check_data (buf, pos, data->len));
+        pos += data->len;
+        mctest_assert_int_eq (vfs_arcread_tell (ar), pos);
+    }
+
+    /* end of file */
+    mctest_assert_int_eq (vfs_arcread_read (ar, buf, 10), 0);
+
+    g_free (buf);
+    vfs_arcread_close (ar);
+    mc_close (fd);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_arcread_scan)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_arcread_t *ar;
+    char buf[512];
+    off_t pos;
+    int fd;
+
+    fd = test_open ();
+    mctest_assert_int_ne (fd, -1);
+    ar = vfs_arcread_open (fd, NULL);
+
+    /* when: read header, skip member like tar loader does */
+    for (pos = 0; pos + (off_t) sizeof (buf) <= DATA_SIZE; pos += 3 * sizeof (buf))
+    {
+        /* then */
+        mctest_assert_int_eq (vfs_arcread_seek (ar, pos), pos);
+        mctest_assert_int_eq (vfs_arcread_read (ar, buf, sizeof (buf)), sizeof (buf));
+        mctest_assert_true (test_check_data (buf, pos, sizeof (buf)));
+    }
+
+    vfs_arcread_close (ar);
+    mc_close (fd);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_vfs_arcread_sequence);
+    tcase_add_test (tc_core, test_vfs_arcread_scan);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_arcread.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,279 @@
+/* lib/vfs - test block cache of remote files
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include "tests/mctest.h"
+
+#include "lib/vfs/blockcache.h"
+
+#define BLOCK VFS_BLOCKCACHE_BLOCK
+#define DATA_SIZE (100 * BLOCK + 1000)
+
+/* fake remote file */
+static struct
+{
+    off_t size;                 /* real size, may differ from expected one */
+    gboolean fail;
+    int calls;
+    off_t last_offset;
+    size_t last_len;
+} remote;
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char
+test_data_byte (off_t offset)
+{
+    return (char) ((offset * 7 + offset / 1024) % 251);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+test_check_data (const char *buf, off_t offset, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        if (buf[i] != test_data_byte (offset + i))
+            return FALSE;
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+test_fetch (void *data, off_t offset, char *buf, size_t len)
+{
+    size_t i;
+
+    (void) data;
+
+    remote.calls++;
+    remote.last_offset = offset;
+    remote.last_len = len;
+
+    if (remote.fail)
+        return (-1);
+
+    if (offset >= remote.size)
+        return 0;
+
+    len = MIN (len, (size_t) (remote.size - offset));
+    for (i = 0; i < len; i++)
+        buf[i] = test_data_byte (offset + i);
+
+    return (ssize_t) len;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    remote.size = DATA_SIZE;
+    remote.fail = FALSE;
+    remote.calls = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_blockcache_random)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_blockcache_t *bc;
+    char buf[300];
+
+    bc = vfs_blockcache_new (DATA_SIZE, test_fetch, NULL);
+
+    /* when: tail of file */
+    mctest_assert_int_eq (vfs_blockcache_read (bc, DATA_SIZE - 200, buf, sizeof (buf)), 200);
+
+    /* then: only last block is fetched */
+    mctest_assert_true (test_check_data (buf, DATA_SIZE - 200, 200));
+    mctest_assert_int_eq (remote.calls, 1);
+    mctest_assert_int_eq (remote.last_offset, 100 * BLOCK);
+    mctest_assert_int_eq (remote.last_len, 1000);
+
+    /* when: crossing block boundary far from previous read */
+    mctest_assert_int_eq (vfs_blockcache_read (bc, 10 * BLOCK - 100, buf, sizeof (buf)),
+                          sizeof (buf));
+
+    /* then: two single blocks are fetched */
+    mctest_assert_true (test_check_data (buf, 10 * BLOCK - 100, sizeof (buf)));
+    mctest_assert_int_eq (remote.calls, 3);
+
+    /* when: cached data is read again */
+    mctest_assert_int_eq (vfs_blockcache_read (bc, 10 * BLOCK - 50, buf, 100), 100);
+
+    /* then */
+    mctest_assert_true (test_check_data (buf, 10 * BLOCK - 50, 100));
+    mctest_assert_int_eq (remote.calls, 3);
+
+    /* end of file */
+    mctest_assert_int_eq (vfs_blockcache_read (bc, DATA_SIZE, buf, sizeof (buf)), 0);
+    mctest_assert_int_eq (remote.calls, 3);
+
+    vfs_blockcache_free (bc);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_blockcache_sequential)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_blockcache_t *bc;
+    char *buf;
+    off_t pos;
+    ssize_t n;
+
+    bc = vfs_blockcache_new (DATA_SIZE, test_fetch, NULL);
+    buf = g_malloc (BLOCK);
+
+    /* when */
+    for (pos = 0; (n = vfs_blockcache_read (bc, pos, buf, 4096)) > 0; pos += n)
+        mctest_assert_true (test_check_data (buf, pos, n));
+
+    /* then: whole file read with growing fetches */
+    mctest_assert_int_eq (pos, DATA_SIZE);
+    mctest_assert_true ((remote.calls < 12));
+
+    g_free (buf);
+    vfs_blockcache_free (bc);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_blockcache_lru)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_blockcache_t *bc;
+    char buf[10];
+    int i, calls;
+
+    bc = vfs_blockcache_new (1000 * BLOCK, test_fetch, NULL);
+    remote.size = 1000 * BLOCK;
+
+    /* when: many random blocks, first one is kept in use */
+    for (i = 0; i < 600; i++)
+    {
+        mctest_assert_int_eq (vfs_blockcache_read (bc, 0, buf, sizeof (buf)), sizeof (buf));
+        mctest_assert_int_eq (vfs_blockcache_read (bc, (off_t) (i * 3 % 997 + 2) * BLOCK, buf,
+                                                   sizeof (buf)), sizeof (buf));
+    }
+
+    /* then: recently used block is cached, early ones are dropped */
+    calls = remote.calls;
+    mctest_assert_int_eq (vfs_blockcache_read (bc, 0, buf, sizeof (buf)), sizeof (buf));
+    mctest_assert_int_eq (remote.calls, calls);
+    mctest_assert_int_eq (vfs_blockcache_read (bc, 2 * BLOCK, buf, sizeof (buf)), sizeof (buf));
+    mctest_assert_int_eq (remote.calls, calls + 1);
+    mctest_assert_true (test_check_data (buf, 2 * BLOCK, sizeof (buf)));
+
+    vfs_blockcache_free (bc);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_blockcache_errors)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_blockcache_t *bc;
+    char buf[100];
+
+    bc = vfs_blockcache_new (DATA_SIZE, test_fetch, NULL);
+
+    /* when: fetch fails */
+    remote.fail = TRUE;
+
+    /* then */
+    mctest_assert_int_eq (vfs_blockcache_read (bc, 0, buf, sizeof (buf)), -1);
+
+    /* when: file is shorter than expected */
+    remote.fail = FALSE;
+    remote.size = 5 * BLOCK + 10;
+
+    /* then: data up to real end of file */
+    mctest_assert_int_eq (vfs_blockcache_read (bc, 5 * BLOCK, buf, sizeof (buf)), 10);
+    mctest_assert_true (test_check_data (buf, 5 * BLOCK, 10));
+    mctest_assert_int_eq (vfs_blockcache_read (bc, 5 * BLOCK + 10, buf, sizeof (buf)), 0);
+    mctest_assert_int_eq (vfs_blockcache_read (bc, 7 * BLOCK, buf, sizeof (buf)), 0);
+
+    vfs_blockcache_free (bc);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, NULL);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_vfs_blockcache_random);
+    tcase_add_test (tc_core, test_vfs_blockcache_sequential);
+    tcase_add_test (tc_core, test_vfs_blockcache_lru);
+    tcase_add_test (tc_core, test_vfs_blockcache_errors);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_blockcache.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -314,6 +314,181 @@ END_PARAMETRIZED_TEST
 
 /* --------------------------------------------------------------------------------------------- */
 
+/* @DataSource("test_vfs_parse_ls_lga_corpus_ds") */
+/* *INDENT-OFF* */
+static const struct test_vfs_parse_ls_lga_corpus_ds
+{
+    const char *input_string;
+    gboolean expected_result;
+    const char *expected_filename;
+    const char *expected_linkname;
+    mode_t expected_mode;
+    off_t expected_size;
+    int expected_year;          /* 0 if year is not shown in the line */
+    int expected_mon;
+    int expected_mday;
+    int expected_hour;
+    int expected_min;
+} test_vfs_parse_ls_lga_corpus_ds[] =
+{
+    { /* 0. ftp, file dated by year */
+        "-rw-r--r--    1 ftp      ftp       1048576 Jan 12  2015 file with  spaces",
+        TRUE, "file with  spaces", NULL, S_IFREG | 0644, 1048576, 2015, 0, 12, 0, 0
+    },
+    { /* 1. ftp, file dated by time */
+        "-rw-r--r--    1 ftp      ftp            12 Nov  3 08:05 recent.txt",
+        TRUE, "recent.txt", NULL, S_IFREG | 0644, 12, 0, 10, 3, 8, 5
+    },
+    { /* 2. symlink */
+        "lrwxrwxrwx    1 root     root            7 Feb 29  2016 lib -> usr/lib",
+        TRUE, "lib", "usr/lib", S_IFLNK | 0777, 7, 2016, 1, 29, 0, 0
+    },
+    { /* 3. symlink without target */
+        "lrwxrwxrwx    1 root     root            7 Feb 29  2016 broken ->",
+        TRUE, "broken", "", S_IFLNK | 0777, 7, 2016, 1, 29, 0, 0
+    },
+    { /* 4. device */
+        "crw-rw-rw-    1 root     root       1,   3 Dec 31  1999 null",
+        TRUE, "null", NULL, S_IFCHR | 0666, 0, 1999, 11, 31, 0, 0
+    },
+    { /* 5. device without space between major and minor */
+        "brw-rw----    1 root     disk       8,0 Dec 31  1999 sda",
+        TRUE, "sda", NULL, S_IFBLK | 0660, 0, 1999, 11, 31, 0, 0
+    },
+    { /* 6. extfs, DOS date with time */
+        "-rw-r--r-- 1 0 0 5 12-24-99 23:59 dos.txt",
+        TRUE, "dos.txt", NULL, S_IFREG | 0644, 5, 1999, 11, 24, 23, 59
+    },
+    { /* 7. extfs, DOS date with four digit year and seconds */
+        "-rw-r--r-- 1 0 0 5 07/04/2003 10:11:12 dos.txt",
+        TRUE, "dos.txt", NULL, S_IFREG | 0644, 5, 2003, 6, 4, 10, 11
+    },
+    { /* 8. extfs, weekday, time and year */
+        "-rw-r--r-- 1 0 0 5 Mon Jan 11 10:11:12 2010 week.txt",
+        TRUE, "2010 week.txt", NULL, S_IFREG | 0644, 5, 0, 0, 11, 10, 11
+    },
+    { /* 9. no group field */
+        "-rw-r--r-- 1 user 5 Jun 30  2001 nogroup",
+        TRUE, "nogroup", NULL, S_IFREG | 0644, 5, 2001, 5, 30, 0, 0
+    },
+    { /* 10. Notwell */
+        "d [RWCEAFM] 1 user 512 Jun 30  2001 notwell dir",
+        TRUE, "notwell dir", NULL, S_IFDIR | 0755, 512, 2001, 5, 30, 0, 0
+    },
+    { /* 11. hardlink in extfs */
+        "-rw-r--r--   2 user  group   1 Aug 12  2012 hard -> link",
+        TRUE, "hard", "link", S_IFREG | 0644, 1, 2012, 7, 12, 0, 0
+    },
+    { /* 12. CR LF line end */
+        "-rw-r--r--   1 user  group   1 Aug 12  2012 dos line\r\n",
+        TRUE, "dos line", NULL, S_IFREG | 0644, 1, 2012, 7, 12, 0, 0
+    },
+    { /* 13. no file name */
+        "-rw-r--r--   1 user  group   1 Aug 12  2012",
+        FALSE, NULL, NULL, 0, 0, 0, 0, 0, 0, 0
+    },
+    { /* 14. no date */
+        "-rw-r--r--   1 user  group   1 file",
+        FALSE, NULL, NULL, 0, 0, 0, 0, 0, 0, 0
+    },
+    { /* 15. bad size */
+        "-rw-r--r--   1 user  group   abc Aug 12  2012 file",
+        FALSE, NULL, NULL, 0, 0, 0, 0, 0, 0, 0
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_vfs_parse_ls_lga_corpus_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_vfs_parse_ls_lga_corpus, test_vfs_parse_ls_lga_corpus_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct stat test_stat;
+    char *filename = NULL;
+    char *linkname = NULL;
+    gboolean actual_result;
+
+    vfs_parse_ls_lga_init ();
+    memset (&test_stat, 0, sizeof (test_stat));
+
+    /* when */
+    actual_result =
+        vfs_parse_ls_lga (data->input_string, &test_stat, &filename, &linkname, NULL);
+
+    /* then */
+    mctest_assert_int_eq (actual_result, data->expected_result);
+
+    if (actual_result)
+    {
+        struct tm *tim;
+
+        mctest_assert_str_eq (filename, data->expected_filename);
+        mctest_assert_str_eq (linkname, data->expected_linkname);
+        mctest_assert_int_eq (test_stat.st_mode, data->expected_mode);
+        mctest_assert_int_eq (test_stat.st_size, data->expected_size);
+        mctest_assert_int_eq (test_stat.st_atime, test_stat.st_mtime);
+
+        tim = localtime (&test_stat.st_mtime);
+        if (data->expected_year != 0)
+            mctest_assert_int_eq (tim->tm_year + 1900, data->expected_year);
+        mctest_assert_int_eq (tim->tm_mon, data->expected_mon);
+        mctest_assert_int_eq (tim->tm_mday, data->expected_mday);
+        mctest_assert_int_eq (tim->tm_hour, data->expected_hour);
+        mctest_assert_int_eq (tim->tm_min, data->expected_min);
+    }
+
+    g_free (filename);
+    g_free (linkname);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_parse_filedate)
+/* *INDENT-ON* */
+{
+    /* given */
+    char line[] = "Jul 14 1998 Jul 15 10:20 Jun 31 1998";
+    time_t t;
+    struct tm *tim;
+
+    /* when */
+    mctest_assert_int_eq (vfs_split_text (line), 9);
+
+    /* then */
+    mctest_assert_int_eq (vfs_parse_filedate (0, &t), 3);
+    tim = localtime (&t);
+    mctest_assert_int_eq (tim->tm_year, 98);
+    mctest_assert_int_eq (tim->tm_mon, 6);
+    mctest_assert_int_eq (tim->tm_mday, 14);
+
+    mctest_assert_int_eq (vfs_parse_filedate (3, &t), 6);
+    tim = localtime (&t);
+    mctest_assert_int_eq (tim->tm_mon, 6);
+    mctest_assert_int_eq (tim->tm_mday, 15);
+    mctest_assert_int_eq (tim->tm_hour, 10);
+    mctest_assert_int_eq (tim->tm_min, 20);
+
+    /* day out of month range is normalized by mktime() */
+    mctest_assert_int_eq (vfs_parse_filedate (6, &t), 9);
+    tim = localtime (&t);
+    mctest_assert_int_eq (tim->tm_mon, 6);
+    mctest_assert_int_eq (tim->tm_mday, 1);
+
+    /* out of columns */
+    mctest_assert_int_eq (vfs_parse_filedate (8, &t), 0);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
 /* @Test */
 /* *INDENT-OFF* */
 START_TEST (test_vfs_parse_ls_lga_reorder)
@@ -418,6 +593,9 @@ main (void)
 
     /* Add new tests here: *************** */
     mctest_add_parameterized_test (tc_core, test_vfs_parse_ls_lga, test_vfs_parse_ls_lga_ds);
+    mctest_add_parameterized_test (tc_core, test_vfs_parse_ls_lga_corpus,
+                                   test_vfs_parse_ls_lga_corpus_ds);
+    tcase_add_test (tc_core, test_vfs_parse_filedate);
     tcase_add_test (tc_core, test_vfs_parse_ls_lga_reorder);
     tcase_add_test (tc_core, test_vfs_parse_ls_lga_unaligned);
     /* *********************************** */
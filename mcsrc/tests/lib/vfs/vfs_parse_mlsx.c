@@ -0,0 +1,174 @@
+/*
+   lib/vfs - test vfs_parse_mlsx() functionality
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include "tests/mctest.h"
+
+#include "lib/vfs/utilvfs.h"
+
+/* --------------------------------------------------------------------------------------------- */
+/* @DataSource("test_vfs_parse_mlsx_ds") */
+/* *INDENT-OFF* */
+static const struct test_vfs_parse_mlsx_ds
+{
+    const char *input_line;
+    gboolean expected_result;
+    mode_t expected_mode;
+    off_t expected_size;
+    time_t expected_mtime;
+    uid_t expected_uid;
+    gid_t expected_gid;
+    const char *expected_filename;
+    const char *expected_linkname;
+} test_vfs_parse_mlsx_ds[] =
+{
+    { /* 0. */
+        "type=file;size=1234;modify=20200102030405;UNIX.mode=0640;UNIX.owner=1000;UNIX.group=100; my file.txt\r",
+        TRUE,
+        S_IFREG | 0640,
+        1234,
+        1577934245,
+        1000,
+        100,
+        "my file.txt",
+        NULL
+    },
+    { /* 1. fractional seconds, permissions from perm fact */
+        "Type=DIR;Perm=el;Modify=20200102030405.123; sub",
+        TRUE,
+        S_IFDIR | 0555,
+        0,
+        1577934245,
+        42,
+        42,
+        "sub",
+        NULL
+    },
+    { /* 2. */
+        "type=OS.unix=slink:/etc/target;size=5; link",
+        TRUE,
+        S_IFLNK | 0777,
+        5,
+        0,
+        42,
+        42,
+        "link",
+        "/etc/target"
+    },
+    { /* 3. name with leading space */
+        "type=file;perm=rw;  leading",
+        TRUE,
+        S_IFREG | 0644,
+        0,
+        0,
+        42,
+        42,
+        " leading",
+        NULL
+    },
+    { /* 4. listed directory itself */
+        "type=cdir;perm=el; /pub",
+        FALSE,
+        0, 0, 0, 0, 0, NULL, NULL
+    },
+    { /* 5. parent directory */
+        "type=pdir;perm=el; ..",
+        FALSE,
+        0, 0, 0, 0, 0, NULL, NULL
+    },
+    { /* 6. no facts */
+        " nofacts",
+        FALSE,
+        0, 0, 0, 0, 0, NULL, NULL
+    },
+    { /* 7. no name */
+        "type=file;size=1;",
+        FALSE,
+        0, 0, 0, 0, 0, NULL, NULL
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_vfs_parse_mlsx_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_vfs_parse_mlsx, test_vfs_parse_mlsx_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct stat st;
+    char *filename = NULL;
+    char *linkname = NULL;
+    gboolean actual_result;
+
+    memset (&st, 0, sizeof (st));
+    st.st_uid = 42;
+    st.st_gid = 42;
+
+    /* when */
+    actual_result = vfs_parse_mlsx (data->input_line, &st, &filename, &linkname);
+
+    /* then */
+    mctest_assert_int_eq (actual_result, data->expected_result);
+    if (data->expected_result)
+    {
+        mctest_assert_int_eq (st.st_mode, data->expected_mode);
+        mctest_assert_int_eq (st.st_size, data->expected_size);
+        mctest_assert_int_eq (st.st_mtime, data->expected_mtime);
+        mctest_assert_int_eq (st.st_uid, data->expected_uid);
+        mctest_assert_int_eq (st.st_gid, data->expected_gid);
+        mctest_assert_str_eq (filename, data->expected_filename);
+        mctest_assert_str_eq (linkname, data->expected_linkname);
+    }
+
+    g_free (filename);
+    g_free (linkname);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    /* Add new tests here: *************** */
+    mctest_add_parameterized_test (tc_core, test_vfs_parse_mlsx, test_vfs_parse_mlsx_ds);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_parse_mlsx.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
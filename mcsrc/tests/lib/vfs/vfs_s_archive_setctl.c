@@ -0,0 +1,244 @@
+/*
+   lib/vfs - test position of file data in archive
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include "tests/mctest.h"
+
+#include "lib/strutil.h"
+#include "lib/vfs/xdirentry.h"
+
+#include "src/vfs/local/local.c"
+
+#define ARCH_NAME "/path/to/some/archive.tar"
+
+static struct vfs_s_subclass test_subclass;
+static struct vfs_class *vfs_test_ops = VFS_CLASS (&test_subclass);
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_inode *
+test_add_entry (struct vfs_s_super *super, const char *path, mode_t mode, off_t size,
+                off_t data_offset)
+{
+    struct vfs_s_inode *parent, *inode;
+    struct vfs_s_entry *entry;
+    struct stat st;
+    char *dir_name;
+
+    dir_name = g_path_get_dirname (path);
+    parent = strcmp (dir_name, ".") == 0 ? super->root
+        : vfs_s_find_inode (vfs_test_ops, super, dir_name, LINK_NO_FOLLOW, FL_NONE);
+    g_free (dir_name);
+
+    memset (&st, 0, sizeof (st));
+    st.st_mode = mode;
+    st.st_size = size;
+
+    inode = vfs_s_new_inode (vfs_test_ops, super, &st);
+    inode->data_offset = data_offset;
+    entry = vfs_s_new_entry (vfs_test_ops, x_basename (path), inode);
+    vfs_s_insert_entry (vfs_test_ops, parent, entry);
+
+    return inode;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_open_archive (struct vfs_s_super *super, const vfs_path_t * vpath,
+                   const vfs_path_element_t * vpath_element)
+{
+    struct stat st;
+
+    (void) vpath_element;
+
+    super->name = g_strdup (vfs_path_as_str (vpath));
+
+    memset (&st, 0, sizeof (st));
+    st.st_mode = S_IFDIR | 0755;
+    super->root = vfs_s_new_inode (vfs_test_ops, super, &st);
+    super->root->data_offset = -1;
+
+    test_add_entry (super, "a.txt", S_IFREG | 0644, 10, 5000);
+    test_add_entry (super, "b.txt", S_IFREG | 0644, 10, 1000);
+    test_add_entry (super, "dir", S_IFDIR | 0755, 0, 500);
+    test_add_entry (super, "dir/x", S_IFREG | 0644, 5, 3000);
+    test_add_entry (super, "dir/sub", S_IFDIR | 0755, 0, 600);
+    test_add_entry (super, "dir/sub/y", S_IFREG | 0644, 5, 2000);
+    test_add_entry (super, "empty", S_IFDIR | 0755, 0, 700);
+    test_add_entry (super, "zero.txt", S_IFREG | 0644, 0, 800);
+    test_add_entry (super, "link", S_IFLNK | 0777, 0, 900);
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_archive_same (const vfs_path_element_t * vpath_element, struct vfs_s_super *super,
+                   const vfs_path_t * vpath, void *cookie)
+{
+    (void) vpath_element;
+    (void) super;
+    (void) cookie;
+
+    return strcmp (ARCH_NAME, vfs_path_get_by_index (vpath, -1)->path) == 0 ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_setup_work_dir ();
+
+    vfs_init_subclass (&test_subclass, "testfs", VFSF_READONLY, "test");
+    test_subclass.open_archive = test_open_archive;
+    test_subclass.archive_same = test_archive_same;
+    vfs_test_ops->setctl = vfs_s_archive_setctl;
+    vfs_register_class (vfs_test_ops);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @DataSource("test_vfs_s_archive_setctl_ds") */
+/* *INDENT-OFF* */
+static const struct test_vfs_s_archive_setctl_ds
+{
+    const char *path;
+    off_t expected_offset;
+} test_vfs_s_archive_setctl_ds[] =
+{
+    { /* 0. */
+        "a.txt",
+        5000
+    },
+    { /* 1. */
+        "b.txt",
+        1000
+    },
+    { /* 2. directory is positioned by its first file */
+        "dir",
+        2000
+    },
+    { /* 3. */
+        "dir/sub",
+        2000
+    },
+    { /* 4. no data */
+        "empty",
+        -1
+    },
+    { /* 5. */
+        "zero.txt",
+        -1
+    },
+    { /* 6. */
+        "link",
+        -1
+    },
+    { /* 7. */
+        "missing",
+        -1
+    },
+    { /* 8. whole archive */
+        "",
+        1000
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_vfs_s_archive_setctl_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_vfs_s_archive_setctl, test_vfs_s_archive_setctl_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_path_t *vpath;
+    char *path;
+    off_t offset = 12345;
+    int result;
+
+    path = g_strconcat (ARCH_NAME "/test://", data->path, (char *) NULL);
+    vpath = vfs_path_from_str (path);
+    g_free (path);
+
+    /* when */
+    result = mc_setctl (vpath, VFS_SETCTL_DATA_OFFSET, &offset);
+
+    /* then */
+    mctest_assert_int_eq (result, 1);
+    mctest_assert_int_eq (offset, data->expected_offset);
+
+    /* other operations are not supported */
+    mctest_assert_int_eq (mc_setctl (vpath, VFS_SETCTL_FLUSH, NULL), 0);
+
+    vfs_path_free (vpath);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    mctest_add_parameterized_test (tc_core, test_vfs_s_archive_setctl,
+                                   test_vfs_s_archive_setctl_ds);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_s_archive_setctl.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,400 @@
+/*
+   lib/vfs - test memory arena of read-only archive trees
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include "tests/mctest.h"
+
+#ifdef TEST_BENCHMARK
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+#include "lib/strutil.h"
+#include "lib/vfs/xdirentry.h"
+#include "lib/vfs/gc.h"
+
+#include "src/vfs/local/local.c"
+
+#define ARCH_NAME "/path/to/some/archive.tar"
+
+#ifdef TEST_BENCHMARK
+/* vfs_s_arena_bench, not run by "make check": time and memory of building and freeing
+   a big tree */
+#define TEST_DIRS 1000
+#define TEST_MEMBERS 500000
+#else
+#define TEST_DIRS 10
+#define TEST_MEMBERS 5000
+#endif
+
+/* read-only archive class: tree is allocated from arena */
+static struct vfs_s_subclass test_subclass;
+/* the same with tree allocated from heap */
+static struct vfs_s_subclass test_rw_subclass;
+
+/* number of members to create, 0 for small test tree */
+static int test_members = 0;
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_inode *
+test_add_entry (struct vfs_class *me, struct vfs_s_inode *parent, const char *name, mode_t mode)
+{
+    struct vfs_s_inode *inode;
+    struct vfs_s_entry *entry;
+    struct stat st;
+
+    memset (&st, 0, sizeof (st));
+    st.st_mode = mode;
+    st.st_size = 100;
+
+    inode = vfs_s_new_inode (me, parent->super, &st);
+    entry = vfs_s_new_entry (me, name, inode);
+    vfs_s_insert_entry (me, parent, entry);
+
+    return inode;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_open_archive (struct vfs_s_super *super, const vfs_path_t * vpath,
+                   const vfs_path_element_t * vpath_element)
+{
+    struct vfs_class *me = vpath_element->class;
+    struct stat st;
+
+    super->name = g_strdup (vfs_path_as_str (vpath));
+
+    memset (&st, 0, sizeof (st));
+    st.st_mode = S_IFDIR | 0755;
+    super->root = vfs_s_new_inode (me, super, &st);
+
+    if (test_members == 0)
+    {
+        struct vfs_s_inode *dir, *link;
+
+        dir = test_add_entry (me, super->root, "a", S_IFDIR | 0755);
+        test_add_entry (me, dir, "Makefile", S_IFREG | 0644);
+        test_add_entry (me, dir, "x.c", S_IFREG | 0644);
+        dir = test_add_entry (me, super->root, "b", S_IFDIR | 0755);
+        test_add_entry (me, dir, "Makefile", S_IFREG | 0644);
+        link = test_add_entry (me, super->root, "link", S_IFLNK | 0777);
+        vfs_s_set_linkname (link, "a/x.c", -1);
+    }
+    else
+    {
+        struct vfs_s_inode *dirs[TEST_DIRS];
+        char name[BUF_TINY];
+        int i;
+
+        for (i = 0; i < TEST_DIRS; i++)
+        {
+            g_snprintf (name, sizeof (name), "dir%04d", i);
+            dirs[i] = test_add_entry (me, super->root, name, S_IFDIR | 0755);
+        }
+
+        for (i = 0; i < test_members; i++)
+        {
+            g_snprintf (name, sizeof (name), "file%07d.c", i);
+            test_add_entry (me, dirs[i % TEST_DIRS], name, S_IFREG | 0644);
+        }
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_archive_same (const vfs_path_element_t * vpath_element, struct vfs_s_super *super,
+                   const vfs_path_t * vpath, void *cookie)
+{
+    (void) vpath_element;
+    (void) super;
+    (void) cookie;
+
+    return strcmp (ARCH_NAME, vfs_path_get_by_index (vpath, -1)->path) == 0 ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_super *
+test_get_super (struct vfs_s_subclass *sub, const char *path)
+{
+    vfs_path_t *vpath;
+    struct stat st;
+    char *p;
+    int ret;
+
+    p = g_strconcat (ARCH_NAME "/", VFS_CLASS (sub)->prefix, "://", path, (char *) NULL);
+    vpath = vfs_path_from_str (p);
+    g_free (p);
+    ret = mc_lstat (vpath, &st);
+    vfs_path_free (vpath);
+
+    return (ret == 0 && sub->supers != NULL) ? VFS_SUPER (sub->supers->data) : NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_free_super (struct vfs_s_super *super)
+{
+    vfs_rmstamp (super->me, (vfsid) super);
+    super->me->free ((vfsid) super);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef TEST_BENCHMARK
+/* resident memory in KiB, 0 if unknown */
+static long
+test_get_rss (void)
+{
+    long pages = 0, rss = 0;
+    FILE *f;
+
+    f = fopen ("/proc/self/statm", "r");
+    if (f != NULL)
+    {
+        if (fscanf (f, "%ld %ld", &pages, &rss) != 2)
+            rss = 0;
+        fclose (f);
+    }
+
+    return rss * (sysconf (_SC_PAGESIZE) / 1024);
+}
+#endif /* TEST_BENCHMARK */
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_init_subclass (struct vfs_s_subclass *sub, const char *name, vfs_flags_t flags,
+                    const char *prefix)
+{
+    vfs_init_subclass (sub, name, flags, prefix);
+    sub->open_archive = test_open_archive;
+    sub->archive_same = test_archive_same;
+    vfs_register_class (VFS_CLASS (sub));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_setup_work_dir ();
+
+    test_init_subclass (&test_subclass, "testfs", VFSF_READONLY, "test");
+    test_init_subclass (&test_rw_subclass, "testrwfs", VFSF_UNKNOWN, "testrw");
+
+    test_members = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @DataSource("test_vfs_s_arena_ds") */
+/* *INDENT-OFF* */
+static const struct test_vfs_s_arena_ds
+{
+    gboolean read_only;
+} test_vfs_s_arena_ds[] =
+{
+    { /* 0. */
+        TRUE
+    },
+    { /* 1. */
+        FALSE
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_vfs_s_arena_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_vfs_s_arena_tree, test_vfs_s_arena_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct vfs_s_subclass *sub = data->read_only ? &test_subclass : &test_rw_subclass;
+    struct vfs_class *me = VFS_CLASS (sub);
+    struct vfs_s_super *super;
+    struct vfs_s_inode *a, *b, *link;
+    struct vfs_s_entry *ent;
+
+    /* when */
+    super = test_get_super (sub, "a/x.c");
+
+    /* then */
+    mctest_assert_not_null (super);
+    mctest_assert_true (((super->arena != NULL) == data->read_only));
+
+    a = vfs_s_find_inode (me, super, "a/Makefile", LINK_NO_FOLLOW, FL_NONE);
+    b = vfs_s_find_inode (me, super, "b/Makefile", LINK_NO_FOLLOW, FL_NONE);
+    mctest_assert_not_null (a);
+    mctest_assert_not_null (b);
+    mctest_assert_str_eq (a->ent->name, "Makefile");
+    /* names are interned */
+    mctest_assert_true (((a->ent->name == b->ent->name) == data->read_only));
+
+    link = vfs_s_find_inode (me, super, "link", LINK_NO_FOLLOW, FL_NONE);
+    mctest_assert_not_null (link);
+    mctest_assert_str_eq (link->linkname, "a/x.c");
+    mctest_assert_ptr_eq (vfs_s_find_inode (me, super, "link", LINK_FOLLOW, FL_NONE),
+                          vfs_s_find_inode (me, super, "a/x.c", LINK_NO_FOLLOW, FL_NONE));
+
+    /* entries still can be removed one by one */
+    ent = a->ent;
+    vfs_s_free_entry (me, ent);
+    mctest_assert_null (vfs_s_find_inode (me, super, "a/Makefile", LINK_NO_FOLLOW, FL_NONE));
+    mctest_assert_not_null (vfs_s_find_inode (me, super, "a/x.c", LINK_NO_FOLLOW, FL_NONE));
+    mctest_assert_int_eq (g_queue_get_length (vfs_s_find_inode (me, super, "a", LINK_NO_FOLLOW,
+                                                                FL_NONE)->subdir), 1);
+
+    test_free_super (super);
+    mctest_assert_null (sub->supers);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test(dataSource = "test_vfs_s_arena_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_vfs_s_arena_large, test_vfs_s_arena_ds)
+/* *INDENT-ON* */
+{
+    /* given: tree taking many blocks of arena */
+    struct vfs_s_subclass *sub = data->read_only ? &test_subclass : &test_rw_subclass;
+    struct vfs_class *me = VFS_CLASS (sub);
+    struct vfs_s_super *super;
+    struct vfs_s_inode *dir;
+
+    test_members = TEST_MEMBERS;
+
+    /* when */
+    super = test_get_super (sub, "dir0009/file0004999.c");
+
+    /* then */
+    mctest_assert_not_null (super);
+    mctest_assert_not_null (vfs_s_find_inode (me, super, "dir0000/file0000000.c", LINK_NO_FOLLOW,
+                                              FL_NONE));
+    mctest_assert_null (vfs_s_find_inode (me, super, "dir0001/file0000000.c", LINK_NO_FOLLOW,
+                                          FL_NONE));
+    dir = vfs_s_find_inode (me, super, "dir0005", LINK_NO_FOLLOW, FL_NONE);
+    mctest_assert_not_null (dir);
+    mctest_assert_int_eq (g_queue_get_length (dir->subdir), TEST_MEMBERS / TEST_DIRS);
+
+    test_free_super (super);
+    mctest_assert_null (sub->supers);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef TEST_BENCHMARK
+/* @Test(dataSource = "test_vfs_s_arena_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_vfs_s_arena_benchmark, test_vfs_s_arena_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct vfs_s_subclass *sub = data->read_only ? &test_subclass : &test_rw_subclass;
+    struct vfs_s_super *super;
+    gint64 start, loaded, done;
+    long rss;
+
+    test_members = TEST_MEMBERS;
+    rss = test_get_rss ();
+
+    /* when */
+    start = g_get_monotonic_time ();
+    super = test_get_super (sub, "dir0999/file0000999.c");
+    loaded = g_get_monotonic_time ();
+    rss = test_get_rss () - rss;
+    test_free_super (super);
+    done = g_get_monotonic_time ();
+
+    /* then */
+    mctest_assert_not_null (super);
+    mctest_assert_null (sub->supers);
+
+    printf ("%s tree of %d members: built in %.1f ms, %ld KiB, freed in %.1f ms\n",
+            data->read_only ? "arena" : "heap", TEST_MEMBERS, (double) (loaded - start) / 1000.0,
+            rss, (double) (done - loaded) / 1000.0);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+#endif /* TEST_BENCHMARK */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+#ifdef TEST_BENCHMARK
+    mctest_add_parameterized_test (tc_core, test_vfs_s_arena_benchmark, test_vfs_s_arena_ds);
+#else
+    mctest_add_parameterized_test (tc_core, test_vfs_s_arena_tree, test_vfs_s_arena_ds);
+    mctest_add_parameterized_test (tc_core, test_vfs_s_arena_large, test_vfs_s_arena_ds);
+#endif
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_s_arena.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
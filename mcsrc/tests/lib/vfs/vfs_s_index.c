@@ -0,0 +1,348 @@
+/* lib/vfs - test persistent listing index of archives
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include "tests/mctest.h"
+
+#include <unistd.h>
+
+#include "lib/strutil.h"
+#include "lib/vfs/xdirentry.h"
+#include "lib/vfs/arcindex.h"
+
+#include "src/vfs/local/local.c"
+
+#define ARCH_NAME "/path/to/some/archive.tar"
+#define FILES_COUNT 100
+
+static struct vfs_s_subclass test_subclass;
+static struct vfs_class *vfs_test_ops = VFS_CLASS (&test_subclass);
+
+static char *test_home = NULL;
+static struct stat archive_stat;
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_rmtree (const char *path)
+{
+    GDir *dir;
+
+    dir = g_dir_open (path, 0, NULL);
+    if (dir != NULL)
+    {
+        const char *name;
+
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            char *child;
+
+            child = g_build_filename (path, name, (char *) NULL);
+            test_rmtree (child);
+            g_free (child);
+        }
+        g_dir_close (dir);
+        rmdir (path);
+    }
+    else
+        unlink (path);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_super *
+test_new_super (void)
+{
+    struct vfs_s_super *super;
+    struct stat st;
+
+    super = g_new0 (struct vfs_s_super, 1);
+    super->me = vfs_test_ops;
+    super->name = g_strdup (ARCH_NAME);
+
+    memset (&st, 0, sizeof (st));
+    st.st_mode = S_IFDIR | 0755;
+    super->root = vfs_s_new_inode (vfs_test_ops, super, &st);
+    super->root->st.st_nlink++;
+
+    test_subclass.supers = g_list_prepend (test_subclass.supers, super);
+
+    return super;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_entry *
+test_add_entry (struct vfs_s_super *super, struct vfs_s_inode *dir, const char *name,
+                mode_t mode, off_t size)
+{
+    struct vfs_s_inode *inode;
+    struct vfs_s_entry *entry;
+    struct stat st;
+
+    memset (&st, 0, sizeof (st));
+    st.st_mode = mode;
+    st.st_size = size;
+    st.st_mtime = 1000000 + size;
+    st.st_uid = 1000;
+    st.st_gid = 100;
+
+    inode = vfs_s_new_inode (vfs_test_ops, super, &st);
+    inode->data_offset = size * 512;
+    entry = vfs_s_new_entry (vfs_test_ops, name, inode);
+    vfs_s_insert_entry (vfs_test_ops, dir, entry);
+
+    return entry;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_entry *
+test_find_entry (struct vfs_s_inode *dir, const char *name)
+{
+    GList *iter;
+
+    for (iter = g_queue_peek_head_link (dir->subdir); iter != NULL; iter = g_list_next (iter))
+        if (strcmp (VFS_ENTRY (iter->data)->name, name) == 0)
+            return VFS_ENTRY (iter->data);
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_super *
+test_make_archive (void)
+{
+    struct vfs_s_super *super;
+    struct vfs_s_entry *dir, *file;
+    int i;
+
+    super = test_new_super ();
+
+    dir = test_add_entry (super, super->root, "dir", S_IFDIR | 0755, 0);
+    dir->ino->data_offset = -1;
+
+    for (i = 0; i < FILES_COUNT; i++)
+    {
+        char name[32];
+
+        g_snprintf (name, sizeof (name), "file%03d", i);
+        test_add_entry (super, dir->ino, name, S_IFREG | 0644, i + 1);
+    }
+
+    file = test_add_entry (super, super->root, "symlink", S_IFLNK | 0777, 0);
+    file->ino->linkname = g_strdup ("dir/file000");
+
+    /* hard link */
+    file = test_find_entry (dir->ino, "file001");
+    vfs_s_insert_entry (vfs_test_ops, super->root,
+                        vfs_s_new_entry (vfs_test_ops, "hardlink", file->ino));
+
+    return super;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    test_home = g_dir_make_tmp ("mctest-XXXXXX", NULL);
+    g_setenv ("HOME", test_home, TRUE);
+    g_setenv ("XDG_CACHE_HOME", test_home, TRUE);
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_setup_work_dir ();
+
+    vfs_init_subclass (&test_subclass, "testfs", VFSF_UNKNOWN, "test");
+    vfs_register_class (vfs_test_ops);
+
+    memset (&archive_stat, 0, sizeof (archive_stat));
+    archive_stat.st_mode = S_IFREG | 0644;
+    archive_stat.st_size = 123456;
+    archive_stat.st_mtime = 1500000000;
+    archive_stat.st_ino = 42;
+    archive_stat.st_dev = 1;
+
+    mc_global.vfs.archive_index = TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    vfs_shut ();
+    str_uninit_strings ();
+
+    test_rmtree (test_home);
+    g_free (test_home);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_s_index_roundtrip)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct vfs_s_super *etalon, *actual;
+    struct vfs_s_entry *dir, *file, *link;
+    gboolean loaded;
+
+    etalon = test_make_archive ();
+    vfs_s_index_save (etalon, NULL, &archive_stat);
+
+    actual = test_new_super ();
+
+    /* when */
+    loaded = vfs_s_index_load (actual, NULL, &archive_stat);
+
+    /* then */
+    mctest_assert_true (loaded);
+    mctest_assert_int_eq (g_queue_get_length (actual->root->subdir), 3);
+
+    dir = test_find_entry (actual->root, "dir");
+    mctest_assert_not_null (dir);
+    mctest_assert_true (S_ISDIR (dir->ino->st.st_mode));
+    mctest_assert_int_eq (g_queue_get_length (dir->ino->subdir), FILES_COUNT);
+
+    file = test_find_entry (dir->ino, "file050");
+    mctest_assert_not_null (file);
+    mctest_assert_int_eq (file->ino->st.st_size, 51);
+    mctest_assert_int_eq (file->ino->st.st_mtime, 1000051);
+    mctest_assert_int_eq (file->ino->st.st_uid, 1000);
+    mctest_assert_int_eq (file->ino->data_offset, 51 * 512);
+
+    link = test_find_entry (actual->root, "symlink");
+    mctest_assert_not_null (link);
+    mctest_assert_true (S_ISLNK (link->ino->st.st_mode));
+    mctest_assert_str_eq (link->ino->linkname, "dir/file000");
+
+    link = test_find_entry (actual->root, "hardlink");
+    mctest_assert_not_null (link);
+    mctest_assert_ptr_eq (link->ino, test_find_entry (dir->ino, "file001")->ino);
+    mctest_assert_int_eq (link->ino->st.st_nlink, 2);
+    /* first entry is kept */
+    mctest_assert_ptr_eq (link->ino->ent, link);
+
+    vfs_test_ops->free ((vfsid) actual);
+    vfs_test_ops->free ((vfsid) etalon);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_s_index_stale)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct vfs_s_super *etalon, *actual;
+    gboolean loaded;
+
+    etalon = test_make_archive ();
+    vfs_s_index_save (etalon, NULL, &archive_stat);
+    actual = test_new_super ();
+
+    /* when */
+    archive_stat.st_mtime++;
+    loaded = vfs_s_index_load (actual, NULL, &archive_stat);
+
+    /* then */
+    mctest_assert_false (loaded);
+    mctest_assert_int_eq (g_queue_get_length (actual->root->subdir), 0);
+
+    vfs_test_ops->free ((vfsid) actual);
+    vfs_test_ops->free ((vfsid) etalon);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_s_index_owner)
+/* *INDENT-ON* */
+{
+    /* given: index built by one extfs helper */
+    struct vfs_s_super *etalon, *actual;
+
+    etalon = test_make_archive ();
+    vfs_s_index_save (etalon, "uzip", &archive_stat);
+    actual = test_new_super ();
+
+    /* then: it isn't used by the class itself and by other helpers */
+    mctest_assert_false (vfs_s_index_load (actual, NULL, &archive_stat));
+    mctest_assert_false (vfs_s_index_load (actual, "urar", &archive_stat));
+    mctest_assert_int_eq (g_queue_get_length (actual->root->subdir), 0);
+
+    mctest_assert_true (vfs_s_index_load (actual, "uzip", &archive_stat));
+    mctest_assert_int_eq (g_queue_get_length (actual->root->subdir), 3);
+
+    vfs_test_ops->free ((vfsid) actual);
+    vfs_test_ops->free ((vfsid) etalon);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_vfs_s_index_roundtrip);
+    tcase_add_test (tc_core, test_vfs_s_index_stale);
+    tcase_add_test (tc_core, test_vfs_s_index_owner);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_s_index.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,227 @@
+/*
+   lib/vfs - test loading of remote directories in advance
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include "tests/mctest.h"
+
+#include "lib/strutil.h"
+#include "lib/vfs/xdirentry.h"
+
+#include "src/vfs/local/local.c"
+
+static struct vfs_s_subclass test_subclass;
+static struct vfs_class *vfs_test_ops = VFS_CLASS (&test_subclass);
+
+static int dir_load_calls;
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *path)
+{
+    struct vfs_s_entry *ent;
+
+    (void) path;
+
+    dir_load_calls++;
+    dir->timestamp.tv_sec = G_MAXINT32;
+
+    ent = vfs_s_generate_entry (me, "sub", dir, S_IFDIR | 0755);
+    vfs_s_insert_entry (me, dir, ent);
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_open_archive (struct vfs_s_super *super, const vfs_path_t * vpath,
+                   const vfs_path_element_t * vpath_element)
+{
+    (void) vpath;
+    (void) vpath_element;
+
+    super->name = g_strdup (PATH_SEP_STR);
+    super->root = vfs_s_new_inode (vfs_test_ops, super, vfs_s_default_stat (vfs_test_ops,
+                                                                            S_IFDIR | 0755));
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_archive_same (const vfs_path_element_t * vpath_element, struct vfs_s_super *super,
+                   const vfs_path_t * vpath, void *cookie)
+{
+    (void) vpath_element;
+    (void) super;
+    (void) vpath;
+    (void) cookie;
+
+    return 1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_opendir (const char *path)
+{
+    vfs_path_t *vpath;
+    DIR *dir;
+    int count = 0;
+
+    vpath = vfs_path_from_str (path);
+    dir = mc_opendir (vpath);
+    vfs_path_free (vpath);
+
+    if (dir == NULL)
+        return (-1);
+
+    while (mc_readdir (dir) != NULL)
+        count++;
+    mc_closedir (dir);
+
+    return count;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_prefetch_dir (const char *path)
+{
+    vfs_path_t *vpath;
+    int result;
+
+    vpath = vfs_path_from_str (path);
+    result = mc_setctl (vpath, VFS_SETCTL_PREFETCH_DIR, NULL);
+    vfs_path_free (vpath);
+
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_setup_work_dir ();
+
+    vfs_init_subclass (&test_subclass, "testfs", VFSF_REMOTE, "test");
+    test_subclass.open_archive = test_open_archive;
+    test_subclass.archive_same = test_archive_same;
+    test_subclass.dir_load = test_dir_load;
+    vfs_register_class (vfs_test_ops);
+
+    dir_load_calls = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_s_prefetch_dir)
+/* *INDENT-ON* */
+{
+    /* given: connection is open */
+    mctest_assert_int_eq (test_opendir ("/test://host/dir"), 1);
+    mctest_assert_int_eq (dir_load_calls, 1);
+
+    /* when */
+    mctest_assert_int_eq (test_prefetch_dir ("/test://host/dir/sub"), 1);
+
+    /* then */
+    mctest_assert_int_eq (dir_load_calls, 2);
+
+    /* when: listing is cached already */
+    mctest_assert_int_eq (test_prefetch_dir ("/test://host/dir/sub"), 0);
+
+    /* then: entering the directory doesn't load it again */
+    mctest_assert_int_eq (test_opendir ("/test://host/dir/sub"), 1);
+    mctest_assert_int_eq (dir_load_calls, 2);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_s_prefetch_dir_no_connection)
+/* *INDENT-ON* */
+{
+    /* when */
+    mctest_assert_int_eq (test_prefetch_dir ("/test://host/dir"), 0);
+
+    /* then: no connection is opened for it */
+    mctest_assert_int_eq (dir_load_calls, 0);
+    mctest_assert_null (test_subclass.supers);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_vfs_s_prefetch_dir);
+    tcase_add_test (tc_core, test_vfs_s_prefetch_dir_no_connection);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_s_prefetch_dir.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
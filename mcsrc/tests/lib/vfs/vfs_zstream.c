@@ -0,0 +1,423 @@
+/* lib/vfs - test in-process decompression of archives
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include "tests/mctest.h"
+
+#include <unistd.h>
+
+#include <zlib.h>
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#include "lib/strutil.h"
+#include "lib/vfs/zstream.h"
+
+#include "src/vfs/local/local.c"
+
+#define DATA_SIZE (8 * 1024 * 1024)
+
+/* size of xz blocks */
+#define XZ_BLOCK_SIZE (1024 * 1024)
+
+static char *test_file = NULL;
+#ifdef HAVE_LZMA
+static char *test_xz_file = NULL;
+#endif
+
+/* @CapturedValue */
+static size_t mc_read__bytes;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+ssize_t
+mc_read (int handle, void *buf, size_t count)
+{
+    struct vfs_class *vfs;
+    void *fsinfo = NULL;
+    ssize_t ret;
+
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
+    ret = vfs->read (fsinfo, buf, count);
+    if (ret > 0)
+        mc_read__bytes += (size_t) ret;
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* data doesn't compress, so amount of compressed data read shows how much was decoded */
+static char
+test_data_byte (off_t offset)
+{
+    guint32 h = (guint32) offset * 0x9e3779b1U;
+
+    h ^= h >> 15;
+    h *= 0x85ebca77U;
+    h ^= h >> 13;
+
+    return (char) (h >> 24);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* write data as two gzip members to check concatenated files */
+static void
+test_make_gzip_file (void)
+{
+    char *buf;
+    gzFile gz;
+    off_t i;
+
+    buf = g_malloc (DATA_SIZE);
+    for (i = 0; i < DATA_SIZE; i++)
+        buf[i] = test_data_byte (i);
+
+    gz = gzopen (test_file, "wb");
+    gzwrite (gz, buf, DATA_SIZE / 2);
+    gzclose (gz);
+
+    gz = gzopen (test_file, "ab");
+    gzwrite (gz, buf + DATA_SIZE / 2, DATA_SIZE / 2);
+    gzclose (gz);
+
+    g_free (buf);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_LZMA
+/* write data as two xz streams of several blocks each */
+static void
+test_make_xz_file (void)
+{
+    char *buf;
+    unsigned char *out;
+    FILE *f;
+    int i;
+    off_t j;
+
+    buf = g_malloc (DATA_SIZE);
+    for (j = 0; j < DATA_SIZE; j++)
+        buf[j] = test_data_byte (j);
+
+    out = g_malloc (BUF_8K);
+    f = fopen (test_xz_file, "wb");
+
+    for (i = 0; i < 2; i++)
+    {
+        lzma_stream xz = LZMA_STREAM_INIT;
+        lzma_ret ret = LZMA_OK;
+
+        mctest_assert_int_eq (lzma_easy_encoder (&xz, 0, LZMA_CHECK_CRC64), LZMA_OK);
+
+        for (j = 0; j < DATA_SIZE / 2; j += XZ_BLOCK_SIZE)
+        {
+            /* full flush ends the block */
+            const lzma_action action =
+                j + XZ_BLOCK_SIZE < DATA_SIZE / 2 ? LZMA_FULL_FLUSH : LZMA_FINISH;
+
+            xz.next_in = (const uint8_t *) buf + i * DATA_SIZE / 2 + j;
+            xz.avail_in = XZ_BLOCK_SIZE;
+
+            do
+            {
+                xz.next_out = out;
+                xz.avail_out = BUF_8K;
+                ret = lzma_code (&xz, action);
+                fwrite (out, 1, BUF_8K - xz.avail_out, f);
+            }
+            while (ret == LZMA_OK);
+        }
+
+        mctest_assert_int_eq (ret, LZMA_STREAM_END);
+        lzma_end (&xz);
+    }
+
+    /* stream padding */
+    fwrite ("\0\0\0\0", 1, 4, f);
+
+    fclose (f);
+    g_free (out);
+    g_free (buf);
+}
+#endif
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+test_check_data (const char *buf, off_t offset, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        if (buf[i] != test_data_byte (offset + i))
+            return FALSE;
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_setup_work_dir ();
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-zstream.gz", (char *) NULL);
+    test_make_gzip_file ();
+
+#ifdef HAVE_LZMA
+    test_xz_file = g_build_filename (g_get_tmp_dir (), "mctest-zstream.xz", (char *) NULL);
+    test_make_xz_file ();
+#endif
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    unlink (test_file);
+    g_free (test_file);
+
+#ifdef HAVE_LZMA
+    unlink (test_xz_file);
+    g_free (test_xz_file);
+#endif
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_vfs_zstream_read_seek)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_path_t *vpath;
+    vfs_zstream_t *zs;
+    char *buf;
+    off_t total = 0;
+    ssize_t n;
+    int fd;
+
+    vpath = vfs_path_from_str (test_file);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+    mctest_assert_int_ne (fd, -1);
+
+    /* when */
+    zs = vfs_zstream_open (fd, get_compression_type (fd, test_file));
+
+    /* then */
+    mctest_assert_not_null (zs);
+
+    buf = g_malloc (BUF_10K);
+
+    /* sequential read through member boundary */
+    while ((n = vfs_zstream_read (zs, buf, 5000)) > 0)
+    {
+        mctest_assert_true (test_check_data (buf, total, (size_t) n));
+        total += n;
+    }
+    mctest_assert_int_eq (n, 0);
+    mctest_assert_int_eq (total, DATA_SIZE);
+
+    /* backward seek */
+    mctest_assert_int_eq (vfs_zstream_seek (zs, 10), 10);
+    mctest_assert_int_eq (vfs_zstream_read (zs, buf, 100), 100);
+    mctest_assert_true (test_check_data (buf, 10, 100));
+    mctest_assert_int_eq (vfs_zstream_tell (zs), 110);
+
+    /* forward seek into the second member */
+    mctest_assert_int_eq (vfs_zstream_seek (zs, 5000000), 5000000);
+    mctest_assert_int_eq (vfs_zstream_read (zs, buf, BUF_10K), BUF_10K);
+    mctest_assert_true (test_check_data (buf, 5000000, BUF_10K));
+
+    /* seek past the end */
+    mctest_assert_int_eq (vfs_zstream_seek (zs, DATA_SIZE + 100), DATA_SIZE);
+
+    g_free (buf);
+    vfs_zstream_close (zs);
+    mc_close (fd);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @DataSource("test_vfs_zstream_seek_point_ds") */
+/* *INDENT-OFF* */
+static const struct test_vfs_zstream_seek_point_ds
+{
+    off_t offset;
+} test_vfs_zstream_seek_point_ds[] =
+{
+    { /* 0. */
+        DATA_SIZE - 1000
+    },
+    { /* 1. */
+        DATA_SIZE / 2 + 3
+    },
+    { /* 2. end of the first gzip member */
+        DATA_SIZE / 2 - 100
+    },
+    { /* 3. */
+        3 * 1024 * 1024 + 12345
+    },
+    { /* 4. */
+        1024 * 1024 - 1
+    },
+    { /* 5. */
+        7
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_vfs_zstream_seek_point_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_vfs_zstream_seek_point, test_vfs_zstream_seek_point_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_path_t *vpath;
+    vfs_zstream_t *zs;
+    char buf[200];
+    int fd;
+
+    vpath = vfs_path_from_str (test_file);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+    zs = vfs_zstream_open (fd, COMPRESSION_GZIP);
+    mctest_assert_not_null (zs);
+
+    /* first pass records seek points */
+    mctest_assert_int_eq (vfs_zstream_seek (zs, DATA_SIZE), DATA_SIZE);
+
+    /* when */
+    mc_read__bytes = 0;
+    mctest_assert_int_eq (vfs_zstream_seek (zs, data->offset), data->offset);
+    mctest_assert_int_eq (vfs_zstream_read (zs, buf, sizeof (buf)), sizeof (buf));
+
+    /* then */
+    mctest_assert_true (test_check_data (buf, data->offset, sizeof (buf)));
+    /* decoding started at seek point, not at the beginning of file */
+    mctest_assert_true ((mc_read__bytes < DATA_SIZE / 4));
+
+    vfs_zstream_close (zs);
+    mc_close (fd);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_LZMA
+/* @Test(dataSource = "test_vfs_zstream_seek_point_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_vfs_zstream_xz_seek_point, test_vfs_zstream_seek_point_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_path_t *vpath;
+    vfs_zstream_t *zs;
+    char buf[200];
+    int fd;
+
+    vpath = vfs_path_from_str (test_xz_file);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+    mctest_assert_int_eq (get_compression_type (fd, test_xz_file), COMPRESSION_XZ);
+    /* seek points are taken from xz index */
+    zs = vfs_zstream_open (fd, COMPRESSION_XZ);
+    mctest_assert_not_null (zs);
+
+    /* when */
+    mc_read__bytes = 0;
+    mctest_assert_int_eq (vfs_zstream_seek (zs, data->offset), data->offset);
+    mctest_assert_int_eq (vfs_zstream_read (zs, buf, sizeof (buf)), sizeof (buf));
+
+    /* then */
+    mctest_assert_true (test_check_data (buf, data->offset, sizeof (buf)));
+    /* decoding started at block boundary, not at the beginning of file */
+    mctest_assert_true ((mc_read__bytes < DATA_SIZE / 4));
+
+    /* block and stream boundaries are crossed after restore */
+    mctest_assert_int_eq (vfs_zstream_seek (zs, DATA_SIZE / 2 - 100), DATA_SIZE / 2 - 100);
+    mctest_assert_int_eq (vfs_zstream_seek (zs, DATA_SIZE + 100), DATA_SIZE);
+
+    vfs_zstream_close (zs);
+    mc_close (fd);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+#endif
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_vfs_zstream_read_seek);
+    mctest_add_parameterized_test (tc_core, test_vfs_zstream_seek_point,
+                                   test_vfs_zstream_seek_point_ds);
+#ifdef HAVE_LZMA
+    mctest_add_parameterized_test (tc_core, test_vfs_zstream_xz_seek_point,
+                                   test_vfs_zstream_seek_point_ds);
+#endif
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_zstream.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,528 @@
+/* src/vfs/ar - test ar filesystem
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/ar"
+
+#include "tests/mctest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "lib/strutil.h"
+
+#include "src/vfs/local/local.c"
+#include "src/vfs/ar/ar.c"
+#ifdef ENABLE_VFS_TAR
+#include "src/vfs/tar/tar.c"
+#endif
+
+/* bigger than the block of archive reader */
+#define BIG_SIZE (300 * 1024 + 1)
+#define TEST_MTIME 1500000000
+
+#define TEST_REGTYPE '0'
+
+typedef struct
+{
+    const char *name;
+    const char *data;
+    size_t len;
+} test_member_t;
+
+static char *test_file = NULL;
+static char *big_data = NULL;
+
+/* @CapturedValue */
+static char *message_text__captured = NULL;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+message (int flags, const char *title, const char *text, ...)
+{
+    va_list ap;
+
+    (void) flags;
+    (void) title;
+
+    g_free (message_text__captured);
+    va_start (ap, text);
+    message_text__captured = g_strdup_vprintf (text, ap);
+    va_end (ap);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_header (GByteArray * out, const char *name, size_t size)
+{
+    char hdr[AR_HEADER_SIZE + 1];
+
+    g_snprintf (hdr, sizeof (hdr), "%-16s%-12lu%-6u%-6u%-8o%-10lu`\n", name,
+                (unsigned long) TEST_MTIME, 1000U, 1000U, 0100640U, (unsigned long) size);
+    g_byte_array_append (out, (const guint8 *) hdr, AR_HEADER_SIZE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_data (GByteArray * out, const char *data, size_t len)
+{
+    g_byte_array_append (out, (const guint8 *) data, len);
+    if (len % 2 != 0)
+        g_byte_array_append (out, (const guint8 *) "\n", 1);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* write ar archive with GNU or BSD long names and a symbol table */
+static void
+test_make_ar (const test_member_t * members, size_t count, gboolean bsd)
+{
+    GByteArray *out;
+    GString *names;
+    size_t i, names_offset = 0;
+    FILE *f;
+
+    out = g_byte_array_new ();
+    names = g_string_new ("");
+
+    g_byte_array_append (out, (const guint8 *) AR_MAGIC, AR_MAGIC_LEN);
+
+    if (bsd)
+    {
+        test_put_header (out, "#1/20", 20 + 8);
+        test_put_data (out, "__.SYMDEF SORTED\0\0\0\0" "\0\0\0\0\0\0\0\0", 20 + 8);
+    }
+    else
+    {
+        test_put_header (out, "/", 4);
+        test_put_data (out, "\0\0\0\0", 4);
+
+        for (i = 0; i < count; i++)
+            if (strlen (members[i].name) > 15)
+                g_string_append_printf (names, "%s/\n", members[i].name);
+
+        if (names->len != 0)
+        {
+            test_put_header (out, "//", names->len);
+            test_put_data (out, names->str, names->len);
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        const test_member_t *m = &members[i];
+        size_t name_len;
+        char field[AR_NAME_LEN + 1];
+
+        name_len = strlen (m->name);
+
+        if (bsd && name_len > 16)
+        {
+            GString *data;
+
+            g_snprintf (field, sizeof (field), "#1/%u", (unsigned int) name_len);
+            data = g_string_new_len (m->name, name_len);
+            g_string_append_len (data, m->data, m->len);
+            test_put_header (out, field, data->len);
+            test_put_data (out, data->str, data->len);
+            g_string_free (data, TRUE);
+            continue;
+        }
+
+        if (bsd)
+            g_strlcpy (field, m->name, sizeof (field));
+        else if (name_len > 15)
+        {
+            /* offset in the long names table */
+            g_snprintf (field, sizeof (field), "/%u", (unsigned int) names_offset);
+            names_offset += name_len + 2;
+        }
+        else
+            g_snprintf (field, sizeof (field), "%s/", m->name);
+
+        test_put_header (out, field, m->len);
+        test_put_data (out, m->data, m->len);
+    }
+
+    f = fopen (test_file, "wb");
+    fwrite (out->data, 1, out->len, f);
+    fclose (f);
+
+    g_string_free (names, TRUE);
+    g_byte_array_free (out, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static vfs_path_t *
+test_inner_path (const char *name)
+{
+    vfs_path_t *vpath;
+    char *path;
+
+    path = g_strconcat (test_file, "/ar://", name, (char *) NULL);
+    vpath = vfs_path_from_str (path);
+    g_free (path);
+
+    return vpath;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_open (const char *name)
+{
+    vfs_path_t *vpath;
+    int fd;
+
+    vpath = test_inner_path (name);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+
+    return fd;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_stat (const char *name, struct stat *st)
+{
+    vfs_path_t *vpath;
+    int ret;
+
+    vpath = test_inner_path (name);
+    ret = mc_lstat (vpath, st);
+    vfs_path_free (vpath);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef ENABLE_VFS_TAR
+static void
+test_put_tar_member (GString * tar, const char *name, const char *data, size_t len)
+{
+    union block b;
+    unsigned int sum = 0;
+    size_t i;
+
+    memset (&b, 0, sizeof (b));
+    g_strlcpy (b.header.name, name, sizeof (b.header.name));
+    g_snprintf (b.header.mode, sizeof (b.header.mode), "%07o", 0644);
+    g_snprintf (b.header.uid, sizeof (b.header.uid), "%07o", 0);
+    g_snprintf (b.header.gid, sizeof (b.header.gid), "%07o", 0);
+    g_snprintf (b.header.size, sizeof (b.header.size), "%011lo", (unsigned long) len);
+    g_snprintf (b.header.mtime, sizeof (b.header.mtime), "%011lo", (unsigned long) TEST_MTIME);
+    b.header.typeflag = TEST_REGTYPE;
+    memcpy (b.header.magic, "ustar ", 6);
+    memcpy (b.header.version, " ", 2);
+
+    memset (b.header.chksum, ' ', sizeof (b.header.chksum));
+    for (i = 0; i < sizeof (b.buffer); i++)
+        sum += (unsigned char) b.buffer[i];
+    g_snprintf (b.header.chksum, sizeof (b.header.chksum), "%06o", sum);
+
+    g_string_append_len (tar, b.buffer, sizeof (b.buffer));
+    g_string_append_len (tar, data, len);
+    while (tar->len % BLOCKSIZE != 0)
+        g_string_append_c (tar, '\0');
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_tar_end (GString * tar)
+{
+    static const char zeros[2 * BLOCKSIZE] = { 0 };
+
+    g_string_append_len (tar, zeros, sizeof (zeros));
+}
+#endif /* ENABLE_VFS_TAR */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    guint32 seed = 12345;
+    size_t i;
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_init_arfs ();
+#ifdef ENABLE_VFS_TAR
+    vfs_init_tarfs ();
+#endif
+    vfs_setup_work_dir ();
+
+    mc_global.vfs.archive_index = FALSE;
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-arfs.a", (char *) NULL);
+
+    big_data = g_malloc (BIG_SIZE);
+    for (i = 0; i < BIG_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        big_data[i] = (char) (seed >> 16);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    unlink (test_file);
+    g_free (test_file);
+    g_free (big_data);
+    MC_PTR_FREE (message_text__captured);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @DataSource("test_arfs_read_ds") */
+/* *INDENT-OFF* */
+static const struct test_arfs_read_ds
+{
+    gboolean bsd;
+} test_arfs_read_ds[] =
+{
+    { /* 0. GNU ar */
+        FALSE
+    },
+    { /* 1. BSD ar */
+        TRUE
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_arfs_read_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_arfs_read, test_arfs_read_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    static const char text[] = "The quick brown fox jumps over the lazy dog\n";
+    const test_member_t members[] = {
+        {"short.o", text, sizeof (text) - 1},
+        {"a_very_long_member_name.o", text, 9},
+        {"big.bin", big_data, BIG_SIZE},
+        {"last.txt", text + 4, sizeof (text) - 5},
+    };
+    struct stat st;
+    char *buf;
+    vfs_path_t *vpath;
+    DIR *dir;
+    struct dirent *dirent;
+    ssize_t n;
+    int fd, count = 0;
+
+    test_make_ar (members, G_N_ELEMENTS (members), data->bsd);
+
+    /* when */
+    mctest_assert_int_eq (test_stat ("short.o", &st), 0);
+
+    /* then */
+    mctest_assert_true (S_ISREG (st.st_mode));
+    mctest_assert_int_eq (st.st_mode & 07777, 0640);
+    mctest_assert_int_eq (st.st_size, sizeof (text) - 1);
+    mctest_assert_int_eq (st.st_mtime, TEST_MTIME);
+    mctest_assert_int_eq (st.st_uid, 1000);
+
+    mctest_assert_int_eq (test_stat ("a_very_long_member_name.o", &st), 0);
+    mctest_assert_int_eq (st.st_size, 9);
+
+    /* symbol tables are not shown */
+    vpath = test_inner_path ("");
+    dir = mc_opendir (vpath);
+    vfs_path_free (vpath);
+    mctest_assert_not_null (dir);
+    while ((dirent = mc_readdir (dir)) != NULL)
+        if (!DIR_IS_DOT (dirent->d_name) && !DIR_IS_DOTDOT (dirent->d_name))
+            count++;
+    mc_closedir (dir);
+    mctest_assert_int_eq (count, G_N_ELEMENTS (members));
+
+    buf = g_malloc (BIG_SIZE);
+
+    fd = test_open ("a_very_long_member_name.o");
+    mctest_assert_int_ne (fd, -1);
+    mctest_assert_int_eq (mc_read (fd, buf, BUF_1K), 9);
+    mctest_assert_int_eq (memcmp (buf, text, 9), 0);
+    mc_close (fd);
+
+    fd = test_open ("big.bin");
+    mctest_assert_int_ne (fd, -1);
+    for (n = 0; n < BIG_SIZE;)
+    {
+        ssize_t r;
+
+        r = mc_read (fd, buf + n, BIG_SIZE - n);
+        mctest_assert_true ((r > 0));
+        n += r;
+    }
+    mctest_assert_int_eq (mc_read (fd, buf, BUF_1K), 0);
+    mctest_assert_int_eq (memcmp (buf, big_data, BIG_SIZE), 0);
+    mc_close (fd);
+
+    /* member after the odd-sized one */
+    fd = test_open ("last.txt");
+    mctest_assert_int_ne (fd, -1);
+    mctest_assert_int_eq (mc_read (fd, buf, BUF_1K), sizeof (text) - 5);
+    mctest_assert_int_eq (memcmp (buf, text + 4, sizeof (text) - 5), 0);
+    mc_close (fd);
+
+    g_free (buf);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef ENABLE_VFS_TAR
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_arfs_deb)
+/* *INDENT-ON* */
+{
+    /* given */
+    static const char copyright[] = "Copyright (C) 2020 Free Software Foundation, Inc.\n";
+    static const char control[] = "Package: mc\nVersion: 4.8.24\n";
+    GString *control_tar, *data_tar;
+    char buf[BUF_1K];
+    vfs_path_t *vpath;
+    ssize_t n;
+    int fd;
+
+    control_tar = g_string_new ("");
+    test_put_tar_member (control_tar, "control", control, sizeof (control) - 1);
+    test_put_tar_end (control_tar);
+
+    data_tar = g_string_new ("");
+    test_put_tar_member (data_tar, "usr/share/doc/mc/copyright", copyright,
+                         sizeof (copyright) - 1);
+    test_put_tar_end (data_tar);
+
+    {
+        const test_member_t members[] = {
+            {"debian-binary", "2.0\n", 4},
+            {"control.tar", control_tar->str, control_tar->len},
+            {"data.tar", data_tar->str, data_tar->len},
+        };
+
+        test_make_ar (members, G_N_ELEMENTS (members), FALSE);
+    }
+
+    /* when */
+    vpath = test_inner_path ("data.tar/utar://usr/share/doc/mc/copyright");
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+
+    /* then */
+    mctest_assert_int_ne (fd, -1);
+    n = mc_read (fd, buf, sizeof (buf));
+    mctest_assert_int_eq (n, sizeof (copyright) - 1);
+    mctest_assert_int_eq (memcmp (buf, copyright, n), 0);
+    mc_close (fd);
+
+    fd = test_open ("control.tar/utar://control");
+    mctest_assert_int_ne (fd, -1);
+    n = mc_read (fd, buf, sizeof (buf));
+    mctest_assert_int_eq (n, sizeof (control) - 1);
+    mc_close (fd);
+
+    g_string_free (data_tar, TRUE);
+    g_string_free (control_tar, TRUE);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+#endif /* ENABLE_VFS_TAR */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_arfs_not_ar)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct stat st;
+    FILE *f;
+
+    f = fopen (test_file, "wb");
+    fputs ("this is not an ar archive", f);
+    fclose (f);
+
+    /* when */
+    mctest_assert_int_eq (test_stat ("file", &st), -1);
+
+    /* then */
+    mctest_assert_not_null (message_text__captured);
+    mctest_assert_not_null (strstr (message_text__captured, "doesn't look like an ar archive"));
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    mctest_add_parameterized_test (tc_core, test_arfs_read, test_arfs_read_ds);
+#ifdef ENABLE_VFS_TAR
+    tcase_add_test (tc_core, test_arfs_deb);
+#endif
+    tcase_add_test (tc_core, test_arfs_not_ar);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "arfs.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,387 @@
+/* src/vfs/cpio - test cpio filesystem
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/cpio"
+
+#include "tests/mctest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "lib/strutil.h"
+
+#include "src/vfs/local/local.c"
+#include "src/vfs/cpio/cpio.c"
+
+/* bigger than the block of archive reader */
+#define BIG_SIZE (1536 * 1024 + 100)
+#define TEST_MTIME 1500000000
+
+/* members spanning several blocks of archive reader */
+#ifdef TEST_BENCHMARK
+/* cpiofs_bench, not run by "make check": time loading of a big archive */
+#define TEST_FILES 20000
+#else
+#define TEST_FILES 2000
+#endif
+#define TEST_FILE_SIZE 700
+
+typedef struct
+{
+    const char *name;
+    const char *data;
+    size_t len;
+    mode_t mode;
+} test_member_t;
+
+static char *test_file = NULL;
+static char *big_data = NULL;
+
+/* @CapturedValue */
+static char *message_text__captured = NULL;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+message (int flags, const char *title, const char *text, ...)
+{
+    va_list ap;
+
+    (void) flags;
+    (void) title;
+
+    g_free (message_text__captured);
+    va_start (ap, text);
+    message_text__captured = g_strdup_vprintf (text, ap);
+    va_end (ap);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_padded (FILE * f, const char *data, size_t len)
+{
+    static const char zeros[4] = { 0 };
+
+    fwrite (data, 1, len, f);
+    if (len % 4 != 0)
+        fwrite (zeros, 1, 4 - len % 4, f);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_member (FILE * f, const char *name, unsigned long ino, mode_t mode, const char *data,
+                 size_t len)
+{
+    char *head;
+
+    /* header is 110 bytes, name is padded together with header */
+    head = g_strdup_printf ("070701%08lX%08lX%08lX%08lX%08lX%08lX%08lX%08lX%08lX%08lX%08lX"
+                            "%08lX%08lX%s", ino, (unsigned long) mode, 1000UL, 1000UL, 1UL,
+                            (unsigned long) TEST_MTIME, (unsigned long) len, 8UL, 1UL, 0UL, 0UL,
+                            (unsigned long) strlen (name) + 1, 0UL, name);
+    test_put_padded (f, head, strlen (head) + 1);
+    test_put_padded (f, data, len);
+    g_free (head);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* write cpio archive in SVR4 "newc" format */
+static void
+test_make_cpio (const test_member_t * members, size_t count)
+{
+    FILE *f;
+    size_t i;
+
+    f = fopen (test_file, "wb");
+
+    for (i = 0; i < count; i++)
+        test_put_member (f, members[i].name, i + 1, members[i].mode, members[i].data,
+                         members[i].len);
+
+    test_put_member (f, "TRAILER!!!", 0, 0, "", 0);
+    fclose (f);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static vfs_path_t *
+test_inner_path (const char *name)
+{
+    vfs_path_t *vpath;
+    char *path;
+
+    path = g_strconcat (test_file, "/ucpio://", name, (char *) NULL);
+    vpath = vfs_path_from_str (path);
+    g_free (path);
+
+    return vpath;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_open (const char *name)
+{
+    vfs_path_t *vpath;
+    int fd;
+
+    vpath = test_inner_path (name);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+
+    return fd;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_stat (const char *name, struct stat *st)
+{
+    vfs_path_t *vpath;
+    int ret;
+
+    vpath = test_inner_path (name);
+    ret = mc_lstat (vpath, st);
+    vfs_path_free (vpath);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    guint32 seed = 12345;
+    size_t i;
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_init_cpiofs ();
+    vfs_setup_work_dir ();
+
+    mc_global.vfs.archive_index = FALSE;
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-cpiofs.cpio", (char *) NULL);
+
+    big_data = g_malloc (BIG_SIZE);
+    for (i = 0; i < BIG_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        big_data[i] = (char) (seed >> 16);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    unlink (test_file);
+    g_free (test_file);
+    g_free (big_data);
+    MC_PTR_FREE (message_text__captured);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_cpiofs_read)
+/* *INDENT-ON* */
+{
+    /* given */
+    static const char text[] = "The quick brown fox jumps over the lazy dog\n";
+    const test_member_t members[] = {
+        {"dir", "", 0, S_IFDIR | 0755},
+        {"dir/first.txt", text, sizeof (text) - 1, S_IFREG | 0644},
+        {"big.bin", big_data, BIG_SIZE, S_IFREG | 0644},
+        {"odd.txt", text, 9, S_IFREG | 0644},
+        {"link", "dir/first.txt", 13, S_IFLNK | 0777},
+        {"last.txt", text + 4, sizeof (text) - 5, S_IFREG | 0644},
+    };
+    struct stat st;
+    char *buf;
+    char link[MC_MAXPATHLEN];
+    vfs_path_t *vpath;
+    ssize_t n;
+    int fd;
+
+    test_make_cpio (members, G_N_ELEMENTS (members));
+
+    /* when */
+    mctest_assert_int_eq (test_stat ("dir/first.txt", &st), 0);
+
+    /* then */
+    mctest_assert_true (S_ISREG (st.st_mode));
+    mctest_assert_int_eq (st.st_size, sizeof (text) - 1);
+    mctest_assert_int_eq (st.st_mtime, TEST_MTIME);
+
+    mctest_assert_int_eq (test_stat ("dir", &st), 0);
+    mctest_assert_true (S_ISDIR (st.st_mode));
+    mctest_assert_int_eq (test_stat ("odd.txt", &st), 0);
+    mctest_assert_int_eq (st.st_size, 9);
+
+    vpath = test_inner_path ("link");
+    n = mc_readlink (vpath, link, sizeof (link) - 1);
+    vfs_path_free (vpath);
+    mctest_assert_int_eq (n, strlen ("dir/first.txt"));
+    link[n] = '\0';
+    mctest_assert_str_eq (link, "dir/first.txt");
+
+    buf = g_malloc (BIG_SIZE);
+
+    fd = test_open ("big.bin");
+    mctest_assert_int_ne (fd, -1);
+    for (n = 0; n < BIG_SIZE;)
+    {
+        ssize_t r;
+
+        r = mc_read (fd, buf + n, BIG_SIZE - n);
+        mctest_assert_true (r > 0);
+        n += r;
+    }
+    mctest_assert_int_eq (memcmp (buf, big_data, BIG_SIZE), 0);
+    mc_close (fd);
+
+    /* member after the big one: header was read after a skip past the buffer */
+    fd = test_open ("last.txt");
+    mctest_assert_int_ne (fd, -1);
+    mctest_assert_int_eq (mc_read (fd, buf, BUF_1K), sizeof (text) - 5);
+    mctest_assert_int_eq (memcmp (buf, text + 4, sizeof (text) - 5), 0);
+    mc_close (fd);
+
+    g_free (buf);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_cpiofs_many_members)
+/* *INDENT-ON* */
+{
+    /* given */
+    test_member_t *members;
+    char **names;
+    char *buf;
+    vfs_path_t *vpath;
+    DIR *dir;
+    struct dirent *dirent;
+#ifdef TEST_BENCHMARK
+    gint64 start, done;
+#endif
+    int i, count = 0;
+
+    members = g_new0 (test_member_t, TEST_FILES);
+    names = g_new0 (char *, TEST_FILES + 1);
+    for (i = 0; i < TEST_FILES; i++)
+    {
+        names[i] = g_strdup_printf ("dir%02d/file%05d.txt", i % 50, i);
+        members[i].name = names[i];
+        members[i].data = big_data + i;
+        members[i].len = TEST_FILE_SIZE;
+        members[i].mode = S_IFREG | 0644;
+    }
+    test_make_cpio (members, TEST_FILES);
+
+    buf = g_malloc (TEST_FILE_SIZE);
+
+    /* when */
+#ifdef TEST_BENCHMARK
+    start = g_get_monotonic_time ();
+#endif
+
+    vpath = test_inner_path ("dir07");
+    dir = mc_opendir (vpath);
+    vfs_path_free (vpath);
+    mctest_assert_not_null (dir);
+    while ((dirent = mc_readdir (dir)) != NULL)
+        if (DIR_IS_DOT (dirent->d_name) || DIR_IS_DOTDOT (dirent->d_name))
+            continue;
+        else
+            count++;
+    mc_closedir (dir);
+
+#ifdef TEST_BENCHMARK
+    done = g_get_monotonic_time ();
+    printf ("cpiofs: archive of %d members loaded in %.3f ms\n", TEST_FILES,
+            (double) (done - start) / 1000.0);
+#endif
+
+    /* then */
+    mctest_assert_int_eq (count, TEST_FILES / 50);
+
+    i = test_open (names[TEST_FILES - 1]);
+    mctest_assert_int_eq (mc_read (i, buf, TEST_FILE_SIZE), TEST_FILE_SIZE);
+    mc_close (i);
+    mctest_assert_int_eq (memcmp (buf, big_data + TEST_FILES - 1, TEST_FILE_SIZE), 0);
+
+    g_free (buf);
+    g_strfreev (names);
+    g_free (members);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_cpiofs_read);
+    tcase_add_test (tc_core, test_cpiofs_many_members);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "cpiofs.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,336 @@
+/*
+   src/vfs/extfs - test extraction of many files in one helper run
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/extfs"
+
+#include "tests/mctest.h"
+
+#include <unistd.h>
+
+#include "lib/strutil.h"
+
+#include "src/vfs/local/local.c"
+#include "src/vfs/extfs/extfs.c"
+
+/* "copyout-many" command of helper that supports it */
+#define COPYOUT_MANY_OK \
+    "while read f; do\n" \
+    "    mkdir -p \"$3/`dirname \"$f\"`\"\n" \
+    "    printf 'file:%s' \"$f\" > \"$3/$f\"\n" \
+    "done < \"$4\""
+
+static char *test_dir = NULL;
+static char *test_archive = NULL;
+static mc_shell_t test_shell;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+const char *
+mc_config_get_data_path (void)
+{
+    return test_dir;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+const char *
+mc_config_get_cache_path (void)
+{
+    return test_dir;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+shell_execute (const char *command, int flags)
+{
+    (void) command;
+    (void) flags;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* helper logs its commands to test_dir/log */
+static void
+test_write_helper (const char *copyout_many)
+{
+    char *helper, *script;
+
+    script = g_strdup_printf ("#! /bin/sh\n"
+                              "echo \"$1\" >> '%s/log'\n"
+                              "case \"$1\" in\n"
+                              "list)\n"
+                              "    for f in a b c; do\n"
+                              "        echo \"-rw-r--r--    1 user     group           6 Jan  1  2020 dir/$f\"\n"
+                              "    done\n"
+                              "    ;;\n"
+                              "copyout)\n"
+                              "    printf 'file:%%s' \"$3\" > \"$4\"\n"
+                              "    ;;\n"
+                              "copyout-many)\n"
+                              "%s\n"
+                              "    ;;\n"
+                              "*)\n"
+                              "    exit 1\n"
+                              "    ;;\n"
+                              "esac\n", test_dir, copyout_many);
+
+    helper = g_build_filename (test_dir, MC_EXTFS_DIR, "testarc", (char *) NULL);
+    mctest_assert_true (g_file_set_contents (helper, script, -1, NULL));
+    chmod (helper, 0755);
+    g_free (helper);
+    g_free (script);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* commands the helper has run, one per line */
+static char *
+test_helper_log (void)
+{
+    char *log_name, *log = NULL;
+
+    log_name = g_build_filename (test_dir, "log", (char *) NULL);
+    if (!g_file_get_contents (log_name, &log, NULL, NULL))
+        log = g_strdup ("");
+    g_free (log_name);
+
+    return log;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static const extfs_plugin_info_t *
+test_helper_info (void)
+{
+    guint i;
+
+    for (i = 0; i < extfs_plugins->len; i++)
+    {
+        const extfs_plugin_info_t *info;
+
+        info = &g_array_index (extfs_plugins, extfs_plugin_info_t, i);
+        if (strcmp (info->prefix, "testarc") == 0)
+            return info;
+    }
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_prefetch (void)
+{
+    const char *names[] = { "a", "b", "c", NULL };
+    vfs_path_t *vpath;
+
+    vpath = vfs_path_build_filename (test_archive, "testarc://dir", (char *) NULL);
+    mctest_assert_int_eq (mc_setctl (vpath, VFS_SETCTL_PREFETCH, (void *) names), 1);
+    vfs_path_free (vpath);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_check_files (void)
+{
+    const char *names[] = { "a", "b", "c" };
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+        vfs_path_t *vpath;
+        char buf[BUF_SMALL];
+        char *expected;
+        ssize_t n;
+        int fd;
+
+        vpath = vfs_path_build_filename (test_archive, "testarc://dir", names[i], (char *) NULL);
+        fd = mc_open (vpath, O_RDONLY);
+        vfs_path_free (vpath);
+        mctest_assert_int_ne (fd, -1);
+
+        n = mc_read (fd, buf, sizeof (buf) - 1);
+        mctest_assert_int_ne (n, -1);
+        buf[n] = '\0';
+        mc_close (fd);
+
+        expected = g_strconcat ("file:dir/", names[i], (char *) NULL);
+        mctest_assert_str_eq (buf, expected);
+        g_free (expected);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    char *extfs_dir;
+
+    str_init_strings (NULL);
+
+    test_dir = g_build_filename (g_get_tmp_dir (), "mctest-extfs-XXXXXX", (char *) NULL);
+    mctest_assert_not_null (g_mkdtemp (test_dir));
+    extfs_dir = g_build_filename (test_dir, MC_EXTFS_DIR, (char *) NULL);
+    mctest_assert_int_eq (g_mkdir (extfs_dir, 0700), 0);
+    g_free (extfs_dir);
+
+    /* helpers are found when extfs is initialized */
+    test_write_helper (COPYOUT_MANY_OK);
+
+    test_archive = g_build_filename (test_dir, "test.arc", (char *) NULL);
+    mctest_assert_true (g_file_set_contents (test_archive, "", 0, NULL));
+
+    test_shell.path = (char *) "/bin/sh";
+    mc_global.shell = &test_shell;
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_init_extfs ();
+    vfs_setup_work_dir ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    vfs_shut ();
+
+    extfs_remove_tree (test_dir);
+    g_free (test_dir);
+    g_free (test_archive);
+
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_extfs_copyout_many)
+/* *INDENT-ON* */
+{
+    /* given */
+    char *log;
+
+    /* when */
+    test_prefetch ();
+
+    /* then: all files are extracted by one run of helper */
+    test_check_files ();
+    log = test_helper_log ();
+    mctest_assert_str_eq (log, "list\ncopyout-many\n");
+    g_free (log);
+    mctest_assert_false (test_helper_info ()->no_copyout_many);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @DataSource("test_extfs_copyout_many_fallback_ds") */
+/* *INDENT-OFF* */
+static const struct test_extfs_copyout_many_fallback_ds
+{
+    const char *copyout_many;
+} test_extfs_copyout_many_fallback_ds[] =
+{
+    { /* 0. command is unknown to helper */
+        "    echo \"unknown command\" >&2; exit 1"
+    },
+    { /* 1. helper ignores the command silently */
+        "    :"
+    },
+    { /* 2. helper extracts to wrong place */
+        "    mkdir \"$3/other\"; echo other > \"$3/other/a\""
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_extfs_copyout_many_fallback_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_extfs_copyout_many_fallback, test_extfs_copyout_many_fallback_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    char *log;
+
+    test_write_helper (data->copyout_many);
+
+    /* when */
+    test_prefetch ();
+
+    /* then: helper isn't asked again */
+    mctest_assert_true (test_helper_info ()->no_copyout_many);
+    test_prefetch ();
+    log = test_helper_log ();
+    mctest_assert_str_eq (log, "list\ncopyout-many\n");
+    g_free (log);
+
+    /* then: files are extracted one by one */
+    test_check_files ();
+    log = test_helper_log ();
+    mctest_assert_str_eq (log, "list\ncopyout-many\ncopyout\ncopyout\ncopyout\n");
+    g_free (log);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_extfs_copyout_many);
+    mctest_add_parameterized_test (tc_core, test_extfs_copyout_many_fallback,
+                                   test_extfs_copyout_many_fallback_ds);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "extfs_copyout_many.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,326 @@
+/*
+   src/vfs/ftpfs - test pool of connections to the same server
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/ftpfs"
+
+#include "tests/mctest.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+
+#include "lib/strutil.h"
+
+#include "src/vfs/ftpfs/ftpfs.c"
+
+#define MAX_CONNECTIONS 8
+
+/* fake server: it listens on unix socket, every connection is accepted as soon as
+   the client has connected, and all replies are written to it in advance */
+static struct
+{
+    gboolean refuse;            /* server doesn't allow more sessions */
+    int listener;
+    struct sockaddr_un addr;
+    int connections;
+    int peers[MAX_CONNECTIONS];
+} server;
+
+static struct vfs_s_super *super;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+char *
+load_anon_passwd (void)
+{
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+getaddrinfo (const char *node, const char *service, const struct addrinfo *hints,
+             struct addrinfo **res)
+{
+    static struct addrinfo info;
+
+    (void) node;
+    (void) service;
+    (void) hints;
+
+    info.ai_family = AF_UNIX;
+    info.ai_socktype = SOCK_STREAM;
+    info.ai_addr = (struct sockaddr *) &server.addr;
+    info.ai_addrlen = sizeof (server.addr);
+    *res = &info;
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+freeaddrinfo (struct addrinfo *res)
+{
+    const char *replies;
+    int peer;
+    ssize_t ret;
+
+    (void) res;
+
+    /* called after connect() */
+    peer = accept (server.listener, NULL, NULL);
+    if (peer == -1)
+        return;
+
+    if (server.refuse)
+        replies = "421 Too many connections\r\n";
+    else if (server.connections == 0)
+        replies = "220 Ready\r\n"
+            "331 Password required\r\n"
+            "230 Logged in\r\n"
+            "211-Features:\r\n"
+            " SIZE\r\n"
+            " MLST type*;size*;modify*;UNIX.mode;\r\n"
+            "211 End\r\n"
+            "200 MLST OPTS type;size;modify;UNIX.mode;\r\n"
+            "257 \"/home/user\" is current directory\r\n";
+    else
+        /* FEAT is asked for once per server */
+        replies = "220 Ready\r\n"
+            "331 Password required\r\n"
+            "230 Logged in\r\n"
+            "200 MLST OPTS type;size;modify;UNIX.mode;\r\n"
+            "257 \"/home/user\" is current directory\r\n";
+
+    ret = write (peer, replies, strlen (replies));
+    (void) ret;
+
+    server.peers[server.connections++] = peer;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* commands the client has sent through the connection */
+
+static char *
+test_commands (int connection)
+{
+    GString *commands;
+    char buf[BUF_1K];
+    ssize_t n;
+
+    commands = g_string_new ("");
+    while ((n = recv (server.peers[connection], buf, sizeof (buf), MSG_DONTWAIT)) > 0)
+        g_string_append_len (commands, buf, n);
+
+    return g_string_free (commands, FALSE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    ftp_super_t *ftp_super;
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_ftpfs ();
+
+    memset (&server, 0, sizeof (server));
+    server.addr.sun_family = AF_UNIX;
+    g_snprintf (server.addr.sun_path, sizeof (server.addr.sun_path), "%s/mctest-ftpfs-%d",
+                g_get_tmp_dir (), (int) getpid ());
+    unlink (server.addr.sun_path);
+    server.listener = socket (AF_UNIX, SOCK_STREAM, 0);
+    mctest_assert_int_ne (server.listener, -1);
+    mctest_assert_int_eq (bind (server.listener, (struct sockaddr *) &server.addr,
+                                sizeof (server.addr)), 0);
+    mctest_assert_int_eq (listen (server.listener, MAX_CONNECTIONS), 0);
+
+    ftpfs_max_connections = 4;
+
+    super = ftpfs_new_archive (vfs_ftpfs_ops);
+    super->path_element = vfs_url_split ("user:secret@ftp.example.org", FTP_COMMAND_PORT,
+                                         URL_NOSLASH);
+    ftp_super = FTP_SUPER (super);
+    ftp_super->sock = ftpfs_open_socket (vfs_ftpfs_ops, super);
+    mctest_assert_true (ftpfs_login_server (vfs_ftpfs_ops, super, NULL));
+    ftp_super->current_dir = ftpfs_get_current_directory (vfs_ftpfs_ops, super);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    int i;
+
+    ftpfs_free_archive (vfs_ftpfs_ops, super);
+    vfs_path_element_free (super->path_element);
+    g_free (super->name);
+    g_free (super);
+
+    for (i = 0; i < server.connections; i++)
+        close (server.peers[i]);
+    close (server.listener);
+    unlink (server.addr.sun_path);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_ftpfs_pool)
+/* *INDENT-ON* */
+{
+    /* given */
+    ftp_super_t *ftp_super = FTP_SUPER (super);
+    struct vfs_s_super *conn1, *conn2;
+    char *commands;
+
+    commands = test_commands (0);
+    mctest_assert_not_null (strstr (commands, "FEAT\r\n"));
+    mctest_assert_not_null (strstr (commands, "OPTS MLST type;size;modify;UNIX.mode;\r\n"));
+    g_free (commands);
+    mctest_assert_true (ftp_super->use_mlsd);
+    mctest_assert_str_eq (ftp_super->current_dir, "/home/user/");
+
+    /* when: main connection is idle */
+    /* then: it is used */
+    mctest_assert_ptr_eq (ftpfs_get_connection (vfs_ftpfs_ops, super), super);
+    mctest_assert_int_eq (server.connections, 1);
+
+    /* when: main connection is busy with transfer */
+    ftp_super->ctl_connection_busy = TRUE;
+    conn1 = ftpfs_get_connection (vfs_ftpfs_ops, super);
+
+    /* then: another one is logged in without FEAT, but with the same MLST facts */
+    mctest_assert_ptr_ne (conn1, super);
+    mctest_assert_int_eq (server.connections, 2);
+    mctest_assert_true (FTP_SUPER (conn1)->pooled);
+    mctest_assert_true (FTP_SUPER (conn1)->use_mlsd);
+    mctest_assert_str_eq (FTP_SUPER (conn1)->current_dir, "/home/user/");
+    commands = test_commands (1);
+    mctest_assert_null (strstr (commands, "FEAT\r\n"));
+    mctest_assert_not_null (strstr (commands, "USER user\r\nPASS secret\r\n"));
+    mctest_assert_not_null (strstr (commands, "OPTS MLST type;size;modify;UNIX.mode;\r\n"));
+    g_free (commands);
+
+    /* when: pooled connection is busy too */
+    FTP_SUPER (conn1)->ctl_connection_busy = TRUE;
+    conn2 = ftpfs_get_connection (vfs_ftpfs_ops, super);
+
+    /* then */
+    mctest_assert_ptr_ne (conn2, super);
+    mctest_assert_ptr_ne (conn2, conn1);
+    mctest_assert_int_eq (server.connections, 3);
+    mctest_assert_int_eq (g_list_length (ftp_super->pool), 2);
+
+    /* when: pooled connection is released */
+    FTP_SUPER (conn1)->ctl_connection_busy = FALSE;
+
+    /* then: it is reused */
+    mctest_assert_ptr_eq (ftpfs_get_connection (vfs_ftpfs_ops, super), conn1);
+    mctest_assert_int_eq (server.connections, 3);
+
+    /* when: all connections are busy and limit is reached */
+    FTP_SUPER (conn1)->ctl_connection_busy = TRUE;
+    FTP_SUPER (conn2)->ctl_connection_busy = TRUE;
+    ftpfs_max_connections = 3;
+
+    /* then: main connection is used */
+    mctest_assert_ptr_eq (ftpfs_get_connection (vfs_ftpfs_ops, super), super);
+    mctest_assert_int_eq (server.connections, 3);
+    mctest_assert_false (ftp_super->pool_full);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_ftpfs_pool_refused)
+/* *INDENT-ON* */
+{
+    /* given */
+    ftp_super_t *ftp_super = FTP_SUPER (super);
+
+    /* when: server limits number of sessions */
+    server.refuse = TRUE;
+    ftp_super->ctl_connection_busy = TRUE;
+
+    /* then: main connection is used */
+    mctest_assert_ptr_eq (ftpfs_get_connection (vfs_ftpfs_ops, super), super);
+    mctest_assert_int_eq (server.connections, 2);
+    mctest_assert_true (ftp_super->pool_full);
+    mctest_assert_null (ftp_super->pool);
+
+    /* when: main connection is busy again */
+    /* then: server isn't asked again */
+    mctest_assert_ptr_eq (ftpfs_get_connection (vfs_ftpfs_ops, super), super);
+    mctest_assert_int_eq (server.connections, 2);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_ftpfs_pool);
+    tcase_add_test (tc_core, test_ftpfs_pool_refused);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "ftpfs_pool.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
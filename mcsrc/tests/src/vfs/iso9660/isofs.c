@@ -0,0 +1,681 @@
+/* src/vfs/iso9660 - test ISO9660 filesystem
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/iso9660"
+
+#include "tests/mctest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "lib/strutil.h"
+
+#include "src/vfs/local/local.c"
+#include "src/vfs/iso9660/iso9660.c"
+
+#define TEST_MTIME 1500000000
+#define TEST_RR_MTIME 1600000000
+
+/* first extent of multi-extent file */
+#define TEST_BIG_SPLIT (64 * 1024)
+#define BIG_SIZE (TEST_BIG_SPLIT + 40000)
+
+/* image layout in sectors */
+#define TEST_ROOT 20
+#define TEST_DIR 21
+#define TEST_JOLIET_ROOT 22
+#define TEST_JOLIET_DIR 23
+#define TEST_README 24
+#define TEST_FILE 25
+#define TEST_CE 26
+#define TEST_BIG1 28
+#define TEST_BIG2 (TEST_BIG1 + TEST_BIG_SPLIT / ISO_SECTOR_SIZE + 3)  /* extents aren't adjacent */
+#define TEST_SECTORS (TEST_BIG2 + (BIG_SIZE - TEST_BIG_SPLIT) / ISO_SECTOR_SIZE + 1)
+
+typedef enum
+{
+    TEST_PLAIN,
+    TEST_JOLIET,
+    TEST_ROCK_RIDGE
+} test_names_t;
+
+static const char test_text[] = "The quick brown fox jumps over the lazy dog\n";
+
+static char *test_file = NULL;
+static char *big_data = NULL;
+
+/* @CapturedValue */
+static char *message_text__captured = NULL;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+message (int flags, const char *title, const char *text, ...)
+{
+    va_list ap;
+
+    (void) flags;
+    (void) title;
+
+    g_free (message_text__captured);
+    va_start (ap, text);
+    message_text__captured = g_strdup_vprintf (text, ap);
+    va_end (ap);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_both16 (guint8 * p, guint16 v)
+{
+    p[0] = p[3] = v & 0xff;
+    p[1] = p[2] = v >> 8;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_both32 (guint8 * p, guint32 v)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+        p[i] = p[7 - i] = (v >> (8 * i)) & 0xff;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_date (guint8 * p, time_t t)
+{
+    struct tm tm;
+
+    gmtime_r (&t, &tm);
+    p[0] = tm.tm_year;
+    p[1] = tm.tm_mon + 1;
+    p[2] = tm.tm_mday;
+    p[3] = tm.tm_hour;
+    p[4] = tm.tm_min;
+    p[5] = tm.tm_sec;
+    p[6] = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_susp (GByteArray * sua, const char *sig, const guint8 * data, size_t len)
+{
+    guint8 hdr[4] = { sig[0], sig[1], len + 4, 1 };
+
+    g_byte_array_append (sua, hdr, sizeof (hdr));
+    g_byte_array_append (sua, data, len);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_susp_px (GByteArray * sua, mode_t mode)
+{
+    guint8 px[32];
+
+    memset (px, 0, sizeof (px));
+    test_put_both32 (px, mode);
+    test_put_both32 (px + 8, 1);
+    test_put_both32 (px + 16, 1000);
+    test_put_both32 (px + 24, 1000);
+    test_susp (sua, "PX", px, sizeof (px));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_susp_nm (GByteArray * sua, const char *name)
+{
+    GByteArray *nm;
+
+    nm = g_byte_array_new ();
+    g_byte_array_append (nm, (const guint8 *) "", 1);
+    g_byte_array_append (nm, (const guint8 *) name, strlen (name));
+    test_susp (sua, "NM", nm->data, nm->len);
+    g_byte_array_free (nm, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_dirrec (GByteArray * dir, const char *name, size_t name_len, guint32 extent, guint32 size,
+             guint8 flags, const GByteArray * sua)
+{
+    guint8 rec[256];
+    size_t len, sua_len = sua != NULL ? sua->len : 0;
+
+    len = ISO_DIRREC_SIZE + name_len + (name_len % 2 == 0 ? 1 : 0) + sua_len;
+    len += len % 2;
+
+    memset (rec, 0, sizeof (rec));
+    rec[0] = len;
+    test_put_both32 (rec + 2, extent);
+    test_put_both32 (rec + 10, size);
+    test_put_date (rec + 18, TEST_MTIME);
+    rec[25] = flags;
+    test_put_both16 (rec + 28, 1);
+    rec[32] = name_len;
+    memcpy (rec + ISO_DIRREC_SIZE, name, name_len);
+    if (sua_len != 0)
+        memcpy (rec + ISO_DIRREC_SIZE + name_len + (name_len % 2 == 0 ? 1 : 0), sua->data,
+                sua_len);
+
+    /* records don't cross sector boundaries */
+    while (dir->len % ISO_SECTOR_SIZE + len > ISO_SECTOR_SIZE)
+        g_byte_array_append (dir, (const guint8 *) "", 1);
+
+    g_byte_array_append (dir, rec, len);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* directory record of file with name in volume's encoding */
+static void
+test_dirrec_name (GByteArray * dir, test_names_t names, const char *name, guint32 extent,
+                  guint32 size, guint8 flags, const GByteArray * sua)
+{
+    char buf[128];
+    size_t i, len = strlen (name);
+
+    if (names != TEST_JOLIET)
+    {
+        test_dirrec (dir, name, len, extent, size, flags, sua);
+        return;
+    }
+
+    /* UCS-2BE */
+    for (i = 0; i < len; i++)
+    {
+        buf[2 * i] = '\0';
+        buf[2 * i + 1] = name[i];
+    }
+    test_dirrec (dir, buf, 2 * len, extent, size, flags, sua);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_dots (GByteArray * dir, guint32 self, guint32 parent, gboolean sp)
+{
+    GByteArray *sua = NULL;
+
+    if (sp)
+    {
+        static const guint8 sp_data[] = { 0xBE, 0xEF, 0 };
+
+        sua = g_byte_array_new ();
+        test_susp (sua, "SP", sp_data, sizeof (sp_data));
+    }
+
+    test_dirrec (dir, "\0", 1, self, ISO_SECTOR_SIZE, ISO_FLAG_DIRECTORY, sua);
+    test_dirrec (dir, "\1", 1, parent, ISO_SECTOR_SIZE, ISO_FLAG_DIRECTORY, NULL);
+
+    if (sua != NULL)
+        g_byte_array_free (sua, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_volume (guint8 * image, guint32 sector, guint8 type, guint32 root)
+{
+    guint8 *vd = image + sector * ISO_SECTOR_SIZE;
+    GByteArray *rec;
+
+    vd[0] = type;
+    memcpy (vd + 1, "CD001", 5);
+    vd[6] = 1;
+
+    if (type == ISO_VD_TERMINATOR)
+        return;
+
+    if (type == ISO_VD_SUPPLEMENTARY)
+        memcpy (vd + ISO_VD_ESCAPES, "%/E", 3);
+
+    test_put_both32 (vd + 80, TEST_SECTORS);
+    test_put_both16 (vd + ISO_VD_BLOCK_SIZE, ISO_SECTOR_SIZE);
+
+    rec = g_byte_array_new ();
+    test_dirrec (rec, "\0", 1, root, ISO_SECTOR_SIZE, ISO_FLAG_DIRECTORY, NULL);
+    memcpy (vd + ISO_VD_ROOT, rec->data, rec->len);
+    g_byte_array_free (rec, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* write directory tree with file names in given format */
+static void
+test_put_tree (guint8 * image, test_names_t names, guint32 root_sector, guint32 dir_sector)
+{
+    gboolean rr = names == TEST_ROCK_RIDGE;
+    GByteArray *root, *dir, *sua, *ce;
+    guint8 buf[64];
+
+    root = g_byte_array_new ();
+    dir = g_byte_array_new ();
+    sua = g_byte_array_new ();
+    ce = g_byte_array_new ();
+
+    test_put_dots (root, root_sector, root_sector, rr);
+
+    if (rr)
+    {
+        test_susp_px (sua, S_IFREG | 0600);
+        test_susp_nm (sua, "readme.txt");
+        buf[0] = 1 << ISO_TF_MODIFY;
+        test_put_date (buf + 1, TEST_RR_MTIME);
+        test_susp (sua, "TF", buf, 8);
+    }
+    test_dirrec_name (root, names, names == TEST_JOLIET ? "ReadMe.txt;1" : "README.TXT;1",
+                      TEST_README, sizeof (test_text) - 1, 0, sua);
+
+    g_byte_array_set_size (sua, 0);
+    if (rr)
+    {
+        test_susp_px (sua, S_IFDIR | 0755);
+        test_susp_nm (sua, "dir");
+    }
+    test_dirrec_name (root, names, names == TEST_JOLIET ? "Dir" : "DIR", dir_sector,
+                      ISO_SECTOR_SIZE, ISO_FLAG_DIRECTORY, sua);
+
+    g_byte_array_set_size (sua, 0);
+    if (rr)
+    {
+        test_susp_px (sua, S_IFREG | 0644);
+        test_susp_nm (sua, "big.bin");
+    }
+    test_dirrec_name (root, names, names == TEST_JOLIET ? "Big.bin;1" : "BIG.BIN;1", TEST_BIG1,
+                      TEST_BIG_SPLIT, ISO_FLAG_MULTI_EXTENT, sua);
+    test_dirrec_name (root, names, names == TEST_JOLIET ? "Big.bin;1" : "BIG.BIN;1", TEST_BIG2,
+                      BIG_SIZE - TEST_BIG_SPLIT, 0, sua);
+
+    if (rr)
+    {
+        static const guint8 sl[] = { 0, 0, 3, 'd', 'i', 'r', 0, 8, 'f', 'i', 'l', 'e', '.', 't',
+            'x', 't'
+        };
+
+        g_byte_array_set_size (sua, 0);
+        test_susp_px (sua, S_IFLNK | 0777);
+        test_susp_nm (sua, "link");
+        test_susp (sua, "SL", sl, sizeof (sl));
+        test_dirrec (root, "LINK.;1", 7, 0, 0, 0, sua);
+    }
+
+    test_put_dots (dir, dir_sector, root_sector, FALSE);
+
+    g_byte_array_set_size (sua, 0);
+    if (rr)
+    {
+        /* name is in continuation area */
+        test_susp_px (sua, S_IFREG | 0644);
+        test_put_both32 (buf, TEST_CE);
+        test_put_both32 (buf + 8, 0);
+        test_susp_nm (ce, "file.txt");
+        test_susp (ce, "ST", NULL, 0);
+        test_put_both32 (buf + 16, ce->len);
+        test_susp (sua, "CE", buf, 24);
+        memcpy (image + TEST_CE * ISO_SECTOR_SIZE, ce->data, ce->len);
+    }
+    test_dirrec_name (dir, names, names == TEST_JOLIET ? "File.txt;1" : "FILE.TXT;1", TEST_FILE,
+                      sizeof (test_text) - 5, 0, sua);
+
+    memcpy (image + root_sector * ISO_SECTOR_SIZE, root->data, root->len);
+    memcpy (image + dir_sector * ISO_SECTOR_SIZE, dir->data, dir->len);
+
+    g_byte_array_free (ce, TRUE);
+    g_byte_array_free (sua, TRUE);
+    g_byte_array_free (dir, TRUE);
+    g_byte_array_free (root, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_make_iso (test_names_t names)
+{
+    guint8 *image;
+    size_t size = TEST_SECTORS * ISO_SECTOR_SIZE;
+    FILE *f;
+
+    image = g_malloc0 (size);
+
+    test_put_volume (image, ISO_VD_FIRST, ISO_VD_PRIMARY, TEST_ROOT);
+    if (names == TEST_JOLIET)
+    {
+        test_put_volume (image, ISO_VD_FIRST + 1, ISO_VD_SUPPLEMENTARY, TEST_JOLIET_ROOT);
+        test_put_volume (image, ISO_VD_FIRST + 2, ISO_VD_TERMINATOR, 0);
+        test_put_tree (image, TEST_PLAIN, TEST_ROOT, TEST_DIR);
+        test_put_tree (image, TEST_JOLIET, TEST_JOLIET_ROOT, TEST_JOLIET_DIR);
+    }
+    else
+    {
+        test_put_volume (image, ISO_VD_FIRST + 1, ISO_VD_TERMINATOR, 0);
+        test_put_tree (image, names, TEST_ROOT, TEST_DIR);
+    }
+
+    memcpy (image + TEST_README * ISO_SECTOR_SIZE, test_text, sizeof (test_text) - 1);
+    memcpy (image + TEST_FILE * ISO_SECTOR_SIZE, test_text + 4, sizeof (test_text) - 5);
+    memcpy (image + TEST_BIG1 * ISO_SECTOR_SIZE, big_data, TEST_BIG_SPLIT);
+    memcpy (image + TEST_BIG2 * ISO_SECTOR_SIZE, big_data + TEST_BIG_SPLIT,
+            BIG_SIZE - TEST_BIG_SPLIT);
+
+    f = fopen (test_file, "wb");
+    fwrite (image, 1, size, f);
+    fclose (f);
+
+    g_free (image);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static vfs_path_t *
+test_inner_path (const char *name)
+{
+    vfs_path_t *vpath;
+    char *path;
+
+    path = g_strconcat (test_file, "/iso://", name, (char *) NULL);
+    vpath = vfs_path_from_str (path);
+    g_free (path);
+
+    return vpath;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_open (const char *name)
+{
+    vfs_path_t *vpath;
+    int fd;
+
+    vpath = test_inner_path (name);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+
+    return fd;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_stat (const char *name, struct stat *st)
+{
+    vfs_path_t *vpath;
+    int ret;
+
+    vpath = test_inner_path (name);
+    ret = mc_lstat (vpath, st);
+    vfs_path_free (vpath);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    guint32 seed = 12345;
+    size_t i;
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_init_iso9660fs ();
+    vfs_setup_work_dir ();
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-isofs.iso", (char *) NULL);
+
+    big_data = g_malloc (BIG_SIZE);
+    for (i = 0; i < BIG_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        big_data[i] = (char) (seed >> 16);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    unlink (test_file);
+    g_free (test_file);
+    g_free (big_data);
+    MC_PTR_FREE (message_text__captured);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @DataSource("test_isofs_read_ds") */
+/* *INDENT-OFF* */
+static const struct test_isofs_read_ds
+{
+    test_names_t names;
+    const char *readme;
+    const char *big;
+    const char *file;
+    mode_t readme_mode;
+    time_t readme_mtime;
+} test_isofs_read_ds[] =
+{
+    { /* 0. */
+        TEST_PLAIN,
+        "README.TXT",
+        "BIG.BIN",
+        "DIR/FILE.TXT",
+        S_IFREG | 0444,
+        TEST_MTIME
+    },
+    { /* 1. */
+        TEST_JOLIET,
+        "ReadMe.txt",
+        "Big.bin",
+        "Dir/File.txt",
+        S_IFREG | 0444,
+        TEST_MTIME
+    },
+    { /* 2. */
+        TEST_ROCK_RIDGE,
+        "readme.txt",
+        "big.bin",
+        "dir/file.txt",
+        S_IFREG | 0600,
+        TEST_RR_MTIME
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_isofs_read_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_isofs_read, test_isofs_read_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct stat st;
+    char *buf;
+    ssize_t n;
+    int fd;
+
+    test_make_iso (data->names);
+
+    /* when */
+    mctest_assert_int_eq (test_stat (data->readme, &st), 0);
+
+    /* then */
+    mctest_assert_int_eq (st.st_mode, data->readme_mode);
+    mctest_assert_int_eq (st.st_size, sizeof (test_text) - 1);
+    mctest_assert_int_eq (st.st_mtime, data->readme_mtime);
+
+    mctest_assert_int_eq (test_stat (data->file, &st), 0);
+    mctest_assert_true (S_ISREG (st.st_mode));
+    mctest_assert_int_eq (st.st_mtime, TEST_MTIME);
+
+    /* both extents make one file */
+    mctest_assert_int_eq (test_stat (data->big, &st), 0);
+    mctest_assert_int_eq (st.st_size, BIG_SIZE);
+
+    buf = g_malloc (BIG_SIZE);
+
+    fd = test_open (data->readme);
+    mctest_assert_int_ne (fd, -1);
+    mctest_assert_int_eq (mc_read (fd, buf, BUF_1K), sizeof (test_text) - 1);
+    mctest_assert_int_eq (memcmp (buf, test_text, sizeof (test_text) - 1), 0);
+    mc_close (fd);
+
+    fd = test_open (data->file);
+    mctest_assert_int_ne (fd, -1);
+    mctest_assert_int_eq (mc_read (fd, buf, BUF_1K), sizeof (test_text) - 5);
+    mctest_assert_int_eq (memcmp (buf, test_text + 4, sizeof (test_text) - 5), 0);
+    mc_close (fd);
+
+    fd = test_open (data->big);
+    mctest_assert_int_ne (fd, -1);
+    for (n = 0; n < BIG_SIZE;)
+    {
+        ssize_t r;
+
+        r = mc_read (fd, buf + n, BIG_SIZE - n);
+        mctest_assert_true ((r > 0));
+        n += r;
+    }
+    mctest_assert_int_eq (memcmp (buf, big_data, BIG_SIZE), 0);
+
+    /* seek into the second extent */
+    mctest_assert_int_eq (mc_lseek (fd, TEST_BIG_SPLIT + 100, SEEK_SET), TEST_BIG_SPLIT + 100);
+    mctest_assert_int_eq (mc_read (fd, buf, 1000), 1000);
+    mctest_assert_int_eq (memcmp (buf, big_data + TEST_BIG_SPLIT + 100, 1000), 0);
+    mc_close (fd);
+
+    g_free (buf);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_isofs_rock_ridge)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct stat st;
+    char link[MC_MAXPATHLEN];
+    vfs_path_t *vpath;
+    ssize_t n;
+
+    test_make_iso (TEST_ROCK_RIDGE);
+
+    /* when */
+    mctest_assert_int_eq (test_stat ("link", &st), 0);
+
+    /* then */
+    mctest_assert_true (S_ISLNK (st.st_mode));
+    mctest_assert_int_eq (st.st_uid, 1000);
+
+    vpath = test_inner_path ("link");
+    n = mc_readlink (vpath, link, sizeof (link) - 1);
+    vfs_path_free (vpath);
+    mctest_assert_int_eq (n, strlen ("dir/file.txt"));
+    link[n] = '\0';
+    mctest_assert_str_eq (link, "dir/file.txt");
+
+    mctest_assert_int_eq (test_stat ("dir", &st), 0);
+    mctest_assert_int_eq (st.st_mode, S_IFDIR | 0755);
+
+    /* names of primary volume are not shown */
+    mctest_assert_int_eq (test_stat ("README.TXT", &st), -1);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_isofs_not_iso)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct stat st;
+    FILE *f;
+
+    f = fopen (test_file, "wb");
+    fputs ("this is not an ISO9660 image", f);
+    fclose (f);
+
+    /* when */
+    mctest_assert_int_eq (test_stat ("file", &st), -1);
+
+    /* then */
+    mctest_assert_not_null (message_text__captured);
+    mctest_assert_not_null (strstr (message_text__captured, "doesn't look like an ISO9660 image"));
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    mctest_add_parameterized_test (tc_core, test_isofs_read, test_isofs_read_ds);
+    tcase_add_test (tc_core, test_isofs_rock_ridge);
+    tcase_add_test (tc_core, test_isofs_not_iso);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "isofs.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,465 @@
+/*
+   src/vfs/sftpfs - test copying of files on server side
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/sftpfs"
+
+#include "tests/mctest.h"
+
+#include "src/vfs/sftpfs/file.c"
+
+struct vfs_class *sftpfs_class = NULL;
+
+/* fake server */
+static struct
+{
+    gboolean open_fails;        /* server doesn't allow exec channels */
+    int exit_status;
+    gboolean killed;            /* cp is killed by signal: no exit status is sent */
+    gboolean slow;              /* cp doesn't end until user interrupts waiting */
+    gboolean interrupted;
+    int channels;
+    char *command;
+    const char *output;
+} server;
+
+static struct vfs_s_inode *src_ino, *dest_ino;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+char *
+vfs_s_fullpath (struct vfs_class *me, struct vfs_s_inode *ino)
+{
+    (void) me;
+
+    return g_strdup (ino == src_ino ? "/home/user/it's a file" : "/tmp/copy");
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+const char *
+sftpfs_fix_filename (const char *file_name, unsigned int *length)
+{
+    *length = strlen (file_name);
+    return file_name;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+gboolean
+sftpfs_waitsocket (sftpfs_super_t * super, int sftp_res, GError ** mcerror)
+{
+    (void) super;
+    (void) mcerror;
+
+    return sftp_res == LIBSSH2_ERROR_EAGAIN;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+gboolean
+tty_got_interrupt (void)
+{
+    return server.interrupted;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+libssh2_session_last_errno (LIBSSH2_SESSION * session)
+{
+    (void) session;
+
+    return LIBSSH2_ERROR_CHANNEL_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+LIBSSH2_CHANNEL *
+libssh2_channel_open_session (LIBSSH2_SESSION * session)
+{
+    (void) session;
+
+    if (server.open_fails)
+        return NULL;
+
+    server.channels++;
+    return (LIBSSH2_CHANNEL *) & server;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+libssh2_channel_handle_extended_data2 (LIBSSH2_CHANNEL * channel, int ignore_mode)
+{
+    (void) channel;
+    (void) ignore_mode;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+libssh2_channel_process_startup (LIBSSH2_CHANNEL * channel, const char *request,
+                                 unsigned int request_len, const char *message,
+                                 unsigned int message_len)
+{
+    (void) channel;
+    (void) request;
+    (void) request_len;
+
+    g_free (server.command);
+    server.command = g_strndup (message, message_len);
+
+    /* "cp ... && echo marker" */
+    server.output = server.exit_status == 0 && !server.killed ? SFTPFS_COPY_DONE "\n" : "";
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+ssize_t
+libssh2_channel_read_ex (LIBSSH2_CHANNEL * channel, int stream_id, char *buf, size_t buflen)
+{
+    size_t len;
+
+    (void) channel;
+    (void) stream_id;
+
+    if (server.slow)
+        return LIBSSH2_ERROR_EAGAIN;
+
+    len = MIN (strlen (server.output), buflen);
+    memcpy (buf, server.output, len);
+    server.output += len;
+
+    return (ssize_t) len;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+libssh2_channel_close (LIBSSH2_CHANNEL * channel)
+{
+    (void) channel;
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+libssh2_channel_wait_closed (LIBSSH2_CHANNEL * channel)
+{
+    (void) channel;
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+libssh2_channel_get_exit_status (LIBSSH2_CHANNEL * channel)
+{
+    (void) channel;
+
+    return server.exit_status;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+libssh2_channel_free (LIBSSH2_CHANNEL * channel)
+{
+    (void) channel;
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static vfs_file_handler_t *
+test_fh_new (struct vfs_s_super *super, int flags)
+{
+    struct vfs_s_inode *ino;
+    vfs_file_handler_t *fh;
+
+    ino = g_new0 (struct vfs_s_inode, 1);
+    ino->super = super;
+
+    fh = sftpfs_fh_new (ino, FALSE);
+    SFTP_FILE_HANDLER (fh)->flags = flags;
+
+    return fh;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_fh_free (vfs_file_handler_t * fh)
+{
+    g_free (fh->ino);
+    g_free (fh);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_copy (vfs_file_handler_t * dest_fh, vfs_file_handler_t * src_fh)
+{
+    GError *mcerror = NULL;
+    int rc;
+
+    src_ino = src_fh->ino;
+    dest_ino = dest_fh->ino;
+    rc = sftpfs_copy_file (dest_fh, src_fh, &mcerror);
+    mctest_assert_null (mcerror);
+
+    return rc;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    memset (&server, 0, sizeof (server));
+    sftpfs_remote_copy = TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    MC_PTR_FREE (server.command);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_sftpfs_copy_file)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct vfs_s_super *super;
+    vfs_file_handler_t *src_fh, *dest_fh;
+
+    super = VFS_SUPER (g_new0 (sftpfs_super_t, 1));
+    src_fh = test_fh_new (super, O_RDONLY);
+    dest_fh = test_fh_new (super, O_WRONLY | O_CREAT | O_TRUNC);
+
+    /* when */
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), 0);
+
+    /* then: cp is run on server with quoted names */
+    mctest_assert_int_eq (server.channels, 1);
+    mctest_assert_str_eq (server.command,
+                          "cp -- '/home/user/it'\\''s a file' '/tmp/copy' && echo mc-cp-done");
+
+    /* when: cp fails */
+    server.exit_status = 1;
+
+    /* then: file is copied through client, but server is asked next time again */
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), -1);
+    mctest_assert_false (SFTP_SUPER (super)->no_remote_copy);
+
+    /* when: destination is appended to */
+    server.exit_status = 0;
+    SFTP_FILE_HANDLER (dest_fh)->flags |= O_APPEND;
+
+    /* then */
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), -1);
+    mctest_assert_int_eq (server.channels, 2);
+
+    test_fh_free (src_fh);
+    test_fh_free (dest_fh);
+    g_free (super);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_sftpfs_copy_file_other_server)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct vfs_s_super *super1, *super2;
+    vfs_file_handler_t *src_fh, *dest_fh;
+
+    super1 = VFS_SUPER (g_new0 (sftpfs_super_t, 1));
+    super2 = VFS_SUPER (g_new0 (sftpfs_super_t, 1));
+    src_fh = test_fh_new (super1, O_RDONLY);
+    dest_fh = test_fh_new (super2, O_WRONLY | O_CREAT | O_TRUNC);
+
+    /* when */
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), -1);
+
+    /* then */
+    mctest_assert_int_eq (server.channels, 0);
+
+    test_fh_free (src_fh);
+    test_fh_free (dest_fh);
+    g_free (super1);
+    g_free (super2);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_sftpfs_copy_file_not_allowed)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct vfs_s_super *super;
+    vfs_file_handler_t *src_fh, *dest_fh;
+
+    super = VFS_SUPER (g_new0 (sftpfs_super_t, 1));
+    src_fh = test_fh_new (super, O_RDONLY);
+    dest_fh = test_fh_new (super, O_WRONLY | O_CREAT | O_TRUNC);
+
+    /* when: SFTP-only account */
+    server.open_fails = TRUE;
+
+    /* then */
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), -1);
+    mctest_assert_true (SFTP_SUPER (super)->no_remote_copy);
+
+    /* when: shell without cp */
+    server.open_fails = FALSE;
+    SFTP_SUPER (super)->no_remote_copy = FALSE;
+    server.exit_status = 127;
+
+    /* then: it is not tried again */
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), -1);
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), -1);
+    mctest_assert_int_eq (server.channels, 1);
+
+    /* when: disabled in config */
+    SFTP_SUPER (super)->no_remote_copy = FALSE;
+    server.exit_status = 0;
+    sftpfs_remote_copy = FALSE;
+
+    /* then */
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), -1);
+    mctest_assert_int_eq (server.channels, 1);
+
+    test_fh_free (src_fh);
+    test_fh_free (dest_fh);
+    g_free (super);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_sftpfs_copy_file_unfinished)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct vfs_s_super *super;
+    vfs_file_handler_t *src_fh, *dest_fh;
+
+    super = VFS_SUPER (g_new0 (sftpfs_super_t, 1));
+    src_fh = test_fh_new (super, O_RDONLY);
+    dest_fh = test_fh_new (super, O_WRONLY | O_CREAT | O_TRUNC);
+
+    /* when: cp is killed, server sends no exit status */
+    server.killed = TRUE;
+
+    /* then: file is copied through client */
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), -1);
+    mctest_assert_false (SFTP_SUPER (super)->no_remote_copy);
+
+    /* when: user interrupts waiting for long copy */
+    server.killed = FALSE;
+    server.slow = TRUE;
+    server.interrupted = TRUE;
+
+    /* then */
+    mctest_assert_int_eq (test_copy (dest_fh, src_fh), -1);
+    mctest_assert_false (SFTP_SUPER (super)->no_remote_copy);
+    mctest_assert_int_eq (server.channels, 2);
+
+    test_fh_free (src_fh);
+    test_fh_free (dest_fh);
+    g_free (super);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_sftpfs_copy_file);
+    tcase_add_test (tc_core, test_sftpfs_copy_file_other_server);
+    tcase_add_test (tc_core, test_sftpfs_copy_file_not_allowed);
+    tcase_add_test (tc_core, test_sftpfs_copy_file_unfinished);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "sftpfs_copy.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
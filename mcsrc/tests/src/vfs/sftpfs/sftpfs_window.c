@@ -0,0 +1,544 @@
+/* src/vfs/sftpfs - test read-ahead and write-behind windows
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/sftpfs"
+
+#include "tests/mctest.h"
+
+#include "src/vfs/sftpfs/file.c"
+
+/* Round trip time of the link, in milliseconds */
+#define TEST_RTT 100
+
+#define TEST_FILE_SIZE (4 * 1024 * 1024)
+#define TEST_BLOCK 4096
+
+/* Both reads and writes are sent by libssh2 in packets of this size */
+#define TEST_PACKET 30000
+
+/*
+ * The mocks below stand in for the libssh2 SFTP client together with the server.
+ * Requests are answered one round trip after they are sent; time is virtual, so
+ * the test is fast and its results don't depend on the machine.
+ */
+
+typedef struct
+{
+    off_t end;                  /* requests up to this offset... */
+    long arrival;               /* ...are answered at this time */
+} test_batch_t;
+
+static struct
+{
+    char *data;
+    off_t size;
+    off_t offset;               /* read: returned to caller; write: acknowledged */
+    off_t sent;                 /* requested or written */
+    GQueue batches;
+    long now;                   /* virtual time, ms */
+} server;
+
+struct vfs_class *sftpfs_class = NULL;
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char
+test_byte (off_t offset)
+{
+    return (char) ((offset * 13 + offset / 4096) % 251);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_send (off_t end)
+{
+    test_batch_t *b;
+
+    b = g_new (test_batch_t, 1);
+    b->end = end;
+    b->arrival = server.now + TEST_RTT;
+    g_queue_push_tail (&server.batches, b);
+    server.sent = end;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* wait for the answer to the oldest outstanding request */
+static void
+test_wait_answer (void)
+{
+    test_batch_t *b;
+
+    b = (test_batch_t *) g_queue_peek_head (&server.batches);
+    if (b->arrival > server.now)
+        server.now = b->arrival;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_drop_batches (void)
+{
+    test_batch_t *b;
+
+    while ((b = (test_batch_t *) g_queue_pop_head (&server.batches)) != NULL)
+        g_free (b);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+ssize_t
+libssh2_sftp_read (LIBSSH2_SFTP_HANDLE * handle, char *buffer, size_t buffer_maxlen)
+{
+    off_t ahead, end;
+    test_batch_t *b;
+    size_t n, i;
+
+    (void) handle;
+
+    if (server.offset >= server.size)
+        return 0;
+
+    /* libssh2 keeps four times the buffer requested */
+    ahead = MIN (server.offset + (off_t) buffer_maxlen * 4, server.size);
+    if (server.sent < ahead)
+        test_send (ahead);
+
+    test_wait_answer ();
+    b = (test_batch_t *) g_queue_peek_head (&server.batches);
+    end = MIN (b->end, server.offset + TEST_PACKET);
+
+    n = MIN (buffer_maxlen, (size_t) (end - server.offset));
+    for (i = 0; i < n; i++)
+        buffer[i] = test_byte (server.offset + i);
+    server.offset += n;
+
+    if (server.offset == b->end)
+        g_free (g_queue_pop_head (&server.batches));
+
+    return (ssize_t) n;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+ssize_t
+libssh2_sftp_write (LIBSSH2_SFTP_HANDLE * handle, const char *buffer, size_t count)
+{
+    size_t already;
+    off_t acked;
+    test_batch_t *b;
+
+    (void) handle;
+
+    /* unacknowledged data is passed again, new data follows it */
+    already = (size_t) (server.sent - server.offset);
+    if (count > already)
+    {
+        memcpy (server.data + server.sent, buffer + already, count - already);
+        test_send (server.sent + (off_t) (count - already));
+        if (server.sent > server.size)
+            server.size = server.sent;
+    }
+
+    if (g_queue_is_empty (&server.batches))
+        return 0;
+
+    test_wait_answer ();
+
+    acked = server.offset;
+    while ((b = (test_batch_t *) g_queue_peek_head (&server.batches)) != NULL
+           && b->arrival <= server.now)
+    {
+        server.offset = b->end;
+        g_free (g_queue_pop_head (&server.batches));
+    }
+
+    return (ssize_t) (server.offset - acked);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+libssh2_sftp_seek64 (LIBSSH2_SFTP_HANDLE * handle, libssh2_uint64_t offset)
+{
+    (void) handle;
+
+    test_drop_batches ();
+    server.offset = server.sent = (off_t) offset;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+libssh2_uint64_t
+libssh2_sftp_tell64 (LIBSSH2_SFTP_HANDLE * handle)
+{
+    (void) handle;
+
+    return (libssh2_uint64_t) server.offset;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+libssh2_sftp_close_handle (LIBSSH2_SFTP_HANDLE * handle)
+{
+    (void) handle;
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+libssh2_sftp_fstat_ex (LIBSSH2_SFTP_HANDLE * handle, LIBSSH2_SFTP_ATTRIBUTES * attrs, int setstat)
+{
+    (void) handle;
+    (void) setstat;
+
+    attrs->filesize = (libssh2_uint64_t) server.size;
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+LIBSSH2_SFTP_HANDLE *
+libssh2_sftp_open_ex (LIBSSH2_SFTP * sftp, const char *filename, unsigned int filename_len,
+                      unsigned long flags, long mode, int open_type)
+{
+    (void) sftp;
+    (void) filename;
+    (void) filename_len;
+    (void) flags;
+    (void) mode;
+    (void) open_type;
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+libssh2_session_last_errno (LIBSSH2_SESSION * session)
+{
+    (void) session;
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+gboolean
+sftpfs_is_sftp_error (LIBSSH2_SFTP * sftp_session, int sftp_res, int sftp_error)
+{
+    (void) sftp_session;
+    (void) sftp_res;
+    (void) sftp_error;
+
+    return FALSE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+gboolean
+sftpfs_waitsocket (sftpfs_super_t * super, int sftp_res, GError ** mcerror)
+{
+    (void) super;
+    (void) sftp_res;
+    (void) mcerror;
+
+    return FALSE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+sftpfs_ssherror_to_gliberror (sftpfs_super_t * super, int libssh_errno, GError ** mcerror)
+{
+    (void) super;
+    (void) libssh_errno;
+    (void) mcerror;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+const char *
+sftpfs_fix_filename (const char *file_name, unsigned int *length)
+{
+    *length = strlen (file_name);
+    return file_name;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+sftpfs_attr_to_stat (const LIBSSH2_SFTP_ATTRIBUTES * attrs, struct stat *s)
+{
+    s->st_size = (off_t) attrs->filesize;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static vfs_file_handler_t *
+test_open (off_t size)
+{
+    struct vfs_s_super *super;
+    struct vfs_s_inode *ino;
+    vfs_file_handler_t *fh;
+
+    server.data = g_malloc (TEST_FILE_SIZE);
+    server.size = size;
+    server.offset = server.sent = 0;
+    server.now = 0;
+    g_queue_init (&server.batches);
+
+    super = VFS_SUPER (g_new0 (sftpfs_super_t, 1));
+    ino = g_new0 (struct vfs_s_inode, 1);
+    ino->super = super;
+    ino->st.st_size = size;
+
+    fh = sftpfs_fh_new (ino, FALSE);
+    SFTP_FILE_HANDLER (fh)->handle = (LIBSSH2_SFTP_HANDLE *) & server;
+
+    return fh;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_close (vfs_file_handler_t * fh)
+{
+    sftpfs_close_file (fh, NULL);
+    test_drop_batches ();
+    g_free (fh->ino->super);
+    g_free (fh->ino);
+    g_free (fh);
+    MC_PTR_FREE (server.data);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* read whole file in small blocks, return virtual time spent */
+static long
+test_read_all (vfs_file_handler_t * fh)
+{
+    char buf[TEST_BLOCK];
+    off_t pos = 0;
+    ssize_t n;
+    GError *mcerror = NULL;
+
+    while ((n = sftpfs_read_file (fh, buf, sizeof (buf), &mcerror)) > 0)
+    {
+        ssize_t i;
+
+        for (i = 0; i < n; i++)
+            mctest_assert_int_eq (buf[i], test_byte (pos + i));
+        pos += n;
+        mctest_assert_int_eq (fh->pos, pos);
+    }
+
+    mctest_assert_int_eq (n, 0);
+    mctest_assert_int_eq (pos, TEST_FILE_SIZE);
+    mctest_assert_null (mcerror);
+
+    return server.now;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* write whole file in small blocks, return virtual time spent */
+static long
+test_write_all (vfs_file_handler_t * fh)
+{
+    char buf[TEST_BLOCK];
+    off_t pos = 0;
+    GError *mcerror = NULL;
+    off_t i;
+
+    while (pos < TEST_FILE_SIZE)
+    {
+        ssize_t n, written = 0;
+
+        for (i = 0; i < TEST_BLOCK; i++)
+            buf[i] = test_byte (pos + i);
+
+        /* like copy_file_file(): pass the rest again after short write */
+        while (written < TEST_BLOCK)
+        {
+            n = sftpfs_write_file (fh, buf + written, TEST_BLOCK - written, &mcerror);
+            mctest_assert_true (n > 0);
+            written += n;
+        }
+        pos += TEST_BLOCK;
+    }
+
+    mctest_assert_int_eq (sftpfs_close_file (fh, &mcerror), 0);
+    mctest_assert_null (mcerror);
+
+    mctest_assert_int_eq (server.size, TEST_FILE_SIZE);
+    for (i = 0; i < TEST_FILE_SIZE; i++)
+        if (server.data[i] != test_byte (i))
+            break;
+    mctest_assert_int_eq (i, TEST_FILE_SIZE);
+
+    return server.now;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_sftpfs_read_window)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_file_handler_t *fh;
+    long unbuffered, buffered;
+
+    /* when */
+    sftpfs_window_size = 0;
+    fh = test_open (TEST_FILE_SIZE);
+    unbuffered = test_read_all (fh);
+    test_close (fh);
+
+    sftpfs_window_size = 256;
+    fh = test_open (TEST_FILE_SIZE);
+    buffered = test_read_all (fh);
+    test_close (fh);
+
+    /* then: a few round trips instead of one for each block */
+    mctest_assert_true (buffered < 8 * TEST_RTT);
+    mctest_assert_true (unbuffered > buffered * 20);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_sftpfs_write_window)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_file_handler_t *fh;
+    long unbuffered, buffered;
+
+    /* when */
+    sftpfs_window_size = 0;
+    fh = test_open (0);
+    unbuffered = test_write_all (fh);
+    test_close (fh);
+
+    sftpfs_window_size = 256;
+    fh = test_open (0);
+    buffered = test_write_all (fh);
+    test_close (fh);
+
+    /* then */
+    mctest_assert_true (buffered < 20 * TEST_RTT);
+    mctest_assert_true (unbuffered > buffered * 20);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_sftpfs_seek_drops_window)
+/* *INDENT-ON* */
+{
+    /* given */
+    vfs_file_handler_t *fh;
+    char buf[100];
+    GError *mcerror = NULL;
+    int i;
+
+    sftpfs_window_size = 256;
+    fh = test_open (TEST_FILE_SIZE);
+    mctest_assert_int_eq (sftpfs_read_file (fh, buf, sizeof (buf), &mcerror), sizeof (buf));
+
+    /* when: seek forward inside of read-ahead data */
+    mctest_assert_int_eq (sftpfs_lseek (fh, 5000, SEEK_SET, &mcerror), 5000);
+
+    /* then */
+    mctest_assert_int_eq (sftpfs_read_file (fh, buf, sizeof (buf), &mcerror), sizeof (buf));
+    for (i = 0; i < (int) sizeof (buf); i++)
+        mctest_assert_int_eq (buf[i], test_byte (5000 + i));
+    mctest_assert_int_eq (fh->pos, 5000 + sizeof (buf));
+
+    /* when: relative seek */
+    mctest_assert_int_eq (sftpfs_lseek (fh, 1000, SEEK_CUR, &mcerror), 6100);
+
+    /* then */
+    mctest_assert_int_eq (sftpfs_read_file (fh, buf, sizeof (buf), &mcerror), sizeof (buf));
+    mctest_assert_int_eq (buf[0], test_byte (6100));
+    mctest_assert_null (mcerror);
+
+    test_close (fh);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_sftpfs_read_window);
+    tcase_add_test (tc_core, test_sftpfs_write_window);
+    tcase_add_test (tc_core, test_sftpfs_seek_drops_window);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "sftpfs_window.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,419 @@
+/* src/vfs/tar - test tar filesystem
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/tar"
+
+#include "tests/mctest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "lib/strutil.h"
+
+#include "src/vfs/local/local.c"
+#include "src/vfs/tar/tar.c"
+
+/* bigger than the block of archive reader */
+#define BIG_SIZE (1536 * 1024 + 100)
+#define TEST_MTIME 1500000000
+
+/* members spanning several blocks of archive reader */
+#ifdef TEST_BENCHMARK
+/* tarfs_bench, not run by "make check": time loading of a big archive */
+#define TEST_FILES 20000
+#else
+#define TEST_FILES 2000
+#endif
+#define TEST_FILE_SIZE 700
+
+#define TEST_REGTYPE '0'
+
+typedef struct
+{
+    const char *name;
+    const char *data;
+    size_t len;
+    char typeflag;
+} test_member_t;
+
+static char *test_file = NULL;
+static char *big_data = NULL;
+
+/* @CapturedValue */
+static char *message_text__captured = NULL;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+message (int flags, const char *title, const char *text, ...)
+{
+    va_list ap;
+
+    (void) flags;
+    (void) title;
+
+    g_free (message_text__captured);
+    va_start (ap, text);
+    message_text__captured = g_strdup_vprintf (text, ap);
+    va_end (ap);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_block (FILE * f, const char *name, size_t size, char typeflag, const char *linkname)
+{
+    union block b;
+    unsigned int sum = 0;
+    size_t i;
+
+    memset (&b, 0, sizeof (b));
+    g_strlcpy (b.header.name, name, sizeof (b.header.name));
+    g_snprintf (b.header.mode, sizeof (b.header.mode), "%07o", typeflag == DIRTYPE ? 0755 : 0644);
+    g_snprintf (b.header.uid, sizeof (b.header.uid), "%07o", 1000);
+    g_snprintf (b.header.gid, sizeof (b.header.gid), "%07o", 1000);
+    g_snprintf (b.header.size, sizeof (b.header.size), "%011lo", (unsigned long) size);
+    g_snprintf (b.header.mtime, sizeof (b.header.mtime), "%011lo", (unsigned long) TEST_MTIME);
+    b.header.typeflag = typeflag;
+    if (linkname != NULL)
+        g_strlcpy (b.header.linkname, linkname, sizeof (b.header.linkname));
+    memcpy (b.header.magic, "ustar ", 6);
+    memcpy (b.header.version, " ", 2);
+
+    memset (b.header.chksum, ' ', sizeof (b.header.chksum));
+    for (i = 0; i < sizeof (b.buffer); i++)
+        sum += (unsigned char) b.buffer[i];
+    g_snprintf (b.header.chksum, sizeof (b.header.chksum), "%06o", sum);
+
+    fwrite (b.buffer, 1, sizeof (b.buffer), f);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put_data (FILE * f, const char *data, size_t len)
+{
+    static const char zeros[BLOCKSIZE] = { 0 };
+
+    fwrite (data, 1, len, f);
+    if (len % BLOCKSIZE != 0)
+        fwrite (zeros, 1, BLOCKSIZE - len % BLOCKSIZE, f);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* write GNU tar archive, names longer than 100 characters are stored in LongLink records */
+static void
+test_make_tar (const test_member_t * members, size_t count)
+{
+    static const char zeros[2 * BLOCKSIZE] = { 0 };
+    FILE *f;
+    size_t i;
+
+    f = fopen (test_file, "wb");
+
+    for (i = 0; i < count; i++)
+    {
+        const test_member_t *m = &members[i];
+        gboolean link = m->typeflag == SYMTYPE;
+        size_t name_len;
+
+        name_len = strlen (m->name);
+        if (name_len >= sizeof (((struct posix_header *) NULL)->name))
+        {
+            test_put_block (f, "././@LongLink", name_len + 1, GNUTYPE_LONGNAME, NULL);
+            test_put_data (f, m->name, name_len + 1);
+        }
+
+        test_put_block (f, m->name, link ? 0 : m->len, m->typeflag, link ? m->data : NULL);
+        if (!link)
+            test_put_data (f, m->data, m->len);
+    }
+
+    fwrite (zeros, 1, sizeof (zeros), f);
+    fclose (f);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static vfs_path_t *
+test_inner_path (const char *name)
+{
+    vfs_path_t *vpath;
+    char *path;
+
+    path = g_strconcat (test_file, "/utar://", name, (char *) NULL);
+    vpath = vfs_path_from_str (path);
+    g_free (path);
+
+    return vpath;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_open (const char *name)
+{
+    vfs_path_t *vpath;
+    int fd;
+
+    vpath = test_inner_path (name);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+
+    return fd;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_stat (const char *name, struct stat *st)
+{
+    vfs_path_t *vpath;
+    int ret;
+
+    vpath = test_inner_path (name);
+    ret = mc_lstat (vpath, st);
+    vfs_path_free (vpath);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    guint32 seed = 12345;
+    size_t i;
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_init_tarfs ();
+    vfs_setup_work_dir ();
+
+    mc_global.vfs.archive_index = FALSE;
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-tarfs.tar", (char *) NULL);
+
+    big_data = g_malloc (BIG_SIZE);
+    for (i = 0; i < BIG_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        big_data[i] = (char) (seed >> 16);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    unlink (test_file);
+    g_free (test_file);
+    g_free (big_data);
+    MC_PTR_FREE (message_text__captured);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_tarfs_read)
+/* *INDENT-ON* */
+{
+    /* given */
+    static const char text[] = "The quick brown fox jumps over the lazy dog\n";
+    static const char long_name[] =
+        "long/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+        "/bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb.txt";
+    const test_member_t members[] = {
+        {"dir/", "", 0, DIRTYPE},
+        {"dir/first.txt", text, sizeof (text) - 1, TEST_REGTYPE},
+        {"big.bin", big_data, BIG_SIZE, TEST_REGTYPE},
+        {long_name, text, 10, TEST_REGTYPE},
+        {"link", "dir/first.txt", 0, SYMTYPE},
+        {"last.txt", text + 4, sizeof (text) - 5, TEST_REGTYPE},
+    };
+    struct stat st;
+    char *buf;
+    char link[MC_MAXPATHLEN];
+    vfs_path_t *vpath;
+    ssize_t n;
+    int fd;
+
+    test_make_tar (members, G_N_ELEMENTS (members));
+
+    /* when */
+    mctest_assert_int_eq (test_stat ("dir/first.txt", &st), 0);
+
+    /* then */
+    mctest_assert_true (S_ISREG (st.st_mode));
+    mctest_assert_int_eq (st.st_size, sizeof (text) - 1);
+    mctest_assert_int_eq (st.st_mtime, TEST_MTIME);
+
+    mctest_assert_int_eq (test_stat ("dir", &st), 0);
+    mctest_assert_true (S_ISDIR (st.st_mode));
+    mctest_assert_int_eq (test_stat (long_name, &st), 0);
+    mctest_assert_int_eq (st.st_size, 10);
+
+    vpath = test_inner_path ("link");
+    n = mc_readlink (vpath, link, sizeof (link) - 1);
+    vfs_path_free (vpath);
+    mctest_assert_int_eq (n, strlen ("dir/first.txt"));
+    link[n] = '\0';
+    mctest_assert_str_eq (link, "dir/first.txt");
+
+    buf = g_malloc (BIG_SIZE);
+
+    fd = test_open ("big.bin");
+    mctest_assert_int_ne (fd, -1);
+    for (n = 0; n < BIG_SIZE;)
+    {
+        ssize_t r;
+
+        r = mc_read (fd, buf + n, BIG_SIZE - n);
+        mctest_assert_true (r > 0);
+        n += r;
+    }
+    mctest_assert_int_eq (memcmp (buf, big_data, BIG_SIZE), 0);
+    mc_close (fd);
+
+    /* member after the big one: header was read after a skip past the buffer */
+    fd = test_open ("last.txt");
+    mctest_assert_int_ne (fd, -1);
+    mctest_assert_int_eq (mc_read (fd, buf, BUF_1K), sizeof (text) - 5);
+    mctest_assert_int_eq (memcmp (buf, text + 4, sizeof (text) - 5), 0);
+    mc_close (fd);
+
+    g_free (buf);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_tarfs_many_members)
+/* *INDENT-ON* */
+{
+    /* given */
+    test_member_t *members;
+    char **names;
+    char *buf;
+    vfs_path_t *vpath;
+    DIR *dir;
+    struct dirent *dirent;
+#ifdef TEST_BENCHMARK
+    gint64 start, done;
+#endif
+    int i, count = 0;
+
+    members = g_new0 (test_member_t, TEST_FILES);
+    names = g_new0 (char *, TEST_FILES + 1);
+    for (i = 0; i < TEST_FILES; i++)
+    {
+        names[i] = g_strdup_printf ("dir%02d/file%05d.txt", i % 50, i);
+        members[i].name = names[i];
+        members[i].data = big_data + i;
+        members[i].len = TEST_FILE_SIZE;
+        members[i].typeflag = TEST_REGTYPE;
+    }
+    test_make_tar (members, TEST_FILES);
+
+    buf = g_malloc (TEST_FILE_SIZE);
+
+    /* when */
+#ifdef TEST_BENCHMARK
+    start = g_get_monotonic_time ();
+#endif
+
+    vpath = test_inner_path ("dir07");
+    dir = mc_opendir (vpath);
+    vfs_path_free (vpath);
+    mctest_assert_not_null (dir);
+    while ((dirent = mc_readdir (dir)) != NULL)
+        if (DIR_IS_DOT (dirent->d_name) || DIR_IS_DOTDOT (dirent->d_name))
+            continue;
+        else
+            count++;
+    mc_closedir (dir);
+
+#ifdef TEST_BENCHMARK
+    done = g_get_monotonic_time ();
+    printf ("tarfs: archive of %d members loaded in %.3f ms\n", TEST_FILES,
+            (double) (done - start) / 1000.0);
+#endif
+
+    /* then */
+    mctest_assert_int_eq (count, TEST_FILES / 50);
+
+    i = test_open (names[TEST_FILES - 1]);
+    mctest_assert_int_eq (mc_read (i, buf, TEST_FILE_SIZE), TEST_FILE_SIZE);
+    mc_close (i);
+    mctest_assert_int_eq (memcmp (buf, big_data + TEST_FILES - 1, TEST_FILE_SIZE), 0);
+
+    g_free (buf);
+    g_strfreev (names);
+    g_free (members);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_tarfs_read);
+    tcase_add_test (tc_core, test_tarfs_many_members);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "tarfs.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
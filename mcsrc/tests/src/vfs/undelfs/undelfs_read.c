@@ -0,0 +1,310 @@
+/* src/vfs/undelfs - test reading of deleted files
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/undelfs"
+
+#include "tests/mctest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "src/vfs/undelfs/undelfs.c"
+
+/* with 1K blocks, file has single and double indirect blocks between its data blocks */
+#define TEST_BLOCKSIZE 1024
+#define TEST_SIZE (400 * TEST_BLOCKSIZE + 300)
+
+static char *test_image = NULL;
+static char *test_source = NULL;
+
+/* @CapturedValue */
+static char *message_text__captured = NULL;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+message (int flags, const char *title, const char *text, ...)
+{
+    va_list ap;
+
+    (void) flags;
+    (void) title;
+
+    g_free (message_text__captured);
+    va_start (ap, text);
+    message_text__captured = g_strdup_vprintf (text, ap);
+    va_end (ap);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char
+test_data_byte (off_t offset)
+{
+    return (char) ((offset * 7 + offset / 1024) % 251);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+test_check_data (const char *buf, off_t offset, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        if (buf[i] != test_data_byte (offset + i))
+            return FALSE;
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* e2fsprogs are needed to make the test image */
+static gboolean
+test_tools_found (void)
+{
+    return system ("PATH=\"$PATH:/sbin:/usr/sbin\"; "
+                   "command -v mke2fs >/dev/null 2>&1 && command -v debugfs >/dev/null 2>&1") == 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* ext2 image with one file written and then deleted by debugfs */
+static void
+test_make_image (void)
+{
+    FILE *f;
+    off_t i;
+    char *cmd;
+
+    f = fopen (test_source, "w");
+    for (i = 0; i < TEST_SIZE; i++)
+        fputc (test_data_byte (i), f);
+    fclose (f);
+
+    cmd = g_strdup_printf ("PATH=\"$PATH:/sbin:/usr/sbin\"; "
+                           "mke2fs -q -F -t ext2 -b %d '%s' 2048 >/dev/null 2>&1 && "
+                           "debugfs -w -R 'write %s data' '%s' >/dev/null 2>&1 && "
+                           "debugfs -w -R 'rm data' '%s' >/dev/null 2>&1",
+                           TEST_BLOCKSIZE, test_image, test_source, test_image, test_image);
+    mctest_assert_int_eq (system (cmd), 0);
+    g_free (cmd);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    test_image = g_build_filename (g_get_tmp_dir (), "mctest-undelfs.img", (char *) NULL);
+    test_source = g_build_filename (g_get_tmp_dir (), "mctest-undelfs.src", (char *) NULL);
+    test_make_image ();
+
+    /* what undelfs_opendir does for undel://<device> */
+    mctest_assert_int_eq (ext2fs_open (test_image, 0, 0, 0, unix_io_manager, &fs), 0);
+    mctest_assert_int_eq (ext2fs_read_inode_bitmap (fs), 0);
+    mctest_assert_int_eq (ext2fs_read_block_bitmap (fs), 0);
+    ext2_fname = g_strdup (test_image);
+    mctest_assert_int_eq (undelfs_loaddel (), 1);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    undelfs_shutdown ();
+
+    unlink (test_image);
+    unlink (test_source);
+    MC_PTR_FREE (test_image);
+    MC_PTR_FREE (test_source);
+    MC_PTR_FREE (message_text__captured);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_undelfs_loaddel)
+/* *INDENT-ON* */
+{
+    /* then */
+    mctest_assert_int_eq (num_delarray, 1);
+    mctest_assert_int_eq (delarray[0].size, TEST_SIZE);
+    /* data blocks and indirect ones */
+    mctest_assert_true ((delarray[0].num_blocks > 401));
+    mctest_assert_int_eq (delarray[0].free_blocks, delarray[0].num_blocks);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_undelfs_read_sequential)
+/* *INDENT-ON* */
+{
+    /* given */
+    undelfs_file *p;
+    char buf[3000];
+    off_t pos;
+    ssize_t n;
+
+    p = undelfs_file_new (0);
+    mctest_assert_not_null (p);
+
+    /* when: chunks not aligned to blocks */
+    for (pos = 0; (n = undelfs_read (p, buf, sizeof (buf))) > 0; pos += n)
+        mctest_assert_true (test_check_data (buf, pos, n));
+
+    /* then */
+    mctest_assert_int_eq (n, 0);
+    mctest_assert_int_eq (pos, TEST_SIZE);
+    mctest_assert_null (message_text__captured);
+
+    undelfs_close (p);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_undelfs_read_whole)
+/* *INDENT-ON* */
+{
+    /* given */
+    undelfs_file *p;
+    char *buf;
+
+    p = undelfs_file_new (0);
+    mctest_assert_not_null (p);
+    buf = g_malloc (TEST_SIZE + 100);
+
+    /* when: runs of adjacent blocks are split by indirect blocks */
+    mctest_assert_int_eq (undelfs_read (p, buf, TEST_SIZE + 100), TEST_SIZE);
+
+    /* then */
+    mctest_assert_true (test_check_data (buf, 0, TEST_SIZE));
+    mctest_assert_int_eq (undelfs_read (p, buf, 100), 0);
+
+    g_free (buf);
+    undelfs_close (p);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_undelfs_lseek)
+/* *INDENT-ON* */
+{
+    /* given */
+    undelfs_file *p;
+    char buf[5000];
+    off_t offset;
+
+    p = undelfs_file_new (0);
+    mctest_assert_not_null (p);
+
+    /* when: blocks behind double indirect one */
+    offset = 300 * TEST_BLOCKSIZE - 10;
+    mctest_assert_int_eq (undelfs_lseek (p, offset, SEEK_SET), offset);
+    mctest_assert_int_eq (undelfs_read (p, buf, sizeof (buf)), sizeof (buf));
+
+    /* then */
+    mctest_assert_true (test_check_data (buf, offset, sizeof (buf)));
+
+    /* when: backwards, over single indirect block */
+    offset = 10 * TEST_BLOCKSIZE;
+    mctest_assert_int_eq (undelfs_lseek (p, -(off_t) (290 * TEST_BLOCKSIZE - 10 + sizeof (buf)),
+                                         SEEK_CUR), offset);
+    mctest_assert_int_eq (undelfs_read (p, buf, 3 * TEST_BLOCKSIZE), 3 * TEST_BLOCKSIZE);
+
+    /* then */
+    mctest_assert_true (test_check_data (buf, offset, 3 * TEST_BLOCKSIZE));
+
+    /* tail of file */
+    mctest_assert_int_eq (undelfs_lseek (p, -100, SEEK_END), TEST_SIZE - 100);
+    mctest_assert_int_eq (undelfs_read (p, buf, sizeof (buf)), 100);
+    mctest_assert_true (test_check_data (buf, TEST_SIZE - 100, 100));
+
+    /* before start of file */
+    mctest_assert_int_eq (undelfs_lseek (p, -1, SEEK_SET), -1);
+    mctest_assert_int_eq (undelfs_lseek (p, 0, SEEK_CUR), TEST_SIZE);
+
+    undelfs_close (p);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+    Suite *s;
+    TCase *tc_core;
+    SRunner *sr;
+
+    if (!test_tools_found ())
+    {
+        fprintf (stderr, "mke2fs or debugfs not found, test skipped\n");
+        return 77;              /* skipped, see automake manual */
+    }
+
+    s = suite_create (TEST_SUITE_NAME);
+    tc_core = tcase_create ("Core");
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_undelfs_loaddel);
+    tcase_add_test (tc_core, test_undelfs_read_sequential);
+    tcase_add_test (tc_core, test_undelfs_read_whole);
+    tcase_add_test (tc_core, test_undelfs_lseek);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "undelfs_read.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
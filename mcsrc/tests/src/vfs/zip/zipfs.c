@@ -0,0 +1,655 @@
+/* src/vfs/zip - test native zip filesystem
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/vfs/zip"
+
+#include "tests/mctest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "lib/strutil.h"
+
+#include "src/vfs/local/local.c"
+#include "src/vfs/zip/zip.c"
+
+#define BIG_SIZE (300 * 1024)
+#define TEST_MTIME 1500000000
+
+#ifdef TEST_BENCHMARK
+/* zipfs_bench, not run by "make check": time listing and reading of many members;
+   uzip-bench times the same with the uzip extfs helper */
+#define TEST_FILES 2000
+#define TEST_FILE_SIZE 4096
+#else
+#define TEST_FILES 200
+#define TEST_FILE_SIZE 1024
+#endif
+
+typedef struct
+{
+    const char *name;
+    const char *data;
+    size_t len;
+    int method;
+    mode_t mode;
+    int flags;
+} test_member_t;
+
+static char *test_file = NULL;
+static char *big_data = NULL;
+
+/* @CapturedValue */
+static char *message_text__captured = NULL;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+void
+message (int flags, const char *title, const char *text, ...)
+{
+    va_list ap;
+
+    (void) flags;
+    (void) title;
+
+    g_free (message_text__captured);
+    va_start (ap, text);
+    message_text__captured = g_strdup_vprintf (text, ap);
+    va_end (ap);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put16 (GByteArray * buf, guint16 v)
+{
+    guint8 b[2] = { v & 0xff, v >> 8 };
+
+    g_byte_array_append (buf, b, sizeof (b));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put32 (GByteArray * buf, guint32 v)
+{
+    test_put16 (buf, v & 0xffff);
+    test_put16 (buf, v >> 16);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_put64 (GByteArray * buf, guint64 v)
+{
+    test_put32 (buf, v & 0xffffffff);
+    test_put32 (buf, v >> 32);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static GByteArray *
+test_deflate (const char *data, size_t len)
+{
+    GByteArray *out;
+    z_stream zs;
+    guint8 chunk[BUF_8K];
+    int err;
+
+    out = g_byte_array_new ();
+    memset (&zs, 0, sizeof (zs));
+    deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    zs.next_in = (Bytef *) data;
+    zs.avail_in = (uInt) len;
+
+    do
+    {
+        zs.next_out = chunk;
+        zs.avail_out = sizeof (chunk);
+        err = deflate (&zs, Z_FINISH);
+        g_byte_array_append (out, chunk, sizeof (chunk) - zs.avail_out);
+    }
+    while (err == Z_OK);
+
+    deflateEnd (&zs);
+    return out;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* write zip archive, optionally in zip64 format and prepended with @prefix_len bytes of junk */
+static void
+test_make_zip (const test_member_t * members, size_t count, gboolean zip64, size_t prefix_len)
+{
+    GByteArray *out, *cdir;
+    size_t i, cd_offset, zip64_offset;
+    FILE *f;
+
+    out = g_byte_array_new ();
+    cdir = g_byte_array_new ();
+
+    for (i = 0; i < count; i++)
+    {
+        const test_member_t *m = &members[i];
+        GByteArray *packed = NULL;
+        const guint8 *data = (const guint8 *) m->data;
+        size_t csize = m->len, offset = out->len;
+        guint32 crc;
+
+        crc = crc32 (0, (const Bytef *) m->data, (uInt) m->len);
+        if (m->method == ZIP_METHOD_DEFLATED)
+        {
+            packed = test_deflate (m->data, m->len);
+            data = packed->data;
+            csize = packed->len;
+        }
+
+        /* local header */
+        test_put32 (out, ZIP_LOCAL_HEADER_SIG);
+        test_put16 (out, zip64 ? 45 : 20);
+        test_put16 (out, m->flags);
+        test_put16 (out, m->method);
+        test_put16 (out, 0);
+        test_put16 (out, 0);
+        test_put32 (out, crc);
+        test_put32 (out, zip64 ? 0xFFFFFFFF : csize);
+        test_put32 (out, zip64 ? 0xFFFFFFFF : m->len);
+        test_put16 (out, strlen (m->name));
+        test_put16 (out, zip64 ? 20 : 0);
+        g_byte_array_append (out, (const guint8 *) m->name, strlen (m->name));
+        if (zip64)
+        {
+            test_put16 (out, ZIP_EXTRA_ZIP64);
+            test_put16 (out, 16);
+            test_put64 (out, m->len);
+            test_put64 (out, csize);
+        }
+        g_byte_array_append (out, data, csize);
+
+        /* central directory header */
+        test_put32 (cdir, ZIP_CDIR_HEADER_SIG);
+        test_put16 (cdir, (ZIP_HOST_UNIX << 8) | 45);
+        test_put16 (cdir, zip64 ? 45 : 20);
+        test_put16 (cdir, m->flags);
+        test_put16 (cdir, m->method);
+        test_put16 (cdir, 0);
+        test_put16 (cdir, 0);
+        test_put32 (cdir, crc);
+        test_put32 (cdir, zip64 ? 0xFFFFFFFF : csize);
+        test_put32 (cdir, zip64 ? 0xFFFFFFFF : m->len);
+        test_put16 (cdir, strlen (m->name));
+        test_put16 (cdir, (zip64 ? 28 : 0) + 9);
+        test_put16 (cdir, 0);
+        test_put16 (cdir, 0);
+        test_put16 (cdir, 0);
+        test_put32 (cdir, (guint32) m->mode << 16);
+        test_put32 (cdir, zip64 ? 0xFFFFFFFF : offset);
+        g_byte_array_append (cdir, (const guint8 *) m->name, strlen (m->name));
+        if (zip64)
+        {
+            test_put16 (cdir, ZIP_EXTRA_ZIP64);
+            test_put16 (cdir, 24);
+            test_put64 (cdir, m->len);
+            test_put64 (cdir, csize);
+            test_put64 (cdir, offset);
+        }
+        test_put16 (cdir, ZIP_EXTRA_TIMESTAMP);
+        test_put16 (cdir, 5);
+        g_byte_array_append (cdir, (const guint8 *) "\1", 1);
+        test_put32 (cdir, TEST_MTIME);
+
+        if (packed != NULL)
+            g_byte_array_free (packed, TRUE);
+    }
+
+    cd_offset = out->len;
+    g_byte_array_append (out, cdir->data, cdir->len);
+    zip64_offset = out->len;
+
+    if (zip64)
+    {
+        test_put32 (out, ZIP64_EOCD_SIG);
+        test_put64 (out, ZIP64_EOCD_SIZE - 12);
+        test_put16 (out, 45);
+        test_put16 (out, 45);
+        test_put32 (out, 0);
+        test_put32 (out, 0);
+        test_put64 (out, count);
+        test_put64 (out, count);
+        test_put64 (out, cdir->len);
+        test_put64 (out, cd_offset);
+
+        test_put32 (out, ZIP64_EOCD_LOCATOR_SIG);
+        test_put32 (out, 0);
+        test_put64 (out, zip64_offset);
+        test_put32 (out, 1);
+    }
+
+    test_put32 (out, ZIP_EOCD_SIG);
+    test_put16 (out, 0);
+    test_put16 (out, 0);
+    test_put16 (out, zip64 ? 0xFFFF : count);
+    test_put16 (out, zip64 ? 0xFFFF : count);
+    test_put32 (out, zip64 ? 0xFFFFFFFF : cdir->len);
+    test_put32 (out, zip64 ? 0xFFFFFFFF : cd_offset);
+    test_put16 (out, 7);
+    g_byte_array_append (out, (const guint8 *) "comment", 7);
+
+    f = fopen (test_file, "wb");
+    for (i = 0; i < prefix_len; i++)
+        fputc ('#', f);
+    fwrite (out->data, 1, out->len, f);
+    fclose (f);
+
+    g_byte_array_free (cdir, TRUE);
+    g_byte_array_free (out, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static vfs_path_t *
+test_inner_path (const char *name)
+{
+    vfs_path_t *vpath;
+    char *path;
+
+    path = g_strconcat (test_file, "/zip://", name, (char *) NULL);
+    vpath = vfs_path_from_str (path);
+    g_free (path);
+
+    return vpath;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_open (const char *name)
+{
+    vfs_path_t *vpath;
+    int fd;
+
+    vpath = test_inner_path (name);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+
+    return fd;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+test_stat (const char *name, struct stat *st)
+{
+    vfs_path_t *vpath;
+    int ret;
+
+    vpath = test_inner_path (name);
+    ret = mc_lstat (vpath, st);
+    vfs_path_free (vpath);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    guint32 seed = 12345;
+    size_t i;
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_init_zipfs ();
+    vfs_setup_work_dir ();
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-zipfs.zip", (char *) NULL);
+
+    /* incompressible data to get member larger than the read buffer */
+    big_data = g_malloc (BIG_SIZE);
+    for (i = 0; i < BIG_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        big_data[i] = (char) (seed >> 16);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    unlink (test_file);
+    g_free (test_file);
+    g_free (big_data);
+    MC_PTR_FREE (message_text__captured);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @DataSource("test_zipfs_read_ds") */
+/* *INDENT-OFF* */
+static const struct test_zipfs_read_ds
+{
+    gboolean zip64;
+    size_t prefix_len;
+} test_zipfs_read_ds[] =
+{
+    { /* 0. */
+        FALSE,
+        0
+    },
+    { /* 1. */
+        TRUE,
+        0
+    },
+    { /* 2. self-extracting archive */
+        FALSE,
+        1000
+    },
+    { /* 3. */
+        TRUE,
+        1000
+    },
+};
+/* *INDENT-ON* */
+
+/* @Test(dataSource = "test_zipfs_read_ds") */
+/* *INDENT-OFF* */
+START_PARAMETRIZED_TEST (test_zipfs_read, test_zipfs_read_ds)
+/* *INDENT-ON* */
+{
+    /* given */
+    static const char text[] = "The quick brown fox jumps over the lazy dog\n";
+    const test_member_t members[] = {
+        {"stored.txt", text, sizeof (text) - 1, ZIP_METHOD_STORED, S_IFREG | 0644, 0},
+        {"dir/", "", 0, ZIP_METHOD_STORED, S_IFDIR | 0700, 0},
+        {"a/b/c.txt", text, sizeof (text) - 1, ZIP_METHOD_DEFLATED, S_IFREG | 0600, 0},
+        {"big.bin", big_data, BIG_SIZE, ZIP_METHOD_DEFLATED, S_IFREG | 0644, 0},
+        {"link", "a/b/c.txt", 9, ZIP_METHOD_STORED, S_IFLNK | 0777, 0},
+    };
+    struct stat st;
+    char *buf;
+    char link[MC_MAXPATHLEN];
+    vfs_path_t *vpath;
+    off_t total = 0, offset1 = -1, offset2 = -1;
+    ssize_t n;
+    int fd;
+
+    test_make_zip (members, G_N_ELEMENTS (members), data->zip64, data->prefix_len);
+
+    /* when */
+    mctest_assert_int_eq (test_stat ("a/b/c.txt", &st), 0);
+
+    /* then */
+    mctest_assert_true (S_ISREG (st.st_mode));
+    mctest_assert_int_eq (st.st_mode & 07777, 0600);
+    mctest_assert_int_eq (st.st_size, sizeof (text) - 1);
+    mctest_assert_int_eq (st.st_mtime, TEST_MTIME);
+
+    mctest_assert_int_eq (test_stat ("a/b", &st), 0);
+    mctest_assert_true (S_ISDIR (st.st_mode));
+    mctest_assert_int_eq (test_stat ("dir", &st), 0);
+    mctest_assert_true (S_ISDIR (st.st_mode));
+    mctest_assert_int_eq (st.st_mode & 07777, 0700);
+
+    vpath = test_inner_path ("link");
+    n = mc_readlink (vpath, link, sizeof (link) - 1);
+    vfs_path_free (vpath);
+    mctest_assert_int_eq (n, 9);
+    link[n] = '\0';
+    mctest_assert_str_eq (link, "a/b/c.txt");
+
+    buf = g_malloc (BUF_10K);
+
+    /* members are copied in archive order */
+    vpath = test_inner_path ("stored.txt");
+    mctest_assert_int_eq (mc_setctl (vpath, VFS_SETCTL_DATA_OFFSET, &offset1), 1);
+    vfs_path_free (vpath);
+    vpath = test_inner_path ("a/b/c.txt");
+    mctest_assert_int_eq (mc_setctl (vpath, VFS_SETCTL_DATA_OFFSET, &offset2), 1);
+    vfs_path_free (vpath);
+    mctest_assert_true ((offset1 >= 0));
+    mctest_assert_true ((offset1 < offset2));
+
+    fd = test_open ("stored.txt");
+    mctest_assert_int_ne (fd, -1);
+    mctest_assert_int_eq (mc_read (fd, buf, BUF_10K), sizeof (text) - 1);
+    mctest_assert_int_eq (memcmp (buf, text, sizeof (text) - 1), 0);
+    mc_close (fd);
+
+    fd = test_open ("a/b/c.txt");
+    mctest_assert_int_ne (fd, -1);
+    mctest_assert_int_eq (mc_read (fd, buf, BUF_10K), sizeof (text) - 1);
+    mctest_assert_int_eq (memcmp (buf, text, sizeof (text) - 1), 0);
+    mc_close (fd);
+
+    fd = test_open ("big.bin");
+    mctest_assert_int_ne (fd, -1);
+    while ((n = mc_read (fd, buf, 7000)) > 0)
+    {
+        mctest_assert_int_eq (memcmp (buf, big_data + total, n), 0);
+        total += n;
+    }
+    mctest_assert_int_eq (n, 0);
+    mctest_assert_int_eq (total, BIG_SIZE);
+
+    /* backward seek re-inflates the member */
+    mctest_assert_int_eq (mc_lseek (fd, 100000, SEEK_SET), 100000);
+    mctest_assert_int_eq (mc_read (fd, buf, 5000), 5000);
+    mctest_assert_int_eq (memcmp (buf, big_data + 100000, 5000), 0);
+    mc_close (fd);
+
+    g_free (buf);
+}
+/* *INDENT-OFF* */
+END_PARAMETRIZED_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_zipfs_not_zip)
+/* *INDENT-ON* */
+{
+    /* given */
+    struct stat st;
+    FILE *f;
+
+    f = fopen (test_file, "wb");
+    fputs ("this is not a zip archive", f);
+    fclose (f);
+
+    /* when */
+    mctest_assert_int_eq (test_stat ("file", &st), -1);
+
+    /* then */
+    mctest_assert_not_null (message_text__captured);
+    mctest_assert_not_null (strstr (message_text__captured, "doesn't look like a zip archive"));
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_zipfs_unsupported)
+/* *INDENT-ON* */
+{
+    /* given */
+    static const char text[] = "The quick brown fox jumps over the lazy dog\n";
+    const test_member_t members[] = {
+        {"secret.txt", text, sizeof (text) - 1, ZIP_METHOD_STORED, S_IFREG | 0644,
+         ZIP_FLAG_ENCRYPTED},
+        {"text.bz2", text, sizeof (text) - 1, 12, S_IFREG | 0644, 0},
+    };
+    struct stat st;
+
+    test_make_zip (members, G_N_ELEMENTS (members), FALSE, 0);
+
+    /* when */
+    mctest_assert_int_eq (test_stat ("secret.txt", &st), 0);
+    mctest_assert_int_eq (test_open ("secret.txt"), -1);
+
+    /* then: user is told to use the extfs helper */
+    mctest_assert_not_null (message_text__captured);
+    mctest_assert_not_null (strstr (message_text__captured, "encrypted"));
+    mctest_assert_not_null (strstr (message_text__captured, "secret.txt"));
+    mctest_assert_not_null (strstr (message_text__captured, "uzip://"));
+
+    /* when */
+    MC_PTR_FREE (message_text__captured);
+    mctest_assert_int_eq (test_open ("text.bz2"), -1);
+
+    /* then */
+    mctest_assert_not_null (message_text__captured);
+    mctest_assert_not_null (strstr (message_text__captured, "unsupported method"));
+    mctest_assert_not_null (strstr (message_text__captured, "uzip://"));
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_zipfs_many_members)
+/* *INDENT-ON* */
+{
+    /* given */
+    test_member_t *members;
+    char **names;
+    char *buf;
+    vfs_path_t *vpath;
+    DIR *dir;
+    struct dirent *dirent;
+#ifdef TEST_BENCHMARK
+    gint64 start, listed, done;
+#endif
+    int i, count = 0;
+
+    members = g_new0 (test_member_t, TEST_FILES);
+    names = g_new0 (char *, TEST_FILES + 1);
+    for (i = 0; i < TEST_FILES; i++)
+    {
+        names[i] = g_strdup_printf ("dir%02d/file%05d.txt", i % 50, i);
+        members[i].name = names[i];
+        members[i].data = big_data + i;
+        members[i].len = TEST_FILE_SIZE;
+        members[i].method = ZIP_METHOD_DEFLATED;
+        members[i].mode = S_IFREG | 0644;
+    }
+    test_make_zip (members, TEST_FILES, FALSE, 0);
+
+    buf = g_malloc (TEST_FILE_SIZE);
+
+    /* when */
+#ifdef TEST_BENCHMARK
+    start = g_get_monotonic_time ();
+#endif
+
+    vpath = test_inner_path ("dir07");
+    dir = mc_opendir (vpath);
+    vfs_path_free (vpath);
+    mctest_assert_not_null (dir);
+    while ((dirent = mc_readdir (dir)) != NULL)
+        if (DIR_IS_DOT (dirent->d_name) || DIR_IS_DOTDOT (dirent->d_name))
+            continue;
+        else
+            count++;
+    mc_closedir (dir);
+
+#ifdef TEST_BENCHMARK
+    listed = g_get_monotonic_time ();
+#endif
+
+    for (i = 0; i < TEST_FILES; i++)
+    {
+        int fd;
+
+        fd = test_open (names[i]);
+        mctest_assert_int_eq (mc_read (fd, buf, TEST_FILE_SIZE), TEST_FILE_SIZE);
+        mc_close (fd);
+    }
+
+#ifdef TEST_BENCHMARK
+    done = g_get_monotonic_time ();
+    printf ("zipfs: %d members listed in %.3f ms, read at %.1f files/s\n", TEST_FILES,
+            (double) (listed - start) / 1000.0,
+            TEST_FILES * 1000000.0 / (double) MAX (done - listed, 1));
+#endif
+
+    /* then */
+    mctest_assert_int_eq (count, TEST_FILES / 50);
+    mctest_assert_int_eq (memcmp (buf, big_data + TEST_FILES - 1, TEST_FILE_SIZE), 0);
+
+    g_free (buf);
+    g_strfreev (names);
+    g_free (members);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    mctest_add_parameterized_test (tc_core, test_zipfs_read, test_zipfs_read_ds);
+    tcase_add_test (tc_core, test_zipfs_not_zip);
+    tcase_add_test (tc_core, test_zipfs_unsupported);
+    tcase_add_test (tc_core, test_zipfs_many_members);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "zipfs.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
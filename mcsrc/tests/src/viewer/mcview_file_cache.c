@@ -0,0 +1,382 @@
+/*
+   src/viewer - test cache of file data
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/viewer"
+
+#include "tests/mctest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "lib/strutil.h"
+#include "lib/vfs/vfs.h"
+#include "src/vfs/local/local.h"
+
+#include "src/viewer/datasource.c"
+
+#define TEST_SIZE (80 * VIEW_FILE_BLOCK + 1000)
+
+#ifdef TEST_BENCHMARK
+/* mcview_file_cache_bench, not run by "make check": scroll up in wrap mode through a big file */
+#define BENCH_SIZE ((off_t) 1024 * 1024 * 1024)
+#define BENCH_SCROLL ((off_t) 64 * 1024 * 1024)
+#endif
+
+static char *test_file = NULL;
+static WView *view = NULL;
+
+/* @CapturedValue */
+static int mc_lseek__calls;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+off_t
+mc_lseek (int fd, off_t offset, int whence)
+{
+    struct vfs_class *vfs;
+    void *fsinfo = NULL;
+
+    mc_lseek__calls++;
+
+    vfs = vfs_class_find_by_handle (fd, &fsinfo);
+    return vfs->lseek (fsinfo, offset, whence);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char
+test_data_byte (off_t offset)
+{
+    /* lines of 100 characters */
+    return offset % 100 == 99 ? '\n' : (char) ('a' + (offset / 100 + offset % 100) % 26);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_write_file (off_t size)
+{
+    FILE *f;
+    char *buf;
+    off_t i;
+
+    /* pattern repeats after 2600 bytes */
+    buf = g_malloc (2600 * 128);
+    for (i = 0; i < 2600 * 128; i++)
+        buf[i] = test_data_byte (i);
+
+    f = fopen (test_file, "w");
+    for (i = 0; i < size; i += 2600 * 128)
+        fwrite (buf, 1, (size_t) MIN (size - i, 2600 * 128), f);
+    fclose (f);
+
+    g_free (buf);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_open_file (void)
+{
+    vfs_path_t *vpath;
+    struct stat st;
+    int fd;
+
+    vpath = vfs_path_from_str (test_file);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+    mctest_assert_true ((fd != -1));
+    mctest_assert_int_eq (mc_fstat (fd, &st), 0);
+
+    mcview_set_datasource_file (view, fd, &st);
+    mc_lseek__calls = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+test_check_byte (off_t offset)
+{
+    int c;
+
+    return mcview_get_byte (view, offset, &c) && c == (unsigned char) test_data_byte (offset);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_setup_work_dir ();
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-viewer.txt", (char *) NULL);
+    mcview_cache_size = 4096;
+
+    view = mcview_new (0, 0, 25, 80, FALSE);
+    view->data_area.top = 0;
+    view->data_area.left = 0;
+    view->data_area.height = 24;
+    view->data_area.width = 80;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    mcview_close_datasource (view);
+    g_free (view);
+
+    unlink (test_file);
+    MC_PTR_FREE (test_file);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_file_cache_forward)
+/* *INDENT-ON* */
+{
+    /* given */
+    off_t i;
+
+    test_write_file (TEST_SIZE);
+    test_open_file ();
+
+    /* when */
+    for (i = 0; i < TEST_SIZE; i++)
+        if (!test_check_byte (i))
+            break;
+
+    /* then: reads are growing */
+    mctest_assert_int_eq (i, TEST_SIZE);
+    mctest_assert_false (mcview_get_byte (view, TEST_SIZE, NULL));
+    mctest_assert_int_eq (mc_lseek__calls, 9);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_file_cache_backward)
+/* *INDENT-ON* */
+{
+    /* given */
+    off_t i;
+
+    test_write_file (TEST_SIZE);
+    test_open_file ();
+
+    /* when */
+    for (i = TEST_SIZE - 1; i >= 0; i--)
+        if (!test_check_byte (i))
+            break;
+
+    /* then: reads behind are growing too */
+    mctest_assert_int_eq (i, -1);
+    mctest_assert_int_eq (mc_lseek__calls, 9);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_file_cache_lru)
+/* *INDENT-ON* */
+{
+    /* given: room for two blocks */
+    mcview_cache_size = 2 * VIEW_FILE_BLOCK / 1024;
+    test_write_file (TEST_SIZE);
+    test_open_file ();
+
+    /* when */
+    mctest_assert_true (test_check_byte (0));
+    mctest_assert_true (test_check_byte (5 * VIEW_FILE_BLOCK));
+    mctest_assert_true (test_check_byte (10));
+
+    /* then */
+    mctest_assert_int_eq (mc_lseek__calls, 2);
+
+    /* when: least recently used block is dropped */
+    mctest_assert_true (test_check_byte (10 * VIEW_FILE_BLOCK));
+    mctest_assert_true (test_check_byte (20));
+    mctest_assert_true (test_check_byte (5 * VIEW_FILE_BLOCK + 20));
+
+    /* then */
+    mctest_assert_int_eq (mc_lseek__calls, 4);
+    mctest_assert_int_eq (g_hash_table_size (view->ds_file_blocks), 2);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_file_cache_utf8)
+/* *INDENT-ON* */
+{
+    /* given: character crossing boundary of blocks */
+    static const char euro[] = "\xe2\x82\xac";
+    char *data;
+    int ch, ch_len;
+
+    data = g_malloc0 (2 * VIEW_FILE_BLOCK);
+    memcpy (data + VIEW_FILE_BLOCK - 1, euro, 3);
+    mctest_assert_true (g_file_set_contents (test_file, data, 2 * VIEW_FILE_BLOCK, NULL));
+    g_free (data);
+    test_open_file ();
+
+    /* when */
+    mctest_assert_true (mcview_get_utf (view, VIEW_FILE_BLOCK - 1, &ch, &ch_len));
+
+    /* then */
+    mctest_assert_int_eq (ch, 0x20ac);
+    mctest_assert_int_eq (ch_len, 3);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_file_cache_truncate)
+/* *INDENT-ON* */
+{
+    /* given */
+    off_t i;
+
+    test_write_file (TEST_SIZE);
+    test_open_file ();
+    for (i = TEST_SIZE - 1; i >= 0; i--)
+        if (!test_check_byte (i))
+            break;
+    mctest_assert_int_eq (i, -1);
+
+    /* when: file is truncated by another process */
+    mctest_assert_int_eq (truncate (test_file, 1000), 0);
+    mcview_update_filesize (view);
+
+    /* then: cached data behind the end is dropped */
+    mctest_assert_int_eq (mcview_get_filesize (view), 1000);
+    mctest_assert_int_eq (g_hash_table_size (view->ds_file_blocks), 0);
+    mctest_assert_true (test_check_byte (999));
+    mctest_assert_false (mcview_get_byte (view, 1000, NULL));
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef TEST_BENCHMARK
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_file_cache_benchmark)
+/* *INDENT-ON* */
+{
+    /* given */
+    gint64 start, done;
+    int pages = 0;
+
+    test_write_file (BENCH_SIZE);
+    test_open_file ();
+    view->mode_flags.wrap = TRUE;
+    view->dpy_start = BENCH_SIZE;
+    mcview_state_machine_init (&view->dpy_state_top, view->dpy_start);
+
+    /* when */
+    start = g_get_monotonic_time ();
+    while (view->dpy_start > BENCH_SIZE - BENCH_SCROLL)
+    {
+        mcview_move_up (view, view->data_area.height - 1);
+        pages++;
+    }
+    done = g_get_monotonic_time ();
+
+    /* then */
+    printf ("cache: scrolled up %d pages (%d MiB) in %.1f ms, %d reads\n", pages,
+            (int) (BENCH_SCROLL >> 20), (double) (done - start) / 1000.0, mc_lseek__calls);
+
+    mctest_assert_int_eq (view->dpy_start % 100, 0);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+#endif /* TEST_BENCHMARK */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+#ifdef TEST_BENCHMARK
+    tcase_set_timeout (tc_core, 600);
+    tcase_add_test (tc_core, test_mcview_file_cache_benchmark);
+#else
+    tcase_add_test (tc_core, test_mcview_file_cache_forward);
+    tcase_add_test (tc_core, test_mcview_file_cache_backward);
+    tcase_add_test (tc_core, test_mcview_file_cache_lru);
+    tcase_add_test (tc_core, test_mcview_file_cache_utf8);
+    tcase_add_test (tc_core, test_mcview_file_cache_truncate);
+#endif
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "mcview_file_cache.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,285 @@
+/*
+   src/viewer - tests for growing buffer kept partly on disk
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/viewer"
+
+#include "tests/mctest.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "lib/strutil.h"
+#include "lib/vfs/vfs.h"
+#include "src/vfs/local/local.h"
+
+#include "src/viewer/growbuf.c"
+
+#define TEST_PAGES 40
+#define TEST_SIZE ((off_t) TEST_PAGES * VIEW_PAGE_SIZE + 1000)
+
+static char *test_file = NULL;
+static WView *view = NULL;
+
+/* @CapturedValue */
+static int mc_read__calls;
+
+/* @ThenReturnValue */
+static gboolean unlink__open_fails;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+ssize_t
+mc_read (int handle, void *buffer, size_t count)
+{
+    struct vfs_class *vfs;
+    void *fsinfo = NULL;
+
+    mc_read__calls++;
+
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
+    return vfs->read (fsinfo, buffer, count);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+int
+unlink (const char *pathname)
+{
+    /* like on Windows, the spill file can't be removed while it's open */
+    if (unlink__open_fails && view != NULL && view->growbuf_spill_fd != -1)
+    {
+        errno = EACCES;
+        return -1;
+    }
+
+    return unlinkat (AT_FDCWD, pathname, 0);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char
+test_data_byte (off_t offset)
+{
+    return (char) ((offset * 7 + offset / 4096) % 251);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+test_check_byte (off_t offset)
+{
+    int c;
+
+    return mcview_get_byte_growing_buffer (view, offset, &c)
+        && c == (unsigned char) test_data_byte (offset);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* file read as a stream, like a compressed one */
+static void
+test_open_pipe (void)
+{
+    vfs_path_t *vpath;
+    int fd;
+
+    vpath = vfs_path_from_str (test_file);
+    fd = mc_open (vpath, O_RDONLY);
+    vfs_path_free (vpath);
+    mctest_assert_true ((fd != -1));
+
+    mcview_set_datasource_vfs_pipe (view, fd);
+    mc_read__calls = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    FILE *f;
+    off_t i;
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_setup_work_dir ();
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-growbuf.bin", (char *) NULL);
+    f = fopen (test_file, "w");
+    for (i = 0; i < TEST_SIZE; i++)
+        fputc (test_data_byte (i), f);
+    fclose (f);
+
+    view = mcview_new (0, 0, 25, 80, FALSE);
+    unlink__open_fails = FALSE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    mcview_close_datasource (view);
+    g_free (view);
+
+    unlink (test_file);
+    MC_PTR_FREE (test_file);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_growbuf_memory)
+/* *INDENT-ON* */
+{
+    /* given */
+    mcview_growbuf_size = 65536;
+    test_open_pipe ();
+
+    /* when */
+    mcview_growbuf_read_all_data (view);
+
+    /* then: a page is read at once */
+    mctest_assert_int_eq (mcview_growbuf_filesize (view), TEST_SIZE);
+    mctest_assert_int_eq (mc_read__calls, TEST_PAGES + 2);
+    mctest_assert_int_eq (view->growbuf_lru.length, TEST_PAGES + 1);
+    mctest_assert_int_eq (view->growbuf_spill_fd, -1);
+    mctest_assert_true (test_check_byte (0));
+    mctest_assert_true (test_check_byte (TEST_SIZE - 1));
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_growbuf_spill)
+/* *INDENT-ON* */
+{
+    /* given: 4 pages in memory */
+    off_t i;
+
+    mcview_growbuf_size = 4 * (VIEW_PAGE_SIZE / 1024);
+    test_open_pipe ();
+
+    /* when */
+    for (i = 0; i < TEST_SIZE; i++)
+        if (!test_check_byte (i) || view->growbuf_lru.length > 4)
+            break;
+
+    /* then */
+    mctest_assert_int_eq (i, TEST_SIZE);
+    mctest_assert_false (mcview_get_byte_growing_buffer (view, TEST_SIZE, NULL));
+    mctest_assert_true (view->growbuf_finished);
+    mctest_assert_int_ne (view->growbuf_spill_fd, -1);
+    mctest_assert_int_eq (view->growbuf_spilled, TEST_PAGES);
+
+    /* when: going back */
+    for (i = TEST_SIZE - 1; i >= 0; i--)
+        if (!test_check_byte (i) || view->growbuf_lru.length > 4)
+            break;
+
+    /* then: pages are read from disk */
+    mctest_assert_int_eq (i, -1);
+    mctest_assert_int_eq (mcview_growbuf_filesize (view), TEST_SIZE);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_growbuf_spill_unlink)
+/* *INDENT-ON* */
+{
+    /* given */
+    char *spill_file;
+
+    mcview_growbuf_size = 4 * (VIEW_PAGE_SIZE / 1024);
+    unlink__open_fails = TRUE;
+    test_open_pipe ();
+
+    /* when */
+    mcview_growbuf_read_all_data (view);
+
+    /* then: spill file is kept while it's open */
+    mctest_assert_int_ne (view->growbuf_spill_fd, -1);
+    mctest_assert_not_null (view->growbuf_spill_vpath);
+    spill_file = g_strdup (vfs_path_as_str (view->growbuf_spill_vpath));
+    mctest_assert_true (g_file_test (spill_file, G_FILE_TEST_EXISTS));
+
+    /* when */
+    mcview_close_datasource (view);
+
+    /* then: and removed after closing */
+    mctest_assert_null (view->growbuf_spill_vpath);
+    mctest_assert_false (g_file_test (spill_file, G_FILE_TEST_EXISTS));
+    g_free (spill_file);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_mcview_growbuf_memory);
+    tcase_add_test (tc_core, test_mcview_growbuf_spill);
+    tcase_add_test (tc_core, test_mcview_growbuf_spill_unlink);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "mcview_growbuf.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
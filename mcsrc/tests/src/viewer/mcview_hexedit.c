@@ -0,0 +1,289 @@
+/*
+   src/viewer - tests for changes of hex editor
+
+   Copyright (C) 2020
+   Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_SUITE_NAME "/src/viewer"
+
+#include "tests/mctest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "lib/strutil.h"
+#include "lib/vfs/vfs.h"
+#include "src/vfs/local/local.h"
+
+#include "src/viewer/hex.c"
+
+#define TEST_SIZE 10000
+
+static char *test_file = NULL;
+static WView *view = NULL;
+
+/* @CapturedValue */
+static int mc_write__calls;
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Mock */
+ssize_t
+mc_write (int handle, const void *buffer, size_t count)
+{
+    struct vfs_class *vfs;
+    void *fsinfo = NULL;
+
+    mc_write__calls++;
+
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
+    return vfs->write (fsinfo, buffer, count);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static byte
+test_changed_byte (off_t offset)
+{
+    return (byte) (offset % 251) ^ 0xff;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* changed bytes: 7, 1000...2999, 5000 */
+static void
+test_enqueue_changes (void)
+{
+    off_t i;
+
+    mcview_enqueue_change (view, 5000, test_changed_byte (5000));
+    for (i = 2999; i >= 1000; i--)
+        mcview_enqueue_change (view, i, test_changed_byte (i));
+    mcview_enqueue_change (view, 7, test_changed_byte (7));
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+test_is_changed (off_t offset)
+{
+    return offset == 7 || offset == 5000 || (offset >= 1000 && offset < 3000);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Before */
+static void
+setup (void)
+{
+    FILE *f;
+    vfs_path_t *vpath;
+    struct stat st;
+    int fd, i;
+
+    str_init_strings (NULL);
+
+    vfs_init ();
+    vfs_init_localfs ();
+    vfs_setup_work_dir ();
+
+    test_file = g_build_filename (g_get_tmp_dir (), "mctest-hexedit.bin", (char *) NULL);
+    f = fopen (test_file, "w");
+    for (i = 0; i < TEST_SIZE; i++)
+        fputc (i % 256, f);
+    fclose (f);
+
+    view = mcview_new (0, 0, 25, 80, FALSE);
+
+    vpath = vfs_path_from_str (test_file);
+    fd = mc_open (vpath, O_RDONLY);
+    mctest_assert_true ((fd != -1));
+    mctest_assert_int_eq (mc_fstat (fd, &st), 0);
+    mcview_set_datasource_file (view, fd, &st);
+    view->filename_vpath = vpath;
+
+    mc_write__calls = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @After */
+static void
+teardown (void)
+{
+    mcview_hexedit_free_change_list (view);
+    mcview_close_datasource (view);
+    vfs_path_free (view->filename_vpath);
+    g_free (view);
+
+    unlink (test_file);
+    MC_PTR_FREE (test_file);
+
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_hexedit_find_change)
+/* *INDENT-ON* */
+{
+    /* given */
+    off_t i;
+
+    /* when */
+    test_enqueue_changes ();
+
+    /* then */
+    for (i = 0; i < TEST_SIZE; i++)
+    {
+        struct hexedit_change_node *node;
+
+        node = mcview_hexedit_find_change (view, i);
+        if (!test_is_changed (i))
+        {
+            mctest_assert_null (node);
+        }
+        else
+        {
+            mctest_assert_not_null (node);
+            mctest_assert_int_eq (node->offset, i);
+            mctest_assert_int_eq (node->value, test_changed_byte (i));
+        }
+    }
+
+    /* first changes to be displayed from offset */
+    mctest_assert_int_eq (mcview_hexedit_change (mcview_hexedit_first_change (view, 0))->offset, 7);
+    mctest_assert_int_eq (mcview_hexedit_change (mcview_hexedit_first_change (view, 7))->offset, 7);
+    mctest_assert_int_eq (mcview_hexedit_change (mcview_hexedit_first_change (view, 8))->offset,
+                          1000);
+    mctest_assert_int_eq (mcview_hexedit_change (mcview_hexedit_first_change (view, 2000))->offset,
+                          2000);
+    mctest_assert_int_eq (mcview_hexedit_change (mcview_hexedit_first_change (view, 3000))->offset,
+                          5000);
+    mctest_assert_null (mcview_hexedit_first_change (view, 5001));
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_hexedit_save_changes)
+/* *INDENT-ON* */
+{
+    /* given */
+    FILE *f;
+    int i;
+
+    test_enqueue_changes ();
+
+    /* when */
+    mctest_assert_true (mcview_hexedit_save_changes (view));
+
+    /* then: one write for each range of adjacent changes */
+    mctest_assert_int_eq (mc_write__calls, 3);
+    mctest_assert_null (view->change_list);
+
+    f = fopen (test_file, "r");
+    for (i = 0; i < TEST_SIZE; i++)
+    {
+        int c;
+
+        c = fgetc (f);
+        if (test_is_changed (i))
+        {
+            mctest_assert_int_eq (c, test_changed_byte (i));
+        }
+        else
+        {
+            mctest_assert_int_eq (c, i % 256);
+        }
+    }
+    mctest_assert_int_eq (fgetc (f), EOF);
+    fclose (f);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* @Test */
+/* *INDENT-OFF* */
+START_TEST (test_mcview_hexedit_fill)
+/* *INDENT-ON* */
+{
+    /* given */
+    GSequenceIter *curr;
+    off_t i;
+
+    /* when: every byte is typed, looked up before */
+    for (i = 0; i < TEST_SIZE; i++)
+        if (mcview_hexedit_find_change (view, i) == NULL)
+            mcview_enqueue_change (view, i, test_changed_byte (i));
+
+    /* then: changes are in order */
+    for (i = 0, curr = mcview_hexedit_first_change (view, 0); curr != NULL;
+         i++, curr = mcview_hexedit_next_change (curr))
+        if (mcview_hexedit_change (curr)->offset != i)
+            break;
+    mctest_assert_int_eq (i, TEST_SIZE);
+
+    /* then: they are written at once */
+    mctest_assert_true (mcview_hexedit_save_changes (view));
+    mctest_assert_int_eq (mc_write__calls, 1);
+}
+/* *INDENT-OFF* */
+END_TEST
+/* *INDENT-ON* */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_mcview_hexedit_find_change);
+    tcase_add_test (tc_core, test_mcview_hexedit_save_changes);
+    tcase_add_test (tc_core, test_mcview_hexedit_fill);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "mcview_hexedit.log");
+    srunner_run_all (sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -150,15 +150,23 @@ extern void                 tty_set_title(const char *title);
 #define ENABLE_CONFIGURE_ARGS 1                  /* 4.8.24+ */
 
 #define ENABLE_VFS 1
+#define ENABLE_VFS_AR 1
 #define ENABLE_VFS_CPIO 1
 #define ENABLE_VFS_TAR 1
 #define ENABLE_VFS_SFS 1
 #define ENABLE_VFS_EXTFS 1
 #define ENABLE_VFS_FTP 1
+#define ENABLE_VFS_ISO9660 1
 #undef  ENABLE_VFS_FISH
 #define ENABLE_VFS_SFTP 1                       /* libssh2 */
 #undef  ENABLE_VFS_SMB
 #undef  ENABLE_VFS_UNDELFS
+#define ENABLE_VFS_ZIP 1                        /* libz */
+
+#define HAVE_ZLIB 1                             /* libz, tar/cpio decompression, zip */
+#undef  HAVE_BZLIB
+#undef  HAVE_LZMA
+#undef  HAVE_ZSTD
 
 #define SIG_ATOMIC_VOLATILE_T int               /* FIXME */
 #define PROMOTED_MODE_T int                     /* FIXME */
@@ -95,6 +95,10 @@ if (!open (OUT, ">${outenc}", $out)) {          # output
 #       @RUBY@              ruby
 #       @UNZIP@             busybox unzip
 #       @ZIP@               busybox zip
+#       @ZIPFS_PREFIX@      zip
+#       @ARFS_PREFIX@       ar
+#       @DEBFS_PREFIX@      ar
+#       @ISO9660FS_PREFIX@  iso
 #
 
 my $busybox = '$(MC_BUSYBOX)';
@@ -139,6 +143,10 @@ while ($line = <IN>) {
         $line =~ s/\@RUBY\@/ruby/g;
         $line =~ s/\@UNZIP\@/${busybox} unzip/g;
         $line =~ s/\@ZIP\@/${busybox} zip/g;
+        $line =~ s/\@ZIPFS_PREFIX\@/zip/g;
+        $line =~ s/\@ARFS_PREFIX\@/ar/g;
+        $line =~ s/\@DEBFS_PREFIX\@/ar/g;
+        $line =~ s/\@ISO9660FS_PREFIX\@/iso/g;
 
         if ($line =~ /(\@[A-Za-z_]+\@)/) {
 		    my $var = $1;